@@ -97,6 +97,8 @@ local_ void *		g_pExitHandlerArg = nil;
 
 local_ mxGlobalLogger	g_Logger;
 
+local_ AsyncJobQueue *	g_jobQueue = nil;
+
 }//anonymous namespace
 
 /*================================
@@ -119,6 +121,10 @@ mxBaseSubsystem::mxBaseSubsystem()
 
 	TypeRegistry::Initialize();
 
+	// Start worker threads.
+	g_jobQueue = AsyncJobQueue::StaticCreate();
+	g_jobQueue->Initialize();
+
 	//mxUtil_StartLogging( &GetGlobalLogger() );
 }
 //---------------------------------------------------------------------------
@@ -128,6 +134,14 @@ mxBaseSubsystem::~mxBaseSubsystem()
 		g_pExitHandler( g_pExitHandlerArg );
 	}
 
+	// Stop worker threads.
+	if( g_jobQueue != nil )
+	{
+		g_jobQueue->Release();
+		free_one( g_jobQueue );
+		g_jobQueue = nil;
+	}
+
 	// Destroy the type system.
 	TypeRegistry::Destroy();
 
@@ -158,6 +172,16 @@ mxLogManager& GetGlobalLogger()
 	return mxGlobalLogger::Get();
 }
 
+/*
+================================
+	GetGlobalJobQueue
+================================
+*/
+AsyncJobQueue* GetGlobalJobQueue()
+{
+	return g_jobQueue;
+}
+
 /*
 ================================
 	mxBaseSystemIsInitialized
@@ -167,6 +167,130 @@ bool FileReader::IsMapped() const
 	return (mMappedData != nil);
 }
 
+/*================================
+			FileMapping
+================================*/
+
+namespace
+{
+	// views must start at multiples of the allocation granularity (usually 64 KiB)
+	static SizeT F_GetAllocationGranularity()
+	{
+		static SizeT granularity = 0;
+		if( !granularity )
+		{
+			SYSTEM_INFO	systemInfo;
+			::GetSystemInfo( &systemInfo );
+			granularity = systemInfo.dwAllocationGranularity;
+		}
+		return granularity;
+	}
+}//namespace
+
+FileMapping::FileMapping()
+{
+	mHandle = InvalidFileHandle;
+	mMapping = nil;
+	mSize = 0;
+}
+
+FileMapping::~FileMapping()
+{
+	this->Close();
+}
+
+bool FileMapping::Open( const char* fileName )
+{
+	AssertPtr( fileName );
+	Assert( !this->IsOpen() );
+
+	mHandle = FS_OpenFile( fileName, EAccessMode::ReadAccess, EAccessPattern::Random );
+	if( !FS_IsValid(mHandle) ) {
+		mxErrf( "Failed to open file '%s' for mapping\n", fileName );
+		return false;
+	}
+
+	mSize = FS_GetFileSize( mHandle );
+	if( mSize == 0 || mSize == INVALID_FILE_SIZE ) {
+		mxErrf( "Failed to map file '%s' of zero size\n", fileName );
+		this->Close();
+		return false;
+	}
+
+	// copy-on-write so that in-place loaders can patch pointers
+	mMapping = ::CreateFileMapping( mHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if( mMapping == nil ) {
+		mxErrf( "CreateFileMapping('%s') failed\n", fileName );
+		this->Close();
+		return false;
+	}
+
+	return true;
+}
+
+void FileMapping::Close()
+{
+	if( mMapping != nil ) {
+		::CloseHandle( mMapping );
+		mMapping = nil;
+	}
+	if( FS_IsValid(mHandle) ) {
+		FS_CloseFile( mHandle );
+	}
+	mHandle = InvalidFileHandle;
+	mSize = 0;
+}
+
+bool FileMapping::IsOpen() const
+{
+	return (mMapping != nil);
+}
+
+BYTE* FileMapping::MapView( SizeT offset, SizeT numBytes, void *&viewBase ) const
+{
+	Assert(this->IsOpen());
+	Assert( numBytes > 0 && offset + numBytes <= mSize );
+
+	const SizeT viewOffset = offset & ~(F_GetAllocationGranularity() - 1);
+	const SizeT viewSize = (offset - viewOffset) + numBytes;
+	const U8 viewOffset64 = viewOffset;
+
+	viewBase = ::MapViewOfFile( mMapping, FILE_MAP_COPY, (DWORD)(viewOffset64 >> 32), (DWORD)viewOffset64, viewSize );
+	if( viewBase == nil ) {
+		mxErrf( "MapViewOfFile(offset=%u, size=%u) failed\n", (UINT)viewOffset, (UINT)viewSize );
+		return nil;
+	}
+
+	return c_cast(BYTE*) viewBase + (offset - viewOffset);
+}
+
+void FileMapping::UnmapView( void* viewBase )
+{
+	AssertPtr( viewBase );
+	::UnmapViewOfFile( viewBase );
+}
+
+void FileMapping::Prefetch( SizeT offset, SizeT numBytes ) const
+{
+	void* viewBase;
+	const BYTE* data = this->MapView( offset, numBytes, viewBase );
+	if( data == nil ) {
+		return;
+	}
+
+	// touch one byte in each page, the OS reads ahead around page faults;
+	// the pages stay in the file cache after the view is unmapped
+	const volatile BYTE* start = data - (offset & (PAGE_SIZE-1));
+	const volatile BYTE* end = data + numBytes;
+
+	for( const volatile BYTE* p = start; p < end; p += PAGE_SIZE )
+	{
+		(void)*p;
+	}
+
+	UnmapView( viewBase );
+}
+
 /*================================
 			FileWriter
 ================================*/
@@ -117,6 +117,49 @@ private:
 	void *	mMappedData;
 };
 
+/*
+-----------------------------------------------------------------------------
+	FileMapping
+
+	maps parts of the file into the address space on demand
+	(large files don't fit into the address space of a 32-bit process);
+	pages are loaded on first access and shared with the OS file cache.
+	views are copy-on-write: written pages become private copies of the view
+	and changes are never saved into the file.
+-----------------------------------------------------------------------------
+*/
+class FileMapping
+{
+public:
+	FileMapping();
+	~FileMapping();
+
+	// creates the mapping object, nothing is mapped yet
+	bool	Open( const char* fileName );
+	void	Close();
+
+	bool	IsOpen() const;
+
+	FORCEINLINE SizeT	GetSize() const { return mSize; }
+
+	// maps the given range of the file and returns a pointer to its first byte (nil on failure);
+	// 'viewBase' receives the start of the view which must be passed to UnmapView()
+	BYTE *	MapView( SizeT offset, SizeT numBytes, void *&viewBase ) const;
+	static void	UnmapView( void* viewBase );
+
+	// hints that the given range will be read soon: faults in its pages
+	// so that the following sequential accesses don't stall on each page;
+	// blocks until the pages are read, so it should be called on a background thread
+	void	Prefetch( SizeT offset, SizeT numBytes ) const;
+
+private:
+	FileHandle	mHandle;
+	HANDLE		mMapping;
+	SizeT		mSize;
+
+	PREVENT_COPY(FileMapping);
+};
+
 /*
 -----------------------------------------------------------------------------
 	FileWriter
@@ -1,7 +1,7 @@
 /*
 =============================================================================
 File:	JobSystem.cpp
-Desc:	
+Desc:
 =============================================================================
 */
 
@@ -10,10 +10,25 @@ Desc:
 #include <Base.h>
 
 #include <JobSystem/JobSystem.h>
-#include <JobSystem/Win32/ThreadPoolWin32.h>
+#include <JobSystem/JobSystem_Private.h>
 
-enum { MAXJOBTHREADS = 32 };
-enum { MAXJOBS = 256 };
+// number of failed attempts to find work before a worker goes to sleep
+enum { WORKER_SPIN_COUNT = 64 };
+enum { WORKER_SLEEP_MSEC = 2 };
+
+// the deques of external threads are accessed under a lock
+enum { EXTERNAL_QUEUE_SIZE = 1024 };
+
+namespace
+{
+	// the queue which owns the calling thread and the thread's index in that queue
+	MX_THREAD_LOCAL AsyncJobQueue_WorkStealing *	tls_jobQueue = nil;
+	MX_THREAD_LOCAL INT								tls_workerIndex = INDEX_NONE;
+
+	// the task being executed on the calling thread
+	MX_THREAD_LOCAL TaskID							tls_currentTask = INVALID_TASK_ID;
+
+}//namespace
 
 AsyncJobQueue::SInitArgs::SInitArgs()
 {
@@ -23,13 +38,376 @@ AsyncJobQueue::SInitArgs::SInitArgs()
 	threadWorkspaceSize = 0;
 }
 
-AsyncJobQueue* AsyncJobQueue::StaticCreate()
+/*================================
+	AsyncJobQueue_WorkStealing
+================================*/
+
+AsyncJobQueue_WorkStealing::AsyncJobQueue_WorkStealing()
+{
+	m_numThreads = 0;
+	m_numPendingJobs = 0;
+	m_quit = 0;
+	m_initialized = false;
+}
+
+AsyncJobQueue_WorkStealing::~AsyncJobQueue_WorkStealing()
+{
+	Assert( !m_initialized );
+}
+
+void AsyncJobQueue_WorkStealing::Initialize( const SInitArgs& cInfo )
+{
+	Assert( !m_initialized );
+
+	UINT numThreads = cInfo.numThreads;
+	if( !numThreads ) {
+		numThreads = (UINT) mxGetNumCpuCores();
+	}
+	numThreads = Clamp< UINT >( numThreads, 1, MAXJOBTHREADS );
+
+	const UINT maxJobs = CeilPowerOfTwo( cInfo.maxJobs ? cInfo.maxJobs : MAXJOBS );
+
+	m_taskPool.Init( maxJobs );
+
+	// any deque can hold all the tasks, pushes never fail
+	for( UINT iWorker = 0; iWorker < numThreads; iWorker++ )
+	{
+		for( UINT iLane = 0; iLane < AsyncJob::NumPriorities; iLane++ )
+		{
+			m_workers[ iWorker ].lanes[ iLane ].Initialize( maxJobs );
+		}
+	}
+	for( UINT iLane = 0; iLane < AsyncJob::NumPriorities; iLane++ )
+	{
+		m_external[ iLane ].Initialize( EXTERNAL_QUEUE_SIZE );
+	}
+
+	m_numThreads = numThreads;
+	m_numPendingJobs = 0;
+	m_quit = 0;
+
+	// the calling thread becomes worker zero
+	tls_jobQueue = this;
+	tls_workerIndex = 0;
+
+	for( UINT iWorker = 1; iWorker < numThreads; iWorker++ )
+	{
+		m_threads[ iWorker ].Setup( this, iWorker );
+		m_threads[ iWorker ].Create( cInfo.threadStackSize );
+	}
+
+	m_initialized = true;
+
+	DBGOUT("AsyncJobQueue: started %u worker threads\n", numThreads - 1);
+}
+
+void AsyncJobQueue_WorkStealing::Release()
+{
+	if( !m_initialized ) {
+		return;
+	}
+
+	this->WaitForAllJobs();
+
+	AtomicExchange( &m_quit, 1 );
+
+	for( UINT iWorker = 1; iWorker < m_numThreads; iWorker++ )
+	{
+		m_threads[ iWorker ].WakeUp();
+	}
+	for( UINT iWorker = 1; iWorker < m_numThreads; iWorker++ )
+	{
+		m_threads[ iWorker ].Wait();
+	}
+
+	for( UINT iWorker = 0; iWorker < m_numThreads; iWorker++ )
+	{
+		for( UINT iLane = 0; iLane < AsyncJob::NumPriorities; iLane++ )
+		{
+			m_workers[ iWorker ].lanes[ iLane ].Shutdown();
+		}
+	}
+	for( UINT iLane = 0; iLane < AsyncJob::NumPriorities; iLane++ )
+	{
+		m_external[ iLane ].Shutdown();
+	}
+
+	m_taskPool.Shutdown();
+
+	if( tls_jobQueue == this )
+	{
+		tls_jobQueue = nil;
+		tls_workerIndex = INDEX_NONE;
+	}
+
+	m_numThreads = 0;
+	m_initialized = false;
+}
+
+TaskID AsyncJobQueue_WorkStealing::AddTask( AsyncJob* newTask, AsyncJob::EJobPriority priority, TaskID parent )
+{
+	AssertPtr( newTask );
+	Assert( m_initialized );
+	Assert( priority >= 0 && priority < AsyncJob::NumPriorities );
+
+	const INT workerIndex = this->CurrentWorkerIndex();
+
+	STask* task = m_taskPool.Allocate( newTask, priority, parent );
+	while( task == nil )
+	{
+		// the pool is exhausted, help with the work until a slot is freed
+		if( !this->RunOneTask( workerIndex ) ) {
+			YieldProcessor();
+		}
+		task = m_taskPool.Allocate( newTask, priority, parent );
+	}
+
+	const TaskID taskId = task->id;
+
+	AtomicIncrement( m_numPendingJobs );
+
+	bool queued = false;
+	if( workerIndex != INDEX_NONE )
+	{
+		queued = m_workers[ workerIndex ].lanes[ priority ].Push( task );
+	}
+	else
+	{
+		mxScopedMutex	lock( &m_externalLock );
+		queued = m_external[ priority ].Push( task );
+	}
+
+	if( queued ) {
+		this->WakeUpOneWorker();
+	} else {
+		this->Execute( task );	// no room, run it right away
+	}
+
+	return taskId;
+}
+
+bool AsyncJobQueue_WorkStealing::IsTaskCompleted( TaskID taskId ) const
+{
+	return m_taskPool.IsCompleted( taskId );
+}
+
+TaskID AsyncJobQueue_WorkStealing::CurrentTask() const
+{
+	return tls_currentTask;
+}
+
+void AsyncJobQueue_WorkStealing::WaitForTask( TaskID taskId )
+{
+	const INT workerIndex = this->CurrentWorkerIndex();
+
+	while( !m_taskPool.IsCompleted( taskId ) )
+	{
+		if( !this->RunOneTask( workerIndex ) ) {
+			YieldProcessor();
+		}
+	}
+}
+
+void AsyncJobQueue_WorkStealing::WaitForAllJobs()
+{
+	const INT workerIndex = this->CurrentWorkerIndex();
+
+	while( m_numPendingJobs > 0 )
+	{
+		if( !this->RunOneTask( workerIndex ) ) {
+			YieldProcessor();
+		}
+	}
+}
+
+UINT AsyncJobQueue_WorkStealing::NumThreads() const
+{
+	return m_numThreads;
+}
+
+void AsyncJobQueue_WorkStealing::WorkerLoop( UINT workerIndex )
 {
-	UNDONE;
+	tls_jobQueue = this;
+	tls_workerIndex = workerIndex;
+
+	mxWorkerThread & thread = m_threads[ workerIndex ];
+
+	UINT numFailedAttempts = 0;
+
+	while( !m_quit )
+	{
+		if( this->RunOneTask( workerIndex ) )
+		{
+			numFailedAttempts = 0;
+			continue;
+		}
+		if( ++numFailedAttempts < WORKER_SPIN_COUNT )
+		{
+			YieldProcessor();
+			continue;
+		}
+		thread.Sleep( WORKER_SLEEP_MSEC );
+		numFailedAttempts = 0;
+	}
+
+	tls_jobQueue = nil;
+	tls_workerIndex = INDEX_NONE;
+}
+
+INT AsyncJobQueue_WorkStealing::CurrentWorkerIndex() const
+{
+	return (tls_jobQueue == this) ? tls_workerIndex : INDEX_NONE;
+}
+
+STask* AsyncJobQueue_WorkStealing::FindWork( INT workerIndex )
+{
+	const UINT numThreads = m_numThreads;
+
+	// higher priority lanes are always drained first
+	for( INT iLane = AsyncJob::NumPriorities - 1; iLane >= 0; iLane-- )
+	{
+		STask* task = nil;
+
+		if( workerIndex != INDEX_NONE )
+		{
+			task = m_workers[ workerIndex ].lanes[ iLane ].Pop();
+			if( task ) {
+				return task;
+			}
+		}
+
+		task = m_external[ iLane ].Steal();
+		if( task ) {
+			return task;
+		}
+
+		// start with the next thread to spread thieves evenly among victims
+		const UINT start = (workerIndex != INDEX_NONE) ? workerIndex + 1 : 0;
+		for( UINT i = 0; i < numThreads; i++ )
+		{
+			const UINT victim = (start + i) % numThreads;
+			if( victim == (UINT)workerIndex ) {
+				continue;
+			}
+			task = m_workers[ victim ].lanes[ iLane ].Steal();
+			if( task ) {
+				return task;
+			}
+		}
+	}
 	return nil;
 }
 
-NO_EMPTY_FILE;
+bool AsyncJobQueue_WorkStealing::RunOneTask( INT workerIndex )
+{
+	STask* task = this->FindWork( workerIndex );
+	if( task != nil )
+	{
+		this->Execute( task );
+		return true;
+	}
+	return false;
+}
+
+void AsyncJobQueue_WorkStealing::Execute( STask* task )
+{
+	AssertPtr( task->job );
+
+	// tasks can be nested when waiting inside jobs
+	const TaskID prevTask = tls_currentTask;
+	tls_currentTask = task->id;
+
+	task->job->Run();
+
+	tls_currentTask = prevTask;
+
+	m_taskPool.Finish( task );
+
+	AtomicDecrement( m_numPendingJobs );
+}
+
+void AsyncJobQueue_WorkStealing::WakeUpOneWorker()
+{
+	for( UINT iWorker = 1; iWorker < m_numThreads; iWorker++ )
+	{
+		if( m_threads[ iWorker ].WakeUp() ) {
+			break;
+		}
+	}
+}
+
+/*================================
+	AsyncJobQueue_Serial
+================================*/
+
+AsyncJobQueue_Serial::AsyncJobQueue_Serial()
+{
+	m_lastTaskId = INVALID_TASK_ID;
+}
+
+void AsyncJobQueue_Serial::Initialize( const SInitArgs& cInfo )
+{
+	mxUNUSED(cInfo);
+	m_lastTaskId = INVALID_TASK_ID;
+}
+
+void AsyncJobQueue_Serial::Release()
+{
+}
+
+TaskID AsyncJobQueue_Serial::AddTask( AsyncJob* newTask, AsyncJob::EJobPriority priority, TaskID parent )
+{
+	AssertPtr( newTask );
+	mxUNUSED(priority);
+	mxUNUSED(parent);
+
+	// children are executed before the parent's Run() returns
+	newTask->Run();
+
+	if( ++m_lastTaskId == INVALID_TASK_ID ) {
+		++m_lastTaskId;
+	}
+	return m_lastTaskId;
+}
+
+bool AsyncJobQueue_Serial::IsTaskCompleted( TaskID taskId ) const
+{
+	mxUNUSED(taskId);
+	return true;
+}
+
+TaskID AsyncJobQueue_Serial::CurrentTask() const
+{
+	return INVALID_TASK_ID;
+}
+
+void AsyncJobQueue_Serial::WaitForTask( TaskID taskId )
+{
+	mxUNUSED(taskId);
+}
+
+void AsyncJobQueue_Serial::WaitForAllJobs()
+{
+}
+
+UINT AsyncJobQueue_Serial::NumThreads() const
+{
+	return 1;
+}
+
+/*================================
+		AsyncJobQueue
+================================*/
+
+AsyncJobQueue* AsyncJobQueue::StaticCreate()
+{
+	// the serial job system is always enabled on single-core CPUs
+	if( MX_USE_SERIAL_JOB_SYSTEM || mxGetNumCpuCores() == 1 )
+	{
+		return new_one( AsyncJobQueue_Serial() );
+	}
+	return new_one( AsyncJobQueue_WorkStealing() );
+}
 
 //--------------------------------------------------------------//
 //				End Of File.									//
@@ -17,6 +17,8 @@
 // Config
 enum { TP_MAX_THREADS = 32 };
 
+#include "TaskPool.h"
+
 /*
 -----------------------------------------------------------------------------
 	AsyncJob
@@ -31,6 +33,8 @@ public:	// Declarations
 		Priority_Normal,
 		Priority_High,
 		Priority_Realtime,
+
+		NumPriorities	// Marker. Don't use.
 	};
 
 public:
@@ -63,7 +67,7 @@ public:	// Declarations
 
 		UINT	maxJobs;
 		
-		// The program stack size for each thread
+		// The program stack size for each thread (default=0 - the stack size of the executable)
 		UINT	threadStackSize;
 
 		UINT	threadWorkspaceSize;
@@ -79,14 +83,39 @@ public:
 	virtual void Initialize( const SInitArgs& cInfo = SInitArgs() ) = 0;
 	virtual void Release() = 0;
 
-	virtual void AddTask( AsyncJob* newTask ) = 0;
+	// Schedules the job for execution.
+	// If 'parent' is given, the parent task will not be completed
+	// until this task has been completed
+	// (children must be added before the parent's Run() returns).
+	virtual TaskID AddTask(
+		AsyncJob* newTask,
+		AsyncJob::EJobPriority priority = AsyncJob::Priority_Normal,
+		TaskID parent = INVALID_TASK_ID
+	) = 0;
+
+	virtual bool IsTaskCompleted( TaskID taskId ) const = 0;
+
+	// returns the ID of the task being executed on the calling thread
+	// (to be used as a parent for child tasks)
+	virtual TaskID CurrentTask() const = 0;
 
+	// Executes pending jobs on the calling thread while waiting
+	// for the given task and all of its children to complete.
+	virtual void WaitForTask( TaskID taskId ) = 0;
+
+	// Executes pending jobs on the calling thread until the queue is empty.
 	virtual void WaitForAllJobs() = 0;
 
+	// including the thread which initialized the queue
+	virtual UINT NumThreads() const = 0;
+
 public:
 	static AsyncJobQueue* StaticCreate();
 };
 
+// the job queue started by the base system (valid between mxInitializeBase() and mxShutdownBase())
+AsyncJobQueue* GetGlobalJobQueue();
+
 #endif /* !__MX_JOB_SYSTEM_H__ */
 
 //--------------------------------------------------------------//
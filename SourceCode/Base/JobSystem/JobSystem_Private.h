@@ -0,0 +1,118 @@
+/*
+=============================================================================
+	File:	JobSystem_Private.h
+	Desc:	Work-stealing implementation of AsyncJobQueue, internal header.
+=============================================================================
+*/
+#pragma once
+
+#include "JobSystem.h"
+#include "WorkerThread.h"
+
+enum { MAXJOBTHREADS = TP_MAX_THREADS };
+enum { MAXJOBS = 4096 };
+
+/*
+-----------------------------------------------------------------------------
+	AsyncJobQueue_WorkStealing
+
+	Each thread (including the one which initialized the queue)
+	owns one deque per priority level, idle threads steal from the others.
+	Jobs added from foreign threads go into a shared, mutex-protected deque.
+-----------------------------------------------------------------------------
+*/
+class AsyncJobQueue_WorkStealing : public AsyncJobQueue
+{
+public:
+	AsyncJobQueue_WorkStealing();
+	virtual ~AsyncJobQueue_WorkStealing();
+
+	virtual void Initialize( const SInitArgs& cInfo = SInitArgs() ) override;
+	virtual void Release() override;
+
+	virtual TaskID AddTask(
+		AsyncJob* newTask,
+		AsyncJob::EJobPriority priority = AsyncJob::Priority_Normal,
+		TaskID parent = INVALID_TASK_ID
+	) override;
+
+	virtual bool IsTaskCompleted( TaskID taskId ) const override;
+	virtual TaskID CurrentTask() const override;
+	virtual void WaitForTask( TaskID taskId ) override;
+	virtual void WaitForAllJobs() override;
+
+	virtual UINT NumThreads() const override;
+
+public_internal:
+	// entry point of worker threads
+	void WorkerLoop( UINT workerIndex );
+
+private:
+	// returns the worker index of the calling thread or INDEX_NONE for foreign threads
+	INT CurrentWorkerIndex() const;
+
+	STask* FindWork( INT workerIndex );
+
+	// returns false if there was nothing to do
+	bool RunOneTask( INT workerIndex );
+
+	void Execute( STask* task );
+
+	void WakeUpOneWorker();
+
+private:
+	struct WorkerData
+	{
+		mxWorkStealingQueue	lanes[ AsyncJob::NumPriorities ];
+	};
+
+	WorkerData			m_workers[ MAXJOBTHREADS ];
+	mxWorkerThread		m_threads[ MAXJOBTHREADS ];	// [0] is unused (the main thread)
+	UINT				m_numThreads;
+
+	// jobs from threads not owned by this queue
+	mxWorkStealingQueue	m_external[ AsyncJob::NumPriorities ];
+	mxCriticalSection	m_externalLock;
+
+	TaskPool			m_taskPool;
+
+	AtomicInt			m_numPendingJobs;	// queued or running
+	AtomicInt			m_quit;
+	bool				m_initialized;
+};
+
+/*
+-----------------------------------------------------------------------------
+	AsyncJobQueue_Serial
+
+	Runs jobs immediately on the calling thread.
+-----------------------------------------------------------------------------
+*/
+class AsyncJobQueue_Serial : public AsyncJobQueue
+{
+public:
+	AsyncJobQueue_Serial();
+
+	virtual void Initialize( const SInitArgs& cInfo = SInitArgs() ) override;
+	virtual void Release() override;
+
+	virtual TaskID AddTask(
+		AsyncJob* newTask,
+		AsyncJob::EJobPriority priority = AsyncJob::Priority_Normal,
+		TaskID parent = INVALID_TASK_ID
+	) override;
+
+	virtual bool IsTaskCompleted( TaskID taskId ) const override;
+	virtual TaskID CurrentTask() const override;
+	virtual void WaitForTask( TaskID taskId ) override;
+	virtual void WaitForAllJobs() override;
+
+	virtual UINT NumThreads() const override;
+
+private:
+	TaskID	m_lastTaskId;
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
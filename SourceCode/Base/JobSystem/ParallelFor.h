@@ -0,0 +1,255 @@
+/*
+=============================================================================
+	File:	ParallelFor.h
+	Desc:	Fork-join loops over index ranges built on top of AsyncJobQueue.
+	Usage:
+		struct UpdateBodies
+		{
+			TList< Body > &	bodies;
+			void operator () ( UINT begin, UINT end ) const { ... }
+		};
+		UpdateBodies	functor = { m_bodies };
+		ParallelFor( GetGlobalJobQueue(), 0, m_bodies.Num(), 0, functor );
+=============================================================================
+*/
+
+#ifndef __MX_PARALLEL_FOR_H__
+#define __MX_PARALLEL_FOR_H__
+
+#include "JobSystem.h"
+
+enum {
+	// automatic grain sizing: aim for this many chunks per thread to balance the load
+	PARALLEL_FOR_CHUNKS_PER_THREAD = 8,
+	// don't bother with smaller chunks
+	PARALLEL_FOR_MIN_GRAIN_SIZE = 16,
+};
+
+// tag for splitting constructors of ParallelReduce() bodies
+enum EParallelSplit { ParallelSplit };
+
+namespace ParallelFor_Util
+{
+	// returns the size of a single chunk of work or zero if the loop should be executed serially
+	inline UINT CalcGrainSize( const AsyncJobQueue* queue, UINT count, UINT grainSize )
+	{
+		if( MX_USE_SERIAL_JOB_SYSTEM || queue == nil || count == 0 ) {
+			return 0;
+		}
+		const UINT numThreads = queue->NumThreads();
+		if( numThreads < 2 ) {
+			return 0;
+		}
+		if( !grainSize ) {
+			grainSize = largest( count / (numThreads * PARALLEL_FOR_CHUNKS_PER_THREAD), (UINT)PARALLEL_FOR_MIN_GRAIN_SIZE );
+		}
+		return (count > grainSize) ? grainSize : 0;
+	}
+
+	// returns the number of helper jobs to fork (the calling thread also works on the loop)
+	inline UINT CalcNumHelpers( const AsyncJobQueue* queue, UINT count, UINT grainSize )
+	{
+		const UINT numChunks = (count + grainSize - 1) / grainSize;
+		return smallest( queue->NumThreads(), numChunks ) - 1;
+	}
+
+	// the loop range shared by all participants, chunks are grabbed dynamically
+	struct SharedRange
+	{
+		AtomicInt	next;
+		UINT		end;
+		UINT		grainSize;
+
+	public:
+		// returns false if there's no more work
+		FORCEINLINE bool GrabChunk( UINT &chunkBegin, UINT &chunkEnd )
+		{
+			const UINT start = (UINT) AtomicAdd( next, grainSize );
+			if( start >= end ) {
+				return false;
+			}
+			chunkBegin = start;
+			chunkEnd = smallest( start + grainSize, end );
+			return true;
+		}
+	};
+
+}//namespace ParallelFor_Util
+
+/*
+-----------------------------------------------------------------------------
+	TParallelForJob
+-----------------------------------------------------------------------------
+*/
+template< class FUNCTOR >
+struct TParallelForJob : public AsyncJob
+{
+	FUNCTOR *						functor;
+	ParallelFor_Util::SharedRange *	range;
+
+public:
+	virtual int Run() override
+	{
+		UINT chunkBegin, chunkEnd;
+		while( range->GrabChunk( chunkBegin, chunkEnd ) )
+		{
+			(*functor)( chunkBegin, chunkEnd );
+		}
+		return 0;
+	}
+};
+
+/*
+-----------------------------------------------------------------------------
+	ParallelFor
+
+	Calls functor( chunkBegin, chunkEnd ) for disjoint sub-ranges of [begin, end)
+	and returns when the whole range has been processed.
+	Pass zero 'grainSize' to select the chunk size automatically.
+	Runs serially if the queue is single-threaded or the range is too small.
+-----------------------------------------------------------------------------
+*/
+template< class FUNCTOR >
+void ParallelFor( AsyncJobQueue* queue, UINT begin, UINT end, UINT grainSize, FUNCTOR & functor )
+{
+	if( begin >= end ) {
+		return;
+	}
+	const UINT count = end - begin;
+
+	grainSize = ParallelFor_Util::CalcGrainSize( queue, count, grainSize );
+	if( !grainSize )
+	{
+		functor( begin, end );
+		return;
+	}
+
+	ParallelFor_Util::SharedRange	range;
+	range.next = begin;
+	range.end = end;
+	range.grainSize = grainSize;
+
+	TParallelForJob< FUNCTOR >	jobs[ TP_MAX_THREADS ];
+	TaskID						taskIds[ TP_MAX_THREADS ];
+
+	// fork
+	const UINT numHelpers = ParallelFor_Util::CalcNumHelpers( queue, count, grainSize );
+	for( UINT i = 0; i < numHelpers; i++ )
+	{
+		jobs[i].functor = &functor;
+		jobs[i].range = &range;
+		taskIds[i] = queue->AddTask( &jobs[i], AsyncJob::Priority_High );
+	}
+
+	// the calling thread does its share of work
+	TParallelForJob< FUNCTOR >	localJob;
+	localJob.functor = &functor;
+	localJob.range = &range;
+	localJob.Run();
+
+	// join
+	for( UINT i = 0; i < numHelpers; i++ )
+	{
+		queue->WaitForTask( taskIds[i] );
+	}
+}
+
+/*
+-----------------------------------------------------------------------------
+	TParallelReduceJob
+-----------------------------------------------------------------------------
+*/
+template< class BODY >
+struct TParallelReduceJob : public AsyncJob
+{
+	BODY							body;
+	ParallelFor_Util::SharedRange *	range;
+
+public:
+	TParallelReduceJob( BODY & other, ParallelFor_Util::SharedRange* sharedRange )
+		: body( other, ParallelSplit )
+		, range( sharedRange )
+	{}
+	virtual int Run() override
+	{
+		UINT chunkBegin, chunkEnd;
+		while( range->GrabChunk( chunkBegin, chunkEnd ) )
+		{
+			body( chunkBegin, chunkEnd );
+		}
+		return 0;
+	}
+};
+
+/*
+-----------------------------------------------------------------------------
+	ParallelReduce
+
+	BODY must provide:
+		BODY( BODY& other, EParallelSplit );	// creates an empty accumulator
+		void operator () ( UINT begin, UINT end );	// accumulates a sub-range
+		void Join( const BODY& other );	// merges partial results into this body
+
+	The final result ends up in 'body'.
+-----------------------------------------------------------------------------
+*/
+template< class BODY >
+void ParallelReduce( AsyncJobQueue* queue, UINT begin, UINT end, UINT grainSize, BODY & body )
+{
+	typedef TParallelReduceJob< BODY > JOB;
+
+	if( begin >= end ) {
+		return;
+	}
+	const UINT count = end - begin;
+
+	grainSize = ParallelFor_Util::CalcGrainSize( queue, count, grainSize );
+	if( !grainSize )
+	{
+		body( begin, end );
+		return;
+	}
+
+	ParallelFor_Util::SharedRange	range;
+	range.next = begin;
+	range.end = end;
+	range.grainSize = grainSize;
+
+	const UINT numHelpers = ParallelFor_Util::CalcNumHelpers( queue, count, grainSize );
+
+	// bodies are not default-constructible, so use raw memory
+	JOB* jobs = (JOB*) mxAllocX( EMemHeap::HeapTemp, numHelpers * sizeof(JOB) );
+	TaskID taskIds[ TP_MAX_THREADS ];
+
+	// fork
+	for( UINT i = 0; i < numHelpers; i++ )
+	{
+		new( &jobs[i] ) JOB( body, &range );
+		taskIds[i] = queue->AddTask( &jobs[i], AsyncJob::Priority_High );
+	}
+
+	// the calling thread accumulates directly into the given body
+	{
+		UINT chunkBegin, chunkEnd;
+		while( range.GrabChunk( chunkBegin, chunkEnd ) )
+		{
+			body( chunkBegin, chunkEnd );
+		}
+	}
+
+	// join
+	for( UINT i = 0; i < numHelpers; i++ )
+	{
+		queue->WaitForTask( taskIds[i] );
+		body.Join( jobs[i].body );
+		jobs[i].~JOB();
+	}
+
+	mxFreeX( EMemHeap::HeapTemp, jobs );
+}
+
+#endif // !__MX_PARALLEL_FOR_H__
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
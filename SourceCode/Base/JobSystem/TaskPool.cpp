@@ -1,12 +1,142 @@
+/*
+=============================================================================
+	File:	TaskPool.cpp
+	Desc:
+=============================================================================
+*/
 #include <Base_PCH.h>
 #pragma hdrstop
 #include <Base.h>
 
 #include "JobSystem/TaskPool.h"
 
-void TaskPool::Init()
+TaskPool::TaskPool()
 {
-	//
+	m_tasks = nil;
+	m_mask = 0;
+	m_nextTaskId = INVALID_TASK_ID;
+	m_numLiveTasks = 0;
 }
 
-NO_EMPTY_FILE
+TaskPool::~TaskPool()
+{
+	Assert( m_tasks == nil );
+}
+
+void TaskPool::Init( UINT maxTasks )
+{
+	Assert( m_tasks == nil );
+
+	const UINT numSlots = CeilPowerOfTwo( largest( maxTasks, 2 ) );
+
+	m_tasks = (STask*) mxAlloc( numSlots * sizeof(STask) );
+	MemZero( m_tasks, numSlots * sizeof(STask) );
+
+	m_mask = numSlots - 1;
+	m_nextTaskId = INVALID_TASK_ID;
+	m_numLiveTasks = 0;
+}
+
+void TaskPool::Shutdown()
+{
+	Assert( m_numLiveTasks == 0 );
+	if( m_tasks != nil )
+	{
+		mxFree( m_tasks );
+		m_tasks = nil;
+	}
+	m_mask = 0;
+}
+
+STask* TaskPool::Allocate( AsyncJob* job, UINT priority, TaskID parent )
+{
+	AssertPtr( job );
+
+	if( AtomicIncrement( m_numLiveTasks ) > (int)Capacity() )
+	{
+		AtomicDecrement( m_numLiveTasks );
+		return nil;
+	}
+
+	// there is at least one free slot - scan the ring until we claim it
+	STask* task = nil;
+	TaskID newId = INVALID_TASK_ID;
+	for(;;)
+	{
+		newId = (TaskID) AtomicIncrement( m_nextTaskId );
+		if( newId == INVALID_TASK_ID ) {
+			continue;	// wrapped around
+		}
+		STask* slot = &m_tasks[ newId & m_mask ];
+		if( AtomicCAS( &slot->numWorkItems, 0, 1 ) )
+		{
+			task = slot;
+			break;
+		}
+	}
+
+	task->parent = INVALID_TASK_ID;
+	task->affinity = 0;
+	task->priority = priority;
+	task->job = job;
+
+	if( parent != INVALID_TASK_ID )
+	{
+		STask* parentTask = GetTask( parent );
+		if( parentTask != nil )
+		{
+			AtomicIncrement( parentTask->numWorkItems );
+			task->parent = parent;
+		}
+	}
+
+	// publish the ID last so that waiters on a stale ID see a consistent slot
+	_WriteBarrier();
+	task->id = newId;
+
+	return task;
+}
+
+STask* TaskPool::GetTask( TaskID id )
+{
+	STask* task = &m_tasks[ id & m_mask ];
+	if( task->id != id || task->numWorkItems == 0 ) {
+		return nil;
+	}
+	return task;
+}
+
+bool TaskPool::IsCompleted( TaskID id ) const
+{
+	if( id == INVALID_TASK_ID ) {
+		return true;
+	}
+	const STask& task = m_tasks[ id & m_mask ];
+	return task.id != id || task.numWorkItems == 0;
+}
+
+bool TaskPool::Finish( STask* task )
+{
+	// read before the slot can be recycled
+	const TaskID parent = task->parent;
+
+	Assert( task->numWorkItems > 0 );
+	if( AtomicDecrement( task->numWorkItems ) != 0 ) {
+		return false;
+	}
+
+	AtomicDecrement( m_numLiveTasks );
+
+	if( parent != INVALID_TASK_ID )
+	{
+		STask* parentTask = &m_tasks[ parent & m_mask ];
+		if( parentTask->id == parent ) {
+			Finish( parentTask );
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
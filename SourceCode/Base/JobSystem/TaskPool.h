@@ -1,20 +1,78 @@
+/*
+=============================================================================
+	File:	TaskPool.h
+	Desc:	Fixed-size pool of task descriptors with parent/child counters.
+=============================================================================
+*/
 #pragma once
 
+struct AsyncJob;
+
 typedef U4 TaskID;
 
+// zero is never handed out by the task pool
+enum { INVALID_TASK_ID = 0 };
+
+/*
+-----------------------------------------------------------------------------
+	STask
+
+	A task is completed when its job has been run
+	and all of its children have been completed.
+-----------------------------------------------------------------------------
+*/
 struct STask
 {
-	TaskID	id;
-	TaskID	parent;
-	UINT	numWorkItems;	// zero when the task is completed
-	UINT	affinity;
-	UINT	priority;
+	TaskID		id;
+	TaskID		parent;
+	AtomicInt	numWorkItems;	// zero when the task is completed (1 for the job itself + number of unfinished children)
+	UINT		affinity;
+	UINT		priority;
+	AsyncJob *	job;
 };
 
+/*
+-----------------------------------------------------------------------------
+	TaskPool
+
+	Task slots are recycled in a ring, task IDs are never reused
+	so that a stale TaskID can always be safely queried.
+-----------------------------------------------------------------------------
+*/
 struct TaskPool
 {
+	STask *		m_tasks;
+	UINT		m_mask;			// number of task slots minus one
+	AtomicInt	m_nextTaskId;
+	AtomicInt	m_numLiveTasks;	// number of allocated, not yet completed tasks
 
 public:
-	void Init();
+	TaskPool();
+	~TaskPool();
+
+	// 'maxTasks' will be rounded up to the next power of two
+	void Init( UINT maxTasks );
+	void Shutdown();
 
+	// Grabs a free task slot, returns nil if the pool is exhausted.
+	// NOTE: children must be added before the parent's job has finished running.
+	STask* Allocate( AsyncJob* job, UINT priority, TaskID parent = INVALID_TASK_ID );
+
+	// returns nil if the task has already been completed and its slot recycled
+	STask* GetTask( TaskID id );
+
+	bool IsCompleted( TaskID id ) const;
+
+	// Decrements the number of outstanding work items,
+	// propagates completion to the parent task.
+	// Returns true if the task has been completed.
+	bool Finish( STask* task );
+
+	FORCEINLINE UINT Capacity() const { return m_mask + 1; }
+	FORCEINLINE UINT NumLiveTasks() const { return m_numLiveTasks; }
+	FORCEINLINE bool IsFull() const { return (UINT)m_numLiveTasks >= Capacity(); }
 };
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
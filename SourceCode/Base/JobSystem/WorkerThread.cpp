@@ -1,144 +1,165 @@
+/*
+=============================================================================
+	File:	WorkerThread.cpp
+	Desc:
+=============================================================================
+*/
 #include <Base_PCH.h>
 #pragma hdrstop
 #include <Base.h>
 
-#if 0
-#include <JobSystem/WorkerThread.h>
+#include "JobSystem/JobSystem_Private.h"
 
-// Description:
-// A helper function to print out a friendly error code.
-// Arguments:
-// where - Specifies where the error occurred.
-// Return Value List:
-// PE_RESULT_UNKNOWN_ERROR - The error is unknown (to Phyre)
-static PResult HandleLastError(const PChar *where)
-{
-	DWORD dwLastError = GetLastError();
+/*================================
+		mxWorkStealingQueue
+================================*/
 
-	LPSTR MessageBuffer;
+mxWorkStealingQueue::mxWorkStealingQueue()
+{
+	m_tasks = nil;
+	m_mask = 0;
+	m_top = 0;
+	m_bottom = 0;
+}
 
-	// Call FormatMessage() to allow for message text to be acquired from the system or from the supplied module handle.
-	DWORD dwBufferLength = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_FROM_SYSTEM,
-											NULL,
-											dwLastError,
-											MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), // default language
-											(LPSTR) &MessageBuffer,
-											0,
-											NULL);
+mxWorkStealingQueue::~mxWorkStealingQueue()
+{
+	this->Shutdown();
+}
 
-	if (dwBufferLength)
-	{
-		(void)where; // Unused in release builds
-		PHYRE_SET_LAST_ERROR(PE_RESULT_UNKNOWN_ERROR, "%s: Windows Error: %d\n\t%s", where, dwLastError, MessageBuffer);
+void mxWorkStealingQueue::Initialize( UINT capacity )
+{
+	Assert( m_tasks == nil );
+	Assert( IsPowerOfTwo( capacity ) );
 
-		// Free the buffer allocated by the system.
-		LocalFree(MessageBuffer);
+	m_tasks = (STask**) mxAlloc( capacity * sizeof(m_tasks[0]) );
+	m_mask = capacity - 1;
+	m_top = 0;
+	m_bottom = 0;
+}
 
-		return PE_RESULT_UNKNOWN_ERROR;
-	}
-	else
+void mxWorkStealingQueue::Shutdown()
+{
+	if( m_tasks != nil )
 	{
-		return PHYRE_SET_LAST_ERROR(PE_RESULT_UNKNOWN_ERROR, "%s: Windows Error: %d", where, dwLastError);
+		mxFree( m_tasks );
+		m_tasks = nil;
 	}
+	m_mask = 0;
+	m_top = 0;
+	m_bottom = 0;
 }
 
-PThreadWin32::PThreadWin32()
-	: m_handle(NULL)
+bool mxWorkStealingQueue::Push( STask* task )
 {
+	const INT b = m_bottom;
+	const INT t = m_top;
+	if( b - t > (INT)m_mask ) {
+		return false;
+	}
+	m_tasks[ b & m_mask ] = task;
+
+	// the task must be visible to thieves before the new bottom
+	_WriteBarrier();
+
+	m_bottom = b + 1;
+	return true;
 }
 
-// Description:
-// Creates a new thread.
-// Arguments:
-// threadInit - Thread initialization parameters.
-// Return Value List:
-// true:		Thread created successfully.
-// PE_RESULT_OUT_OF_MEMORY:	Unable to allocate thread storage.
-// PE_RESULT_UNKNOWN_ERROR:	OS error occurred.
-bool PThreadWin32::initialize(const SCreateThreadArgs &threadInit)
+STask* mxWorkStealingQueue::Pop()
 {
-	DWORD		threadID	= 0;
-	m_handle = CreateThread(
-		NULL,											// default security attributes
-		threadInit.m_stackSize,							// use default stack size
-		(LPTHREAD_START_ROUTINE)threadInit.m_entryPoint,// thread function
-		threadInit.m_userData,							// argument to thread function
-		0,												// use default creation flags
-		&threadID);										// returns the thread identifier
-
-	if(m_handle == NULL)
-		return HandleLastError("Unable to allocate thread");
-
-	const char	*threadName	= threadInit.m_threadName;
-	if(threadName && threadID)
-	{
-		typedef struct tagTHREADNAME_INFO
-		{
-			DWORD dwType; // must be 0x1000
-			LPCSTR szName; // pointer to name (in user addr space)
-			DWORD dwThreadID; // thread ID (-1=caller thread)
-			DWORD dwFlags; // reserved for future use, must be zero
-		} THREADNAME_INFO;
-
-		THREADNAME_INFO info;
-		info.dwType = 0x1000;
-		info.szName = threadName;
-		info.dwThreadID = threadID;
-		info.dwFlags = 0;
-
-		__try
-		{
-			RaiseException(0x406D1388, 0, sizeof(info) / sizeof(DWORD), (ULONG_PTR*)&info);
-		}
-		__except(EXCEPTION_CONTINUE_EXECUTION)
-		{
-		}
-	}
+	const INT b = m_bottom - 1;
+
+	// full fence: the store to 'bottom' must be globally visible before we read 'top'
+	AtomicExchange( &m_bottom, b );
 
-	// Set the priority based on required priority
-	switch (threadInit.m_priority)
+	const INT t = m_top;
+	if( t > b )
 	{
-	case PE_THREADPRIORITY_HIGHER:
-		SetThreadPriority(m_handle, THREAD_PRIORITY_ABOVE_NORMAL);
-		break;
-	case PE_THREADPRIORITY_LOWER:
-		SetThreadPriority(m_handle, THREAD_PRIORITY_BELOW_NORMAL);
-		break;
-	case PE_THREADPRIORITY_SAME:
-	default:
-		break;
+		// empty
+		m_bottom = t;
+		return nil;
 	}
 
-	m_isInitialized = true;
+	STask* task = m_tasks[ b & m_mask ];
+	if( t != b ) {
+		return task;	// more than one item left, no contention with thieves
+	}
 
-	return true;
+	// the last item, race against thieves
+	if( !AtomicCAS( &m_top, t, t + 1 ) ) {
+		task = nil;
+	}
+	m_bottom = t + 1;
+	return task;
 }
 
-// Description:
-// Wait for the completion of the thread.
-// Arguments:
-// threadResult - Result returned by the thread.
+STask* mxWorkStealingQueue::Steal()
+{
+	const INT t = m_top;
+
+	_ReadWriteBarrier();
+
+	const INT b = m_bottom;
+	if( t >= b ) {
+		return nil;
+	}
+
+	STask* task = m_tasks[ t & m_mask ];
+	if( !AtomicCAS( &m_top, t, t + 1 ) ) {
+		return nil;	// lost the race against the owner or another thief
+	}
+	return task;
+}
 
-bool PThreadWin32::join(U4 &threadResult)
+bool mxWorkStealingQueue::IsEmpty() const
 {
-	WaitForSingleObject(m_handle, INFINITE);
+	return m_bottom <= m_top;
+}
 
-	DWORD	result;
-	GetExitCodeThread(m_handle, &result);
+/*================================
+		mxWorkerThread
+================================*/
 
-	threadResult = result;
+mxWorkerThread::mxWorkerThread()
+	: m_wakeUpEvent( false/*bManualReset*/, false/*bSignalled*/ )
+{
+	m_scheduler = nil;
+	m_workerIndex = 0;
+	m_isSleeping = 0;
+}
 
-	return true;
+void mxWorkerThread::Setup( AsyncJobQueue_WorkStealing* scheduler, UINT workerIndex )
+{
+	m_scheduler = scheduler;
+	m_workerIndex = workerIndex;
+	m_isSleeping = 0;
 }
 
-// Description:
-// Removes a thread from the list of threads.
+void mxWorkerThread::Run()
+{
+	AssertPtr( m_scheduler );
+	m_scheduler->WorkerLoop( m_workerIndex );
+}
 
-bool PThreadWin32::terminate()
+bool mxWorkerThread::WakeUp()
 {
-	m_isInitialized = false;
+	if( AtomicCAS( &m_isSleeping, 1, 0 ) )
+	{
+		m_wakeUpEvent.Signal();
+		return true;
+	}
+	return false;
+}
 
-	return true;
+void mxWorkerThread::Sleep( UINT timeoutMsec )
+{
+	AtomicExchange( &m_isSleeping, 1 );
+	// the timeout covers the window between the last check for work and going to sleep
+	m_wakeUpEvent.WaitTimeout( timeoutMsec );
+	AtomicExchange( &m_isSleeping, 0 );
 }
-#endif
-NO_EMPTY_FILE
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -1,43 +1,82 @@
+/*
+=============================================================================
+	File:	WorkerThread.h
+	Desc:	Per-worker task deques and worker threads of the job system.
+=============================================================================
+*/
 #pragma once
 
-// Description:
-// ThreadEntryPoint_F defines the entry point function pointer for a thread.
-// Arguments:
-// userData :  The pointer to the user data passed to the PThread::initialize() function.
-// Returns:
-// The OS dependent thread completion value.
-typedef U4 (*ThreadEntryPoint_F)(void *userData);
-
-// Description:
-// An enumerated type describing the relative thread priority of a thread being created.
-enum EThreadPriority
-{
-	PE_THREADPRIORITY_HIGHER = 0,		// The thread being created is of a higher priority.
-	PE_THREADPRIORITY_SAME,				// The thread being created is of the same priority.
-	PE_THREADPRIORITY_LOWER				// The thread being created is of a lower priority.
-};
+#include "TaskPool.h"
 
-class SCreateThreadArgs
-{
-public:	
-	ThreadEntryPoint_F	m_entryPoint;			// The entry point for the new thread.
-	U4				m_stackSize;			// The size of the stack for the new thread. 0 implies that the size of the stack is standard for the operating system. Defaults to PD_DEFAULT_THREAD_STACK_SIZE.
-	void				*m_userData;			// The pointer to user data for the new thread.
-	EThreadPriority		m_priority;				// The priority of created thread relative to the current thread. Defaults to PE_THREADPRIORITY_SAME.
-	const char			*m_threadName;			// Optional. The name for thread, which can be up to 27 characters excluding the NULL terminator. Defaults to NULL.
-	U4				m_flags;				// The creation flags for this thread. This value is constructed from the logical OR of PThreadCreationFlags.
+class AsyncJobQueue_WorkStealing;
 
+/*
+-----------------------------------------------------------------------------
+	mxWorkStealingQueue
+
+	Fixed-size Chase-Lev deque.
+	The owner thread pushes and pops at the bottom (LIFO, cache-friendly),
+	other threads steal from the top (FIFO, oldest and usually biggest tasks).
+-----------------------------------------------------------------------------
+*/
+class mxWorkStealingQueue
+{
 public:
-	SCreateThreadArgs(ThreadEntryPoint_F entryPoint);
+	mxWorkStealingQueue();
+	~mxWorkStealingQueue();
+
+	// 'capacity' must be a power of two
+	void Initialize( UINT capacity );
+	void Shutdown();
+
+	// Owner thread only.
+	// Returns false if the deque is full.
+	bool Push( STask* task );
+
+	// Owner thread only.
+	STask* Pop();
+
+	// Can be called from any thread.
+	STask* Steal();
+
+	bool IsEmpty() const;
+
+private:
+	STask **	m_tasks;
+	UINT		m_mask;
+	AtomicInt	m_top;		// the next task to be stolen
+	AtomicInt	m_bottom;	// the next free slot for pushing
+
+	PREVENT_COPY(mxWorkStealingQueue);
 };
 
-class PThreadWin32
+/*
+-----------------------------------------------------------------------------
+	mxWorkerThread
+-----------------------------------------------------------------------------
+*/
+class mxWorkerThread : public mxThread
 {
-	HANDLE m_handle;								// The Win32 handle for the thread.
+public:
+	mxWorkerThread();
+
+	void Setup( AsyncJobQueue_WorkStealing* scheduler, UINT workerIndex );
 
-protected:
-	PThreadWin32();
-	bool initialize(const SCreateThreadArgs &threadInit);
-	bool join(U4 &threadResult);
-	bool terminate();
+	virtual void Run() override;
+
+	// wakes the thread up if it's sleeping, returns false if it's busy
+	bool WakeUp();
+
+	// called by the worker thread when it has run out of work
+	void Sleep( UINT timeoutMsec );
+
+private:
+	AsyncJobQueue_WorkStealing *	m_scheduler;
+	UINT			m_workerIndex;
+	AtomicInt		m_isSleeping;
+	mxEvent			m_wakeUpEvent;
 };
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
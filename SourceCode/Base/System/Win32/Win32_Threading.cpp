@@ -67,14 +67,14 @@ static DWORD WINAPI ThreadFunction( LPVOID lpParam )
 //
 //	mxThread::Create
 //
-bool mxThread::Create()
+bool mxThread::Create( UINT stackSize )
 {
 	hThread = ::CreateThread(
 		NULL,			// LPSECURITY_ATTRIBUTES
-		0,				// dwStackSize
+		stackSize,		// dwStackSize
 		(LPTHREAD_START_ROUTINE) ThreadFunction,	// lpStartAddress
 		(LPVOID) this,	// lpParameter
-		0,
+		stackSize ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0,	// dwCreationFlags
 		(LPDWORD) &threadId
 	);
 
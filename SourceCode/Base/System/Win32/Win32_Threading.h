@@ -662,7 +662,8 @@ INLINE bool mxEvent::Peek() const
 
 		// These functions return false in case of failure.
 
-		bool			Create();
+		// 'stackSize' - bytes of address space reserved for the stack (0 - use the default stack size of the executable)
+		bool			Create( UINT stackSize = 0 );
 		bool			Suspend();
 		bool			Resume();
 		bool			Wait();	// wait for completion
@@ -11,6 +11,8 @@
 
 #include <Core/Kernel.h>
 #include <Core/Resources.h>
+#include <Core/Resource/Streaming.h>
+#include <Core/Serialization/PackageFile.h>
 
 mxNAMESPACE_BEGIN
 
@@ -76,12 +78,15 @@ SResourceLoadArgs::SResourceLoadArgs( AFilePackage* package, PakFileHandle fileH
 	m_dataSize = package->GetFileSize( fileHandle );
 	Assert(m_dataSize > 0);
 	m_mappedData = nil;
+	m_ownsMappedData = false;
+	m_preloaded = false;
 }
 
 SResourceLoadArgs::~SResourceLoadArgs()
 {
 	if( m_mappedData != nil )
 	{
+		m_preloaded = false;
 		this->Unmap();
 	}
 	m_package->CloseFile( m_fileHandle );
@@ -89,11 +94,18 @@ SResourceLoadArgs::~SResourceLoadArgs()
 
 SizeT SResourceLoadArgs::Read( void *pBuffer, SizeT numBytes )
 {
-	Assert(m_mappedData == nil);
 	Assert(m_readOffset < m_dataSize + numBytes);
 	UINT bytesToRead = Min<UINT>( m_dataSize - m_readOffset, numBytes );
 
-	m_package->ReadFile( m_fileHandle, m_readOffset, pBuffer, numBytes );
+	if( m_preloaded )
+	{
+		MemCopy( pBuffer, m_mappedData + m_readOffset, bytesToRead );
+	}
+	else
+	{
+		Assert(m_mappedData == nil);
+		m_package->ReadFile( m_fileHandle, m_readOffset, pBuffer, numBytes );
+	}
 
 	m_readOffset += bytesToRead;
 	return bytesToRead;
@@ -106,21 +118,51 @@ SizeT SResourceLoadArgs::GetSize() const
 
 BYTE* SResourceLoadArgs::Map()
 {
+	if( m_preloaded )
+	{
+		return m_mappedData;
+	}
+
 	Assert(nil == m_mappedData);
+
+	// zero-copy if the package can be mapped
+	m_mappedData = m_package->MapFile( m_fileHandle );
+	if( m_mappedData != nil )
+	{
+		m_ownsMappedData = false;
+		return m_mappedData;
+	}
+
 	const SizeT dataSize = m_dataSize;
 	void* data = mxAllocX( EMemHeap::HeapStreaming, dataSize );
 	const SizeT readSize = this->Read( data, dataSize );
 	Assert( readSize == dataSize );
 	(void)readSize;
 	m_mappedData = c_cast(BYTE*) data;
+	m_ownsMappedData = true;
 	return m_mappedData;
 }
 
 void SResourceLoadArgs::Unmap()
 {
 	Assert(nil != m_mappedData);
-	mxFreeX( EMemHeap::HeapStreaming, m_mappedData );
+	if( m_preloaded ) {
+		return;	// released in destructor
+	}
+	if( m_ownsMappedData ) {
+		mxFreeX( EMemHeap::HeapStreaming, m_mappedData );
+	} else {
+		m_package->UnmapFile( m_fileHandle );
+	}
 	m_mappedData = nil;
+	m_ownsMappedData = false;
+}
+
+void SResourceLoadArgs::Preload()
+{
+	Assert(!m_preloaded);
+	this->Map();
+	m_preloaded = true;
 }
 
 /*
@@ -268,13 +310,18 @@ namespace
 
 		NullContentDatabase		dummyDatabase;
 
+		// recorded sequences of loaded resources
+		TList< PakAccessTrace >	accessTraces;
+		bool					isTracing;
+
 		// put large structures at the end
-		//StreamEngine	streamer;
+		StreamEngine		streamer;
 
 	public:
 		ResourceSystemData()
 		{
 			database = &dummyDatabase;
+			isTracing = false;
 		}
 	};
 
@@ -305,6 +352,26 @@ namespace
 		return defaultInstance;
 	}
 
+	static inline
+	void F_RecordAccess( ObjectGUIDArg resourceGuid )
+	{
+		if( m_data->isTracing && resourceGuid.IsValid() )
+		{
+			m_data->accessTraces.GetLast().guids.Add( resourceGuid );
+		}
+	}
+
+	// caches resources loaded by the streamer
+	static
+	void F_OnResourceStreamed( EAssetType resourceType, ObjectGUIDArg resourceGuid, SResourceObject* resource )
+	{
+		LookUpKey	key;
+		key.guid = resourceGuid;
+		key.type = resourceType;
+
+		F_InsertNewResource( key, resource );
+	}
+
 }//namespace
 
 mxDEFINE_CLASS(ResourceSystem);
@@ -355,6 +422,9 @@ AResourceManager* ResourceSystem::GetManager( EAssetType resourceType )
 
 void ResourceSystem::SetContentDatabase( AContentDatabase* resourceDatabase )
 {
+	// the streaming thread must not read ahead from the old database
+	m_data->streamer.CancelPrefetches( m_data->database );
+
 	if( resourceDatabase != nil )
 	{
 		DBGOUT("ResourceSystem::SetContentDatabase: %s\n",resourceDatabase->rttiGetTypeName());
@@ -375,6 +445,9 @@ void ResourceSystem::Clear()
 {
 	this->uiBeginRefresh();
 
+	m_data->streamer.Flush( &F_OnResourceStreamed );
+	m_data->streamer.CancelPrefetches( m_data->database );
+
 	m_data->loadedMap.Empty();
 
 	// NOTABUG: resource databases are core system objects, they are persistent
@@ -399,6 +472,8 @@ void ResourceSystem::Serialize( mxArchive& archive )
 
 void ResourceSystem::Tick( const SResourceUpdateArgs& args )
 {
+	m_data->streamer.Update( &F_OnResourceStreamed );
+
 	m_data->loadedMap.GrowIfNeeded();
 }
 
@@ -471,6 +546,20 @@ SResourceObject* ResourceSystem::GetResourceByGuid( EAssetType resourceType, Obj
 		return cachedInstance;
 	}
 
+	// the resource may be being loaded in the background
+
+	const StreamRequestHandle request = m_data->streamer.FindRequest( resourceType, resourceGuid );
+	if( request != BadStreamRequestHandle )
+	{
+		m_data->streamer.Finish( request, &F_OnResourceStreamed );
+
+		cachedInstance = m_data->loadedMap.FindRef( key );
+		if(PtrToBool( cachedInstance ))
+		{
+			return cachedInstance;
+		}
+	}
+
 	// load and cache the resource
 
 	SResourceObject *	newInstance = nil;
@@ -483,17 +572,30 @@ SResourceObject* ResourceSystem::GetResourceByGuid( EAssetType resourceType, Obj
 
 		if( resourceGuid.IsValid() )
 		{
+			// the streaming thread may be reading the database;
+			// the lock is released before creating the resource
+			// so that nested loads don't block the streaming thread
+			mxCriticalSection & ioLock = m_data->streamer.GetIOLock();
+			ioLock.Enter();
+
+			F_RecordAccess( resourceGuid );
+
 			const PakFileHandle fileHandle = database->OpenFile( resourceGuid );
 			if( fileHandle != BadPakFileHandle )
 			{
 				//DBGOUT("Loading '%s'.\n",this->GetContentDatabase()->GuidToAssetPath(resourceGuid).ToChars());
 
 				SResourceLoadArgs	loadArgs( database, fileHandle );
+				loadArgs.Preload();
+
+				ioLock.Leave();
 
 				newInstance = manager->LoadResource( loadArgs );
 			}
 			else
 			{
+				ioLock.Leave();
+
 				newInstance = F_OnResourceFailedToLoad( manager, resourceType, resourceGuid );
 			}
 		}
@@ -514,6 +616,133 @@ SResourceObject* ResourceSystem::GetResourceByGuid( EAssetType resourceType, Obj
 	return nil;
 }
 
+void ResourceSystem::PrefetchResources( const ObjectGUID* resourceGuids, UINT numResources )
+{
+	AContentDatabase* database = m_data->database;
+	CHK_VRET_IF_NIL( database );
+
+	for( UINT i = 0; i < numResources; i++ )
+	{
+		F_RecordAccess( resourceGuids[i] );
+	}
+
+	// faulting in pages blocks, so it's done by the streaming thread
+	m_data->streamer.Prefetch( database, resourceGuids, numResources );
+}
+
+StreamRequestHandle ResourceSystem::RequestResource(
+	EAssetType resourceType,
+	ObjectGUIDArg resourceGuid,
+	EStreamPriority priority,
+	FStreamCallback* callback,
+	void* userData
+	)
+{
+	AResourceManager* manager = this->GetManager( resourceType );
+	AssertPtr( manager );
+	CHK_VRET_X_IF_NIL( manager, BadStreamRequestHandle );
+
+	StreamEngine & streamer = m_data->streamer;
+
+	// share the request if the resource is already being loaded
+	StreamRequestHandle request = streamer.FindRequest( resourceType, resourceGuid );
+	if( request != BadStreamRequestHandle )
+	{
+		streamer.AddRef( request );
+		streamer.SetPriority( request, priority );
+	}
+	else
+	{
+		LookUpKey	key;
+		key.guid = resourceGuid;
+		key.type = resourceType;
+
+		// loaded resources are passed to the callback in the next Tick()
+		SResourceObject* loadedInstance = m_data->loadedMap.FindRef( key );
+
+		if( !PtrToBool( loadedInstance ) && resourceGuid.IsNull() )
+		{
+			loadedInstance = F_OnResourceFailedToLoad( manager, resourceType, resourceGuid );
+		}
+
+		// the streaming thread opens files in the order of the current layout,
+		// so record the order of requests
+		if( !PtrToBool( loadedInstance ) )
+		{
+			F_RecordAccess( resourceGuid );
+		}
+
+		request = streamer.Submit( resourceType, resourceGuid, manager, m_data->database, priority, loadedInstance );
+	}
+
+	if( callback != nil && request != BadStreamRequestHandle )
+	{
+		streamer.AddCallback( request, callback, userData );
+	}
+
+	return request;
+}
+
+EStreamStatus ResourceSystem::GetRequestStatus( StreamRequestHandle request )
+{
+	return m_data->streamer.GetStatus( request );
+}
+
+SResourceObject* ResourceSystem::GetRequestedResource( StreamRequestHandle request )
+{
+	SResourceObject* resource = m_data->streamer.GetResult( request );
+	if(PtrToBool( resource ))
+	{
+		return resource;
+	}
+
+	// use the fallback resource until the resource is ready
+	const EAssetType resourceType = m_data->streamer.GetResourceType( request );
+	CHK_VRET_NIL_IF_NOT( resourceType != EAssetType::Asset_Unknown );
+
+	return this->GetDefaultInstance( resourceType );
+}
+
+void ResourceSystem::SetRequestPriority( StreamRequestHandle request, EStreamPriority priority )
+{
+	m_data->streamer.SetPriority( request, priority );
+}
+
+void ResourceSystem::ReleaseRequest( StreamRequestHandle request )
+{
+	m_data->streamer.Release( request );
+}
+
+void ResourceSystem::BeginAccessTrace( const char* name )
+{
+	AssertPtr( name );
+	Assert( !m_data->isTracing );
+
+	PakAccessTrace & newTrace = m_data->accessTraces.Add();
+	newTrace.name = name;
+
+	m_data->isTracing = true;
+}
+
+void ResourceSystem::EndAccessTrace()
+{
+	Assert( m_data->isTracing );
+	m_data->isTracing = false;
+}
+
+bool ResourceSystem::SaveAccessTraces( const char* fileName )
+{
+	CHK_VRET_FALSE_IF_NOT( Pak_SaveAccessTraces( fileName, m_data->accessTraces ) );
+
+	DBGOUT("Saved %u access traces to '%s'\n", m_data->accessTraces.Num(), fileName);
+	return true;
+}
+
+void ResourceSystem::FlushRequests()
+{
+	m_data->streamer.Flush( &F_OnResourceStreamed );
+}
+
 static inline
 const LookUpKey* F_FindKeyByPointer( const void* o )
 {
@@ -0,0 +1,719 @@
+/*
+=============================================================================
+	File:	Streaming.cpp
+	Desc:	Background loading of resources.
+=============================================================================
+*/
+
+#include <Core_PCH.h>
+#pragma hdrstop
+#include <Core.h>
+
+#include <Base/Util/Sorting.h>
+
+#include <Core/Resource/Streaming.h>
+
+mxNAMESPACE_BEGIN
+
+namespace
+{
+	enum { MAX_STREAM_REQUESTS = 0xFFFF };
+
+	FORCEINLINE StreamRequestHandle F_MakeRequestHandle( UINT slot, UINT generation )
+	{
+		return (generation << 16) | slot;
+	}
+
+	// the most important requests first, then in the order of file offsets
+	struct CompareRequests
+	{
+		FORCEINLINE bool operator () ( const StreamRequest* a, const StreamRequest* b ) const
+		{
+			if( a->priority != b->priority ) {
+				return a->priority > b->priority;
+			}
+			return a->fileOffset < b->fileOffset;
+		}
+	};
+
+	// returns false if the resources can only be loaded on the main thread
+	static bool F_CanLoadOnWorkers( AResourceManager* manager )
+	{
+		// tasks of a single-threaded queue would only be executed when the main thread waits for them
+		AsyncJobQueue* jobQueue = GetGlobalJobQueue();
+		return manager->CanLoadAsync()
+			&& jobQueue != nil
+			&& jobQueue->NumThreads() > 1;
+	}
+
+	static AsyncJob::EJobPriority F_GetJobPriority( EStreamPriority priority )
+	{
+		if( priority >= StreamPriority_Visible ) {
+			return AsyncJob::Priority_High;
+		}
+		if( priority == StreamPriority_Background ) {
+			return AsyncJob::Priority_Low;
+		}
+		return AsyncJob::Priority_Normal;
+	}
+
+}//namespace
+
+/*
+-----------------------------------------------------------------------------
+	StreamLoadJob
+-----------------------------------------------------------------------------
+*/
+int StreamLoadJob::Run()
+{
+	request->result = request->manager->LoadResource( *request->loadArgs );
+	engine->OnResourceLoaded( request );
+	return 0;
+}
+
+/*
+-----------------------------------------------------------------------------
+	StreamRequest
+-----------------------------------------------------------------------------
+*/
+StreamRequest::StreamRequest()
+{
+	type = Asset_Unknown;
+	guid = ObjectGUID(_InitInvalid);
+	manager = nil;
+	database = nil;
+	status = StreamStatus_Invalid;
+	priority = StreamPriority_Normal;
+	fileHandle = BadPakFileHandle;
+	fileOffset = 0;
+	loadArgs = nil;
+	result = nil;
+	job.engine = nil;
+	job.request = this;
+	taskId = INVALID_TASK_ID;
+	slot = 0;
+	generation = 0;
+	refCount = 0;
+	finished = false;
+}
+
+/*
+-----------------------------------------------------------------------------
+	StreamEngine
+-----------------------------------------------------------------------------
+*/
+StreamEngine::StreamEngine()
+{
+	m_thread.engine = this;
+	m_numPrefetched = 0;
+	m_prefetchingDatabase = nil;
+	m_threadStarted = false;
+	m_quit = false;
+}
+
+StreamEngine::~StreamEngine()
+{
+	this->Shutdown();
+}
+
+void StreamEngine::Shutdown()
+{
+	if( m_threadStarted )
+	{
+		m_quit = true;
+		m_wakeUp.Signal();
+		m_thread.Wait();
+		m_threadStarted = false;
+	}
+
+	for( UINT i = 0; i < m_requests.Num(); i++ )
+	{
+		StreamRequest* request = m_requests[i];
+
+		if( request->taskId != INVALID_TASK_ID ) {
+			GetGlobalJobQueue()->WaitForTask( request->taskId );
+		}
+		if( request->loadArgs != nil ) {
+			free_one( request->loadArgs );
+		}
+		free_one( request );
+	}
+
+	m_requests.Empty();
+	m_freeSlots.Empty();
+	m_pending.Empty();
+	m_finished.Empty();
+	m_prefetches.Empty();
+	m_numPrefetched = 0;
+	m_prefetchingDatabase = nil;
+	m_batch.Empty();
+	m_completing.Empty();
+
+	m_quit = false;
+}
+
+StreamRequestHandle StreamEngine::Submit(
+	EAssetType resourceType,
+	ObjectGUIDArg resourceGuid,
+	AResourceManager* manager,
+	AContentDatabase* database,
+	EStreamPriority priority,
+	SResourceObject* loadedResource
+	)
+{
+	AssertPtr( manager );
+	AssertPtr( database );
+
+	UINT slot;
+	if( m_freeSlots.Num() ) {
+		slot = m_freeSlots.GetLast();
+		m_freeSlots.PopBack();
+	} else {
+		CHK_VRET_X_IF_NOT( m_requests.Num() < MAX_STREAM_REQUESTS, BadStreamRequestHandle );
+		slot = m_requests.Num();
+		m_requests.Add( new_one(StreamRequest()) );
+	}
+
+	StreamRequest* request = m_requests[ slot ];
+	Assert( request->status == StreamStatus_Invalid );
+
+	request->type = resourceType;
+	request->guid = resourceGuid;
+	request->manager = manager;
+	request->database = database;
+	request->priority = priority;
+	request->fileHandle = BadPakFileHandle;
+	request->fileOffset = 0;
+	request->loadArgs = nil;
+	request->result = loadedResource;
+	request->taskId = INVALID_TASK_ID;
+	request->slot = slot;
+	request->refCount = 1;
+
+	{
+		mxScopedMutex	lock( &m_lock );
+
+		if( loadedResource != nil )
+		{
+			request->status = StreamStatus_Loading;
+			request->finished = true;
+			m_finished.Add( request );
+		}
+		else
+		{
+			request->status = StreamStatus_Pending;
+			request->finished = false;
+			m_pending.Add( request );
+		}
+	}
+
+	if( loadedResource == nil )
+	{
+		this->StartThread();
+		m_wakeUp.Signal();
+	}
+
+	return F_MakeRequestHandle( slot, request->generation );
+}
+
+StreamRequestHandle StreamEngine::FindRequest( EAssetType resourceType, ObjectGUIDArg resourceGuid ) const
+{
+	mxScopedMutex	lock( c_cast(mxCriticalSection*) &m_lock );
+
+	for( UINT i = 0; i < m_requests.Num(); i++ )
+	{
+		const StreamRequest* request = m_requests[i];
+
+		if( request->status != StreamStatus_Invalid
+			&& request->status != StreamStatus_Completed
+			&& request->type == resourceType
+			&& request->guid == resourceGuid )
+		{
+			return F_MakeRequestHandle( i, request->generation );
+		}
+	}
+	return BadStreamRequestHandle;
+}
+
+void StreamEngine::AddRef( StreamRequestHandle handle )
+{
+	StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_IF_NIL( request );
+	request->refCount++;
+}
+
+void StreamEngine::Release( StreamRequestHandle handle )
+{
+	StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_IF_NIL( request );
+	Assert( request->refCount > 0 );
+
+	request->refCount--;
+
+	// requests in flight are freed after completion
+	if( !request->refCount && request->status == StreamStatus_Completed )
+	{
+		this->FreeRequest( request );
+	}
+}
+
+void StreamEngine::AddCallback( StreamRequestHandle handle, FStreamCallback* callback, void* userData )
+{
+	StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_IF_NIL( request );
+	AssertPtr( callback );
+
+	if( request->status == StreamStatus_Completed )
+	{
+		(*callback)( request->result, request->guid, userData );
+		return;
+	}
+
+	StreamCallback & newCallback = request->callbacks.Add();
+	newCallback.function = callback;
+	newCallback.userData = userData;
+}
+
+void StreamEngine::SetPriority( StreamRequestHandle handle, EStreamPriority priority )
+{
+	StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_IF_NIL( request );
+
+	mxScopedMutex	lock( &m_lock );
+
+	// the new priority is taken into account when the streaming thread sorts pending requests
+	if( priority > request->priority ) {
+		request->priority = priority;
+	}
+}
+
+EStreamStatus StreamEngine::GetStatus( StreamRequestHandle handle ) const
+{
+	const StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_X_IF_NIL( request, StreamStatus_Invalid );
+
+	mxScopedMutex	lock( c_cast(mxCriticalSection*) &m_lock );
+	return request->status;
+}
+
+EAssetType StreamEngine::GetResourceType( StreamRequestHandle handle ) const
+{
+	const StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_X_IF_NIL( request, Asset_Unknown );
+	return request->type;
+}
+
+SResourceObject* StreamEngine::GetResult( StreamRequestHandle handle ) const
+{
+	const StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_NIL_IF_NIL( request );
+
+	if( request->status != StreamStatus_Completed ) {
+		return nil;
+	}
+	return request->result;
+}
+
+void StreamEngine::Prefetch( AContentDatabase* database, const ObjectGUID* resourceGuids, UINT numResources )
+{
+	AssertPtr( database );
+
+	{
+		mxScopedMutex	lock( &m_lock );
+
+		for( UINT i = 0; i < numResources; i++ )
+		{
+			if( resourceGuids[i].IsValid() )
+			{
+				StreamPrefetch & prefetch = m_prefetches.Add();
+				prefetch.database = database;
+				prefetch.guid = resourceGuids[i];
+			}
+		}
+	}
+
+	this->StartThread();
+	m_wakeUp.Signal();
+}
+
+void StreamEngine::CancelPrefetches( AContentDatabase* database )
+{
+	for(;;)
+	{
+		{
+			mxScopedMutex	lock( &m_lock );
+
+			UINT numKept = m_numPrefetched;
+			for( UINT i = m_numPrefetched; i < m_prefetches.Num(); i++ )
+			{
+				if( m_prefetches[i].database != database ) {
+					m_prefetches[ numKept++ ] = m_prefetches[i];
+				}
+			}
+			m_prefetches.SetNum( numKept );
+
+			if( m_prefetchingDatabase != database ) {
+				break;
+			}
+		}
+
+		// the streaming thread is reading ahead from the database
+		mxSleepMilliseconds( 1 );
+	}
+}
+
+void StreamEngine::Update( FOnResourceLoaded* onResourceLoaded )
+{
+	{
+		mxScopedMutex	lock( &m_lock );
+
+		if( m_finished.IsEmpty() ) {
+			return;
+		}
+		m_completing.Append( m_finished );
+		m_finished.Empty();
+	}
+
+	mxPROFILE_SCOPE("Complete stream requests");
+
+	// callbacks may submit new requests
+	for( UINT i = 0; i < m_completing.Num(); i++ )
+	{
+		this->CompleteRequest( m_completing[i], onResourceLoaded );
+	}
+	m_completing.Empty();
+}
+
+void StreamEngine::Finish( StreamRequestHandle handle, FOnResourceLoaded* onResourceLoaded )
+{
+	StreamRequest* request = this->GetRequest( handle );
+	CHK_VRET_IF_NIL( request );
+
+	if( request->status == StreamStatus_Completed ) {
+		return;
+	}
+
+	mxPROFILE_SCOPE("Wait for stream request");
+
+	this->SetPriority( handle, StreamPriority_Urgent );
+
+	for(;;)
+	{
+		{
+			mxScopedMutex	lock( &m_lock );
+
+			if( request->finished )
+			{
+				const UINT index = m_finished.FindIndexOf( request );
+				Assert( index != INDEX_NONE );
+				m_finished.RemoveAt( index );
+				break;
+			}
+		}
+		m_finishedEvent.Wait();
+	}
+
+	this->CompleteRequest( request, onResourceLoaded );
+}
+
+void StreamEngine::Flush( FOnResourceLoaded* onResourceLoaded )
+{
+	mxPROFILE_SCOPE("Flush stream requests");
+
+	this->Update( onResourceLoaded );
+
+	while( this->HasRequestsInFlight() )
+	{
+		m_finishedEvent.Wait();
+		this->Update( onResourceLoaded );
+	}
+}
+
+void StreamEngine::ProcessReads()
+{
+	while( !m_quit )
+	{
+		// take all pending requests, read ahead only if there are none
+		StreamPrefetch	prefetch;
+		bool			hasPrefetch = false;
+		{
+			mxScopedMutex	lock( &m_lock );
+
+			if( m_pending.IsEmpty() )
+			{
+				if( m_numPrefetched == m_prefetches.Num() )
+				{
+					m_prefetches.Empty();
+					m_numPrefetched = 0;
+					break;
+				}
+				prefetch = m_prefetches[ m_numPrefetched++ ];
+				hasPrefetch = true;
+				m_prefetchingDatabase = prefetch.database;
+			}
+			else
+			{
+				m_batch.Append( m_pending );
+				m_pending.Empty();
+			}
+		}
+
+		// one file at a time so that new requests are not delayed
+		if( hasPrefetch )
+		{
+			this->PrefetchFile( prefetch );
+
+			mxScopedMutex	lock( &m_lock );
+			m_prefetchingDatabase = nil;
+			continue;
+		}
+
+		// open new files to find out where they are located in the package
+		UINT numOpened = 0;
+		for( UINT i = 0; i < m_batch.Num(); i++ )
+		{
+			StreamRequest* request = m_batch[i];
+
+			if( request->fileHandle == BadPakFileHandle )
+			{
+				mxScopedMutex	ioLock( &m_ioLock );
+
+				request->fileHandle = request->database->OpenFile( request->guid );
+				if( request->fileHandle != BadPakFileHandle ) {
+					request->fileOffset = request->database->GetFileOffset( request->fileHandle );
+				}
+			}
+
+			if( request->fileHandle == BadPakFileHandle )
+			{
+				// the default resource will be used
+				mxScopedMutex	lock( &m_lock );
+				request->status = StreamStatus_Loading;
+				request->finished = true;
+				m_finished.Add( request );
+				m_finishedEvent.Signal();
+				continue;
+			}
+
+			m_batch[ numOpened++ ] = request;
+		}
+		m_batch.SetNum( numOpened );
+
+		if( m_batch.IsEmpty() ) {
+			continue;
+		}
+
+		// read the requests with the highest priority in the order of file offsets,
+		// the rest are sorted again together with new requests on the next iteration
+		UINT numToRead = 0;
+		{
+			mxScopedMutex	lock( &m_lock );
+
+			StreamRequest** requests = m_batch.ToPtr();
+			const UINT numRequests = m_batch.Num();
+
+			if( numRequests > 1 )
+			{
+				CompareRequests	predicate;
+				NxQuickSort( requests, requests + numRequests - 1, predicate );
+			}
+
+			const EStreamPriority topPriority = requests[0]->priority;
+
+			for( UINT i = 0; i < numRequests; i++ )
+			{
+				if( requests[i]->priority == topPriority ) {
+					requests[i]->status = StreamStatus_Reading;
+					numToRead++;
+				} else {
+					m_pending.Add( requests[i] );
+				}
+			}
+		}
+
+		for( UINT i = 0; i < numToRead; i++ )
+		{
+			this->ReadRequest( m_batch[i] );
+		}
+		m_batch.Empty();
+	}
+}
+
+void StreamEngine::ReadRequest( StreamRequest* request )
+{
+	{
+		mxScopedMutex	ioLock( &m_ioLock );
+
+		// fault in pages if the package is mapped into memory
+		request->database->PrefetchFiles( &request->fileHandle, 1 );
+
+		request->loadArgs = new_one(SResourceLoadArgs( request->database, request->fileHandle ));
+		request->loadArgs->Preload();
+	}
+
+	mxScopedMutex	lock( &m_lock );
+
+	request->status = StreamStatus_Loading;
+
+	if( F_CanLoadOnWorkers( request->manager ) )
+	{
+		// the lock makes sure that the task ID is set before the request is completed
+		request->job.engine = this;
+		request->job.request = request;
+		request->taskId = GetGlobalJobQueue()->AddTask( &request->job, F_GetJobPriority( request->priority ) );
+	}
+	else
+	{
+		request->finished = true;
+		m_finished.Add( request );
+		m_finishedEvent.Signal();
+	}
+}
+
+void StreamEngine::PrefetchFile( const StreamPrefetch& prefetch )
+{
+	mxScopedMutex	ioLock( &m_ioLock );
+
+	const PakFileHandle fileHandle = prefetch.database->OpenFile( prefetch.guid );
+	if( fileHandle != BadPakFileHandle )
+	{
+		prefetch.database->PrefetchFiles( &fileHandle, 1 );
+		prefetch.database->CloseFile( fileHandle );
+	}
+}
+
+void StreamEngine::OnResourceLoaded( StreamRequest* request )
+{
+	mxScopedMutex	lock( &m_lock );
+
+	request->finished = true;
+	m_finished.Add( request );
+	m_finishedEvent.Signal();
+}
+
+void StreamEngine::CompleteRequest( StreamRequest* request, FOnResourceLoaded* onResourceLoaded )
+{
+	Assert( request->status == StreamStatus_Loading );
+
+	const bool loadedOnWorker = ( request->taskId != INVALID_TASK_ID );
+	if( loadedOnWorker )
+	{
+		GetGlobalJobQueue()->WaitForTask( request->taskId );
+		request->taskId = INVALID_TASK_ID;
+	}
+
+	if( request->loadArgs != nil )
+	{
+		if( !loadedOnWorker ) {
+			request->result = request->manager->LoadResource( *request->loadArgs );
+		}
+		free_one( request->loadArgs );
+		request->loadArgs = nil;
+	}
+
+	if( request->result == nil )
+	{
+		char	tmp[32];
+		request->guid.ToChars( tmp, NUMBER_OF(tmp) );
+		DBGOUT("Failed to stream resource of type '%s' (GUID=%s), using fallback\n", EAssetType_To_Chars( request->type ), tmp);
+
+		request->result = request->manager->GetDefaultResource();
+		AssertPtr( request->result );
+	}
+
+	{
+		mxScopedMutex	lock( &m_lock );
+		request->status = StreamStatus_Completed;
+		request->finished = false;
+	}
+
+	if( request->result != nil && onResourceLoaded != nil )
+	{
+		(*onResourceLoaded)( request->type, request->guid, request->result );
+	}
+
+	// callbacks may release the request
+	request->refCount++;
+
+	for( UINT i = 0; i < request->callbacks.Num(); i++ )
+	{
+		const StreamCallback callback = request->callbacks[i];
+		(*callback.function)( request->result, request->guid, callback.userData );
+	}
+	request->callbacks.Empty();
+
+	request->refCount--;
+
+	if( !request->refCount ) {
+		this->FreeRequest( request );
+	}
+}
+
+void StreamEngine::FreeRequest( StreamRequest* request )
+{
+	Assert( !request->refCount );
+	Assert( request->loadArgs == nil );
+
+	request->status = StreamStatus_Invalid;
+	request->result = nil;
+	request->fileHandle = BadPakFileHandle;
+	request->callbacks.Empty();
+	request->generation++;
+
+	m_freeSlots.Add( request->slot );
+}
+
+StreamRequest* StreamEngine::GetRequest( StreamRequestHandle handle ) const
+{
+	const UINT slot = handle & 0xFFFF;
+	const UINT generation = handle >> 16;
+
+	if( handle == BadStreamRequestHandle || !m_requests.IsValidIndex( slot ) ) {
+		return nil;
+	}
+
+	StreamRequest* request = m_requests[ slot ];
+	if( request->generation != generation || request->status == StreamStatus_Invalid ) {
+		return nil;
+	}
+	return request;
+}
+
+bool StreamEngine::HasRequestsInFlight() const
+{
+	mxScopedMutex	lock( c_cast(mxCriticalSection*) &m_lock );
+
+	for( UINT i = 0; i < m_requests.Num(); i++ )
+	{
+		const EStreamStatus status = m_requests[i]->status;
+		if( status != StreamStatus_Invalid && status != StreamStatus_Completed ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void StreamEngine::StartThread()
+{
+	if( !m_threadStarted )
+	{
+		m_quit = false;
+		m_threadStarted = m_thread.Create();
+		Assert( m_threadStarted );
+	}
+}
+
+void StreamEngine::StreamingThread::Run()
+{
+	while( !engine->IsQuitting() )
+	{
+		engine->WaitForWork();
+		engine->ProcessReads();
+	}
+}
+
+mxNAMESPACE_END
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,216 @@
+/*
+=============================================================================
+	File:	Streaming.h
+	Desc:	Background loading of resources.
+=============================================================================
+*/
+#pragma once
+
+#include <Base/JobSystem/JobSystem.h>
+
+#include <Core/Resources.h>
+
+mxNAMESPACE_BEGIN
+
+class StreamEngine;
+struct StreamRequest;
+
+struct StreamCallback
+{
+	FStreamCallback *	function;
+	void *				userData;
+};
+mxDECLARE_POD_TYPE( StreamCallback );
+
+// read-ahead hint for a file which is going to be loaded soon
+struct StreamPrefetch
+{
+	AContentDatabase *	database;
+	ObjectGUID			guid;
+};
+mxDECLARE_POD_TYPE( StreamPrefetch );
+
+// loads the resource on a worker thread
+struct StreamLoadJob : public AsyncJob
+{
+	StreamEngine *		engine;
+	StreamRequest *		request;
+
+public:
+	virtual int Run() override;
+};
+
+/*
+-----------------------------------------------------------------------------
+	StreamRequest
+
+	asynchronous load request for a single resource
+-----------------------------------------------------------------------------
+*/
+struct StreamRequest
+{
+	EAssetType			type;
+	ObjectGUID			guid;
+	AResourceManager *	manager;
+	AContentDatabase *	database;
+
+	EStreamStatus		status;		// changed under the engine lock
+	EStreamPriority		priority;
+
+	PakFileHandle		fileHandle;	// opened by the streaming thread
+	U4					fileOffset;	// for sorting reads
+
+	SResourceLoadArgs *	loadArgs;	// holds the file contents after reading
+	SResourceObject *	result;		// nil if failed to load
+
+	TList< StreamCallback >	callbacks;
+
+	StreamLoadJob		job;
+	TaskID				taskId;		// INVALID_TASK_ID if the resource is loaded on the main thread
+
+	U2					slot;		// index in StreamEngine::m_requests
+	U2					generation;	// incremented when the slot is reused
+	U2					refCount;	// number of unreleased handles
+	bool				finished;	// true if it's waiting for StreamEngine::Update()
+
+public:
+	StreamRequest();
+};
+
+/*
+-----------------------------------------------------------------------------
+	StreamEngine
+
+	loads resources in the background:
+	the streaming thread reads requested files from the content database
+	(pending requests of the highest priority are read in the order of file offsets to minimize seeking),
+	then the resources are created on worker threads (if their managers allow it)
+	or in Update() on the main thread.
+	read-ahead hints (see Prefetch()) are processed only when there are no pending requests.
+
+	all functions except the ones marked as thread-safe must be called from the main thread.
+-----------------------------------------------------------------------------
+*/
+class StreamEngine
+{
+public:
+	// called for each newly loaded resource from Update() before the request callbacks
+	typedef void FOnResourceLoaded( EAssetType resourceType, ObjectGUIDArg resourceGuid, SResourceObject* resource );
+
+public:
+	StreamEngine();
+	~StreamEngine();
+
+	// waits for the streaming thread and worker jobs and discards unfinished requests
+	void Shutdown();
+
+	// 'loadedResource' is used for resources which have already been loaded,
+	// such requests are completed in the next Update()
+	StreamRequestHandle Submit(
+		EAssetType resourceType,
+		ObjectGUIDArg resourceGuid,
+		AResourceManager* manager,
+		AContentDatabase* database,
+		EStreamPriority priority,
+		SResourceObject* loadedResource = nil
+	);
+
+	// returns BadStreamRequestHandle if the resource is not being loaded
+	StreamRequestHandle FindRequest( EAssetType resourceType, ObjectGUIDArg resourceGuid ) const;
+
+	// increments the reference count of the request
+	void AddRef( StreamRequestHandle handle );
+	void Release( StreamRequestHandle handle );
+
+	// the callback will be called immediately if the request has been completed
+	void AddCallback( StreamRequestHandle handle, FStreamCallback* callback, void* userData );
+
+	// the priority can only be raised
+	void SetPriority( StreamRequestHandle handle, EStreamPriority priority );
+
+	EStreamStatus GetStatus( StreamRequestHandle handle ) const;
+	EAssetType GetResourceType( StreamRequestHandle handle ) const;
+
+	// valid only for completed requests (nil if failed to load)
+	SResourceObject* GetResult( StreamRequestHandle handle ) const;
+
+	// queues the files for reading ahead on the streaming thread (in the given order),
+	// returns immediately; the hints wait until there are no pending requests
+	void Prefetch( AContentDatabase* database, const ObjectGUID* resourceGuids, UINT numResources );
+
+	// drops read-ahead hints for the database and waits if the streaming thread is reading ahead from it
+	// (must be called before the database is closed or replaced)
+	void CancelPrefetches( AContentDatabase* database );
+
+	// completes finished requests
+	void Update( FOnResourceLoaded* onResourceLoaded );
+
+	// blocks until the request is completed
+	void Finish( StreamRequestHandle handle, FOnResourceLoaded* onResourceLoaded );
+
+	// blocks until all requests are completed
+	void Flush( FOnResourceLoaded* onResourceLoaded );
+
+	// must be held while accessing the content database outside of the streaming thread (thread-safe)
+	mxCriticalSection& GetIOLock() { return m_ioLock; }
+
+public_internal:
+	// Streaming thread.
+	void ProcessReads();
+
+	// Worker threads.
+	void OnResourceLoaded( StreamRequest* request );
+
+	bool IsQuitting() const { return m_quit; }
+	void WaitForWork() { m_wakeUp.Wait(); }
+
+private:
+	void StartThread();
+	StreamRequest* GetRequest( StreamRequestHandle handle ) const;
+	void ReadRequest( StreamRequest* request );
+	void PrefetchFile( const StreamPrefetch& prefetch );
+	void CompleteRequest( StreamRequest* request, FOnResourceLoaded* onResourceLoaded );
+	void FreeRequest( StreamRequest* request );
+	bool HasRequestsInFlight() const;
+
+private:
+	class StreamingThread : public mxThread
+	{
+	public:
+		StreamEngine *	engine;
+	public:
+		virtual void Run() override;
+	};
+
+	// requests are allocated individually so that pointers stay valid for the streaming thread and jobs
+	TList< StreamRequest* >	m_requests;		// indexed by slots
+	TList< U4 >				m_freeSlots;
+
+	TList< StreamRequest* >	m_pending;		// waiting for reading, sorted by the streaming thread
+	TList< StreamRequest* >	m_finished;		// waiting for Update()
+
+	TList< StreamPrefetch >	m_prefetches;	// read-ahead hints in the order of submission
+	UINT					m_numPrefetched;	// index of the next hint to process
+	AContentDatabase *		m_prefetchingDatabase;	// database of the hint being processed or nil
+
+	TList< StreamRequest* >	m_batch;		// scratch memory for the streaming thread
+	TList< StreamRequest* >	m_completing;	// scratch memory for Update()
+
+	mxCriticalSection		m_lock;		// protects the request lists and statuses
+	mxCriticalSection		m_ioLock;	// serializes access to the content database
+
+	mxEvent					m_wakeUp;		// signalled when new requests are submitted
+	mxEvent					m_finishedEvent;	// signalled when a request has been read or loaded
+
+	StreamingThread			m_thread;
+	bool					m_threadStarted;
+	volatile bool			m_quit;
+
+	PREVENT_COPY(StreamEngine);
+};
+
+mxNAMESPACE_END
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
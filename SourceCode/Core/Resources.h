@@ -230,6 +230,39 @@ struct SResourceUpdateArgs
 	//ViewFrustum	viewFrustum;
 };
 
+/*
+-----------------------------------------------------------------------------
+	Asynchronous loading (streaming)
+-----------------------------------------------------------------------------
+*/
+
+// handle of an asynchronous load request
+typedef U4 StreamRequestHandle;
+enum { BadStreamRequestHandle = (StreamRequestHandle)-1 };
+
+enum EStreamPriority
+{
+	StreamPriority_Background = 0,	// prefetching (e.g. resources of the next level)
+	StreamPriority_Normal,
+	StreamPriority_Visible,	// resources of objects on screen
+	StreamPriority_Urgent,	// somebody is waiting for the resource
+
+	StreamPriority_MAX	// Marker. Do not use.
+};
+
+enum EStreamStatus
+{
+	StreamStatus_Invalid = 0,	// bad or released handle
+	StreamStatus_Pending,	// waiting for the streaming thread
+	StreamStatus_Reading,	// the file is being read
+	StreamStatus_Loading,	// the resource is being created
+	StreamStatus_Completed,	// the resource (or the fallback instance) is available
+};
+
+// called on the main thread when the requested resource has been loaded
+// (the default instance is passed if the resource failed to load)
+typedef void FStreamCallback( SResourceObject* resource, ObjectGUIDArg resourceGuid, void* userData );
+
 /*
 -----------------------------------------------------------------------------
 	AResourceManager
@@ -271,6 +304,14 @@ public:
 		mxDBG_UNREACHABLE;
 	}
 
+	// returns true if LoadResource() can be called on worker threads
+	// (it must not request other resources or touch shared state without locking),
+	// otherwise streamed resources are created on the main thread in ResourceSystem::Tick()
+	virtual bool CanLoadAsync() const
+	{
+		return false;
+	}
+
 	// returns fallback resource
 	virtual SResourceObject* GetDefaultResource()
 	{
@@ -348,6 +389,51 @@ public:
 	//
 	SResourceObject* GetResourceByGuid( EAssetType resourceType, ObjectGUIDArg resourceGuid );
 
+	// tells the content database that the given resources are going to be loaded in this order
+	// (e.g. before loading a level) so that it can read ahead;
+	// the files are read ahead on the streaming thread when it has no requests, this doesn't block
+	void PrefetchResources( const ObjectGUID* resourceGuids, UINT numResources );
+
+
+	// Asynchronous loading (streaming)
+
+	// queues the resource for loading in the background and returns a handle to the request
+	// (requests for the same resource share the handle);
+	// the callback is called from Tick() after the resource has been loaded.
+	// the handle must be released with ReleaseRequest().
+	//
+	StreamRequestHandle RequestResource(
+		EAssetType resourceType,
+		ObjectGUIDArg resourceGuid,
+		EStreamPriority priority = StreamPriority_Normal,
+		FStreamCallback* callback = nil,
+		void* userData = nil
+	);
+
+	EStreamStatus GetRequestStatus( StreamRequestHandle request );
+
+	// returns the loaded resource or the default instance if the resource is not ready yet
+	SResourceObject* GetRequestedResource( StreamRequestHandle request );
+
+	// e.g. raise the priority when the object comes into view (the priority is never lowered)
+	void SetRequestPriority( StreamRequestHandle request, EStreamPriority priority );
+
+	void ReleaseRequest( StreamRequestHandle request );
+
+	// blocks until all requests have been completed (e.g. at the end of a loading screen)
+	void FlushRequests();
+
+
+	// Recording the order of loads (used for optimizing the layout of packages)
+
+	// starts a new trace, all loaded, prefetched and requested resources are appended to it
+	// until EndAccessTrace() is called (e.g. call it before and after loading a level)
+	void BeginAccessTrace( const char* name );
+	void EndAccessTrace();
+
+	// saves all recorded traces (see EdPakFileBuilder::LoadAccessTraces())
+	bool SaveAccessTraces( const char* fileName );
+
 
 	template< class RESOURCE >	// where RESOURCE : SResourceObject
 	inline
@@ -450,6 +536,9 @@ public:	// High-level API
 
 public:	// Low-level file access
 
+	// NOTE: the resource system calls these functions from the main thread and the streaming thread
+	// under a single lock, only CloseFile() and UnmapFile() may be called without the lock.
+
 	// fast access to file by file handle;
 	// returns BadPakFileHandle if not found
 	//
@@ -466,6 +555,34 @@ public:	// Low-level file access
 	// Reads the file into the preallocated buffer
 	virtual SizeT ReadFile( PakFileHandle file, UINT startOffset, void *buffer, UINT bytesToRead ) = 0;
 
+	// returns the position of the file in the package in arbitrary units (used for ordering reads)
+	virtual U4 GetFileOffset( PakFileHandle file )
+	{
+		mxUNUSED(file);
+		return 0;
+	}
+
+	// returns a pointer to the file contents if the package is mapped into memory
+	// (copy-on-write, valid until UnmapFile()) or nil if the file must be read with ReadFile()
+	virtual BYTE* MapFile( PakFileHandle file )
+	{
+		mxUNUSED(file);
+		return nil;
+	}
+
+	// releases the view returned by MapFile()
+	virtual void UnmapFile( PakFileHandle file )
+	{
+		mxUNUSED(file);
+	}
+
+	// hints that the files are going to be loaded soon in the given order
+	virtual void PrefetchFiles( const PakFileHandle* files, UINT numFiles )
+	{
+		mxUNUSED(files);
+		mxUNUSED(numFiles);
+	}
+
 	// works only in editor mode
 	//virtual void UpdateFile( PakFileHandle file, const void* uncompressedData, UINT size );
 
@@ -540,6 +657,8 @@ class SResourceLoadArgs : public AStreamReader
 	UINT			m_readOffset;
 	UINT			m_dataSize;
 	BYTE *			m_mappedData;
+	bool			m_ownsMappedData;	// false if m_mappedData points into the mapped package
+	bool			m_preloaded;		// true if the file has been read by Preload()
 
 public:
 	SResourceLoadArgs( AFilePackage* package, PakFileHandle fileHandle );
@@ -549,9 +668,14 @@ public:
 
 	SizeT GetSize() const;
 
-	// Map stream to memory.
+	// Map stream to memory
+	// (returns a view into the package if it's mapped, otherwise reads the file into a new buffer).
 	BYTE* Map();
 	void Unmap();
+
+	// reads the whole file into memory so that Read() and Map() don't touch the package
+	// (e.g. the file is read on the streaming thread and the resource is created on another thread)
+	void Preload();
 };
 
 
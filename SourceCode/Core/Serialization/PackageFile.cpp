@@ -2,6 +2,10 @@
 #pragma hdrstop
 #include <Core.h>
 
+#include <Base/IO/Compression/LZ4.h>
+#include <Base/JobSystem/JobSystem.h>
+#include <Base/JobSystem/ParallelFor.h>
+
 #include <Core/Serialization.h>
 #include <Core/Serialization/PackageFile.h>
 
@@ -28,6 +32,9 @@ PakFileHeader::PakFileHeader( U4 fourCC )
 	totalSize = 0;
 	crc32 = 0;
 	md5 = 0;
+
+	numVolumes = 0;
+	numEntries = 0;
 }
 
 bool PakFileHeader::Matches( const PakFileHeader& other ) const
@@ -35,22 +42,465 @@ bool PakFileHeader::Matches( const PakFileHeader& other ) const
 	return mxSessionInfo::AreCompatible( session, other.session );
 }
 
+static bool F_CheckPakHeader( const PakFileHeader& header, const char* fileName )
+{
+	if( header.session.fourCC != PAK_FILE_FOURCC )
+	{
+		mxErrf("Package '%s' has unsupported format, rebuild it!\n", fileName);
+		return false;
+	}
+	return true;
+}
+
+/*
+-----------------------------------------------------------------------------
+	Compression
+-----------------------------------------------------------------------------
+*/
+namespace
+{
+	// LZ4 worst case: input size + 0.4%, at least 8 bytes
+	FORCEINLINE UINT F_CalcMaxCompressedBlockSize( UINT blockSize )
+	{
+		return blockSize + blockSize / 255 + 16;
+	}
+
+	struct DecompressPakBlocks
+	{
+		const U4 *		blockEnds;
+		const BYTE *	blockData;
+		UINT			blockDataSize;
+		BYTE *			dest;
+		UINT			uncompressedSize;
+		bool *			failed;
+
+	public:
+		void operator () ( UINT firstBlock, UINT lastBlock ) const
+		{
+			for( UINT iBlock = firstBlock; iBlock < lastBlock; iBlock++ )
+			{
+				const UINT start = iBlock ? (blockEnds[ iBlock-1 ] & ~PAK_STORED_BLOCK) : 0;
+				const UINT end = blockEnds[ iBlock ] & ~PAK_STORED_BLOCK;
+
+				const UINT rawOffset = iBlock * PAK_COMPRESSION_BLOCK_SIZE;
+				const UINT rawSize = Min<UINT>( uncompressedSize - rawOffset, PAK_COMPRESSION_BLOCK_SIZE );
+
+				if( start > end || end > blockDataSize ) {
+					*failed = true;
+					return;
+				}
+
+				char* src = c_cast(char*) blockData + start;
+				char* dst = c_cast(char*) dest + rawOffset;
+
+				if( blockEnds[ iBlock ] & PAK_STORED_BLOCK )
+				{
+					if( end - start != rawSize ) {
+						*failed = true;
+						return;
+					}
+					MemCopy( dst, src, rawSize );
+				}
+				else
+				{
+					// returns the number of bytes read
+					const int bytesRead = LZ4_uncompress( src, dst, rawSize );
+					if( bytesRead != (int)(end - start) ) {
+						*failed = true;
+						return;
+					}
+				}
+			}
+		}
+	};
+
+}//namespace
+
+bool Pak_CompressEntry( const void* data, UINT dataSize, TList< BYTE > &compressedData )
+{
+	if( dataSize < PAK_MIN_COMPRESSED_ENTRY_SIZE ) {
+		return false;
+	}
+
+	const UINT numBlocks = Pak_CalcNumBlocks( dataSize );
+	const UINT tableSize = numBlocks * sizeof(U4);
+
+	compressedData.SetNum( tableSize + numBlocks * F_CalcMaxCompressedBlockSize( PAK_COMPRESSION_BLOCK_SIZE ) );
+
+	U4 * blockEnds = c_cast(U4*) compressedData.ToPtr();
+	BYTE * blockData = compressedData.ToPtr() + tableSize;
+
+	UINT written = 0;
+
+	for( UINT iBlock = 0; iBlock < numBlocks; iBlock++ )
+	{
+		const UINT rawOffset = iBlock * PAK_COMPRESSION_BLOCK_SIZE;
+		const UINT rawSize = Min<UINT>( dataSize - rawOffset, PAK_COMPRESSION_BLOCK_SIZE );
+
+		char* src = c_cast(char*) data + rawOffset;
+		char* dst = c_cast(char*) blockData + written;
+
+		const int compressedSize = LZ4_compress( src, dst, rawSize );
+
+		if( compressedSize > 0 && (UINT)compressedSize < rawSize )
+		{
+			written += compressedSize;
+			blockEnds[ iBlock ] = written;
+		}
+		else
+		{
+			// incompressible data
+			MemCopy( dst, src, rawSize );
+			written += rawSize;
+			blockEnds[ iBlock ] = written | PAK_STORED_BLOCK;
+		}
+	}
+
+	compressedData.SetNum( tableSize + written );
+
+	// not worth decompressing if it saves less than 1/8th
+	return compressedData.Num() < dataSize - dataSize / 8;
+}
+
+bool Pak_DecompressEntry( const void* compressedData, UINT compressedSize, void* buffer, UINT uncompressedSize, AsyncJobQueue* jobQueue )
+{
+	const UINT numBlocks = Pak_CalcNumBlocks( uncompressedSize );
+	const UINT tableSize = numBlocks * sizeof(U4);
+	CHK_VRET_FALSE_IF_NOT( compressedSize >= tableSize );
+
+	bool failed = false;
+
+	DecompressPakBlocks	functor;
+	functor.blockEnds = c_cast(const U4*) compressedData;
+	functor.blockData = c_cast(const BYTE*) compressedData + tableSize;
+	functor.blockDataSize = compressedSize - tableSize;
+	functor.dest = c_cast(BYTE*) buffer;
+	functor.uncompressedSize = uncompressedSize;
+	functor.failed = &failed;
+
+	if( jobQueue != nil ) {
+		ParallelFor( jobQueue, 0, numBlocks, 1, functor );
+	} else {
+		functor( 0, numBlocks );
+	}
+
+	CHK_VRET_FALSE_IF_NOT( !failed );
+	return true;
+}
+
+void Pak_GetVolumeFileName( const char* packageFileName, UINT volume, char* buffer, UINT bufferSize )
+{
+	if( !volume ) {
+		mxSPrintfAnsi( buffer, bufferSize, "%s", packageFileName );
+	} else {
+		mxSPrintfAnsi( buffer, bufferSize, "%s.%03u", packageFileName, volume );
+	}
+}
+
+bool Pak_SaveAccessTraces( const char* fileName, const TList< PakAccessTrace >& traces )
+{
+	FileWriter	file( fileName );
+	CHK_VRET_FALSE_IF_NOT( file.IsOpen() );
+
+	const U4 fourCC = PAK_TRACE_FOURCC;
+	const U4 numTraces = traces.Num();
+
+	file << fourCC;
+	file << numTraces;
+
+	for( UINT i = 0; i < numTraces; i++ )
+	{
+		file << traces[i].name;
+		file << traces[i].guids;
+	}
+
+	return true;
+}
+
+bool Pak_LoadAccessTraces( const char* fileName, TList< PakAccessTrace > &traces )
+{
+	FileReader	file( fileName );
+	CHK_VRET_FALSE_IF_NOT( file.IsOpen() );
+
+	U4 fourCC = 0;
+	U4 numTraces = 0;
+
+	file >> fourCC;
+	if( fourCC != PAK_TRACE_FOURCC )
+	{
+		mxErrf("'%s' is not an access trace file\n", fileName);
+		return false;
+	}
+	file >> numTraces;
+
+	traces.SetNum( numTraces );
+
+	for( UINT i = 0; i < numTraces; i++ )
+	{
+		file >> traces[i].name;
+		file >> traces[i].guids;
+	}
+
+	return true;
+}
+
+/*
+-----------------------------------------------------------------------------
+	PakVolumeSet
+-----------------------------------------------------------------------------
+*/
+PakVolumeSet::PakVolumeSet()
+{
+}
+
+PakVolumeSet::~PakVolumeSet()
+{
+	this->Close();
+}
+
+bool PakVolumeSet::Open( const char* fileName )
+{
+	this->Close();
+
+	Volume* mainVolume = new_one(Volume());
+	m_volumes.Add( mainVolume );
+
+	return mainVolume->reader.Open( fileName );
+}
+
+bool PakVolumeSet::OpenVolumes( const char* fileName, UINT numVolumes, UINT numEntries )
+{
+	Assert( m_volumes.Num() == 1 );
+	CHK_VRET_FALSE_IF_NOT( numVolumes > 0 && numVolumes <= PAK_MAX_VOLUMES );
+
+	for( UINT iVolume = 1; iVolume < numVolumes; iVolume++ )
+	{
+		char	volumeName[ FS_MAX_PATH ];
+		Pak_GetVolumeFileName( fileName, iVolume, volumeName, NUMBER_OF(volumeName) );
+
+		Volume* volume = new_one(Volume());
+		m_volumes.Add( volume );
+
+		if( !volume->reader.Open( volumeName ) )
+		{
+			mxErrf("Failed to open volume '%s'\n", volumeName);
+			return false;
+		}
+	}
+
+	// create mappings for zero-copy loading, the package can still be read without them
+	for( UINT iVolume = 0; iVolume < numVolumes; iVolume++ )
+	{
+		char	volumeName[ FS_MAX_PATH ];
+		Pak_GetVolumeFileName( fileName, iVolume, volumeName, NUMBER_OF(volumeName) );
+
+		if( !m_volumes[ iVolume ]->mapping.Open( volumeName ) )
+		{
+			DEVOUT("Volume '%s' is not mapped, its entries will be read\n", volumeName);
+		}
+	}
+
+	m_entryViews.SetNum( numEntries );
+	MemZero( m_entryViews.ToPtr(), m_entryViews.GetDataSize() );
+
+	return true;
+}
+
+void PakVolumeSet::Close()
+{
+	{
+		mxScopedMutex	lock( &m_entryViewsLock );
+
+		for( UINT i = 0; i < m_entryViews.Num(); i++ )
+		{
+			Assert( m_entryViews[i] == nil );	// the resource is still being loaded
+			if( m_entryViews[i] != nil ) {
+				FileMapping::UnmapView( m_entryViews[i] );
+			}
+		}
+		m_entryViews.Clear();
+	}
+
+	for( UINT i = 0; i < m_regionViews.Num(); i++ )
+	{
+		FileMapping::UnmapView( m_regionViews[i] );
+	}
+	m_regionViews.Clear();
+
+	for( UINT i = 0; i < m_volumes.Num(); i++ )
+	{
+		free_one( m_volumes[i] );
+	}
+	m_volumes.Clear();
+}
+
+bool PakVolumeSet::IsOpen() const
+{
+	return m_volumes.Num() && m_volumes[0]->reader.IsOpen();
+}
+
+FileReader& PakVolumeSet::GetMainFile()
+{
+	Assert( m_volumes.Num() );
+	return m_volumes[0]->reader;
+}
+
+const BYTE* PakVolumeSet::MapRegion( UINT volume, U8 offset, SizeT size )
+{
+	if( !m_volumes.IsValidIndex( volume ) ) {
+		return nil;
+	}
+	const FileMapping& mapping = m_volumes[ volume ]->mapping;
+	if( !mapping.IsOpen() || offset + size > mapping.GetSize() ) {
+		return nil;
+	}
+
+	void* viewBase;
+	const BYTE* data = mapping.MapView( (SizeT)offset, size, viewBase );
+	if( data != nil ) {
+		m_regionViews.Add( viewBase );
+	}
+	return data;
+}
+
+SizeT PakVolumeSet::ReadEntry( const PakFileEntry& entry, void *buffer )
+{
+	CHK_VRET_X_IF_NOT( m_volumes.IsValidIndex( entry.volume ), 0 );
+
+	Volume & volume = *m_volumes[ entry.volume ];
+	FileReader & reader = volume.reader;
+	const U8 offset = Pak_GetFileEntryOffset( entry );
+	CHK_VRET_X_IF_NOT( offset + entry.compressedSize <= PAK_MAX_VOLUME_SIZE, 0 );
+
+	if( entry.codec == PakCodec_None )
+	{
+		reader.Seek( (FileOffset)offset );
+		reader.Read( buffer, entry.uncompressedSize );
+		return entry.uncompressedSize;
+	}
+
+	CHK_VRET_X_IF_NOT( entry.codec == PakCodec_LZ4, 0 );
+
+	bool ok = false;
+
+	// decompress straight from a temporary view of the package
+	void* viewBase = nil;
+	const BYTE* mappedData = nil;
+	if( volume.mapping.IsOpen() && offset + entry.compressedSize <= volume.mapping.GetSize() ) {
+		mappedData = volume.mapping.MapView( (SizeT)offset, entry.compressedSize, viewBase );
+	}
+
+	if( mappedData != nil )
+	{
+		ok = Pak_DecompressEntry( mappedData, entry.compressedSize, buffer, entry.uncompressedSize, GetGlobalJobQueue() );
+
+		FileMapping::UnmapView( viewBase );
+	}
+	else
+	{
+		void* compressedData = mxAllocX( EMemHeap::HeapStreaming, entry.compressedSize );
+
+		reader.Seek( (FileOffset)offset );
+		reader.Read( compressedData, entry.compressedSize );
+
+		ok = Pak_DecompressEntry( compressedData, entry.compressedSize, buffer, entry.uncompressedSize, GetGlobalJobQueue() );
+
+		mxFreeX( EMemHeap::HeapStreaming, compressedData );
+	}
+
+	CHK_VRET_X_IF_NOT( ok, 0 );
+	return entry.uncompressedSize;
+}
+
+BYTE* PakVolumeSet::MapEntry( UINT index, const PakFileEntry& entry )
+{
+	// compressed entries must be read with ReadEntry()
+	if( !m_entryViews.IsValidIndex( index ) || entry.codec != PakCodec_None || !m_volumes.IsValidIndex( entry.volume ) ) {
+		return nil;
+	}
+
+	const FileMapping& mapping = m_volumes[ entry.volume ]->mapping;
+	const U8 offset = Pak_GetFileEntryOffset( entry );
+	if( !mapping.IsOpen() || offset + entry.uncompressedSize > mapping.GetSize() ) {
+		return nil;
+	}
+
+	mxScopedMutex	lock( &m_entryViewsLock );
+
+	// each view has its own copy-on-write pages,
+	// but the entry can only be tracked once
+	if( m_entryViews[ index ] != nil ) {
+		return nil;
+	}
+
+	void* viewBase;
+	BYTE* mappedData = mapping.MapView( (SizeT)offset, entry.uncompressedSize, viewBase );
+	if( mappedData != nil ) {
+		m_entryViews[ index ] = viewBase;
+	}
+	return mappedData;
+}
+
+void PakVolumeSet::UnmapEntry( UINT index )
+{
+	mxScopedMutex	lock( &m_entryViewsLock );
+
+	if( m_entryViews.IsValidIndex( index ) && m_entryViews[ index ] != nil )
+	{
+		FileMapping::UnmapView( m_entryViews[ index ] );
+		m_entryViews[ index ] = nil;
+	}
+}
+
+bool PakVolumeSet::IsEntryMapped( UINT index ) const
+{
+	mxScopedMutex	lock( c_cast(mxCriticalSection*) &m_entryViewsLock );
+
+	return m_entryViews.IsValidIndex( index ) && m_entryViews[ index ] != nil;
+}
+
+void PakVolumeSet::PrefetchEntry( const PakFileEntry& entry ) const
+{
+	if( !m_volumes.IsValidIndex( entry.volume ) ) {
+		return;
+	}
+	const FileMapping& mapping = m_volumes[ entry.volume ]->mapping;
+	const U8 offset = Pak_GetFileEntryOffset( entry );
+	if( mapping.IsOpen() && offset + entry.compressedSize <= mapping.GetSize() ) {
+		mapping.Prefetch( (SizeT)offset, entry.compressedSize );
+	}
+}
+
 /*
 -----------------------------------------------------------------------------
 	OptimizedPakFile
 -----------------------------------------------------------------------------
 */
 OptimizedPakFile::OptimizedPakFile()
-	: m_fileReader( _NoInit )
 {
 
 }
 
 OptimizedPakFile::OptimizedPakFile( const char* fileName )
-	: m_fileReader( fileName )
 {
-	m_fileReader >> m_header;
-	m_fileReader >> m_entries;
+	if( !m_volumes.Open( fileName ) ) {
+		return;
+	}
+
+	FileReader & mainFile = m_volumes.GetMainFile();
+
+	mainFile >> m_header;
+	if( !F_CheckPakHeader( m_header, fileName ) )
+	{
+		m_volumes.Close();
+		return;
+	}
+	mainFile >> m_entries;
+
+	if( !m_volumes.OpenVolumes( fileName, m_header.numVolumes, m_entries.Num() ) )
+	{
+		this->Close();
+	}
 }
 
 OptimizedPakFile::~OptimizedPakFile()
@@ -63,12 +513,13 @@ OptimizedPakFile::~OptimizedPakFile()
 
 bool OptimizedPakFile::IsOpen() const
 {
-	return m_fileReader.IsOpen();
+	return m_volumes.IsOpen();
 }
 
 void OptimizedPakFile::Close()
 {
-	return m_fileReader.Close();
+	m_volumes.Close();
+	m_entries.Clear();
 }
 
 PakFileHandle OptimizedPakFile::OpenFile( ObjectGUIDArg fileGuid )
@@ -96,20 +547,38 @@ SizeT OptimizedPakFile::ReadFile( PakFileHandle file, UINT startOffset, void *bu
 {
 	CHK_VRET_X_IF_NOT( m_entries.IsValidIndex( file ), 0 );
 
-	PakFileEntry& entry = m_entries[ file ];
-
-	const UINT offset = Pak_GetFileEntryOffset( entry );
-	const SizeT dataSize = entry.uncompressedSize;
-	Assert(bytesToRead <= dataSize);
+	const PakFileEntry& entry = m_entries[ file ];
+	Assert(bytesToRead <= entry.uncompressedSize);
 
-	m_fileReader.Seek( offset );
-	m_fileReader.Read( buffer, dataSize );
+	return m_volumes.ReadEntry( entry, buffer );
+}
 
-	return dataSize;
+U4 OptimizedPakFile::GetFileOffset( PakFileHandle file )
+{
+	CHK_VRET_X_IF_NOT( m_entries.IsValidIndex( file ), 0 );
+	return Pak_GetFileEntryOrder( m_entries[ file ] );
 }
 
+BYTE* OptimizedPakFile::MapFile( PakFileHandle file )
+{
+	CHK_VRET_NIL_IF_NOT( m_entries.IsValidIndex( file ) );
+	return m_volumes.MapEntry( file, m_entries[ file ] );
+}
 
+void OptimizedPakFile::UnmapFile( PakFileHandle file )
+{
+	m_volumes.UnmapEntry( file );
+}
 
+void OptimizedPakFile::PrefetchFiles( const PakFileHandle* files, UINT numFiles )
+{
+	for( UINT i = 0; i < numFiles; i++ )
+	{
+		if( m_entries.IsValidIndex( files[i] ) ) {
+			m_volumes.PrefetchEntry( m_entries[ files[i] ] );
+		}
+	}
+}
 
 /*
 -----------------------------------------------------------------------------
@@ -117,17 +586,25 @@ SizeT OptimizedPakFile::ReadFile( PakFileHandle file, UINT startOffset, void *bu
 -----------------------------------------------------------------------------
 */
 HashedPakFile::HashedPakFile()
-	: m_fileReader( _NoInit )
 {
-
+	this->ResetFields();
 }
 
 HashedPakFile::HashedPakFile( const char* fileName )
-	: m_fileReader( _NoInit )
 {
+	this->ResetFields();
+
 	this->Open( fileName );
 }
 
+void HashedPakFile::ResetFields()
+{
+	m_guids = nil;
+	m_entries = nil;
+	m_numEntries = 0;
+	m_lastReadOrder = 0;
+}
+
 HashedPakFile::~HashedPakFile()
 {
 	if( this->IsOpen() )
@@ -138,41 +615,91 @@ HashedPakFile::~HashedPakFile()
 
 bool HashedPakFile::Open( const char* fileName )
 {
-	CHK_VRET_FALSE_IF_NOT(m_fileReader.Open( fileName ));
-	m_fileReader >> m_header;
-	m_fileReader >> m_entries;
+	CHK_VRET_FALSE_IF_NOT(m_volumes.Open( fileName ));
 
+	FileReader & mainFile = m_volumes.GetMainFile();
+
+	mainFile >> m_header;
+	if( !F_CheckPakHeader( m_header, fileName ) )
 	{
-		const TMap< ObjectGUID, PakFileEntry >::PairsArray& pairs = m_entries.GetPairs();
-		for( UINT i=0; i < pairs.Num(); i++ )
-		{
-			char	tmp[32];
-			pairs[i].key.ToChars(tmp);
-			DBGOUT( "GUID[%u] = %s\n", i, tmp );
-		}
+		m_volumes.Close();
+		return false;
+	}
+
+	const UINT numEntries = m_header.numEntries;
+
+	if( !m_volumes.OpenVolumes( fileName, m_header.numVolumes, numEntries ) )
+	{
+		this->Close();
+		return false;
+	}
+
+	// the table of contents follows the header
+	const SizeT tocOffset = mainFile.Tell();
+	const SizeT guidsSize = numEntries * sizeof(m_guids[0]);
+	const SizeT entriesSize = numEntries * sizeof(m_entries[0]);
+
+	const BYTE* mappedToc = m_volumes.MapRegion( 0, tocOffset, guidsSize + entriesSize );
+	if( mappedToc != nil )
+	{
+		// search the table in place, nothing is allocated or hashed
+		m_guids = c_cast(const ObjectGUID*) mappedToc;
+		m_entries = c_cast(const PakFileEntry*) (mappedToc + guidsSize);
+	}
+	else
+	{
+		m_guidStorage.SetNum( numEntries );
+		m_entryStorage.SetNum( numEntries );
+
+		mainFile.Read( m_guidStorage.ToPtr(), guidsSize );
+		mainFile.Read( m_entryStorage.ToPtr(), entriesSize );
+
+		m_guids = m_guidStorage.ToPtr();
+		m_entries = m_entryStorage.ToPtr();
 	}
 
+	m_numEntries = numEntries;
+
 	return true;
 }
 
 bool HashedPakFile::IsOpen() const
 {
-	return m_fileReader.IsOpen();
+	return m_volumes.IsOpen();
 }
 
 void HashedPakFile::Close()
 {
-	return m_fileReader.Close();
+	this->ResetFields();
+
+	m_guidStorage.Clear();
+	m_entryStorage.Clear();
+
+	m_volumes.Close();
 }
 
 PakFileHandle HashedPakFile::OpenFile( ObjectGUIDArg fileGuid )
 {
-	const UINT index = m_entries.FindKeyIndex( fileGuid );
-	if( index != INDEX_NONE ) {
-		return index;
+	// binary search in the sorted table
+	UINT lo = 0;
+	UINT hi = m_numEntries;
+	while( lo < hi )
+	{
+		const UINT mid = (lo + hi) / 2;
+		if( m_guids[ mid ].v < fileGuid.v ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
 	}
-	mxDBG_UNREACHABLE;
-	return BadPakFileHandle;
+
+	if( lo >= m_numEntries || m_guids[ lo ].v != fileGuid.v ) {
+		mxDBG_UNREACHABLE;
+		return BadPakFileHandle;
+	}
+
+	// the copy is chosen when the file is read
+	return lo;
 }
 
 void HashedPakFile::CloseFile( PakFileHandle file )
@@ -189,28 +716,100 @@ UINT HashedPakFile::GetFileSize( PakFileHandle file )
 
 SizeT HashedPakFile::ReadFile( PakFileHandle file, UINT startOffset, void *buffer, UINT bytesToRead )
 {
-	const PakFileEntry* pEntry = this->FindEntryByIndex( file );
-	CHK_VRET_X_IF_NIL( pEntry, 0 );
+	CHK_VRET_X_IF_NIL( this->FindEntryByIndex( file ), 0 );
+
+	const PakFileEntry& entry = m_entries[ this->FindNearestCopy( file ) ];
+
+	Assert(bytesToRead <= entry.uncompressedSize);
+
+	m_lastReadOrder = Pak_GetFileEntryOrder( entry );
 
-	const UINT offset = Pak_GetFileEntryOffset( *pEntry );
-	const SizeT dataSize = pEntry->uncompressedSize;
-	Assert(bytesToRead <= dataSize);
+	return m_volumes.ReadEntry( entry, buffer );
+}
 
-	m_fileReader.Seek( offset );
-	m_fileReader.Read( buffer, dataSize );
+U4 HashedPakFile::GetFileOffset( PakFileHandle file )
+{
+	CHK_VRET_X_IF_NIL( this->FindEntryByIndex( file ), 0 );
+	return Pak_GetFileEntryOrder( m_entries[ this->FindNearestCopy( file ) ] );
+}
+
+BYTE* HashedPakFile::MapFile( PakFileHandle file )
+{
+	CHK_VRET_NIL_IF_NIL( this->FindEntryByIndex( file ) );
 
-	return dataSize;
+	// UnmapFile() releases the mapped copy
+	if( this->FindMappedCopy( file ) != INDEX_NONE ) {
+		return nil;
+	}
+
+	const UINT copy = this->FindNearestCopy( file );
+	const PakFileEntry& entry = m_entries[ copy ];
+
+	BYTE* mappedData = m_volumes.MapEntry( copy, entry );
+	if( mappedData != nil ) {
+		m_lastReadOrder = Pak_GetFileEntryOrder( entry );
+	}
+	return mappedData;
+}
+
+void HashedPakFile::UnmapFile( PakFileHandle file )
+{
+	CHK_VRET_IF_NIL( this->FindEntryByIndex( file ) );
+
+	const UINT copy = this->FindMappedCopy( file );
+	if( copy != INDEX_NONE ) {
+		m_volumes.UnmapEntry( copy );
+	}
+}
+
+void HashedPakFile::PrefetchFiles( const PakFileHandle* files, UINT numFiles )
+{
+	for( UINT i = 0; i < numFiles; i++ )
+	{
+		if( this->FindEntryByIndex( files[i] ) != nil ) {
+			m_volumes.PrefetchEntry( m_entries[ this->FindNearestCopy( files[i] ) ] );
+		}
+	}
 }
 
 const PakFileEntry* HashedPakFile::FindEntryByIndex( PakFileHandle index ) const
 {
-	const TMap< ObjectGUID, PakFileEntry >::PairsArray& pairs = m_entries.GetPairs();
-	if( pairs.IsValidIndex( index ) ) {
-		return &pairs[ index ].value;
+	if( index < m_numEntries ) {
+		return &m_entries[ index ];
 	}
 	return nil;
 }
 
+// if the file has several copies, returns the nearest one after the last read entry
+// (or the first one if all copies are behind it)
+UINT HashedPakFile::FindNearestCopy( PakFileHandle file ) const
+{
+	Assert( file < m_numEntries );
+
+	// copies are sorted by position
+	for( UINT i = file; i < m_numEntries && m_guids[ i ].v == m_guids[ file ].v; i++ )
+	{
+		if( Pak_GetFileEntryOrder( m_entries[ i ] ) >= m_lastReadOrder ) {
+			return i;
+		}
+	}
+	return file;
+}
+
+// returns the copy of the file handed out by MapFile() or INDEX_NONE
+UINT HashedPakFile::FindMappedCopy( PakFileHandle file ) const
+{
+	Assert( file < m_numEntries );
+
+	for( UINT i = file; i < m_numEntries && m_guids[ i ].v == m_guids[ file ].v; i++ )
+	{
+		if( m_volumes.IsEntryMapped( i ) ) {
+			return i;
+		}
+	}
+	return INDEX_NONE;
+}
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
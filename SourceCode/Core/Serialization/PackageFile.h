@@ -2,6 +2,12 @@
 
 #include <Core/Resources.h>
 
+class AsyncJobQueue;
+
+
+// identifies the package format, change it when changing the layout of package files
+// ('RPK1' - entries can be compressed, 'RPK2' - 64-bit offsets, multiple volumes)
+enum { PAK_FILE_FOURCC = MAKEFOURCC('R','P','K','2') };
 
 // Structure defining the header of our resource files.
 struct PakFileHeader
@@ -12,13 +18,16 @@ struct PakFileHeader
 	FileTime	whenCreated;
 	FileTime	lastModified;
 
-	U4		totalSize;	// Total size of the PAK file
+	U8		totalSize;	// Total size of the PAK file (of all volumes)
 	U4		crc32;	// CRC32 checksum
 	U4		md5;	// MD5 checksum
+
+	U4		numVolumes;	// number of files the package is split into
+	U4		numEntries;	// number of entries in the table of contents
 #pragma pack (pop)
 
 public:
-	explicit PakFileHeader( U4 fourCC = MAKEFOURCC('R','P','K','0') );
+	explicit PakFileHeader( U4 fourCC = PAK_FILE_FOURCC );
 
 	bool Matches( const PakFileHeader& other ) const;
 };
@@ -26,17 +35,95 @@ mxDECLARE_POD_TYPE(PakFileHeader);
 
 
 
+// compression method of a package entry
+enum EPakCodec
+{
+	PakCodec_None = 0,	// stored as is
+	PakCodec_LZ4,		// split into LZ4-compressed blocks (see Pak_CompressEntry())
+};
+
 // this structure is used for locating individual resource file within a resource package
 #pragma pack (push,1)
 struct PakFileEntry
 {
-	U4	offset;	// Position of the entry relative to the beginning of the package file, in multiples of PAK_BLOCK_ALIGNMENT
-	U4	uncompressedSize;// Size of the entry in PACK file
+	U8	offset;	// Position of the entry relative to the beginning of the volume file, in bytes (multiple of PAK_BLOCK_ALIGNMENT)
+	U4	uncompressedSize;// Size of the loaded entry
+	U4	compressedSize;	// Size of the entry in PACK file (equals uncompressedSize if the entry is not compressed)
+	U2	volume;	// Index of the volume file containing the entry
+	U2	codec;	// EPakCodec
 };
 #pragma pack (pop)
 mxDECLARE_POD_TYPE(PakFileEntry);
 
 
+/*
+-----------------------------------------------------------------------------
+	PakVolumeSet
+
+	files of a package:
+	the first volume holds the header, the table of contents and the first entries,
+	large packages are split into several volumes
+	named "<package>", "<package>.001", "<package>.002", etc.
+-----------------------------------------------------------------------------
+*/
+class PakVolumeSet
+{
+public:
+	PakVolumeSet();
+	~PakVolumeSet();
+
+	// opens the first volume for reading the header and the table of contents
+	bool Open( const char* fileName );
+
+	// opens the remaining volumes and creates file mappings for zero-copy loading
+	// (only the parts which are being loaded are mapped into the address space)
+	bool OpenVolumes( const char* fileName, UINT numVolumes, UINT numEntries );
+
+	void Close();
+
+	bool IsOpen() const;
+
+	FileReader& GetMainFile();
+
+	// maps the given part of the volume until the package is closed (e.g. the table of contents),
+	// returns nil if the volume cannot be mapped
+	const BYTE* MapRegion( UINT volume, U8 offset, SizeT size );
+
+	// reads (and decompresses) the whole entry into the buffer
+	SizeT ReadEntry( const PakFileEntry& entry, void *buffer );
+
+	// returns a copy-on-write view of the entry which is valid until UnmapEntry()
+	// or nil if it must be read (compressed, already mapped or the volume cannot be mapped)
+	BYTE* MapEntry( UINT index, const PakFileEntry& entry );
+
+	// releases the view returned by MapEntry(), can be called from any thread
+	void UnmapEntry( UINT index );
+
+	bool IsEntryMapped( UINT index ) const;
+
+	void PrefetchEntry( const PakFileEntry& entry ) const;
+
+private:
+	struct Volume
+	{
+		FileReader	reader;
+		FileMapping	mapping;	// for zero-copy loading, not open if the volume cannot be mapped
+	public:
+		Volume() : reader( _NoInit ) {}
+	};
+
+	TList< Volume* >	m_volumes;
+
+	// start of the view of each entry handed out by MapEntry(), nil if the entry is not mapped
+	TList< void* >		m_entryViews;
+	mxCriticalSection	m_entryViewsLock;	// loaded resources are released without the content database lock
+
+	// views mapped by MapRegion()
+	TList< void* >		m_regionViews;
+
+	PREVENT_COPY(PakVolumeSet);
+};
+
 /*
 -----------------------------------------------------------------------------
 	OptimizedPakFile
@@ -50,7 +137,7 @@ class OptimizedPakFile : public AFilePackage
 {
 	TList< PakFileEntry >		m_entries;//+persistent
 
-	FileReader		m_fileReader;
+	PakVolumeSet	m_volumes;
 
 	PakFileHeader	m_header;//+persistent
 
@@ -86,6 +173,16 @@ public:
 	// Reads the file into the preallocated buffer
 	virtual SizeT ReadFile( PakFileHandle file, UINT startOffset, void *buffer, UINT bytesToRead ) override;
 
+	virtual U4 GetFileOffset( PakFileHandle file ) override;
+
+	// returns a view into the mapped package
+	virtual BYTE* MapFile( PakFileHandle file ) override;
+
+	virtual void UnmapFile( PakFileHandle file ) override;
+
+	// faults in pages of the given files
+	virtual void PrefetchFiles( const PakFileHandle* files, UINT numFiles ) override;
+
 private:
 	friend class EdPakFileBuilder;
 };
@@ -102,9 +199,23 @@ private:
 */
 class HashedPakFile : public AContentDatabase
 {
-	TMap< ObjectGUID, PakFileEntry >	m_entries;//+persistent
+	// the table of contents: GUIDs sorted in ascending order and corresponding entries,
+	// points into the mapped package or into the arrays below;
+	// small entries can be stored several times (see PakAccessTrace)
+	const ObjectGUID *		m_guids;//+persistent
+	const PakFileEntry *	m_entries;//+persistent
+	UINT					m_numEntries;
+
+	// position of the last read entry, if an entry has several copies,
+	// the nearest one after it is read (the copy is chosen when reading, not when opening,
+	// because the streamer opens a whole batch of files before reading them)
+	U4		m_lastReadOrder;
+
+	// used if the package cannot be mapped into memory
+	TList< ObjectGUID >		m_guidStorage;
+	TList< PakFileEntry >	m_entryStorage;
 
-	FileReader		m_fileReader;
+	PakVolumeSet	m_volumes;
 
 	PakFileHeader	m_header;//+persistent
 
@@ -128,6 +239,7 @@ public:
 
 	// fast access to file by file handle;
 	// returns BadPakFileHandle if not found
+	// (the handle refers to the first copy of the file)
 	//
 	virtual PakFileHandle OpenFile( ObjectGUIDArg fileGuid ) override;
 
@@ -142,8 +254,22 @@ public:
 	// Reads the file into the preallocated buffer
 	virtual SizeT ReadFile( PakFileHandle file, UINT startOffset, void *buffer, UINT bytesToRead ) override;
 
+	// returns the position of the copy which would be read now
+	virtual U4 GetFileOffset( PakFileHandle file ) override;
+
+	// returns a view into the mapped package
+	virtual BYTE* MapFile( PakFileHandle file ) override;
+
+	virtual void UnmapFile( PakFileHandle file ) override;
+
+	// faults in pages of the given files
+	virtual void PrefetchFiles( const PakFileHandle* files, UINT numFiles ) override;
+
 private:
 	const PakFileEntry* FindEntryByIndex( PakFileHandle index ) const;
+	UINT FindNearestCopy( PakFileHandle file ) const;
+	UINT FindMappedCopy( PakFileHandle file ) const;
+	void ResetFields();
 
 private:
 	friend class EdPakFileBuilder;
@@ -172,11 +298,64 @@ void Pak_SeekAlignedOffset( STREAM & file )
 	file.Seek( alignedOffset );
 }
 
-FORCEINLINE U4 Pak_GetFileEntryOffset( const PakFileEntry& fileInfo )
+FORCEINLINE U8 Pak_GetFileEntryOffset( const PakFileEntry& fileInfo )
+{
+	return fileInfo.offset;
+}
+
+// volumes are limited by 32-bit (signed) file offsets
+enum { PAK_MAX_VOLUME_SIZE = mxGIBIBYTE };
+enum { PAK_MAX_VOLUMES = 1000 };	// volume names have 3-digit suffixes
+
+// returns the position of the entry in the package in units of PAK_BLOCK_ALIGNMENT
+// (used for sorting reads, volumes are read in order)
+FORCEINLINE U4 Pak_GetFileEntryOrder( const PakFileEntry& fileInfo )
+{
+	return (U4(fileInfo.volume) << 20) | U4(fileInfo.offset / PAK_BLOCK_ALIGNMENT);
+}
+
+// writes the name of the given volume of the package into the buffer
+void Pak_GetVolumeFileName( const char* packageFileName, UINT volume, char* buffer, UINT bufferSize );
+
+
+// identifies files with recorded access traces
+enum { PAK_TRACE_FOURCC = MAKEFOURCC('R','P','K','T') };
+
+// sequence of resources opened while loading a level (see ResourceSystem::BeginAccessTrace()),
+// used by the package builder to place resources in the order they are read
+struct PakAccessTrace
+{
+	String				name;	// e.g. level name
+	TList< ObjectGUID >	guids;	// in the order of requests, may contain duplicates
+};
+
+bool Pak_SaveAccessTraces( const char* fileName, const TList< PakAccessTrace >& traces );
+bool Pak_LoadAccessTraces( const char* fileName, TList< PakAccessTrace > &traces );
+
+// copies of small entries shared by several levels are stored next to each level's entries
+enum { PAK_MAX_DUPLICATED_ENTRY_SIZE = 16*mxKIBIBYTE };
+
+
+// Compressed entries are split into blocks which can be decompressed independently.
+// Layout: U4 blockEnds[numBlocks] (end of each block relative to the first block,
+// PAK_STORED_BLOCK is set if the block is stored uncompressed) followed by block data.
+enum { PAK_COMPRESSION_BLOCK_SIZE = 64*mxKIBIBYTE };
+enum { PAK_STORED_BLOCK = 0x80000000 };
+
+// smaller entries are not compressed
+enum { PAK_MIN_COMPRESSED_ENTRY_SIZE = 4*mxKIBIBYTE };
+
+FORCEINLINE UINT Pak_CalcNumBlocks( UINT uncompressedSize )
 {
-	return fileInfo.offset * PAK_BLOCK_ALIGNMENT;
+	return (uncompressedSize + (PAK_COMPRESSION_BLOCK_SIZE-1)) / PAK_COMPRESSION_BLOCK_SIZE;
 }
 
+// returns false if the data should be stored uncompressed (too small or doesn't compress well)
+bool Pak_CompressEntry( const void* data, UINT dataSize, TList< BYTE > &compressedData );
+
+// decompresses blocks in parallel if the job queue is not null
+bool Pak_DecompressEntry( const void* compressedData, UINT compressedSize, void* buffer, UINT uncompressedSize, AsyncJobQueue* jobQueue );
+
 
 //--------------------------------------------------------------//
 //				End Of File.									//
@@ -1,10 +1,416 @@
 #include <EditorSupport_PCH.h>
 #pragma hdrstop
 
+#include <Base/Util/Sorting.h>
+
 #include <Core/Serialization/PackageFile.h>
 
 #include <EditorSupport/AssetPipeline/BuildPakFile.h>
 
+namespace
+{
+	struct CompareGuids
+	{
+		FORCEINLINE bool operator () ( const ObjectGUID& a, const ObjectGUID& b ) const
+		{
+			return a.v < b.v;
+		}
+	};
+
+	// copy of an asset in the package
+	struct PakSlot
+	{
+		ObjectGUID		guid;
+		UINT			asset;	// index of the asset
+		PakFileEntry	entry;
+	};
+
+	struct CompareSlots
+	{
+		FORCEINLINE bool operator () ( const PakSlot& a, const PakSlot& b ) const
+		{
+			if( a.guid.v != b.guid.v ) {
+				return a.guid.v < b.guid.v;
+			}
+			return Pak_GetFileEntryOrder( a.entry ) < Pak_GetFileEntryOrder( b.entry );
+		}
+	};
+
+	// assigns the position of the next entry, starts a new volume if the current one is full
+	static bool F_PlaceEntry( U8 & volumeSize, UINT & volume, UINT entrySize, UINT maxVolumeSize, PakFileEntry & entry )
+	{
+		CHK_VRET_FALSE_IF_NOT( entrySize <= maxVolumeSize );
+
+		// data must start at aligned address
+		U8 alignedOffset = Pak_CalcAlignedSize( (SizeT)volumeSize );
+
+		if( alignedOffset + entrySize > maxVolumeSize )
+		{
+			volume++;
+			alignedOffset = 0;
+		}
+
+		entry.offset = alignedOffset;
+		entry.volume = volume;
+
+		volumeSize = alignedOffset + entrySize;
+
+		return true;
+	}
+
+	// writes package entries, starts a new volume when the current one is full
+	class PakVolumeWriter
+	{
+		const char *			m_fileName;
+		UINT					m_maxVolumeSize;
+		TList< FileWriter* >	m_volumes;
+
+	public:
+		PakVolumeWriter( const char* fileName, UINT maxVolumeSize )
+		{
+			m_fileName = fileName;
+			m_maxVolumeSize = maxVolumeSize;
+			m_volumes.Add( new_one(FileWriter( fileName )) );
+		}
+		~PakVolumeWriter()
+		{
+			for( UINT i = 0; i < m_volumes.Num(); i++ )
+			{
+				free_one( m_volumes[i] );
+			}
+		}
+
+		bool IsOpen() const
+		{
+			return m_volumes.GetLast()->IsOpen();
+		}
+
+		// holds the header and the table of contents
+		FileWriter& GetMainFile()
+		{
+			return *m_volumes[0];
+		}
+
+		UINT NumVolumes() const
+		{
+			return m_volumes.Num();
+		}
+
+		// compresses the entry if it's worth it and writes it at an aligned position
+		bool WriteEntry( const MemoryBlob& assetData, TList< BYTE > & compressedData, PakFileEntry & entry )
+		{
+			const UINT fileSize = assetData.GetDataSize();
+
+			const void* data = assetData.ToPtr();
+			UINT dataSize = fileSize;
+
+			entry.uncompressedSize = fileSize;
+			entry.codec = PakCodec_None;
+
+			if( Pak_CompressEntry( assetData.ToPtr(), fileSize, compressedData ) )
+			{
+				data = compressedData.ToPtr();
+				dataSize = compressedData.Num();
+				entry.codec = PakCodec_LZ4;
+			}
+
+			entry.compressedSize = dataSize;
+
+			U8 volumeSize = m_volumes.GetLast()->Tell();
+			UINT volume = m_volumes.Num() - 1;
+
+			CHK_VRET_FALSE_IF_NOT( F_PlaceEntry( volumeSize, volume, dataSize, m_maxVolumeSize, entry ) );
+
+			if( volume >= m_volumes.Num() )
+			{
+				CHK_VRET_FALSE_IF_NOT( m_volumes.Num() < PAK_MAX_VOLUMES );
+
+				char	volumeName[ FS_MAX_PATH ];
+				Pak_GetVolumeFileName( m_fileName, m_volumes.Num(), volumeName, NUMBER_OF(volumeName) );
+
+				m_volumes.Add( new_one(FileWriter( volumeName )) );
+				CHK_VRET_FALSE_IF_NOT( this->IsOpen() );
+			}
+
+			FileWriter & writer = *m_volumes.GetLast();
+			writer.Seek( (FileOffset)entry.offset );
+			writer.Write( data, dataSize );
+
+			return true;
+		}
+	};
+
+	// places assets in the order they are loaded by the recorded traces,
+	// small assets shared by several traces can be placed once per trace;
+	// assets which are never loaded are placed at the end
+	static void F_CalcLayoutOrder(
+		const TList< ObjectGUID >& assetGuids,
+		const TList< UINT >& assetSizes,
+		const TList< PakAccessTrace >& traces,
+		bool duplicateSmallAssets,
+		TList< UINT > &order
+		)
+	{
+		const UINT numAssets = assetGuids.Num();
+
+		TMap< ObjectGUID, UINT >	assetIndices;
+		for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+		{
+			if( assetGuids[ iAsset ].IsValid() ) {
+				assetIndices.Set( assetGuids[ iAsset ], iAsset );
+			}
+		}
+
+		// (index of the trace + 1) which loaded the asset last, zero if not placed yet
+		TList< UINT >	lastTrace;
+		lastTrace.SetNum( numAssets );
+		MemZero( lastTrace.ToPtr(), lastTrace.GetDataSize() );
+
+		order.Empty();
+		order.Reserve( numAssets );
+
+		for( UINT iTrace = 0; iTrace < traces.Num(); iTrace++ )
+		{
+			const TList< ObjectGUID >& guids = traces[ iTrace ].guids;
+
+			for( UINT i = 0; i < guids.Num(); i++ )
+			{
+				const UINT* pAsset = assetIndices.Find( guids[i] );
+				if( pAsset == nil ) {
+					continue;
+				}
+
+				const UINT iAsset = *pAsset;
+				const UINT wasPlaced = lastTrace[ iAsset ];
+
+				if( wasPlaced == iTrace + 1 ) {
+					continue;	// already loaded by this trace
+				}
+				lastTrace[ iAsset ] = iTrace + 1;
+
+				if( !wasPlaced || (duplicateSmallAssets && assetSizes[ iAsset ] <= PAK_MAX_DUPLICATED_ENTRY_SIZE) )
+				{
+					order.Add( iAsset );
+				}
+			}
+		}
+
+		for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+		{
+			if( !lastTrace[ iAsset ] ) {
+				order.Add( iAsset );
+			}
+		}
+	}
+
+	struct PakLayoutStats
+	{
+		UINT	numSeeks;
+		U8		bytesRead;
+		U8		seekDistance;	// total distance of seeks within volumes
+		U8		packageSize;
+	};
+
+	// returns the nearest copy of the asset after the last read entry
+	// or the first one if all copies are behind it (see HashedPakFile::FindNearestCopy())
+	static UINT F_FindNearestCopy(
+		const TList< PakSlot >& slots,
+		const TList< UINT >& nextCopy,
+		UINT firstCopy,
+		U4 lastReadOrder
+		)
+	{
+		UINT best = firstCopy;
+		U4 bestOrder = Pak_GetFileEntryOrder( slots[ best ].entry );
+
+		for( UINT iSlot = nextCopy[ best ]; iSlot != INDEX_NONE; iSlot = nextCopy[ iSlot ] )
+		{
+			const U4 order = Pak_GetFileEntryOrder( slots[ iSlot ].entry );
+			const bool isAhead = (order >= lastReadOrder);
+			const bool bestIsAhead = (bestOrder >= lastReadOrder);
+
+			if( (isAhead && (!bestIsAhead || order < bestOrder)) || (!isAhead && !bestIsAhead && order < bestOrder) )
+			{
+				best = iSlot;
+				bestOrder = order;
+			}
+		}
+		return best;
+	}
+
+	// pending read of the simulated streamer
+	struct PakRead
+	{
+		U4		order;	// position of the nearest copy when the file was opened
+		UINT	asset;
+	};
+
+	struct CompareReads
+	{
+		FORCEINLINE bool operator () ( const PakRead& a, const PakRead& b ) const
+		{
+			return a.order < b.order;
+		}
+	};
+
+	// simulates loading the traced assets from the given layout the way the streamer does it:
+	// levels are loaded in the order of the traces, each level requests all of its assets at once,
+	// the streamer opens them and sorts the reads by GetFileOffset() (the nearest copy at that time),
+	// then the copy of each asset is chosen again when it's read (see HashedPakFile::ReadFile())
+	static void F_CalcLayoutStats(
+		const TList< PakSlot >& slots,
+		UINT numAssets,
+		const TList< ObjectGUID >& assetGuids,
+		const TList< PakAccessTrace >& traces,
+		PakLayoutStats &stats
+		)
+	{
+		ZERO_OUT( stats );
+
+		// copies of each asset
+		TList< UINT >	firstCopy;
+		TList< UINT >	nextCopy;
+
+		firstCopy.SetNum( numAssets );
+		nextCopy.SetNum( slots.Num() );
+
+		for( UINT iAsset = 0; iAsset < numAssets; iAsset++ ) {
+			firstCopy[ iAsset ] = INDEX_NONE;
+		}
+		for( INT iSlot = slots.Num() - 1; iSlot >= 0; iSlot-- )
+		{
+			if( slots[ iSlot ].guid.IsNull() ) {
+				continue;	// not written
+			}
+			const UINT iAsset = slots[ iSlot ].asset;
+			nextCopy[ iSlot ] = firstCopy[ iAsset ];
+			firstCopy[ iAsset ] = iSlot;
+
+			stats.packageSize += slots[ iSlot ].entry.compressedSize;
+		}
+
+		TMap< ObjectGUID, UINT >	assetIndices;
+		for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+		{
+			if( assetGuids[ iAsset ].IsValid() ) {
+				assetIndices.Set( assetGuids[ iAsset ], iAsset );
+			}
+		}
+
+		TList< UINT >	lastTrace;
+		lastTrace.SetNum( numAssets );
+		MemZero( lastTrace.ToPtr(), lastTrace.GetDataSize() );
+
+		TList< PakRead >	batch;
+
+		// the package has just been opened
+		U4 lastReadOrder = 0;
+
+		for( UINT iTrace = 0; iTrace < traces.Num(); iTrace++ )
+		{
+			const TList< ObjectGUID >& guids = traces[ iTrace ].guids;
+
+			// open the files of the level
+			batch.Empty();
+
+			for( UINT i = 0; i < guids.Num(); i++ )
+			{
+				const UINT* pAsset = assetIndices.Find( guids[i] );
+				if( pAsset == nil || firstCopy[ *pAsset ] == INDEX_NONE || lastTrace[ *pAsset ] == iTrace + 1 ) {
+					continue;
+				}
+				lastTrace[ *pAsset ] = iTrace + 1;
+
+				const UINT copy = F_FindNearestCopy( slots, nextCopy, firstCopy[ *pAsset ], lastReadOrder );
+
+				PakRead & read = batch.Add();
+				read.order = Pak_GetFileEntryOrder( slots[ copy ].entry );
+				read.asset = *pAsset;
+			}
+
+			if( batch.Num() > 1 )
+			{
+				CompareReads	predicate;
+				NxQuickSort( batch.ToPtr(), batch.ToPtr() + batch.Num() - 1, predicate );
+			}
+
+			// read them in the sorted order, each level starts with a seek
+			UINT currVolume = INDEX_NONE;
+			U8 currOffset = 0;
+
+			for( UINT i = 0; i < batch.Num(); i++ )
+			{
+				const UINT copy = F_FindNearestCopy( slots, nextCopy, firstCopy[ batch[i].asset ], lastReadOrder );
+				const PakFileEntry& entry = slots[ copy ].entry;
+
+				const U8 alignedOffset = Pak_CalcAlignedSize( (SizeT)currOffset );
+				if( entry.volume != currVolume || entry.offset != alignedOffset )
+				{
+					stats.numSeeks++;
+					if( entry.volume == currVolume ) {
+						stats.seekDistance += (entry.offset > alignedOffset) ? (entry.offset - alignedOffset) : (alignedOffset - entry.offset);
+					}
+				}
+
+				stats.bytesRead += entry.compressedSize;
+
+				currVolume = entry.volume;
+				currOffset = entry.offset + entry.compressedSize;
+				lastReadOrder = Pak_GetFileEntryOrder( entry );
+			}
+		}
+	}
+
+	// places the assets one after another without writing them (to compare layouts)
+	static void F_SimulateDefaultLayout(
+		const TList< PakSlot >& assetSlots,
+		UINT dataOffset,
+		UINT maxVolumeSize,
+		TList< PakSlot > &slots
+		)
+	{
+		slots = assetSlots;
+
+		U8 volumeSize = dataOffset;
+		UINT volume = 0;
+
+		for( UINT i = 0; i < slots.Num(); i++ )
+		{
+			F_PlaceEntry( volumeSize, volume, slots[i].entry.compressedSize, maxVolumeSize, slots[i].entry );
+		}
+	}
+
+	static void F_ReportLayoutStats( const char* destFilePath, const PakLayoutStats& before, const PakLayoutStats& after )
+	{
+		DEVOUT("Package layout of '%s' (simulated loads of recorded traces):\n"
+			"\tdefault order:    %u seeks, %u KiB read, %u KiB skipped, package: %u KiB\n"
+			"\ttraced order:     %u seeks, %u KiB read, %u KiB skipped, package: %u KiB\n",
+			destFilePath,
+			before.numSeeks, UINT(before.bytesRead/mxKIBIBYTE), UINT(before.seekDistance/mxKIBIBYTE), UINT(before.packageSize/mxKIBIBYTE),
+			after.numSeeks, UINT(after.bytesRead/mxKIBIBYTE), UINT(after.seekDistance/mxKIBIBYTE), UINT(after.packageSize/mxKIBIBYTE)
+			);
+	}
+}
+
+EdPakFileBuilder::EdPakFileBuilder()
+{
+	m_maxVolumeSize = PAK_MAX_VOLUME_SIZE;
+}
+
+void EdPakFileBuilder::SetMaxVolumeSize( UINT maxVolumeSize )
+{
+	Assert( maxVolumeSize >= PAK_BLOCK_ALIGNMENT && maxVolumeSize <= PAK_MAX_VOLUME_SIZE );
+	m_maxVolumeSize = Clamp<UINT>( maxVolumeSize, PAK_BLOCK_ALIGNMENT, PAK_MAX_VOLUME_SIZE );
+}
+
+bool EdPakFileBuilder::LoadAccessTraces( const char* traceFileName )
+{
+	CHK_VRET_FALSE_IF_NOT( Pak_LoadAccessTraces( traceFileName, m_traces ) );
+
+	DEVOUT("Loaded %u access traces from '%s'\n", m_traces.Num(), traceFileName);
+	return true;
+}
+
 bool EdPakFileBuilder::Build_Optimized_Pak_File(
 	const char* destFilePath,
 	const StringListType& referencedAssets
@@ -14,8 +420,10 @@ bool EdPakFileBuilder::Build_Optimized_Pak_File(
 	CHK_VRET_FALSE_IF_NOT(numAssets > 0);
 
 
-	FileWriter	pakFileWriter( destFilePath );
-	CHK_VRET_FALSE_IF_NOT(pakFileWriter.IsOpen());
+	PakVolumeWriter	volumeWriter( destFilePath, m_maxVolumeSize );
+	CHK_VRET_FALSE_IF_NOT(volumeWriter.IsOpen());
+
+	FileWriter & pakFileWriter = volumeWriter.GetMainFile();
 
 
 	AContentDatabase* assetDb = gCore.resources->GetContentDatabase();
@@ -24,6 +432,24 @@ bool EdPakFileBuilder::Build_Optimized_Pak_File(
 	MemoryBlob	assetData(EMemHeap::HeapTemp);
 	assetData.Reserve(32*mxMEGABYTE);
 
+	TList< BYTE >	compressedData;
+
+
+	// Place the assets in the order they are loaded.
+	// Entries are looked up by indices so they cannot be duplicated.
+
+	TList< ObjectGUID >	assetGuids;
+	assetGuids.SetNum( numAssets );
+
+	for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+	{
+		assetGuids[ iAsset ] = assetDb->AssetPathToGuid( referencedAssets[ iAsset ] );
+	}
+
+	TList< UINT >	assetSizes;
+	TList< UINT >	order;
+	F_CalcLayoutOrder( assetGuids, assetSizes, m_traces, false, order );
+
 
 	OptimizedPakFile	packageFile;
 
@@ -37,19 +463,27 @@ bool EdPakFileBuilder::Build_Optimized_Pak_File(
 	const FilePosition tocOffset = pakFileWriter.Tell();
 
 	packageFile.m_entries.SetNum( numAssets );
+	MemZero( packageFile.m_entries.ToPtr(), packageFile.m_entries.GetDataSize() );
 
 	pakFileWriter << packageFile.m_entries;
 
+	const UINT dataOffset = pakFileWriter.Tell();
+
 
 	// Serialize file data.
 
-	SizeT totalPakFileSize = 0;
+	U8 totalPakFileSize = 0;
+	U8 totalUncompressedSize = 0;
 
+	TList< PakSlot >	slots;
+	slots.SetNum( numAssets );
+	MemZero( slots.ToPtr(), slots.GetDataSize() );
 
-	for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+
+	for( UINT i = 0; i < order.Num(); i++ )
 	{
-		const String& assetPath = referencedAssets[ iAsset ];
-		const ObjectGUID assetGuid = assetDb->AssetPathToGuid( assetPath );
+		const UINT iAsset = order[i];
+		const ObjectGUID assetGuid = assetGuids[ iAsset ];
 		Assert( assetGuid.IsValid() );
 		if( assetGuid.IsNull() ) {
 			continue;
@@ -66,16 +500,15 @@ bool EdPakFileBuilder::Build_Optimized_Pak_File(
 		assetDb->ReadFile( fileHandle, 0, assetData.ToPtr(), fileSize );
 
 
-		// data must start at aligned address
-		Pak_SeekAlignedOffset( pakFileWriter );
-
 		PakFileEntry & entry = packageFile.m_entries[ iAsset ];
-		entry.offset = pakFileWriter.Tell() / PAK_BLOCK_ALIGNMENT;
-		entry.uncompressedSize = fileSize;
+		CHK_VRET_FALSE_IF_NOT( volumeWriter.WriteEntry( assetData, compressedData, entry ) );
 
-		pakFileWriter.Write( assetData.ToPtr(), assetData.GetDataSize() );
+		slots[ iAsset ].guid = assetGuid;
+		slots[ iAsset ].asset = iAsset;
+		slots[ iAsset ].entry = entry;
 
-		totalPakFileSize += entry.uncompressedSize;
+		totalPakFileSize += entry.compressedSize;
+		totalUncompressedSize += entry.uncompressedSize;
 	}
 
 	// Update the package header.
@@ -83,7 +516,10 @@ bool EdPakFileBuilder::Build_Optimized_Pak_File(
 	packageFile.m_header.totalSize = totalPakFileSize;
 	packageFile.m_header.crc32 = -1;
 	packageFile.m_header.md5 = -1;
+	packageFile.m_header.numVolumes = volumeWriter.NumVolumes();
+	packageFile.m_header.numEntries = numAssets;
 
+	pakFileWriter.Seek( 0 );
 	pakFileWriter << packageFile.m_header;
 	
 
@@ -93,7 +529,23 @@ bool EdPakFileBuilder::Build_Optimized_Pak_File(
 	pakFileWriter << packageFile.m_entries;
 
 
-	DEVOUT("Saved package to file '%s' (%u entries)\n",destFilePath,numAssets);
+	DEVOUT("Saved package to file '%s' (%u entries, %u volumes, %u KiB, uncompressed: %u KiB)\n",
+		destFilePath,numAssets,volumeWriter.NumVolumes(),UINT(totalPakFileSize/mxKIBIBYTE),UINT(totalUncompressedSize/mxKIBIBYTE));
+
+
+	// Compare with the layout in the order of the asset list.
+
+	if( m_traces.Num() )
+	{
+		TList< PakSlot >	defaultSlots;
+		F_SimulateDefaultLayout( slots, dataOffset, m_maxVolumeSize, defaultSlots );
+
+		PakLayoutStats	before, after;
+		F_CalcLayoutStats( defaultSlots, numAssets, assetGuids, m_traces, before );
+		F_CalcLayoutStats( slots, numAssets, assetGuids, m_traces, after );
+
+		F_ReportLayoutStats( destFilePath, before, after );
+	}
 
 
 	// Save package metadata.
@@ -114,8 +566,10 @@ bool EdPakFileBuilder::Build_Hashed_Pak_File(
 	CHK_VRET_FALSE_IF_NOT(numAssets > 0);
 
 
-	FileWriter	pakFileWriter( destFilePath );
-	CHK_VRET_FALSE_IF_NOT(pakFileWriter.IsOpen());
+	PakVolumeWriter	volumeWriter( destFilePath, m_maxVolumeSize );
+	CHK_VRET_FALSE_IF_NOT(volumeWriter.IsOpen());
+
+	FileWriter & pakFileWriter = volumeWriter.GetMainFile();
 
 
 	AContentDatabase* assetDb = gCore.resources->GetContentDatabase();
@@ -124,9 +578,43 @@ bool EdPakFileBuilder::Build_Hashed_Pak_File(
 	MemoryBlob	assetData(EMemHeap::HeapTemp);
 	assetData.Reserve(32*mxMEGABYTE);
 
+	TList< BYTE >	compressedData;
+
+
+	// Place the assets in the order they are loaded,
+	// small assets shared by several levels are stored next to each level's assets.
+
+	TList< UINT >	assetSizes;
+	assetSizes.SetNum( numAssets );
+
+	for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+	{
+		assetSizes[ iAsset ] = 0;
+
+		PakFileHandle fileHandle = assetDb->OpenFile( loadedAssets[ iAsset ] );
+		if( fileHandle != BadPakFileHandle )
+		{
+			assetSizes[ iAsset ] = assetDb->GetFileSize( fileHandle );
+			assetDb->CloseFile( fileHandle );
+		}
+	}
+
+	TList< UINT >	order;
+	F_CalcLayoutOrder( loadedAssets, assetSizes, m_traces, true, order );
+
+	const UINT numEntries = order.Num();
+
 
 	HashedPakFile	packageFile;
 
+	TList< ObjectGUID > &	guids = packageFile.m_guidStorage;
+	TList< PakFileEntry > &	entries = packageFile.m_entryStorage;
+
+	guids.SetNum( numEntries );
+	entries.SetNum( numEntries );
+	MemZero( guids.ToPtr(), guids.GetDataSize() );
+	MemZero( entries.ToPtr(), entries.GetDataSize() );
+
 	// Reserve space for the header.
 
 	pakFileWriter << packageFile.m_header;
@@ -135,24 +623,25 @@ bool EdPakFileBuilder::Build_Hashed_Pak_File(
 	// Reserve space for the table of contents.
 
 	const FilePosition tocOffset = pakFileWriter.Tell();
-	//packageFile.m_entries.Reserve( numAssets );
-	for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
-	{
-		PakFileEntry	dummy;
-		ZERO_OUT( dummy );
-		packageFile.m_entries.Set( loadedAssets[iAsset], dummy );
-	}
-	pakFileWriter << packageFile.m_entries;
+
+	pakFileWriter.Write( guids.ToPtr(), guids.GetDataSize() );
+	pakFileWriter.Write( entries.ToPtr(), entries.GetDataSize() );
 
 
 	// Serialize file data.
 
-	SizeT totalPakFileSize = 0;
+	U8 totalPakFileSize = 0;
+	U8 totalUncompressedSize = 0;
 
+	TList< PakSlot >	slots;
+	slots.SetNum( numEntries );
+	MemZero( slots.ToPtr(), slots.GetDataSize() );
 
-	for( UINT iAsset = 0; iAsset < numAssets; iAsset++ )
+
+	for( UINT i = 0; i < numEntries; i++ )
 	{
-		const ObjectGUID assetGuid = loadedAssets[iAsset];
+		const UINT iAsset = order[i];
+		const ObjectGUID assetGuid = loadedAssets[ iAsset ];
 		Assert( assetGuid.IsValid() );
 		if( assetGuid.IsNull() ) {
 			continue;
@@ -169,24 +658,26 @@ bool EdPakFileBuilder::Build_Hashed_Pak_File(
 		assetDb->ReadFile( fileHandle, 0, assetData.ToPtr(), fileSize );
 
 
-		// data must start at aligned address
-		Pak_SeekAlignedOffset( pakFileWriter );
+		PakSlot & slot = slots[i];
+		slot.guid = assetGuid;
+		slot.asset = iAsset;
+		CHK_VRET_FALSE_IF_NOT( volumeWriter.WriteEntry( assetData, compressedData, slot.entry ) );
 
-		PakFileEntry * entry = packageFile.m_entries.Find( assetGuid );
-		Assert(entry);
-		if( !entry ) {
-			continue;
-		}
-		entry->offset = pakFileWriter.Tell() / PAK_BLOCK_ALIGNMENT;
-		entry->uncompressedSize = fileSize;
-
-		pakFileWriter.Write( assetData.ToPtr(), assetData.GetDataSize() );
+		totalPakFileSize += slot.entry.compressedSize;
+		totalUncompressedSize += slot.entry.uncompressedSize;
+	}
 
-		totalPakFileSize += entry->uncompressedSize;
+	// the table of contents is sorted by GUIDs for binary search
+	if( numEntries > 1 )
+	{
+		CompareSlots	predicate;
+		NxQuickSort( slots.ToPtr(), slots.ToPtr() + numEntries - 1, predicate );
+	}
 
-		char	tmp[32];
-		assetGuid.ToChars(tmp);
-		DBGOUT( "GUID[%u] = %s\n", iAsset, tmp );
+	for( UINT i = 0; i < numEntries; i++ )
+	{
+		guids[i] = slots[i].guid;
+		entries[i] = slots[i].entry;
 	}
 
 	// Update the package header.
@@ -194,17 +685,48 @@ bool EdPakFileBuilder::Build_Hashed_Pak_File(
 	packageFile.m_header.totalSize = totalPakFileSize;
 	packageFile.m_header.crc32 = -1;
 	packageFile.m_header.md5 = -1;
+	packageFile.m_header.numVolumes = volumeWriter.NumVolumes();
+	packageFile.m_header.numEntries = numEntries;
 
+	pakFileWriter.Seek( 0 );
 	pakFileWriter << packageFile.m_header;
 	
 
 	// Write the table of contents.
 
 	pakFileWriter.Seek( tocOffset );
-	pakFileWriter << packageFile.m_entries;
+	pakFileWriter.Write( guids.ToPtr(), guids.GetDataSize() );
+	pakFileWriter.Write( entries.ToPtr(), entries.GetDataSize() );
+
 
+	DEVOUT("Saved package to file '%s' (%u entries, %u copies, %u volumes, %u KiB, uncompressed: %u KiB)\n",
+		destFilePath,numAssets,numEntries,volumeWriter.NumVolumes(),UINT(totalPakFileSize/mxKIBIBYTE),UINT(totalUncompressedSize/mxKIBIBYTE));
 
-	DEVOUT("Saved package to file '%s' (%u entries)\n",destFilePath,numAssets);
+
+	// Compare with the layout in the order of loaded assets without duplicates.
+
+	if( m_traces.Num() )
+	{
+		TList< PakSlot >	assetSlots;
+		assetSlots.SetNum( numAssets );
+		MemZero( assetSlots.ToPtr(), assetSlots.GetDataSize() );
+
+		for( UINT i = 0; i < numEntries; i++ )
+		{
+			assetSlots[ slots[i].asset ] = slots[i];
+		}
+
+		const UINT defaultDataOffset = tocOffset + numAssets * (sizeof(ObjectGUID) + sizeof(PakFileEntry));
+
+		TList< PakSlot >	defaultSlots;
+		F_SimulateDefaultLayout( assetSlots, defaultDataOffset, m_maxVolumeSize, defaultSlots );
+
+		PakLayoutStats	before, after;
+		F_CalcLayoutStats( defaultSlots, numAssets, loadedAssets, m_traces, before );
+		F_CalcLayoutStats( slots, numAssets, loadedAssets, m_traces, after );
+
+		F_ReportLayoutStats( destFilePath, before, after );
+	}
 
 
 	// Save package metadata.
@@ -212,4 +734,3 @@ bool EdPakFileBuilder::Build_Hashed_Pak_File(
 
 	return true;
 }
-
@@ -1,8 +1,19 @@
 #pragma once
 
+#include <Core/Serialization/PackageFile.h>
+
 class EdPakFileBuilder
 {
 public:
+	EdPakFileBuilder();
+
+	// packages larger than this are split into several volumes
+	void SetMaxVolumeSize( UINT maxVolumeSize );
+
+	// assets will be placed in the order they were loaded by levels
+	// (see ResourceSystem::SaveAccessTraces()), the builder reports the number of seeks before and after
+	bool LoadAccessTraces( const char* traceFileName );
+
 	bool Build_Optimized_Pak_File(
 		const char* destFilePath,
 		const StringListType& referencedAssets
@@ -11,4 +22,8 @@ public:
 	bool Build_Hashed_Pak_File(
 		const char* destFilePath
 		);
+
+private:
+	UINT	m_maxVolumeSize;
+	TList< PakAccessTrace >	m_traces;
 };
@@ -173,6 +173,31 @@ void World::UpdateEntities( FLOAT deltaSeconds )
 	//}
 }
 
+void World::ExtractFramePacket( const rxView& camera )
+{
+	rxFramePacket & packet = m_framePackets.BeginWrite();
+
+	m_renderWorld.ExtractFramePacket( camera, packet );
+
+	m_framePackets.EndWrite();
+}
+
+const rxFramePacket& World::BeginRenderFrame()
+{
+	const rxFramePacket& packet = m_framePackets.BeginRead();
+
+	m_renderWorld.rfSetFramePacket( &packet );
+
+	return packet;
+}
+
+void World::EndRenderFrame()
+{
+	m_renderWorld.rfSetFramePacket( nil );
+
+	m_framePackets.EndRead();
+}
+
 void World::Optimize()
 {
 	// TODO: sort entity list by object id
@@ -147,6 +147,9 @@ class World
 	// graphics
 	rxRenderWorld	m_renderWorld;
 
+	// snapshots of the render world passed from the simulation to the renderer
+	rxFramePacketQueue	m_framePackets;
+
 	// entities
 	TList< AEntity* >	m_entities;
 
@@ -173,6 +176,20 @@ public:
 	//pxWorld& GetPhysicsWorld();
 	rxRenderWorld& GetRenderWorld();
 
+	// Frame packets.
+
+	// copies the state needed for rendering into the next frame packet,
+	// called on the simulation thread after RunPhysics() and UpdateEntities()
+	// (waits if the renderer is still busy with both packets)
+	void ExtractFramePacket( const rxView& camera );
+
+	// binds the oldest extracted packet to the render world,
+	// called on the render thread before drawing the scene
+	const rxFramePacket& BeginRenderFrame();
+
+	// unbinds the packet and gives it back to the simulation thread
+	void EndRenderFrame();
+
 	virtual void Optimize();
 
 	virtual void PostLoad() override;
@@ -417,8 +417,8 @@ bool DemoGame::Init_PostLoad()
 		//physicsWorld->SetGravity(Vec3D(0, -0.001f, 0));
 		physicsWorld->SetGravity(Vec3D(0, 0, 0));
 
-		physicsWorld->GetSolver()->Settings().minIterations = 4;
-		physicsWorld->GetSolver()->Settings().maxIterations = 8;
+		physicsWorld->GetSolver()->Settings().minIterations = 2;
+		physicsWorld->GetSolver()->Settings().maxIterations = 4;
 		physicsWorld->GetSolver()->Settings().erp = 0.4f;
 		physicsWorld->GetSolver()->Settings().precision = 0.001f;
 
@@ -255,9 +255,16 @@ public:	//=-- AClientViewport
 
 			m_camera.SetAspectRatio( m_mainViewport.GetAspectRatio() );
 
-			rxSceneContext	context( m_camera.GetView(), renderWorld );
+			// snapshot the world after the simulation has finished with it
+			m_world->ExtractFramePacket( m_camera.GetView() );
 
-			gRenderer.DrawScene( context );
+			const rxFramePacket& framePacket = m_world->BeginRenderFrame();
+			{
+				rxSceneContext	context( framePacket.camera, renderWorld );
+
+				gRenderer.DrawScene( context );
+			}
+			m_world->EndRenderFrame();
 		}
 
 		//
@@ -21,6 +21,8 @@ void pxCollideable::_ctor( const pxCollideableInfo& desc )
 	m_broadphaseProxy = INDEX_NONE;
 	m_collisionShape = desc.shape;
 
+	m_flags.Clear();
+
 	//m_ccdHitFraction = 1.0f;
 
 	SetMaterial( desc.material );
@@ -43,6 +45,21 @@ const pxShape* pxCollideable::GetShape() const
 	return m_collisionShape.ToPtr();
 }
 
+bool pxCollideable::CastRay( const pxVec3& from, const pxVec3& to, pxShapeRayCastOutput &output ) const
+{
+	// shapes work in their local space
+	pxShapeRayCastInput	localInput;
+	localInput.m_from = m_transform.invXform( from );
+	localInput.m_to = m_transform.invXform( to );
+
+	if( this->GetShape()->CastRay( localInput, output ) )
+	{
+		output.m_normal = m_transform.GetBasis() * output.m_normal;
+		return true;
+	}
+	return false;
+}
+
 void pxCollideable::SetShape( pxShape::Handle newShape )
 {
 	m_collisionShape = newShape;
@@ -20,6 +20,7 @@
 
 
 class pxWorld;
+struct pxShapeRayCastOutput;
 
 // handle to broadphase proxy used for quick and coarse collision detection
 typedef pxU4 pxBroadphaseProxy;
@@ -62,6 +63,7 @@ enum pxcBodyFlags
 	PX_STATIC_OBJECT	= BIT(0),	// is the object static or movable?
 //	PX_FANTOM_OBJECT	= BIT(1),	// is it a ghost object?
 //	PX_CHARACTER_OBJECT	= BIT(2),	// is it a character controller?
+	PX_SLEEPING_OBJECT	= BIT(3),	// is the object deactivated (not simulated until woken up)?
 };
 typedef TBits<
 	pxcBodyFlags,
@@ -91,6 +93,8 @@ MX_ALIGN_16(struct) pxCollideable
 
 	pxMaterial::Handle	m_material;	// physics material
 
+	pxBodyFlags			m_flags;	//4 see pxcBodyFlags
+
 public:
 	typedef pxU4 Handle;
 	enum { NullHandle = -1 };
@@ -116,6 +120,11 @@ public:
 	// Computes world-space bounds from collision shape and local-to-world transform.
 	void GetWorldBounds( pxAABB & bounds ) const;
 
+	// Casts a world-space ray against the collision shape.
+	// Returns true if the shape was hit closer than output.m_hitFraction,
+	// the hit normal is returned in world space.
+	bool CastRay( const pxVec3& from, const pxVec3& to, pxShapeRayCastOutput &output ) const;
+
 	pxShape* GetShape();
 	const pxShape* GetShape() const;
 	void SetShape( pxShape::Handle newShape );
@@ -123,6 +132,9 @@ public:
 	void SetMaterial( pxMaterial::Handle newMaterial );
 	pxMaterial::Handle getMaterialId() const;
 
+	// sleeping objects are skipped by integration, broadphase update, narrowphase and solver
+	bool IsSleeping() const;
+
 public_internal:
 	PX_DECLARE_POD_ALLOCATOR( pxCollideable, PX_MEMORY_COLLISION );
 
@@ -171,6 +183,11 @@ void pxCollideable::GetWorldBounds( pxAABB & bounds ) const {
 	m_collisionShape.ToPtr()->GetWorldBounds( m_transform, bounds );
 }
 
+PX_INLINE
+bool pxCollideable::IsSleeping() const {
+	return m_flags.AnyIsSet( PX_SLEEPING_OBJECT );
+}
+
 #endif // !__PX_COLLIDEABLE_H__
 
 //--------------------------------------------------------------//
@@ -57,6 +57,14 @@ pxBroadphase::~pxBroadphase()
 {
 }
 
+void pxBroadphase::CastRays( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays )
+{
+	for( UINT iRay = 0; iRay < numRays; iRay++ )
+	{
+		this->CastRay( inputs[ iRay ], outputs[ iRay ] );
+	}
+}
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
@@ -119,6 +119,10 @@ public:
 	virtual void CastRay( const WorldRayCastInput& input, WorldRayCastOutput &output )
 	{Unimplemented;}
 
+	// Casts a batch of rays, the default implementation casts them one by one.
+	// Ray queries don't modify the broadphase, so disjoint batches can be processed in parallel.
+	virtual void CastRays( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays );
+
 	virtual void LinearCast( const ConvexCastInput& input, ConvexCastOutput &output )
 	{Unimplemented;}
 
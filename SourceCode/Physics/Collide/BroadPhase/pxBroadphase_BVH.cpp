@@ -1,34 +1,1087 @@
 /*
 =============================================================================
-	File:	pxBroadphase.cpp
-	Desc:
+	File:	pxBroadphase_BVH.cpp
+	Desc:	Dynamic AABB tree broadphase.
+	References:
+	Box2D's b2DynamicTree (Erin Catto),
+	"Fast, Effective BVH Updates for Animated Scenes" (Kopta et al.).
 =============================================================================
 */
 #include <Physics_PCH.h>
 #pragma hdrstop
 #include <Physics.h>
 
-#if 0
+#include <Base/JobSystem/ParallelFor.h>
+
+namespace
+{
+	FORCEINLINE void pxBvhCombine( const pxAABB& a, const pxAABB& b, pxAABB &result )
+	{
+#if PX_FORCE_FPU
+		result = a;
+		result.mMin.setMin( b.mMin );
+		result.mMax.setMax( b.mMax );
+#else
+		result.mMin.mVec128 = _mm_min_ps( a.mMin.mVec128, b.mMin.mVec128 );
+		result.mMax.mVec128 = _mm_max_ps( a.mMax.mVec128, b.mMax.mVec128 );
+#endif
+	}
+
+	// returns true if 'inner' lies completely inside 'outer'
+	FORCEINLINE bool pxBvhContains( const pxAABB& outer, const pxAABB& inner )
+	{
+		return outer.mMin.getX() <= inner.mMin.getX()
+			&& outer.mMin.getY() <= inner.mMin.getY()
+			&& outer.mMin.getZ() <= inner.mMin.getZ()
+			&& outer.mMax.getX() >= inner.mMax.getX()
+			&& outer.mMax.getY() >= inner.mMax.getY()
+			&& outer.mMax.getZ() >= inner.mMax.getZ()
+			;
+	}
+
+	FORCEINLINE pxReal pxBvhSurfaceArea( const pxAABB& aabb )
+	{
+		const pxVec3 d = aabb.mMax - aabb.mMin;
+		return REAL(2.0) * (d.getX() * d.getY() + d.getY() * d.getZ() + d.getZ() * d.getX());
+	}
+
+	// slab test, 'hitFraction' is the current closest hit
+	FORCEINLINE bool pxBvhSegmentOverlaps( const pxVec3& from, const pxVec3& delta, pxReal hitFraction, const pxAABB& aabb )
+	{
+		pxReal tMin = REAL(0.0);
+		pxReal tMax = hitFraction;
+
+		for( UINT iAxis = 0; iAxis < 3; iAxis++ )
+		{
+			const pxReal o = from[ iAxis ];
+			const pxReal d = delta[ iAxis ];
+			const pxReal lo = aabb.mMin[ iAxis ];
+			const pxReal hi = aabb.mMax[ iAxis ];
+
+			if( mxFabs( d ) < PX_EPSILON )
+			{
+				// the segment is parallel to the slab
+				if( o < lo || o > hi ) {
+					return false;
+				}
+				continue;
+			}
+
+			const pxReal invD = REAL(1.0) / d;
+			pxReal t1 = (lo - o) * invD;
+			pxReal t2 = (hi - o) * invD;
+			if( t1 > t2 ) {
+				TSwap( t1, t2 );
+			}
+			tMin = largest( tMin, t1 );
+			tMax = smallest( tMax, t2 );
+			if( tMin > tMax ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// rays traversing the tree together, share the traversal stack
+	MX_ALIGN_16(struct) pxBvhRayPacket
+	{
+		pxVec3	from[ PX_BVH_RAY_PACKET_SIZE ];
+		pxVec3	to[ PX_BVH_RAY_PACKET_SIZE ];
+		pxShapeRayCastOutput	hits[ PX_BVH_RAY_PACKET_SIZE ];
+		pxCollideable *			hitObjects[ PX_BVH_RAY_PACKET_SIZE ];
+		int		activeMask;	// one bit per valid ray
+
+#if !PX_FORCE_FPU
+		// the same rays in SoA layout for testing four rays at once
+		__m128	fromX, fromY, fromZ;
+		__m128	invDeltaX, invDeltaY, invDeltaZ;
+		__m128	maxFraction;	// the closest hits, negative for inactive rays
+#endif
+
+	public:
+		void Setup( const WorldRayCastInput* inputs, UINT numRays )
+		{
+			Assert( numRays > 0 && numRays <= PX_BVH_RAY_PACKET_SIZE );
+
+			activeMask = (1 << numRays) - 1;
+
+			for( UINT iRay = 0; iRay < PX_BVH_RAY_PACKET_SIZE; iRay++ )
+			{
+				// inactive rays duplicate the first one
+				const WorldRayCastInput& input = inputs[ (iRay < numRays) ? iRay : 0 ];
+				from[ iRay ] = pxVec3::From_Vec3D( input.origin );
+				to[ iRay ] = from[ iRay ] + pxVec3::From_Vec3D( input.direction ) * PX_BIG_NUMBER;
+				hits[ iRay ].Reset();
+				hitObjects[ iRay ] = nil;
+			}
+
+#if !PX_FORCE_FPU
+			MX_ALIGN_16(pxReal)	invDelta[3][ PX_BVH_RAY_PACKET_SIZE ];
+			for( UINT iRay = 0; iRay < PX_BVH_RAY_PACKET_SIZE; iRay++ )
+			{
+				const pxVec3 delta = to[ iRay ] - from[ iRay ];
+				for( UINT iAxis = 0; iAxis < 3; iAxis++ )
+				{
+					// avoid infinities, a huge number is enough for rays parallel to the slab
+					const pxReal d = delta[ iAxis ];
+					const pxReal safeD = (mxFabs( d ) < PX_EPSILON) ? ((d < 0.0f) ? -PX_EPSILON : PX_EPSILON) : d;
+					invDelta[ iAxis ][ iRay ] = REAL(1.0) / safeD;
+				}
+			}
+			fromX = _mm_setr_ps( from[0].getX(), from[1].getX(), from[2].getX(), from[3].getX() );
+			fromY = _mm_setr_ps( from[0].getY(), from[1].getY(), from[2].getY(), from[3].getY() );
+			fromZ = _mm_setr_ps( from[0].getZ(), from[1].getZ(), from[2].getZ(), from[3].getZ() );
+			invDeltaX = _mm_load_ps( invDelta[0] );
+			invDeltaY = _mm_load_ps( invDelta[1] );
+			invDeltaZ = _mm_load_ps( invDelta[2] );
+#endif
+			this->UpdateMaxFraction();
+		}
+
+		// must be called after the closest hits have changed
+		FORCEINLINE void UpdateMaxFraction()
+		{
+#if !PX_FORCE_FPU
+			maxFraction = _mm_setr_ps(
+				(activeMask & 1) ? hits[0].m_hitFraction : -1.0f,
+				(activeMask & 2) ? hits[1].m_hitFraction : -1.0f,
+				(activeMask & 4) ? hits[2].m_hitFraction : -1.0f,
+				(activeMask & 8) ? hits[3].m_hitFraction : -1.0f
+			);
+#endif
+		}
+
+		// returns a mask of rays overlapping the box before their closest hits
+		FORCEINLINE int TestOverlap( const pxAABB& aabb ) const
+		{
+#if PX_FORCE_FPU
+			int mask = 0;
+			for( UINT iRay = 0; iRay < PX_BVH_RAY_PACKET_SIZE; iRay++ )
+			{
+				if( (activeMask & (1 << iRay))
+					&& pxBvhSegmentOverlaps( from[ iRay ], to[ iRay ] - from[ iRay ], hits[ iRay ].m_hitFraction, aabb ) )
+				{
+					mask |= (1 << iRay);
+				}
+			}
+			return mask;
+#else
+			const __m128 minV = aabb.mMin.mVec128;
+			const __m128 maxV = aabb.mMax.mVec128;
+
+			const __m128 t1x = _mm_mul_ps( _mm_sub_ps( _mm_shuffle_ps( minV, minV, _MM_SHUFFLE(0,0,0,0) ), fromX ), invDeltaX );
+			const __m128 t2x = _mm_mul_ps( _mm_sub_ps( _mm_shuffle_ps( maxV, maxV, _MM_SHUFFLE(0,0,0,0) ), fromX ), invDeltaX );
+			const __m128 t1y = _mm_mul_ps( _mm_sub_ps( _mm_shuffle_ps( minV, minV, _MM_SHUFFLE(1,1,1,1) ), fromY ), invDeltaY );
+			const __m128 t2y = _mm_mul_ps( _mm_sub_ps( _mm_shuffle_ps( maxV, maxV, _MM_SHUFFLE(1,1,1,1) ), fromY ), invDeltaY );
+			const __m128 t1z = _mm_mul_ps( _mm_sub_ps( _mm_shuffle_ps( minV, minV, _MM_SHUFFLE(2,2,2,2) ), fromZ ), invDeltaZ );
+			const __m128 t2z = _mm_mul_ps( _mm_sub_ps( _mm_shuffle_ps( maxV, maxV, _MM_SHUFFLE(2,2,2,2) ), fromZ ), invDeltaZ );
+
+			const __m128 tEnter = _mm_max_ps(
+				_mm_max_ps( _mm_min_ps( t1x, t2x ), _mm_min_ps( t1y, t2y ) ),
+				_mm_max_ps( _mm_min_ps( t1z, t2z ), _mm_setzero_ps() )
+			);
+			const __m128 tExit = _mm_min_ps(
+				_mm_min_ps( _mm_max_ps( t1x, t2x ), _mm_max_ps( t1y, t2y ) ),
+				_mm_min_ps( _mm_max_ps( t1z, t2z ), maxFraction )
+			);
+			return _mm_movemask_ps( _mm_cmple_ps( tEnter, tExit ) );
+#endif
+		}
+	};
+
+	// per-node flags
+	enum
+	{
+		BVH_PROXY_MOVED = 1,	// the leaf is in the move buffer
+		BVH_BOUNDS_CHANGED = 2,	// the leaf must be reinserted
+	};
+
+	// recomputes bounds of objects and marks the ones
+	// which moved out of their enlarged bounds
+	struct UpdateProxyBounds
+	{
+		const pxBroadphase_BVH *	broadphase;
+		const pxBvhNode *			nodes;
+		pxAABB *					newBounds;
+		pxByte *					movedFlags;
+
+	public:
+		void operator () ( UINT firstNode, UINT lastNode ) const
+		{
+			for( UINT iNode = firstNode; iNode < lastNode; iNode++ )
+			{
+				const pxBvhNode & node = nodes[ iNode ];
+				if( node.height != 0 ) {
+					continue;	// free or internal node
+				}
+				if( broadphase->CheckProxyMoved( iNode, newBounds[ iNode ] ) )
+				{
+					movedFlags[ iNode ] |= BVH_BOUNDS_CHANGED;
+				}
+			}
+		}
+	};
+
+}//namespace
 
 /*================================
-		pxBroadphase
+		pxBroadphase_BVH
 ================================*/
 
-pxBroadphase::pxBroadphase()
+pxBroadphase_BVH::pxBroadphase_BVH( AsyncJobQueue* jobQueue )
 {
+	m_root = INDEX_NONE;
+	m_freeList = INDEX_NONE;
+	m_numNodes = 0;
+	m_numProxies = 0;
+	m_numRemovedProxies = 0;
+	m_jobQueue = jobQueue;
+
+	this->Reserve( 64 );
 }
 
-//pxBroadphase::pxBroadphase( const pxBroadphaseDesc& desc )
-//{
-//	Assert(desc.isOk());
-//}
+pxBroadphase_BVH::~pxBroadphase_BVH()
+{
+}
 
-pxBroadphase::~pxBroadphase()
+void pxBroadphase_BVH::Reserve( UINT numObjects )
 {
+	// a binary tree with N leaves has 2*N-1 nodes
+	const UINT oldNumNodes = m_nodes.Num();
+	const UINT newNumNodes = numObjects * 2;
+	if( newNumNodes <= oldNumNodes ) {
+		return;
+	}
+
+	m_nodes.SetNum( newNumNodes );
+	m_movedFlags.SetNum( newNumNodes );
+
+	// build a linked list of new free nodes
+	for( UINT iNode = oldNumNodes; iNode < newNumNodes; iNode++ )
+	{
+		pxBvhNode & node = m_nodes[ iNode ];
+		node.o = nil;
+		node.parent = (iNode + 1 < newNumNodes) ? iNode + 1 : m_freeList;
+		node.child1 = INDEX_NONE;
+		node.child2 = INDEX_NONE;
+		node.height = -1;
+
+		m_movedFlags[ iNode ] = 0;
+	}
+	m_freeList = oldNumNodes;
 }
-#endif
 
-NO_EMPTY_FILE
+pxU4 pxBroadphase_BVH::AllocateNode()
+{
+	if( m_freeList == INDEX_NONE )
+	{
+		Assert( m_numNodes == m_nodes.Num() );
+		this->Reserve( m_numNodes );	// doubles the node pool
+	}
+
+	const pxU4 nodeIndex = m_freeList;
+
+	pxBvhNode & node = m_nodes[ nodeIndex ];
+	m_freeList = node.parent;
+
+	node.o = nil;
+	node.parent = INDEX_NONE;
+	node.child1 = INDEX_NONE;
+	node.child2 = INDEX_NONE;
+	node.height = 0;
+
+	m_movedFlags[ nodeIndex ] = 0;
+
+	m_numNodes++;
+
+	return nodeIndex;
+}
+
+void pxBroadphase_BVH::FreeNode( pxU4 nodeIndex )
+{
+	Assert( nodeIndex < m_nodes.Num() );
+	Assert( m_numNodes > 0 );
+
+	pxBvhNode & node = m_nodes[ nodeIndex ];
+	node.o = nil;
+	node.parent = m_freeList;
+	node.height = -1;
+
+	m_movedFlags[ nodeIndex ] = 0;
+
+	m_freeList = nodeIndex;
+	m_numNodes--;
+}
+
+void pxBroadphase_BVH::Add( pxCollideable* object )
+{
+	AssertPtr(object);
+	Assert( m_numProxies < PX_BVH_MAX_PROXIES );
+
+	const pxU4 leaf = this->AllocateNode();
+
+	pxBvhNode & node = m_nodes[ leaf ];
+	node.o = object;
+
+	pxAABB	tightBounds;
+	object->GetWorldBounds( tightBounds );
+
+	node.aabb = tightBounds.GetExpandedBy( PX_COLLISION_TOLERANCE + PX_BVH_AABB_MARGIN );
+
+	this->InsertLeaf( leaf );
+
+	// new objects are always queried for pairs
+	m_moveBuffer.Add( leaf );
+	m_movedFlags[ leaf ] = BVH_PROXY_MOVED;
+
+	object->m_broadphaseProxy = leaf;
+
+	m_numProxies++;
+}
+
+void pxBroadphase_BVH::Remove( pxCollideable* object )
+{
+	AssertPtr(object);
+
+	const pxU4 leaf = object->m_broadphaseProxy;
+	Assert( leaf < m_nodes.Num() );
+	Assert( m_nodes[ leaf ].IsLeaf() && m_nodes[ leaf ].o == object );
+
+	if( m_movedFlags[ leaf ] & BVH_PROXY_MOVED )
+	{
+		const INT index = m_moveBuffer.FindIndexOf( leaf );
+		Assert( index != INDEX_NONE );
+		m_moveBuffer.RemoveAt_Fast( index );
+	}
+
+	this->RemoveLeaf( leaf );
+	this->FreeNode( leaf );
+
+	// the object must stay alive until the next Collide() removes its pairs
+	object->m_broadphaseProxy = INDEX_NONE;
+
+	m_numProxies--;
+	m_numRemovedProxies++;
+}
+
+pxUInt pxBroadphase_BVH::GetNumObjects() const
+{
+	return m_numProxies;
+}
+
+pxUInt pxBroadphase_BVH::GetMaxObjects() const
+{
+	return PX_BVH_MAX_PROXIES;
+}
+
+void pxBroadphase_BVH::Clear()
+{
+	m_nodes.Empty();
+	m_movedFlags.Empty();
+	m_newBounds.Empty();
+	m_moveBuffer.Empty();
+
+	m_root = INDEX_NONE;
+	m_freeList = INDEX_NONE;
+	m_numNodes = 0;
+	m_numProxies = 0;
+	m_numRemovedProxies = 0;
+
+	this->Reserve( 64 );
+}
+
+bool pxBroadphase_BVH::CheckProxyMoved( pxU4 nodeIndex, pxAABB &newBounds ) const
+{
+	const pxBvhNode & node = m_nodes[ nodeIndex ];
+
+	// sleeping objects don't move
+	if( node.o->IsSleeping() ) {
+		return false;
+	}
+
+	pxAABB	tightBounds;
+	node.o->GetWorldBounds( tightBounds );
+
+	newBounds = tightBounds.GetExpandedBy( PX_COLLISION_TOLERANCE );
+
+	return !pxBvhContains( node.aabb, newBounds );
+}
+
+void pxBroadphase_BVH::MoveProxy( pxU4 leaf, const pxAABB& tightBounds )
+{
+	this->RemoveLeaf( leaf );
+
+	pxBvhNode & node = m_nodes[ leaf ];
+
+	// predict the movement from the displacement since the last update
+	const pxVec3 displacement = (tightBounds.GetCenter() - node.aabb.GetCenter()) * PX_BVH_DISPLACEMENT_MULTIPLIER;
+
+	pxAABB	fatBounds = tightBounds.GetExpandedBy( PX_BVH_AABB_MARGIN );
+
+	for( UINT iAxis = 0; iAxis < 3; iAxis++ )
+	{
+		if( displacement[ iAxis ] < REAL(0.0) ) {
+			fatBounds.mMin[ iAxis ] += displacement[ iAxis ];
+		} else {
+			fatBounds.mMax[ iAxis ] += displacement[ iAxis ];
+		}
+	}
+
+	node.aabb = fatBounds;
+
+	this->InsertLeaf( leaf );
+}
+
+void pxBroadphase_BVH::InsertLeaf( pxU4 leaf )
+{
+	if( m_root == INDEX_NONE )
+	{
+		m_root = leaf;
+		m_nodes[ m_root ].parent = INDEX_NONE;
+		return;
+	}
+
+	// may reallocate the node pool
+	const pxU4 newParent = this->AllocateNode();
+
+	pxBvhNode * nodes = m_nodes.ToPtr();
+
+	const pxAABB leafAABB = nodes[ leaf ].aabb;
+
+	// find the best sibling for this node:
+	// descend into the child which gives the least increase of the surface area
+	pxU4 index = m_root;
+	while( !nodes[ index ].IsLeaf() )
+	{
+		const pxBvhNode & node = nodes[ index ];
+
+		const pxReal area = pxBvhSurfaceArea( node.aabb );
+
+		pxAABB	combinedAABB;
+		pxBvhCombine( node.aabb, leafAABB, combinedAABB );
+		const pxReal combinedArea = pxBvhSurfaceArea( combinedAABB );
+
+		// cost of creating a new parent for this node and the new leaf
+		const pxReal cost = REAL(2.0) * combinedArea;
+
+		// minimum cost of pushing the leaf further down the tree
+		const pxReal inheritanceCost = REAL(2.0) * (combinedArea - area);
+
+		pxReal childCost[2];
+		const pxU4 children[2] = { node.child1, node.child2 };
+		for( UINT i = 0; i < 2; i++ )
+		{
+			const pxBvhNode & child = nodes[ children[i] ];
+
+			pxAABB	aabb;
+			pxBvhCombine( leafAABB, child.aabb, aabb );
+
+			if( child.IsLeaf() ) {
+				childCost[i] = pxBvhSurfaceArea( aabb ) + inheritanceCost;
+			} else {
+				childCost[i] = pxBvhSurfaceArea( aabb ) - pxBvhSurfaceArea( child.aabb ) + inheritanceCost;
+			}
+		}
+
+		if( cost < childCost[0] && cost < childCost[1] ) {
+			break;
+		}
+
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	const pxU4 sibling = index;
+
+	// create a new parent
+	const pxU4 oldParent = nodes[ sibling ].parent;
+
+	pxBvhNode & parentNode = nodes[ newParent ];
+	parentNode.parent = oldParent;
+	parentNode.o = nil;
+	pxBvhCombine( leafAABB, nodes[ sibling ].aabb, parentNode.aabb );
+	parentNode.height = nodes[ sibling ].height + 1;
+	parentNode.child1 = sibling;
+	parentNode.child2 = leaf;
+
+	if( oldParent != INDEX_NONE )
+	{
+		// the sibling was not the root
+		if( nodes[ oldParent ].child1 == sibling ) {
+			nodes[ oldParent ].child1 = newParent;
+		} else {
+			nodes[ oldParent ].child2 = newParent;
+		}
+	}
+	else
+	{
+		m_root = newParent;
+	}
+
+	nodes[ sibling ].parent = newParent;
+	nodes[ leaf ].parent = newParent;
+
+	this->RefitAncestors( nodes[ leaf ].parent );
+}
+
+void pxBroadphase_BVH::RemoveLeaf( pxU4 leaf )
+{
+	if( leaf == m_root )
+	{
+		m_root = INDEX_NONE;
+		return;
+	}
+
+	pxBvhNode * nodes = m_nodes.ToPtr();
+
+	const pxU4 parent = nodes[ leaf ].parent;
+	const pxU4 grandParent = nodes[ parent ].parent;
+	const pxU4 sibling = (nodes[ parent ].child1 == leaf) ? nodes[ parent ].child2 : nodes[ parent ].child1;
+
+	if( grandParent != INDEX_NONE )
+	{
+		// destroy the parent and connect the sibling to the grand parent
+		if( nodes[ grandParent ].child1 == parent ) {
+			nodes[ grandParent ].child1 = sibling;
+		} else {
+			nodes[ grandParent ].child2 = sibling;
+		}
+		nodes[ sibling ].parent = grandParent;
+		this->FreeNode( parent );
+
+		this->RefitAncestors( grandParent );
+	}
+	else
+	{
+		m_root = sibling;
+		nodes[ sibling ].parent = INDEX_NONE;
+		this->FreeNode( parent );
+	}
+}
+
+void pxBroadphase_BVH::RefitAncestors( pxU4 nodeIndex )
+{
+	pxBvhNode * nodes = m_nodes.ToPtr();
+
+	pxU4 index = nodeIndex;
+	while( index != INDEX_NONE )
+	{
+		index = this->Balance( index );
+
+		pxBvhNode & node = nodes[ index ];
+		const pxBvhNode & child1 = nodes[ node.child1 ];
+		const pxBvhNode & child2 = nodes[ node.child2 ];
+
+		node.height = 1 + largest( child1.height, child2.height );
+		pxBvhCombine( child1.aabb, child2.aabb, node.aabb );
+
+		index = node.parent;
+	}
+}
+
+//
+//	Performs a left or right rotation if node A is imbalanced.
+//
+//	        A
+//	      /   \
+//	     B     C
+//	    / \   / \
+//	   D   E F   G
+//
+pxU4 pxBroadphase_BVH::Balance( pxU4 iA )
+{
+	pxBvhNode * nodes = m_nodes.ToPtr();
+
+	pxBvhNode & A = nodes[ iA ];
+	if( A.IsLeaf() || A.height < 2 ) {
+		return iA;
+	}
+
+	const pxU4 iB = A.child1;
+	const pxU4 iC = A.child2;
+
+	pxBvhNode & B = nodes[ iB ];
+	pxBvhNode & C = nodes[ iC ];
+
+	const pxS4 balance = C.height - B.height;
+
+	// rotate C up
+	if( balance > 1 )
+	{
+		const pxU4 iF = C.child1;
+		const pxU4 iG = C.child2;
+		pxBvhNode & F = nodes[ iF ];
+		pxBvhNode & G = nodes[ iG ];
+
+		// swap A and C
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		// A's old parent should point to C
+		if( C.parent != INDEX_NONE )
+		{
+			if( nodes[ C.parent ].child1 == iA ) {
+				nodes[ C.parent ].child1 = iC;
+			} else {
+				nodes[ C.parent ].child2 = iC;
+			}
+		}
+		else
+		{
+			m_root = iC;
+		}
+
+		// rotate
+		if( F.height > G.height )
+		{
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+			pxBvhCombine( B.aabb, G.aabb, A.aabb );
+			pxBvhCombine( A.aabb, F.aabb, C.aabb );
+
+			A.height = 1 + largest( B.height, G.height );
+			C.height = 1 + largest( A.height, F.height );
+		}
+		else
+		{
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+			pxBvhCombine( B.aabb, F.aabb, A.aabb );
+			pxBvhCombine( A.aabb, G.aabb, C.aabb );
+
+			A.height = 1 + largest( B.height, F.height );
+			C.height = 1 + largest( A.height, G.height );
+		}
+
+		return iC;
+	}
+
+	// rotate B up
+	if( balance < -1 )
+	{
+		const pxU4 iD = B.child1;
+		const pxU4 iE = B.child2;
+		pxBvhNode & D = nodes[ iD ];
+		pxBvhNode & E = nodes[ iE ];
+
+		// swap A and B
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		// A's old parent should point to B
+		if( B.parent != INDEX_NONE )
+		{
+			if( nodes[ B.parent ].child1 == iA ) {
+				nodes[ B.parent ].child1 = iB;
+			} else {
+				nodes[ B.parent ].child2 = iB;
+			}
+		}
+		else
+		{
+			m_root = iB;
+		}
+
+		// rotate
+		if( D.height > E.height )
+		{
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+			pxBvhCombine( C.aabb, E.aabb, A.aabb );
+			pxBvhCombine( A.aabb, D.aabb, B.aabb );
+
+			A.height = 1 + largest( C.height, E.height );
+			B.height = 1 + largest( A.height, D.height );
+		}
+		else
+		{
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+			pxBvhCombine( C.aabb, D.aabb, A.aabb );
+			pxBvhCombine( A.aabb, E.aabb, B.aabb );
+
+			A.height = 1 + largest( C.height, D.height );
+			B.height = 1 + largest( A.height, E.height );
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+void pxBroadphase_BVH::Collide( pxCollisionDispatcher & handler )
+{
+	PX_PROFILE("BVH Broadphase");
+
+	const UINT numNodes = m_nodes.Num();
+
+	// refit: find objects which moved out of their enlarged bounds
+	{
+		m_newBounds.SetNum( numNodes );
+
+		UpdateProxyBounds	updateBounds;
+		updateBounds.broadphase = this;
+		updateBounds.nodes = m_nodes.ToPtr();
+		updateBounds.newBounds = m_newBounds.ToPtr();
+		updateBounds.movedFlags = m_movedFlags.ToPtr();
+
+		if( m_jobQueue ) {
+			ParallelFor( m_jobQueue, 0, numNodes, 0, updateBounds );
+		} else {
+			updateBounds( 0, numNodes );
+		}
+	}
+
+	// reinsert moved objects,
+	// leaf indices don't change so it's safe to do it in one pass
+	for( UINT iNode = 0; iNode < numNodes; iNode++ )
+	{
+		const pxByte flags = m_movedFlags[ iNode ];
+		if( flags & BVH_BOUNDS_CHANGED )
+		{
+			this->MoveProxy( iNode, m_newBounds[ iNode ] );
+
+			if( !(flags & BVH_PROXY_MOVED) ) {
+				m_moveBuffer.Add( iNode );
+			}
+			m_movedFlags[ iNode ] = BVH_PROXY_MOVED;
+		}
+	}
+
+	// find new pairs
+	const UINT numMovedProxies = m_moveBuffer.Num();
+	for( UINT i = 0; i < numMovedProxies; i++ )
+	{
+		this->QueryPairs( m_moveBuffer[ i ], handler );
+	}
+
+	if( numMovedProxies || m_numRemovedProxies )
+	{
+		this->RemoveOldPairs( handler );
+	}
+
+	for( UINT i = 0; i < numMovedProxies; i++ )
+	{
+		m_movedFlags[ m_moveBuffer[ i ] ] = 0;
+	}
+	m_moveBuffer.Empty();
+	m_numRemovedProxies = 0;
+}
+
+void pxBroadphase_BVH::QueryPairs( pxU4 leaf, pxCollisionDispatcher & handler )
+{
+	const pxBvhNode * nodes = m_nodes.ToPtr();
+	const pxByte * movedFlags = m_movedFlags.ToPtr();
+
+	const pxAABB & queryAABB = nodes[ leaf ].aabb;
+	pxCollideable * object = nodes[ leaf ].o;
+
+	pxU4	stack[ PX_BVH_MAX_TREE_DEPTH ];
+	UINT	stackSize = 0;
+	stack[ stackSize++ ] = m_root;
+
+	while( stackSize > 0 )
+	{
+		const pxU4 index = stack[ --stackSize ];
+		const pxBvhNode & node = nodes[ index ];
+
+		if( !node.aabb.Overlaps( queryAABB ) ) {
+			continue;
+		}
+
+		if( node.IsLeaf() )
+		{
+			if( index == leaf ) {
+				continue;
+			}
+			// both proxies are moving, report the pair only once
+			if( (movedFlags[ index ] & BVH_PROXY_MOVED) && index > leaf ) {
+				continue;
+			}
+			handler.AddPair( object, node.o );
+		}
+		else
+		{
+			Assert( stackSize + 2 <= PX_BVH_MAX_TREE_DEPTH );
+			stack[ stackSize++ ] = node.child1;
+			stack[ stackSize++ ] = node.child2;
+		}
+	}
+}
+
+void pxBroadphase_BVH::RemoveOldPairs( pxCollisionDispatcher & handler )
+{
+	const pxBvhNode * nodes = m_nodes.ToPtr();
+	const pxByte * movedFlags = m_movedFlags.ToPtr();
+
+	// removal is deferred until the dispatcher updates its pairs, so pair indices are stable
+	const UINT numPairs = handler.NumPairs();
+	for( UINT iPair = 0; iPair < numPairs; iPair++ )
+	{
+		const pxCollisionPair & pair = handler.GetPairs()[ iPair ];
+
+		const pxU4 proxyA = pair.oA->m_broadphaseProxy;
+		const pxU4 proxyB = pair.oB->m_broadphaseProxy;
+
+		bool removePair = false;
+
+		if( proxyA == INDEX_NONE || proxyB == INDEX_NONE )
+		{
+			removePair = true;
+		}
+		else if( (movedFlags[ proxyA ] | movedFlags[ proxyB ]) & BVH_PROXY_MOVED )
+		{
+			removePair = !nodes[ proxyA ].aabb.Overlaps( nodes[ proxyB ].aabb );
+		}
+
+		if( removePair )
+		{
+			handler.RemovePairAt( iPair );
+		}
+	}
+}
+
+void pxBroadphase_BVH::CastRay( const WorldRayCastInput& input, WorldRayCastOutput &output )
+{
+	this->CastRayPacket( &input, &output, 1 );
+}
+
+void pxBroadphase_BVH::CastRays( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays )
+{
+	for( UINT iFirstRay = 0; iFirstRay < numRays; iFirstRay += PX_BVH_RAY_PACKET_SIZE )
+	{
+		const UINT packetSize = smallest< UINT >( numRays - iFirstRay, PX_BVH_RAY_PACKET_SIZE );
+		this->CastRayPacket( inputs + iFirstRay, outputs + iFirstRay, packetSize );
+	}
+}
+
+void pxBroadphase_BVH::CastRayPacket( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays ) const
+{
+	pxBvhRayPacket	packet;
+	packet.Setup( inputs, numRays );
+
+	const pxBvhNode * nodes = m_nodes.ToPtr();
+
+	pxU4	stack[ PX_BVH_MAX_TREE_DEPTH ];
+	UINT	stackSize = 0;
+	if( m_root != INDEX_NONE ) {
+		stack[ stackSize++ ] = m_root;
+	}
+
+	while( stackSize > 0 )
+	{
+		const pxBvhNode & node = nodes[ stack[ --stackSize ] ];
+
+		// subtrees behind the closest hits are skipped
+		const int rayMask = packet.TestOverlap( node.aabb );
+		if( !rayMask ) {
+			continue;
+		}
+
+		if( node.IsLeaf() )
+		{
+			bool hitAnything = false;
+			for( UINT iRay = 0; iRay < PX_BVH_RAY_PACKET_SIZE; iRay++ )
+			{
+				if( (rayMask & (1 << iRay))
+					&& node.o->CastRay( packet.from[ iRay ], packet.to[ iRay ], packet.hits[ iRay ] ) )
+				{
+					packet.hitObjects[ iRay ] = node.o;
+					hitAnything = true;
+				}
+			}
+			if( hitAnything ) {
+				packet.UpdateMaxFraction();
+			}
+		}
+		else
+		{
+			Assert( stackSize + 2 <= PX_BVH_MAX_TREE_DEPTH );
+			stack[ stackSize++ ] = node.child1;
+			stack[ stackSize++ ] = node.child2;
+		}
+	}
+
+	for( UINT iRay = 0; iRay < numRays; iRay++ )
+	{
+		outputs[ iRay ].normal = packet.hits[ iRay ].m_normal;
+		outputs[ iRay ].hitFraction = packet.hits[ iRay ].m_hitFraction;
+		outputs[ iRay ].hitObject = packet.hitObjects[ iRay ];
+	}
+}
+
+void pxBroadphase_BVH::TraceBox( const TraceBoxInput& input, TraceBoxOutput &output )
+{
+	if( input.start == input.end )
+	{
+		output.hitPosition = input.start;
+		output.hitNormal.SetZero();
+		output.hitFraction = 0.0f;
+		return;
+	}
+
+	ShapePMTraceInput		shapeTraceInput;
+	{
+	shapeTraceInput.start = input.start;
+	shapeTraceInput.end = input.end;
+	shapeTraceInput.size = input.size;
+
+	shapeTraceInput.UpdateCachedData();
+	}
+
+	const pxAABB traceBounds(
+		pxVec3::From_Vec3D( shapeTraceInput.fullTraceBounds.GetMin() ),
+		pxVec3::From_Vec3D( shapeTraceInput.fullTraceBounds.GetMax() )
+	);
+
+	F4	minHitFraction = 1.0f;
+	Vec3D	hitNormal(0);
+
+	const pxBvhNode * nodes = m_nodes.ToPtr();
+
+	pxU4	stack[ PX_BVH_MAX_TREE_DEPTH ];
+	UINT	stackSize = 0;
+	if( m_root != INDEX_NONE ) {
+		stack[ stackSize++ ] = m_root;
+	}
+
+	while( stackSize > 0 )
+	{
+		const pxBvhNode & node = nodes[ stack[ --stackSize ] ];
+
+		if( !node.aabb.Overlaps( traceBounds ) ) {
+			continue;
+		}
+
+		if( node.IsLeaf() )
+		{
+			ShapePMTraceOutput	shapeTraceOutput;
+			node.o->GetShape()->TraceBox( shapeTraceInput, shapeTraceOutput );
+
+			if( shapeTraceOutput.fraction < minHitFraction )
+			{
+				minHitFraction = shapeTraceOutput.fraction;
+				hitNormal = shapeTraceOutput.normal;
+			}
+		}
+		else
+		{
+			Assert( stackSize + 2 <= PX_BVH_MAX_TREE_DEPTH );
+			stack[ stackSize++ ] = node.child1;
+			stack[ stackSize++ ] = node.child2;
+		}
+	}
+
+	output.hitPosition = input.start + (input.end - input.start) * minHitFraction;
+	output.hitNormal = hitNormal;
+	output.hitFraction = minHitFraction;
+}
+
+pxS4 pxBroadphase_BVH::GetHeight() const
+{
+	if( m_root == INDEX_NONE ) {
+		return 0;
+	}
+	return m_nodes[ m_root ].height;
+}
+
+pxReal pxBroadphase_BVH::GetAreaRatio() const
+{
+	if( m_root == INDEX_NONE ) {
+		return REAL(0.0);
+	}
+
+	const pxReal rootArea = pxBvhSurfaceArea( m_nodes[ m_root ].aabb );
+
+	pxReal totalArea = REAL(0.0);
+	for( UINT iNode = 0; iNode < m_nodes.Num(); iNode++ )
+	{
+		const pxBvhNode & node = m_nodes[ iNode ];
+		if( node.height < 0 ) {
+			continue;	// free node
+		}
+		totalArea += pxBvhSurfaceArea( node.aabb );
+	}
+
+	return totalArea / rootArea;
+}
+
+pxS4 pxBroadphase_BVH::ComputeHeight( pxU4 nodeIndex ) const
+{
+	const pxBvhNode & node = m_nodes[ nodeIndex ];
+	if( node.IsLeaf() ) {
+		return 0;
+	}
+	return 1 + largest( ComputeHeight( node.child1 ), ComputeHeight( node.child2 ) );
+}
+
+void pxBroadphase_BVH::ValidateStructure( pxU4 nodeIndex ) const
+{
+	const pxBvhNode & node = m_nodes[ nodeIndex ];
+
+	if( nodeIndex == m_root ) {
+		Assert( node.parent == INDEX_NONE );
+	}
+
+	if( node.IsLeaf() )
+	{
+		Assert( node.child2 == INDEX_NONE );
+		Assert( node.height == 0 );
+		AssertPtr( node.o );
+		Assert( node.o->m_broadphaseProxy == nodeIndex );
+		return;
+	}
+
+	const pxBvhNode & child1 = m_nodes[ node.child1 ];
+	const pxBvhNode & child2 = m_nodes[ node.child2 ];
+
+	Assert( child1.parent == nodeIndex );
+	Assert( child2.parent == nodeIndex );
+	Assert( node.height == 1 + largest( child1.height, child2.height ) );
+	Assert( Abs( child2.height - child1.height ) <= 1 );
+	Assert( pxBvhContains( node.aabb, child1.aabb ) );
+	Assert( pxBvhContains( node.aabb, child2.aabb ) );
+
+	ValidateStructure( node.child1 );
+	ValidateStructure( node.child2 );
+}
+
+void pxBroadphase_BVH::validate()
+{
+	if( m_root != INDEX_NONE )
+	{
+		ValidateStructure( m_root );
+		Assert( ComputeHeight( m_root ) == GetHeight() );
+	}
+
+	UINT numFreeNodes = 0;
+	for( pxU4 index = m_freeList; index != INDEX_NONE; index = m_nodes[ index ].parent )
+	{
+		Assert( m_nodes[ index ].height == -1 );
+		numFreeNodes++;
+	}
+	Assert( m_numNodes + numFreeNodes == m_nodes.Num() );
+	Assert( m_numProxies == 0 || m_numNodes == m_numProxies * 2 - 1 );
+}
+
+void pxBroadphase_BVH::DebugDraw( pxDebugDrawer* renderer )
+{
+	for( UINT iNode = 0; iNode < m_nodes.Num(); iNode++ )
+	{
+		const pxBvhNode & node = m_nodes[ iNode ];
+		if( node.height < 0 ) {
+			continue;	// free node
+		}
+		const FColor & color = node.IsLeaf() ? FColor::GREEN : FColor::YELLOW;
+		renderer->drawBox( node.aabb.mMin, node.aabb.mMax, color.mSimdQuad );
+	}
+}
 
 //--------------------------------------------------------------//
 //				End Of File.									//
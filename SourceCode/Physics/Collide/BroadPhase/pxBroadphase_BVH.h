@@ -1,110 +1,164 @@
 /*
 =============================================================================
 	File:	pxBroadphase_BVH.h
-	Desc:	Broadphase based on dynamic bounding volume hierarchy.
-	Note:	for (almost) static objects we use a KD-trie
-	(elements are stored in leaves, ones that straddle splitting planes
-	are duplicated in leaves, moving objects will be reinserted into tree;
-	for dynamic & frequently moving objects an AABB tree is used
-	(it's a hybrid between a loose octree and ABT).
-	we 'intersect' those two trees when colliding static set vs dynamic set.
+	Desc:	Broadphase based on a dynamic bounding volume hierarchy
+			(incrementally updated AABB tree).
 =============================================================================
 */
 
-#ifndef __PX_BROAD_PHASE_H__
-#define __PX_BROAD_PHASE_H__
+#ifndef __PX_BROAD_PHASE_BVH_H__
+#define __PX_BROAD_PHASE_BVH_H__
 
+class AsyncJobQueue;
 
+// leaves store bounds enlarged by this margin so that
+// small movements don't require updating the tree
+MX_GLOBAL_CONST pxReal PX_BVH_AABB_MARGIN = REAL(0.1);
 
-/*
-	internal (splitting) nodes always have 2 children (leaves).
-
-	each leaf node has a pointer to the corresponding collision object.
-*/
+// enlarged bounds are also extended in the direction of movement
+MX_GLOBAL_CONST pxReal PX_BVH_DISPLACEMENT_MULTIPLIER = REAL(2.0);
 
-struct BVH_SplitNode
+enum pxcBvhLimits
 {
-	float4	plane;	//16 splitting plane
-	U2		parent;	// index of parent node
-	U2		kids[2];// indices of child nodes
+	PX_BVH_MAX_PROXIES = (1<<20),
+	PX_BVH_MAX_TREE_DEPTH = 128,	// the tree is kept balanced so it's very conservative
+	PX_BVH_RAY_PACKET_SIZE = 4,	// number of rays traversing the tree together
 };
 
-struct BVH_LeafNode
+//
+//	pxBvhNode
+//
+MX_ALIGN_16(struct) pxBvhNode
 {
-	float4	sphere;	//16 bounding sphere
-};
+	pxAABB	aabb;	// enlarged bounds for leaves, union of the children's bounds for internal nodes
 
-MX_ALIGN_16(struct) BVH_Node
-{
-	struct LeafData
-	{
-	};
-	struct SplitNodeData 
-	{
-	};
-	float4	splitPlane;	//16 splitting plane
-};
+	pxCollideable *	o;	// only leaves have objects
 
-// node type
-enum EBvhNodeType
-{
-	BNT_Leaf = 0,
+	// index of the parent node;
+	// free nodes use it as an index of the next free node
+	pxU4	parent;
 
-	// axial splitting plane types
-	BNT_Plane_Axis_X,
-	BNT_Plane_Axis_Y,
-	BNT_Plane_Axis_Z,
+	pxU4	child1;	// INDEX_NONE for leaves
+	pxU4	child2;
 
-	BNT_MAX
-};
+	pxS4	height;	// leaves have zero height, free nodes: -1
 
-struct BVTree_Node
-{
-	U4	i;	//4 node type
-	F4	split;	//4 splitting plane distance
-	U2	numPrims;
-	U2	wtf;
-	U4	u1;
-};
-struct BVTree_Leaf
-{
-};
+public:
+	FORCEINLINE bool IsLeaf() const {
+		return child1 == INDEX_NONE;
+	}
 
+	PX_DECLARE_POD_ALLOCATOR( pxBvhNode, PX_MEMORY_COLLISION_BROADPHASE );
+};
 
 //
 //	pxBroadphase_BVH
 //
-class pxBroadphase_BVH
+//	Dynamic AABB tree, ideal for large worlds with lots of objects.
+//	Leaves are inserted using a surface area heuristic
+//	and the tree is rebalanced with rotations.
+//	Only moved objects are reinserted and queried for new pairs,
+//	overlapping pairs persist in the collision dispatcher.
+//	Proxy ids (stored in pxCollideable::m_broadphaseProxy) are indices of leaf nodes.
+//
+class pxBroadphase_BVH : public pxBroadphase
 {
-	TList< BVH_Node >		m_nodes;
+	PX_DECLARE_CLASS_ALLOCATOR( pxBroadphase_BVH, PX_MEMORY_COLLISION_BROADPHASE );
 
 public:
-			pxBroadphase_BVH();
-	virtual	~pxBroadphase_BVH();
+	// the job queue is used for updating bounds of objects, it can be null
+	pxBroadphase_BVH( AsyncJobQueue* jobQueue = nil );
+	~pxBroadphase_BVH();
+
+public:	//-pxBroadphase
+	virtual void Reserve( UINT numObjects ) override;
+
+	virtual void Add( pxCollideable* object ) override;
+	virtual void Remove( pxCollideable* object ) override;
+	virtual pxUInt GetNumObjects() const override;
+	virtual pxUInt GetMaxObjects() const override;
+
+	virtual void Clear() override;
+
+	virtual void Collide( pxCollisionDispatcher & handler ) override;
+
+	virtual void CastRay( const WorldRayCastInput& input, WorldRayCastOutput &output ) override;
+
+	// rays are traversed in packets of PX_BVH_RAY_PACKET_SIZE,
+	// so neighbouring rays in the batch should be coherent (similar origins and directions).
+	virtual void CastRays( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays ) override;
+	virtual void TraceBox( const TraceBoxInput& input, TraceBoxOutput &output ) override;
+
+	virtual void validate() override;
+
+	virtual void DebugDraw( pxDebugDrawer* renderer ) override;
+
+public_internal:
+	// returns the height of the tree (zero if the tree has a single leaf)
+	pxS4 GetHeight() const;
+
+	// ratio of the sum of the node surface areas to the root surface area
+	pxReal GetAreaRatio() const;
+
+	PX_INLINE const pxAABB& GetFatBounds( pxBroadphaseProxy proxyId ) const {
+		Assert( m_nodes[ proxyId ].IsLeaf() );
+		return m_nodes[ proxyId ].aabb;
+	}
+
+	// computes tight world-space bounds of the given leaf,
+	// returns true if they don't fit into the enlarged bounds anymore.
+	// doesn't modify the tree and can be called from multiple threads.
+	bool CheckProxyMoved( pxU4 nodeIndex, pxAABB &newBounds ) const;
+
+private:
+	pxU4 AllocateNode();
+	void FreeNode( pxU4 nodeIndex );
+
+	void InsertLeaf( pxU4 leaf );
+	void RemoveLeaf( pxU4 leaf );
+
+	// performs a left or right rotation if the node is imbalanced,
+	// returns the new root of the subtree
+	pxU4 Balance( pxU4 iA );
+
+	// walks up the tree from the given node and updates bounds and heights
+	void RefitAncestors( pxU4 nodeIndex );
+
+	// reinserts the leaf with new enlarged bounds
+	void MoveProxy( pxU4 leaf, const pxAABB& tightBounds );
+
+	// casts up to PX_BVH_RAY_PACKET_SIZE rays with a single tree traversal
+	void CastRayPacket( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays ) const;
+
+	// finds all leaves overlapping the given leaf and reports them to the handler
+	void QueryPairs( pxU4 leaf, pxCollisionDispatcher & handler );
 
-	// Adds an object to this broadphase.
-	virtual void Add( pxCollideable* object ) = 0;
+	// removes pairs which don't overlap anymore
+	void RemoveOldPairs( pxCollisionDispatcher & handler );
 
-	// Removes an object from the broadphase.
-	virtual void Remove( pxCollideable* object ) = 0;
+	pxS4 ComputeHeight( pxU4 nodeIndex ) const;
+	void ValidateStructure( pxU4 nodeIndex ) const;
 
-	// Returns the total number of objects added to this broadphase.
-	virtual pxUInt GetNumObjects() const = 0;
+private:
+	TList< pxBvhNode >	m_nodes;	// node pool
+	pxU4	m_root;
+	pxU4	m_freeList;	// linked list of free nodes
+	pxU4	m_numNodes;	// number of allocated nodes
+	pxU4	m_numProxies;
 
-	// Returns the maximum allowed number of objects that can be added to this broadphase.
-	virtual pxUInt GetMaxObjects() const = 0;
+	TList< pxU4 >	m_moveBuffer;	// leaves which must be queried for new pairs
+	TList< pxByte >	m_movedFlags;	// per-node, set for leaves in the move buffer
+	TList< pxAABB >	m_newBounds;	// scratch memory for updated tight bounds
 
-	// Removes all objects from the broadphase.
-	virtual void Clear() = 0;
+	// pairs of removed objects are deleted in the next Collide()
+	pxU4	m_numRemovedProxies;
 
-	// Performs a broad-phase collision detection and feeds potentially colliding pairs to the collision handler.
-	virtual void Collide( pxCollisionDispatcher & handler ) = 0;
+	AsyncJobQueue *	m_jobQueue;
 
-	//testing & debugging
-	virtual void validate() {};
+private:	PREVENT_COPY(pxBroadphase_BVH);
 };
 
-#endif // !__PX_BROAD_PHASE_H__
+#endif // !__PX_BROAD_PHASE_BVH_H__
 
 //--------------------------------------------------------------//
 //				End Of File.									//
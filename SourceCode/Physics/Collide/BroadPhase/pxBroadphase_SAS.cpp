@@ -0,0 +1,727 @@
+/*
+=============================================================================
+	File:	pxBroadphase_SAS.cpp
+	Desc:	Incremental sweep-and-prune.
+	References:
+	"An Interactive and Exact Collision Detection System
+	for Large-Scale Environments" (Cohen, Lin, Manocha, Ponamgi),
+	Bullet's btAxisSweep3, Pierre Terdiman's SAP notes.
+=============================================================================
+*/
+#include <Physics_PCH.h>
+#pragma hdrstop
+#include <Physics.h>
+
+#include <Base/Templates/Algorithm/RadixSort.h>
+#include <Base/JobSystem/ParallelFor.h>
+
+namespace
+{
+	FORCEINLINE bool pxSasBoundsEqual( const pxAABB& a, const pxAABB& b )
+	{
+		return a.mMin.getX() == b.mMin.getX()
+			&& a.mMin.getY() == b.mMin.getY()
+			&& a.mMin.getZ() == b.mMin.getZ()
+			&& a.mMax.getX() == b.mMax.getX()
+			&& a.mMax.getY() == b.mMax.getY()
+			&& a.mMax.getZ() == b.mMax.getZ()
+			;
+	}
+
+	struct pxSasEndpointKey
+	{
+		unsigned int operator()( const pxSasEndpoint& e ) const
+		{
+			return radix_float_predicate()( e.value );
+		}
+	};
+
+	// recomputes bounds of objects and marks the ones which moved
+	struct UpdateProxyBounds
+	{
+		const pxBroadphase_SAS *	broadphase;
+		const pxSasProxy *			proxies;
+		pxAABB *					newBounds;
+		pxByte *					boundsChanged;
+
+	public:
+		void operator () ( UINT firstProxy, UINT lastProxy ) const
+		{
+			for( UINT iProxy = firstProxy; iProxy < lastProxy; iProxy++ )
+			{
+				boundsChanged[ iProxy ] = 0;
+				if( proxies[ iProxy ].o != nil ) {
+					boundsChanged[ iProxy ] = broadphase->CheckProxyMoved( iProxy, newBounds[ iProxy ] );
+				}
+			}
+		}
+	};
+
+}//namespace
+
+/*================================
+		pxBroadphase_SAS
+================================*/
+
+pxBroadphase_SAS::pxBroadphase_SAS( AsyncJobQueue* jobQueue )
+{
+	m_firstFreeProxy = INDEX_NONE;
+	m_numProxies = 0;
+	m_numRemovedProxies = 0;
+	m_jobQueue = jobQueue;
+
+	this->Reserve( 64 );
+}
+
+pxBroadphase_SAS::~pxBroadphase_SAS()
+{
+}
+
+void pxBroadphase_SAS::Reserve( UINT numObjects )
+{
+	m_proxies.Reserve( numObjects );
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		m_endpoints[ axis ].Reserve( numObjects * 2 );
+	}
+}
+
+pxU4 pxBroadphase_SAS::AllocateProxy()
+{
+	pxU4 proxyIndex = m_firstFreeProxy;
+	if( proxyIndex != INDEX_NONE )
+	{
+		m_firstFreeProxy = m_proxies[ proxyIndex ].nextFree;
+	}
+	else
+	{
+		proxyIndex = m_proxies.Num();
+		m_proxies.Add();
+	}
+
+	pxSasProxy & proxy = m_proxies[ proxyIndex ];
+	proxy.o = nil;
+	proxy.nextFree = INDEX_NONE;
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		proxy.minEdges[ axis ] = INDEX_NONE;
+		proxy.maxEdges[ axis ] = INDEX_NONE;
+	}
+
+	return proxyIndex;
+}
+
+void pxBroadphase_SAS::FreeProxy( pxU4 proxyIndex )
+{
+	pxSasProxy & proxy = m_proxies[ proxyIndex ];
+	proxy.o = nil;
+	proxy.nextFree = m_firstFreeProxy;
+	m_firstFreeProxy = proxyIndex;
+}
+
+void pxBroadphase_SAS::Add( pxCollideable* object )
+{
+	AssertPtr(object);
+	Assert( m_numProxies < PX_SAS_MAX_PROXIES );
+
+	const pxU4 proxyIndex = this->AllocateProxy();
+
+	pxSasProxy & proxy = m_proxies[ proxyIndex ];
+	proxy.o = object;
+
+	// endpoints are inserted in the next Collide()
+	m_pendingProxies.Add( proxyIndex );
+
+	object->m_broadphaseProxy = proxyIndex;
+
+	m_numProxies++;
+}
+
+void pxBroadphase_SAS::Remove( pxCollideable* object )
+{
+	AssertPtr(object);
+
+	const pxU4 proxyIndex = object->m_broadphaseProxy;
+	Assert( proxyIndex < m_proxies.Num() );
+	Assert( m_proxies[ proxyIndex ].o == object );
+
+	if( m_proxies[ proxyIndex ].minEdges[0] == INDEX_NONE )
+	{
+		// the object hasn't been inserted yet
+		const INT index = m_pendingProxies.FindIndexOf( proxyIndex );
+		Assert( index != INDEX_NONE );
+		m_pendingProxies.RemoveAt_Fast( index );
+	}
+	else
+	{
+		this->RemoveEndpoints( proxyIndex );
+	}
+
+	this->FreeProxy( proxyIndex );
+
+	// the object must stay alive until the next Collide() removes its pairs
+	object->m_broadphaseProxy = INDEX_NONE;
+
+	m_numProxies--;
+	m_numRemovedProxies++;
+}
+
+pxUInt pxBroadphase_SAS::GetNumObjects() const
+{
+	return m_numProxies;
+}
+
+pxUInt pxBroadphase_SAS::GetMaxObjects() const
+{
+	return PX_SAS_MAX_PROXIES;
+}
+
+void pxBroadphase_SAS::Clear()
+{
+	m_proxies.Empty();
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		m_endpoints[ axis ].Empty();
+	}
+	m_pendingProxies.Empty();
+
+	m_firstFreeProxy = INDEX_NONE;
+	m_numProxies = 0;
+	m_numRemovedProxies = 0;
+}
+
+bool pxBroadphase_SAS::CheckProxyMoved( pxU4 proxyIndex, pxAABB &newBounds ) const
+{
+	const pxSasProxy & proxy = m_proxies[ proxyIndex ];
+
+	// sleeping objects don't move, keep their endpoints
+	// (objects added while asleep haven't been inserted yet and have no bounds)
+	const bool isInserted = (proxy.minEdges[0] != INDEX_NONE);
+	if( proxy.o->IsSleeping() && isInserted ) {
+		newBounds = proxy.bounds;
+		return false;
+	}
+
+	pxAABB	aabb;
+	proxy.o->GetWorldBounds( aabb );
+
+	newBounds = aabb.GetExpandedBy( PX_COLLISION_TOLERANCE );
+
+	return !pxSasBoundsEqual( proxy.bounds, newBounds );
+}
+
+void pxBroadphase_SAS::Collide( pxCollisionDispatcher & handler )
+{
+	PX_PROFILE("SAS Broadphase");
+
+	const UINT numProxySlots = m_proxies.Num();
+
+	// compute new bounds
+	{
+		m_newBounds.SetNum( numProxySlots );
+		m_boundsChanged.SetNum( numProxySlots );
+
+		UpdateProxyBounds	updateBounds;
+		updateBounds.broadphase = this;
+		updateBounds.proxies = m_proxies.ToPtr();
+		updateBounds.newBounds = m_newBounds.ToPtr();
+		updateBounds.boundsChanged = m_boundsChanged.ToPtr();
+
+		if( m_jobQueue ) {
+			ParallelFor( m_jobQueue, 0, numProxySlots, 0, updateBounds );
+		} else {
+			updateBounds( 0, numProxySlots );
+		}
+	}
+
+	const UINT numPendingProxies = m_pendingProxies.Num();
+
+	const bool rebuildEndpoints = (numPendingProxies > PX_SAS_BULK_INSERT_THRESHOLD);
+
+	if( rebuildEndpoints )
+	{
+		for( UINT iProxy = 0; iProxy < numProxySlots; iProxy++ )
+		{
+			if( m_proxies[ iProxy ].o != nil ) {
+				m_proxies[ iProxy ].bounds = m_newBounds[ iProxy ];
+			}
+		}
+		this->RebuildEndpoints( handler );
+	}
+	else
+	{
+		// exploit frame coherence: endpoints move only a little
+		for( UINT iProxy = 0; iProxy < numProxySlots; iProxy++ )
+		{
+			if( m_boundsChanged[ iProxy ] && m_proxies[ iProxy ].minEdges[0] != INDEX_NONE )
+			{
+				this->UpdateProxy( iProxy, m_newBounds[ iProxy ], handler );
+			}
+		}
+
+		for( UINT i = 0; i < numPendingProxies; i++ )
+		{
+			const pxU4 proxyIndex = m_pendingProxies[ i ];
+			m_proxies[ proxyIndex ].bounds = m_newBounds[ proxyIndex ];
+			this->InsertProxy( proxyIndex, handler );
+		}
+	}
+
+	m_pendingProxies.Empty();
+
+	if( rebuildEndpoints || m_numRemovedProxies )
+	{
+		this->RemoveOldPairs( handler );
+	}
+	m_numRemovedProxies = 0;
+}
+
+FORCEINLINE bool pxBroadphase_SAS::TestOverlap2D( const pxSasProxy& a, const pxSasProxy& b, UINT axis ) const
+{
+	const UINT axis1 = (axis + 1) % 3;
+	const UINT axis2 = (axis + 2) % 3;
+
+	if( a.maxEdges[ axis1 ] < b.minEdges[ axis1 ] || b.maxEdges[ axis1 ] < a.minEdges[ axis1 ]
+		|| a.maxEdges[ axis2 ] < b.minEdges[ axis2 ] || b.maxEdges[ axis2 ] < a.minEdges[ axis2 ] )
+	{
+		return false;
+	}
+	return true;
+}
+
+bool pxBroadphase_SAS::TestOverlap( const pxSasProxy& a, const pxSasProxy& b ) const
+{
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		if( a.maxEdges[ axis ] < b.minEdges[ axis ] || b.maxEdges[ axis ] < a.minEdges[ axis ] ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// the minimum endpoint moves down and may start overlapping with other objects
+void pxBroadphase_SAS::SortMinDown( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps )
+{
+	pxSasEndpoint * endpoints = m_endpoints[ axis ].ToPtr();
+	pxSasProxy & edgeProxy = m_proxies[ endpoints[ edge ].GetProxy() ];
+
+	while( edge > 0 && endpoints[ edge ].value < endpoints[ edge - 1 ].value )
+	{
+		pxSasEndpoint & prev = endpoints[ edge - 1 ];
+		pxSasProxy & prevProxy = m_proxies[ prev.GetProxy() ];
+
+		if( prev.IsMax() )
+		{
+			if( updateOverlaps && this->TestOverlap2D( edgeProxy, prevProxy, axis ) ) {
+				handler.AddPair( edgeProxy.o, prevProxy.o );
+			}
+			prevProxy.maxEdges[ axis ]++;
+		}
+		else
+		{
+			prevProxy.minEdges[ axis ]++;
+		}
+		edgeProxy.minEdges[ axis ]--;
+
+		TSwap( endpoints[ edge ], prev );
+		edge--;
+	}
+}
+
+// the minimum endpoint moves up and may stop overlapping with other objects
+void pxBroadphase_SAS::SortMinUp( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps )
+{
+	pxSasEndpoint * endpoints = m_endpoints[ axis ].ToPtr();
+	const UINT lastEdge = m_endpoints[ axis ].Num() - 1;
+	pxSasProxy & edgeProxy = m_proxies[ endpoints[ edge ].GetProxy() ];
+
+	while( edge < lastEdge && endpoints[ edge ].value > endpoints[ edge + 1 ].value )
+	{
+		pxSasEndpoint & next = endpoints[ edge + 1 ];
+		pxSasProxy & nextProxy = m_proxies[ next.GetProxy() ];
+
+		if( next.IsMax() )
+		{
+			if( updateOverlaps && this->TestOverlap2D( edgeProxy, nextProxy, axis ) ) {
+				handler.RemovePair( edgeProxy.o, nextProxy.o );
+			}
+			nextProxy.maxEdges[ axis ]--;
+		}
+		else
+		{
+			nextProxy.minEdges[ axis ]--;
+		}
+		edgeProxy.minEdges[ axis ]++;
+
+		TSwap( endpoints[ edge ], next );
+		edge++;
+	}
+}
+
+// the maximum endpoint moves down and may stop overlapping with other objects
+void pxBroadphase_SAS::SortMaxDown( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps )
+{
+	pxSasEndpoint * endpoints = m_endpoints[ axis ].ToPtr();
+	pxSasProxy & edgeProxy = m_proxies[ endpoints[ edge ].GetProxy() ];
+
+	while( edge > 0 && endpoints[ edge ].value < endpoints[ edge - 1 ].value )
+	{
+		pxSasEndpoint & prev = endpoints[ edge - 1 ];
+		pxSasProxy & prevProxy = m_proxies[ prev.GetProxy() ];
+
+		if( !prev.IsMax() )
+		{
+			if( updateOverlaps && this->TestOverlap2D( edgeProxy, prevProxy, axis ) ) {
+				handler.RemovePair( edgeProxy.o, prevProxy.o );
+			}
+			prevProxy.minEdges[ axis ]++;
+		}
+		else
+		{
+			prevProxy.maxEdges[ axis ]++;
+		}
+		edgeProxy.maxEdges[ axis ]--;
+
+		TSwap( endpoints[ edge ], prev );
+		edge--;
+	}
+}
+
+// the maximum endpoint moves up and may start overlapping with other objects
+void pxBroadphase_SAS::SortMaxUp( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps )
+{
+	pxSasEndpoint * endpoints = m_endpoints[ axis ].ToPtr();
+	const UINT lastEdge = m_endpoints[ axis ].Num() - 1;
+	pxSasProxy & edgeProxy = m_proxies[ endpoints[ edge ].GetProxy() ];
+
+	while( edge < lastEdge && endpoints[ edge ].value > endpoints[ edge + 1 ].value )
+	{
+		pxSasEndpoint & next = endpoints[ edge + 1 ];
+		pxSasProxy & nextProxy = m_proxies[ next.GetProxy() ];
+
+		if( !next.IsMax() )
+		{
+			if( updateOverlaps && this->TestOverlap2D( edgeProxy, nextProxy, axis ) ) {
+				handler.AddPair( edgeProxy.o, nextProxy.o );
+			}
+			nextProxy.minEdges[ axis ]--;
+		}
+		else
+		{
+			nextProxy.maxEdges[ axis ]--;
+		}
+		edgeProxy.maxEdges[ axis ]++;
+
+		TSwap( endpoints[ edge ], next );
+		edge++;
+	}
+}
+
+void pxBroadphase_SAS::UpdateProxy( pxU4 proxyIndex, const pxAABB& newBounds, pxCollisionDispatcher & handler )
+{
+	pxSasProxy & proxy = m_proxies[ proxyIndex ];
+
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		pxSasEndpoint * endpoints = m_endpoints[ axis ].ToPtr();
+
+		pxSasEndpoint & minEdge = endpoints[ proxy.minEdges[ axis ] ];
+		pxSasEndpoint & maxEdge = endpoints[ proxy.maxEdges[ axis ] ];
+
+		const pxReal dmin = newBounds.mMin[ axis ] - minEdge.value;
+		const pxReal dmax = newBounds.mMax[ axis ] - maxEdge.value;
+
+		minEdge.value = newBounds.mMin[ axis ];
+		maxEdge.value = newBounds.mMax[ axis ];
+
+		// expand first, then shrink
+		if( dmin < REAL(0.0) ) {
+			this->SortMinDown( axis, proxy.minEdges[ axis ], handler, true );
+		}
+		if( dmax > REAL(0.0) ) {
+			this->SortMaxUp( axis, proxy.maxEdges[ axis ], handler, true );
+		}
+		if( dmin > REAL(0.0) ) {
+			this->SortMinUp( axis, proxy.minEdges[ axis ], handler, true );
+		}
+		if( dmax < REAL(0.0) ) {
+			this->SortMaxDown( axis, proxy.maxEdges[ axis ], handler, true );
+		}
+	}
+
+	proxy.bounds = newBounds;
+}
+
+void pxBroadphase_SAS::InsertProxy( pxU4 proxyIndex, pxCollisionDispatcher & handler )
+{
+	pxSasProxy & proxy = m_proxies[ proxyIndex ];
+
+	// append the endpoints to the end of the arrays
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		TList< pxSasEndpoint > & endpoints = m_endpoints[ axis ];
+
+		const UINT numEndpoints = endpoints.Num();
+		endpoints.SetNum( numEndpoints + 2 );
+
+		endpoints[ numEndpoints ].value = proxy.bounds.mMin[ axis ];
+		endpoints[ numEndpoints ].data = (proxyIndex << 1);
+
+		endpoints[ numEndpoints + 1 ].value = proxy.bounds.mMax[ axis ];
+		endpoints[ numEndpoints + 1 ].data = (proxyIndex << 1) | 1;
+
+		proxy.minEdges[ axis ] = numEndpoints;
+		proxy.maxEdges[ axis ] = numEndpoints + 1;
+	}
+
+	// sort the endpoints into place,
+	// overlaps can be reliably detected only when the other axes are sorted
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		const bool updateOverlaps = (axis == 2);
+		this->SortMinDown( axis, proxy.minEdges[ axis ], handler, updateOverlaps );
+		this->SortMaxDown( axis, proxy.maxEdges[ axis ], handler, updateOverlaps );
+	}
+}
+
+void pxBroadphase_SAS::RemoveEndpoints( pxU4 proxyIndex )
+{
+	pxSasProxy & proxy = m_proxies[ proxyIndex ];
+
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		TList< pxSasEndpoint > & endpointList = m_endpoints[ axis ];
+		pxSasEndpoint * endpoints = endpointList.ToPtr();
+		const UINT numEndpoints = endpointList.Num();
+
+		// shift down the endpoints after the removed ones
+		UINT dst = proxy.minEdges[ axis ];
+		for( UINT src = dst + 1; src < numEndpoints; src++ )
+		{
+			if( endpoints[ src ].GetProxy() == proxyIndex ) {
+				continue;
+			}
+			endpoints[ dst ] = endpoints[ src ];
+
+			pxSasProxy & other = m_proxies[ endpoints[ dst ].GetProxy() ];
+			if( endpoints[ dst ].IsMax() ) {
+				other.maxEdges[ axis ] = dst;
+			} else {
+				other.minEdges[ axis ] = dst;
+			}
+			dst++;
+		}
+		Assert( dst == numEndpoints - 2 );
+		endpointList.SetNum( numEndpoints - 2 );
+
+		proxy.minEdges[ axis ] = INDEX_NONE;
+		proxy.maxEdges[ axis ] = INDEX_NONE;
+	}
+}
+
+void pxBroadphase_SAS::RebuildEndpoints( pxCollisionDispatcher & handler )
+{
+	PX_PROFILE("SAS Rebuild");
+
+	const UINT numProxySlots = m_proxies.Num();
+	const UINT numEndpoints = m_numProxies * 2;
+
+	m_sortBuffer.SetNum( numEndpoints );
+
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		TList< pxSasEndpoint > & endpointList = m_endpoints[ axis ];
+		endpointList.SetNum( numEndpoints );
+
+		pxSasEndpoint * endpoints = endpointList.ToPtr();
+
+		// minimum goes before maximum, radix sort is stable
+		UINT numAdded = 0;
+		for( UINT iProxy = 0; iProxy < numProxySlots; iProxy++ )
+		{
+			const pxSasProxy & proxy = m_proxies[ iProxy ];
+			if( proxy.o == nil ) {
+				continue;
+			}
+			endpoints[ numAdded ].value = proxy.bounds.mMin[ axis ];
+			endpoints[ numAdded ].data = (iProxy << 1);
+			numAdded++;
+
+			endpoints[ numAdded ].value = proxy.bounds.mMax[ axis ];
+			endpoints[ numAdded ].data = (iProxy << 1) | 1;
+			numAdded++;
+		}
+		Assert( numAdded == numEndpoints );
+
+		// four passes, the result ends up in the original array
+		radix_sort_4pass( endpoints, m_sortBuffer.ToPtr(), numEndpoints, pxSasEndpointKey() );
+
+		for( UINT iEdge = 0; iEdge < numEndpoints; iEdge++ )
+		{
+			const pxSasEndpoint & e = endpoints[ iEdge ];
+			pxSasProxy & proxy = m_proxies[ e.GetProxy() ];
+			if( e.IsMax() ) {
+				proxy.maxEdges[ axis ] = iEdge;
+			} else {
+				proxy.minEdges[ axis ] = iEdge;
+			}
+		}
+	}
+
+	// sweep along the first axis to find overlapping pairs
+	m_activeProxies.Empty();
+
+	const pxSasEndpoint * endpoints = m_endpoints[0].ToPtr();
+	for( UINT iEdge = 0; iEdge < numEndpoints; iEdge++ )
+	{
+		const pxU4 proxyIndex = endpoints[ iEdge ].GetProxy();
+
+		if( endpoints[ iEdge ].IsMax() )
+		{
+			const INT index = m_activeProxies.FindIndexOf( proxyIndex );
+			Assert( index != INDEX_NONE );
+			m_activeProxies.RemoveAt_Fast( index );
+			continue;
+		}
+
+		const pxSasProxy & proxy = m_proxies[ proxyIndex ];
+
+		const UINT numActiveProxies = m_activeProxies.Num();
+		for( UINT i = 0; i < numActiveProxies; i++ )
+		{
+			const pxSasProxy & other = m_proxies[ m_activeProxies[ i ] ];
+			if( this->TestOverlap2D( proxy, other, 0 ) )
+			{
+				handler.AddPair( proxy.o, other.o );
+			}
+		}
+
+		m_activeProxies.Add( proxyIndex );
+	}
+	Assert( m_activeProxies.IsEmpty() );
+}
+
+void pxBroadphase_SAS::RemoveOldPairs( pxCollisionDispatcher & handler )
+{
+	// removal is deferred until the dispatcher updates its pairs, so pair indices are stable
+	const UINT numPairs = handler.NumPairs();
+	for( UINT iPair = 0; iPair < numPairs; iPair++ )
+	{
+		const pxCollisionPair & pair = handler.GetPairs()[ iPair ];
+
+		const pxU4 proxyA = pair.oA->m_broadphaseProxy;
+		const pxU4 proxyB = pair.oB->m_broadphaseProxy;
+
+		if( proxyA == INDEX_NONE || proxyB == INDEX_NONE
+			|| !this->TestOverlap( m_proxies[ proxyA ], m_proxies[ proxyB ] ) )
+		{
+			handler.RemovePairAt( iPair );
+		}
+	}
+}
+
+void pxBroadphase_SAS::CastRay( const WorldRayCastInput& input, WorldRayCastOutput &output )
+{
+	pxShapeRayCastInput	shapeRayCastInput;
+	shapeRayCastInput.m_from = pxVec3::From_Vec3D( input.origin );
+	shapeRayCastInput.m_to = shapeRayCastInput.m_from + pxVec3::From_Vec3D( input.direction ) * PX_BIG_NUMBER;
+
+	pxShapeRayCastOutput	shapeRayCastOutput;
+	TPtr< pxCollideable >	hitObject;
+
+	for( UINT i=0; i < m_proxies.Num(); i++ )
+	{
+		const pxSasProxy& proxy = m_proxies[i];
+		if( proxy.o == nil ) {
+			continue;
+		}
+
+		// only closer hits are reported
+		if( proxy.o->CastRay( shapeRayCastInput.m_from, shapeRayCastInput.m_to, shapeRayCastOutput ) )
+		{
+			hitObject = proxy.o;
+		}
+	}
+
+	output.normal = shapeRayCastOutput.m_normal;
+	output.hitFraction = shapeRayCastOutput.m_hitFraction;
+	output.hitObject = hitObject;
+}
+
+void pxBroadphase_SAS::TraceBox( const TraceBoxInput& input, TraceBoxOutput &output )
+{
+	if( input.start == input.end )
+	{
+		output.hitPosition = input.start;
+		output.hitNormal.SetZero();
+		output.hitFraction = 0.0f;
+		return;
+	}
+
+	ShapePMTraceInput		shapeTraceInput;
+	{
+	shapeTraceInput.start = input.start;
+	shapeTraceInput.end = input.end;
+	shapeTraceInput.size = input.size;
+
+	shapeTraceInput.UpdateCachedData();
+	}
+
+	const pxAABB traceBounds(
+		pxVec3::From_Vec3D( shapeTraceInput.fullTraceBounds.GetMin() ),
+		pxVec3::From_Vec3D( shapeTraceInput.fullTraceBounds.GetMax() )
+	);
+
+	F4	minHitFraction = 1.0f;
+	Vec3D	hitNormal(0);
+
+	for( UINT i=0; i < m_proxies.Num(); i++ )
+	{
+		const pxSasProxy& proxy = m_proxies[i];
+		if( proxy.o == nil || !proxy.bounds.Overlaps( traceBounds ) ) {
+			continue;
+		}
+
+		ShapePMTraceOutput	shapeTraceOutput;
+		proxy.o->GetShape()->TraceBox( shapeTraceInput, shapeTraceOutput );
+
+		if( shapeTraceOutput.fraction < minHitFraction )
+		{
+			minHitFraction = shapeTraceOutput.fraction;
+			hitNormal = shapeTraceOutput.normal;
+		}
+	}
+
+	output.hitPosition = input.start + (input.end - input.start) * minHitFraction;
+	output.hitNormal = hitNormal;
+	output.hitFraction = minHitFraction;
+}
+
+void pxBroadphase_SAS::validate()
+{
+	const UINT numInserted = m_numProxies - m_pendingProxies.Num();
+
+	for( UINT axis = 0; axis < 3; axis++ )
+	{
+		const TList< pxSasEndpoint > & endpoints = m_endpoints[ axis ];
+		Assert( endpoints.Num() == numInserted * 2 );
+
+		for( UINT iEdge = 0; iEdge < endpoints.Num(); iEdge++ )
+		{
+			const pxSasEndpoint & e = endpoints[ iEdge ];
+			const pxSasProxy & proxy = m_proxies[ e.GetProxy() ];
+
+			AssertPtr( proxy.o );
+			Assert( (e.IsMax() ? proxy.maxEdges[ axis ] : proxy.minEdges[ axis ]) == iEdge );
+
+			if( iEdge > 0 ) {
+				Assert( endpoints[ iEdge - 1 ].value <= e.value );
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
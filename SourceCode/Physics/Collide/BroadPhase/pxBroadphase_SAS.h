@@ -7,13 +7,75 @@
 #ifndef __PX_BROAD_PHASE_SAS_H__
 #define __PX_BROAD_PHASE_SAS_H__
 
+class AsyncJobQueue;
 
-class pxBroadphase_SAS
+enum pxcSasLimits
 {
+	PX_SAS_MAX_PROXIES = (1<<20),
+
+	// if more objects are added at once, the endpoint arrays are rebuilt from scratch
+	PX_SAS_BULK_INSERT_THRESHOLD = 16,
+};
+
+//
+//	pxSasEndpoint
+//
+struct pxSasEndpoint
+{
+	pxReal	value;
+	pxU4	data;	// (proxy index << 1) | (1 if this is a maximum)
+
+public:
+	FORCEINLINE bool IsMax() const {
+		return data & 1;
+	}
+	FORCEINLINE pxU4 GetProxy() const {
+		return data >> 1;
+	}
+};
+
+//
+//	pxSasProxy
+//
+MX_ALIGN_16(struct) pxSasProxy
+{
+	PX_DECLARE_POD_ALLOCATOR( pxSasProxy, PX_MEMORY_COLLISION_BROADPHASE );
+
+	pxAABB	bounds;	// bounds in world space
+
+	pxCollideable *	o;	// null for free proxies
+
+	// indices of the endpoints on each axis,
+	// INDEX_NONE if the proxy hasn't been inserted into the endpoint arrays yet
+	pxU4	minEdges[3];
+	pxU4	maxEdges[3];
+
+	pxU4	nextFree;	// index of the next free proxy (for organizing a linked list)
+};
+
+//
+//	pxBroadphase_SAS
+//
+//	Incremental three-axis sweep-and-prune.
+//	Endpoints are kept sorted between frames and updated with insertion sort,
+//	so the cost is proportional to the number of moved objects
+//	and the number of endpoint swaps (very low for slowly moving objects).
+//	Pairs are added and removed when endpoints of two objects swap.
+//	Bulk additions are handled by re-sorting all endpoints with radix sort.
+//	Proxy ids (stored in pxCollideable::m_broadphaseProxy) are indices into the proxy array.
+//
+class pxBroadphase_SAS : public pxBroadphase
+{
+	PX_DECLARE_CLASS_ALLOCATOR( pxBroadphase_SAS, PX_MEMORY_COLLISION_BROADPHASE );
+
 public:
-	pxBroadphase_SAS();
+	// the job queue is used for updating bounds of objects, it can be null
+	pxBroadphase_SAS( AsyncJobQueue* jobQueue = nil );
 	~pxBroadphase_SAS();
 
+public:	//-pxBroadphase
+	virtual void Reserve( UINT numObjects ) override;
+
 	// Adds an object to this broadphase.
 	virtual void Add( pxCollideable* object ) override;
 
@@ -31,6 +93,69 @@ public:
 
 	// Performs a broad-phase collision detection and feeds potentially colliding pairs to the collision handler.
 	virtual void Collide( pxCollisionDispatcher & handler ) override;
+
+	virtual void CastRay( const WorldRayCastInput& input, WorldRayCastOutput &output ) override;
+	virtual void TraceBox( const TraceBoxInput& input, TraceBoxOutput &output ) override;
+
+	virtual void validate() override;
+
+public_internal:
+	// computes world-space bounds of the given object,
+	// returns true if they differ from the bounds stored in the proxy.
+	// can be called from multiple threads.
+	bool CheckProxyMoved( pxU4 proxyIndex, pxAABB &newBounds ) const;
+
+private:
+	pxU4 AllocateProxy();
+	void FreeProxy( pxU4 proxyIndex );
+
+	// inserts endpoints of a single proxy and reports new pairs
+	void InsertProxy( pxU4 proxyIndex, pxCollisionDispatcher & handler );
+
+	// removes endpoints of the proxy from the sorted arrays
+	void RemoveEndpoints( pxU4 proxyIndex );
+
+	// moves endpoints of the proxy to the new positions
+	void UpdateProxy( pxU4 proxyIndex, const pxAABB& newBounds, pxCollisionDispatcher & handler );
+
+	// re-sorts all endpoints and finds all overlapping pairs
+	void RebuildEndpoints( pxCollisionDispatcher & handler );
+
+	void SortMinDown( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps );
+	void SortMinUp( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps );
+	void SortMaxDown( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps );
+	void SortMaxUp( UINT axis, pxU4 edge, pxCollisionDispatcher & handler, bool updateOverlaps );
+
+	// tests overlap on the two axes other than the given one using endpoint indices
+	bool TestOverlap2D( const pxSasProxy& a, const pxSasProxy& b, UINT axis ) const;
+	bool TestOverlap( const pxSasProxy& a, const pxSasProxy& b ) const;
+
+	// removes pairs of removed objects and pairs which don't overlap anymore
+	void RemoveOldPairs( pxCollisionDispatcher & handler );
+
+private:
+	TList< pxSasProxy >		m_proxies;
+	pxU4	m_firstFreeProxy;
+	pxU4	m_numProxies;
+
+	// sorted endpoints on each axis
+	TList< pxSasEndpoint >	m_endpoints[3];
+
+	// proxies added since the last Collide()
+	TList< pxU4 >	m_pendingProxies;
+
+	// scratch memory
+	TList< pxAABB >	m_newBounds;	// updated bounds of objects
+	TList< pxByte >	m_boundsChanged;
+	TList< pxSasEndpoint >	m_sortBuffer;	// used by radix sort
+	TList< pxU4 >	m_activeProxies;	// used for sweeping through the sorted endpoints
+
+	// pairs of removed objects are deleted in the next Collide()
+	pxU4	m_numRemovedProxies;
+
+	AsyncJobQueue *	m_jobQueue;
+
+private:	PREVENT_COPY(pxBroadphase_SAS);
 };
 
 #endif // !__PX_BROAD_PHASE_SAS_H__
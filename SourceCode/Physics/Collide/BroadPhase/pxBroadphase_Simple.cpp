@@ -128,14 +128,10 @@ void pxBroadphase_Simple::CastRay( const WorldRayCastInput& input, WorldRayCastO
 	{
 		pxSimpleBroadphaseProxy& proxy = mHandles[i];
 
-		pxShapeRayCastOutput	tmpShapeRayCastOutput;
-		if( proxy.o->GetShape()->CastRay( shapeRayCastInput, tmpShapeRayCastOutput ) )
+		// only closer hits are reported
+		if( proxy.o->CastRay( shapeRayCastInput.m_from, shapeRayCastInput.m_to, shapeRayCastOutput ) )
 		{
-			if( tmpShapeRayCastOutput.m_hitFraction < shapeRayCastOutput.m_hitFraction )
-			{
-				shapeRayCastOutput = tmpShapeRayCastOutput;
-				hitObject = proxy.o;
-			}
+			hitObject = proxy.o;
 		}
 	}
 
@@ -17,6 +17,7 @@
 ================================*/
 
 pxCollisionDispatcher::pxCollisionDispatcher( pxUInt maxPairs )
+	: m_pairs( maxPairs )
 {
 	m_manifoldsPool.Setup( MX_EFFICIENT_SIZE(sizeof(pxContactManifold)), 1024 );
 
@@ -131,30 +132,152 @@ SizeT pxCollisionDispatcher::_RegisterAllCollisionAgents()
 	return maxAgentSize;
 }
 
-void pxCollisionDispatcher::AfterNewPairAdded( pxCollisionPair* newPair )
+static FORCEINLINE
+void MarkPairRemoved( pxCollisionPair & pair, TList< pxU8 > & removedPairKeys )
 {
-	Assert( nil == newPair->agent );
-	//if( PX_DEBUG )
-	//{
-	//	ANSICHAR	buf[512];
-	//	pxDbgDumpPairInfo(newPair->oA,newPair->oB,buf);
-	//	DBGOUT("adding pair: %s\n",buf);
-	//}
-	pxCollideable* oA = newPair->oA;
-	pxCollideable* oB = newPair->oB;
-	newPair->agent = this->CreateCollisionAgent( oA, oB );
+	if( !(pair.flags & PX_PAIR_REMOVED) )
+	{
+		pair.flags |= PX_PAIR_REMOVED;
+		removedPairKeys.Add( pair.GetKey() );
+	}
 }
 
-void pxCollisionDispatcher::BeforePairRemoved( pxCollisionPair* oldPair )
+void pxCollisionDispatcher::AddPair( pxCollideable* oA, pxCollideable* oB )
 {
-	Assert( nil != oldPair->agent );
-	//if( PX_DEBUG )
-	//{
-	//	ANSICHAR	buf[512];
-	//	pxDbgDumpPairInfo(oldPair->oA,oldPair->oB,buf);
-	//	DBGOUT("destroying pair: %s\n",buf);
-	//}
-	this->DestroyCollisionAgent( oldPair->agent );
+	pxU4 idA = oA->m_broadphaseProxy;
+	pxU4 idB = oB->m_broadphaseProxy;
+	Assert( idA != INDEX_NONE && idB != INDEX_NONE && idA != idB );
+
+	if( idA > idB ) {
+		TSwap( idA, idB );
+		TSwap( oA, oB );
+	}
+
+	pxCollisionPair* pair = m_pairs.FindPair( idA, idB );
+
+	if( !pair )
+	{
+		pair = m_pairs.AddPair( idA, idB );
+		pair->Initialize( oA, oB );
+		pair->flags = PX_PAIR_NEW;
+		m_addedPairKeys.Add( pair->GetKey() );
+		return;
+	}
+
+	if( pair->oA != oA || pair->oB != oB )
+	{
+		// the proxy ids have been reused by other objects
+		// since the old pair was reported
+		const bool wasNew = (pair->flags & PX_PAIR_NEW);
+		if( pair->agent )
+		{
+			this->DestroyCollisionAgent( pair->agent );
+			PX_STATS(gPhysStats.removedPairs++);
+		}
+		pair->Initialize( oA, oB );
+		pair->flags = PX_PAIR_NEW;
+		if( !wasNew ) {
+			m_addedPairKeys.Add( pair->GetKey() );
+		}
+		return;
+	}
+
+	// persistent pair
+	pair->flags &= ~PX_PAIR_REMOVED;
+}
+
+void pxCollisionDispatcher::RemovePair( pxCollideable* oA, pxCollideable* oB )
+{
+	pxU4 idA = oA->m_broadphaseProxy;
+	pxU4 idB = oB->m_broadphaseProxy;
+
+	if( idA == INDEX_NONE || idB == INDEX_NONE ) {
+		return;
+	}
+	if( idA > idB ) {
+		TSwap( idA, idB );
+		TSwap( oA, oB );
+	}
+
+	pxCollisionPair* pair = m_pairs.FindPair( idA, idB );
+
+	if( pair && pair->oA == oA && pair->oB == oB )
+	{
+		MarkPairRemoved( *pair, m_removedPairKeys );
+	}
+}
+
+void pxCollisionDispatcher::RemovePairAt( UINT pairIndex )
+{
+	Assert( pairIndex < m_pairs.GetNumPairs() );
+	MarkPairRemoved( m_pairs.GetPairs()[ pairIndex ], m_removedPairKeys );
+}
+
+void pxCollisionDispatcher::UpdatePairs()
+{
+	PX_PROFILE("Update collision pairs");
+
+	m_newPairs.Empty();
+	m_persistingPairs.Empty();
+
+	// delete removed pairs first, the remaining pair indices won't change after that
+
+	const UINT numRemovedKeys = m_removedPairKeys.Num();
+	const pxU8* removedKeys = m_removedPairKeys.ToPtr();
+
+	for( UINT iKey = 0; iKey < numRemovedKeys; iKey++ )
+	{
+		const pxU4 idA = pxU4( removedKeys[ iKey ] );
+		const pxU4 idB = pxU4( removedKeys[ iKey ] >> 32 );
+
+		pxCollisionPair* pair = m_pairs.FindPair( idA, idB );
+
+		// the pair could be re-added after removal
+		if( pair && (pair->flags & PX_PAIR_REMOVED) )
+		{
+			if( pair->agent )
+			{
+				this->DestroyCollisionAgent( pair->agent );
+				PX_STATS(gPhysStats.removedPairs++);
+			}
+			m_pairs.RemovePairAt( m_pairs.GetPairIndex( pair ) );
+		}
+	}
+
+	// all pairs which are not new have been kept
+
+	const UINT numPairs = m_pairs.GetNumPairs();
+	const pxCollisionPair* pairs = m_pairs.GetPairs();
+
+	for( UINT iPair = 0; iPair < numPairs; iPair++ )
+	{
+		if( !(pairs[ iPair ].flags & PX_PAIR_NEW) ) {
+			m_persistingPairs.Add( iPair );
+		}
+	}
+
+	const UINT numAddedKeys = m_addedPairKeys.Num();
+	const pxU8* addedKeys = m_addedPairKeys.ToPtr();
+
+	for( UINT iKey = 0; iKey < numAddedKeys; iKey++ )
+	{
+		const pxU4 idA = pxU4( addedKeys[ iKey ] );
+		const pxU4 idB = pxU4( addedKeys[ iKey ] >> 32 );
+
+		pxCollisionPair* pair = m_pairs.FindPair( idA, idB );
+
+		if( pair && (pair->flags & PX_PAIR_NEW) )
+		{
+			Assert( nil == pair->agent );
+			pair->agent = this->CreateCollisionAgent( pair->oA, pair->oB );
+			pair->flags &= ~PX_PAIR_NEW;
+			m_newPairs.Add( m_pairs.GetPairIndex( pair ) );
+			PX_STATS(gPhysStats.addedPairs++);
+		}
+	}
+
+	m_removedPairKeys.Empty();
+	m_addedPairKeys.Empty();
 }
 
 pxCollisionAgent* pxCollisionDispatcher::CreateCollisionAgent( pxCollideable* oA, pxCollideable* oB )
@@ -237,34 +360,66 @@ void pxCollisionDispatcher::ReleaseContactManifold( pxContactManifold* manifold
 	manifoldsPtrArray[ findIndex ]->internalIndex = findIndex;
 }
 
+// contacts between sleeping and static objects don't change,
+// so such pairs keep their old contact points
+static FORCEINLINE
+bool IsActiveObject( pxCollideable* o )
+{
+	return !o->IsSleeping() && AsRigidBody( o )->IsMovable();
+}
+
+static FORCEINLINE
+UINT CollidePair( pxCollisionPair & pair )
+{
+	AssertPtr(pair.agent);
+
+	pxProcessCollisionInput		input;
+	//{
+	//	input.oA = pair.oA;
+	//	input.oB = pair.oB;
+	//}
+
+	pxProcessCollisionOutput	result;
+
+	pair.agent->ProcessCollision( pair.oA, pair.oB, input, result );
+
+	return result.numContacts;
+}
+
 void pxCollisionDispatcher::Collide( pxContactCache & contacts )
 {
 	contacts.Clear();
 
-	const UINT numPairs = this->NumPairs();
+	this->UpdatePairs();
+
 	pxCollisionPair* pairs = this->GetPairs();
 
 	//@todo: this can be done in parallel
 
 	UINT	totalNumContacts = 0;
 
-	for( UINT iPair = 0; iPair < numPairs; iPair++ )
-	{
-		pxCollisionPair & pair = pairs[ iPair ];
+	// new pairs have empty manifolds, so they are always collided
 
-		AssertPtr(pair.agent);
+	const UINT numNewPairs = m_newPairs.Num();
+	const pxU4* newPairs = m_newPairs.ToPtr();
 
-		pxProcessCollisionInput		input;
-		//{
-		//	input.oA = pair.oA;
-		//	input.oB = pair.oB;
-		//}
+	for( UINT i = 0; i < numNewPairs; i++ )
+	{
+		totalNumContacts += CollidePair( pairs[ newPairs[i] ] );
+	}
 
-		pxProcessCollisionOutput	result;
+	const UINT numPersistingPairs = m_persistingPairs.Num();
+	const pxU4* persistingPairs = m_persistingPairs.ToPtr();
 
-		pair.agent->ProcessCollision( pair.oA, pair.oB, input, result );
+	for( UINT i = 0; i < numPersistingPairs; i++ )
+	{
+		pxCollisionPair & pair = pairs[ persistingPairs[i] ];
+
+		if( !IsActiveObject( pair.oA ) && !IsActiveObject( pair.oB ) ) {
+			continue;
+		}
 
-		totalNumContacts += result.numContacts;
+		totalNumContacts += CollidePair( pair );
 	}
 
 	contacts.manifolds = m_manifoldsPtrArray.ToPtr();
@@ -274,7 +429,21 @@ void pxCollisionDispatcher::Collide( pxContactCache & contacts )
 
 void pxCollisionDispatcher::Clear()
 {
-	Super::Clear();
+	const UINT numPairs = this->NumPairs();
+	pxCollisionPair* pairs = this->GetPairs();
+
+	for( UINT iPair = 0; iPair < numPairs; iPair++ )
+	{
+		if( pairs[ iPair ].agent ) {
+			this->DestroyCollisionAgent( pairs[ iPair ].agent );
+		}
+	}
+
+	m_pairs.Clear();
+	m_addedPairKeys.Empty();
+	m_removedPairKeys.Empty();
+	m_newPairs.Empty();
+	m_persistingPairs.Empty();
 }
 
 //--------------------------------------------------------------//
@@ -47,22 +47,65 @@ typedef pxColliderEntry	CollisionMatrixType[ pxcShapeType::PX_SHAPE_MAX ][ pxcSh
 //  - For each pair of types, there must be a function registered to handle this pair of types
 //
 class pxCollisionDispatcher
-	: public pxSimplePairCache< pxCollisionDispatcher >
-	, SingleInstance< pxCollisionDispatcher >
+	: SingleInstance< pxCollisionDispatcher >
 {
 	PX_DECLARE_CLASS_ALLOCATOR( pxCollisionAgent, PX_MEMORY_COLLISION_DISPATCH );
 
 public:
-	typedef pxSimplePairCache Super;
-
 	pxCollisionDispatcher( pxUInt maxPairs = 1024 );
 
 	~pxCollisionDispatcher();
 
 	//--- Broad-phase collision detection --------------------------------------
 
-	void AfterNewPairAdded( pxCollisionPair* newPair );
-	void BeforePairRemoved( pxCollisionPair* oldPair );
+	// Pair additions and removals reported by the broadphase are buffered
+	// and applied in UpdatePairs() (pair indices stay valid during the broadphase),
+	// so a pair which is removed and re-added in the same frame keeps its collision agent.
+
+	// Adds a new overlapping pair (or keeps the existing one).
+	void AddPair( pxCollideable* oA, pxCollideable* oB );
+
+	// Removes the pair if it exists.
+	void RemovePair( pxCollideable* oA, pxCollideable* oB );
+
+	// Removes the pair with the given index (e.g. pairs of removed objects).
+	void RemovePairAt( UINT pairIndex );
+
+	// Destroys agents of removed pairs (which also releases their contact manifolds),
+	// creates agents for new pairs and sorts pairs into new and persisting ones.
+	// This is called automatically before the narrowphase.
+	void UpdatePairs();
+
+	FORCEINLINE UINT NumPairs() const
+	{
+		return m_pairs.GetNumPairs();
+	}
+	FORCEINLINE pxCollisionPair* GetPairs()
+	{
+		return m_pairs.GetPairs();
+	}
+
+	// indices of pairs created during the last update,
+	// these are always collided to fill their contact manifolds
+	FORCEINLINE UINT NumNewPairs() const
+	{
+		return m_newPairs.Num();
+	}
+	FORCEINLINE const pxU4* GetNewPairs() const
+	{
+		return m_newPairs.ToPtr();
+	}
+
+	// indices of pairs which existed before the last update and still exist,
+	// these are skipped by the narrowphase if both objects are inactive
+	FORCEINLINE UINT NumPersistingPairs() const
+	{
+		return m_persistingPairs.Num();
+	}
+	FORCEINLINE const pxU4* GetPersistingPairs() const
+	{
+		return m_persistingPairs.ToPtr();
+	}
 
 	//--- Narrow-phase collision detection --------------------------------------
 
@@ -102,6 +145,17 @@ private:
 
 	TList< pxContactManifold* >	m_manifoldsPtrArray;
 
+	// overlapping pairs found by the broadphase
+	pxCollisionPairHash	m_pairs;
+
+	// keys of pairs added and removed since the last update
+	TList< pxU8 >	m_addedPairKeys;
+	TList< pxU8 >	m_removedPairKeys;
+
+	// results of the last update
+	TList< pxU4 >	m_newPairs;
+	TList< pxU4 >	m_persistingPairs;
+
 	// collision matrix for invoking proper near-phase callbacks
 	MX_ALIGN_16( CollisionMatrixType	m_collisionMatrix );
 };
@@ -8,15 +8,30 @@
 #ifndef __PX_COLLISION_PAIR_H__
 #define __PX_COLLISION_PAIR_H__
 
-PX_INLINE static
-pxUInt pxCalcCollisionPairHash( pxCollideable* oA, pxCollideable* oB )
+// builds a unique 64-bit key from two (ordered) proxy ids
+FORCEINLINE
+pxU8 pxMakeCollisionPairKey( pxU4 idA, pxU4 idB )
 {
-	// the lowest four bits are usually zeros because of 16-byte alignment
-	const pxULong addrA = pxULong( oA ) >> 4;
-	const pxULong addrB = pxULong( oB ) >> 4;
-	return Hash32Bits_0( pxUInt(addrA) | (pxUInt(addrB)<<16) );
+	Assert( idA < idB );
+	return (pxU8(idB) << 32) | idA;
 }
 
+FORCEINLINE
+pxU4 pxCalcCollisionPairHash( pxU4 idA, pxU4 idB )
+{
+	return (pxU4) hash6432shift( (INT64) pxMakeCollisionPairKey( idA, idB ) );
+}
+
+enum pxcCollisionPairFlags
+{
+	// the pair has been added since the last update of the pair manager,
+	// the collision agent hasn't been created yet
+	PX_PAIR_NEW		= BIT(0),
+
+	// the pair will be deleted during the next update of the pair manager
+	PX_PAIR_REMOVED	= BIT(1),
+};
+
 //
 //	pxCollisionPair
 //
@@ -25,14 +40,16 @@ struct pxCollisionPair
 	pxCollisionAgent *	agent;
 	pxCollideable *	RESTRICT_PTR( oA );
 	pxCollideable *	RESTRICT_PTR( oB );
-	//@todo: 16-bit indices will suffice
-	//pxBroadphasePair	d;
+
+	// broadphase proxy ids of the objects (idA < idB), used as a key in the pair hash
+	pxU4	idA;
+	pxU4	idB;
+
+	pxU4	flags;	// pxcCollisionPairFlags
 
 public:
 	PX_INLINE pxCollisionPair()
 	{
-		//agent = nil;
-		//d.id = 0;
 	}
 
 	FORCEINLINE void Clear()
@@ -40,29 +57,36 @@ public:
 		this->agent = nil;
 		this->oA = nil;
 		this->oB = nil;
+		this->idA = INDEX_NONE;
+		this->idB = INDEX_NONE;
+		this->flags = 0;
 	}
+
+	// the objects must be ordered by their proxy ids
 	FORCEINLINE void Initialize( pxCollideable* oA, pxCollideable* oB )
 	{
+		Assert( oA->m_broadphaseProxy < oB->m_broadphaseProxy );
 		this->agent = nil;
 		this->oA = oA;
 		this->oB = oB;
-		//d.id0 = oA;
-		//d.id1 = oB;
+		this->idA = oA->m_broadphaseProxy;
+		this->idB = oB->m_broadphaseProxy;
+		this->flags = 0;
 	}
 
-	//FORCEINLINE bool Equals( UINT oA, UINT oB ) const
-	//{
-	//	return (this->d.id0 == oA) && (this->d.id1 == oB);
-	//}
-	FORCEINLINE bool Equals( pxCollideable* oA, pxCollideable* oB ) const
+	FORCEINLINE bool Equals( pxU4 idA, pxU4 idB ) const
 	{
-		return (this->oA == oA) && (this->oB == oB);
+		return (this->idA == idA) && (this->idB == idB);
+	}
+
+	FORCEINLINE pxU8 GetKey() const
+	{
+		return pxMakeCollisionPairKey( this->idA, this->idB );
 	}
 
 	FORCEINLINE pxU4 GetHash() const
 	{
-		//return Hash32Bits_0( d.id );
-		return pxCalcCollisionPairHash( this->oA, this->oB );
+		return pxCalcCollisionPairHash( this->idA, this->idB );
 	}
 
 public:
@@ -71,106 +95,6 @@ public:
 
 typedef TList< pxCollisionPair >	pxCollisionPairList;
 
-
-//struct PairCachePolicy
-//{
-//	void AfterNewPairAdded( pxCollisionPair& newPair )
-//	{}
-//	void BeforePairRemoved( pxCollisionPair& oldPair )
-//	{}
-//};
-template
-<
-	class DERIVED
->
-class pxSimplePairCache
-{
-	pxCollisionPairList	m_pairs;
-
-public:
-	pxSimplePairCache()
-	{
-	}
-	~pxSimplePairCache()
-	{
-	}
-
-	FORCEINLINE DERIVED* AsDerived()
-	{
-		return static_cast< DERIVED* >( this );
-	}
-
-	FORCEINLINE UINT NumPairs() const
-	{
-		return m_pairs.Num();
-	}
-	FORCEINLINE pxCollisionPair* GetPairs()
-	{
-		return m_pairs.ToPtr();
-	}
-
-	void Clear()
-	{
-		m_pairs.EmptyOrClear();
-	}
-
-	pxCollisionPair* FindPair( pxCollideable* oA, pxCollideable* oB )
-	{
-		PX_STATS(gPhysStats.searchedPairs++);
-
-		TOrderPointers( oA, oB );
-
-		const UINT numPairs = m_pairs.Num();
-		pxCollisionPair* pairsArray = m_pairs.ToPtr();
-
-		for( UINT iPair = 0; iPair < numPairs; iPair++ )
-		{
-			pxCollisionPair* existingPair = pairsArray + iPair;
-			if( existingPair->Equals( oA, oB ) )
-			{
-				return existingPair;
-			}
-		}
-
-		return nil;
-	}
-
-	void AddPair( pxCollideable* oA, pxCollideable* oB )
-	{
-		TOrderPointers( oA, oB );
-
-		if( !this->FindPair( oA, oB ) )
-		{
-			pxCollisionPair& newPair = m_pairs.Add();
-			newPair.Initialize( oA, oB );
-
-			this->AsDerived()->AfterNewPairAdded( &newPair );
-
-			PX_STATS(gPhysStats.addedPairs++);
-		}
-	}
-
-	void RemovePair( pxCollideable* oA, pxCollideable* oB )
-	{
-		TOrderPointers( oA, oB );
-
-		pxCollisionPair* existingPair = this->FindPair( oA, oB );
-
-		if(PtrToBool( existingPair ))
-		{
-			const UINT pairIndex = existingPair - m_pairs.ToPtr();
-
-			this->AsDerived()->BeforePairRemoved( existingPair );
-
-			m_pairs.RemoveAt_Fast( pairIndex );
-
-			PX_STATS(gPhysStats.removedPairs++);
-		}
-
-		//Unreachable;
-	}
-};
-
 #endif // !__PX_COLLISION_PAIR_H__
 
 //--------------------------------------------------------------//
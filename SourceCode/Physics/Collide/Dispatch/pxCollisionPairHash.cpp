@@ -8,256 +8,188 @@
 #pragma hdrstop
 #include <Physics.h>
 
-#if 0
-static
-PX_INLINE void SortIds( pxULong& oA, pxULong& oB )
-{
-	if(oA>oB)	TSwap(oA, oB);
-}
-static
-PX_INLINE bool DifferentPair( const pxCollisionPair& p, pxCollideable* oA, pxCollideable* oB )
-{
-	return !(p.Equals( oA, oB ));
-}
-
-const pxUInt INVALID_PAIR_INDEX	= pxUInt(-1);
+enum { MIN_HASH_TABLE_SIZE = 64 };
 
 /*================================
 		pxCollisionPairHash
 ================================*/
 
-pxCollisionPairHash::pxCollisionPairHash( pxUInt maxPairs ) :
-	mHashSize		(0),
-	mMask			(0),
-	mHashTable		(nil),
-	mNext			(nil),
-	mNbPairs	(0),
-	mPairs	(nil)
+pxCollisionPairHash::pxCollisionPairHash( pxUInt maxPairs )
 {
-	Assert( maxPairs > 0 && IsPowerOfTwo(maxPairs) );
-
-	mHashSize = maxPairs;
-	mMask = mHashSize - 1;
-
-	mHashTable = (pxUInt*)pxNew(mHashSize*sizeof(pxUInt));
-	MemSet(mHashTable, INVALID_PAIR_INDEX, mHashSize*sizeof(pxUInt) );
+	mMask = 0;
+	mPairs.Reserve( maxPairs );
 
-	mNext = (pxUInt*)pxNew(mHashSize * sizeof(pxUInt));
-	AssertPtr(mNext);
-
-	mPairs = (pxCollisionPair*)pxNew(mHashSize * sizeof(pxCollisionPair));
-	AssertPtr(mPairs);
+	// keep the load factor below 0.5 to make probe sequences short
+	this->Rehash( largest<pxUInt>( CeilPowerOfTwo( maxPairs * 2 ), MIN_HASH_TABLE_SIZE ) );
 }
 
 pxCollisionPairHash::~pxCollisionPairHash()
 {
-	pxFree(mNext);			mNext = nil;
-	pxFree(mPairs);			mPairs = nil;
-	pxFree(mHashTable);		mHashTable = nil;
 }
 
-void pxCollisionPairHash::Clear()
+void pxCollisionPairHash::Empty()
 {
-// @shvd: we don't release memory
-	MemSet(mHashTable, INVALID_PAIR_INDEX, mHashSize*sizeof(pxUInt) );
-	mNbPairs	= 0;
-}
-
-pxCollisionPair* pxCollisionPairHash::FindPair( pxCollideable* oA, pxCollideable* oB )
-{
-// @shvd: this can be removed since we always preallocate arrays
-//	if(!mHashTable)	return nil;	// Nothing has been allocated yet
-
-	// Order the ids
-	SortIds( (pxULong&)oA, (pxULong&)oB );
-
-	// Compute hash value for this pair
-	const pxUInt HashValue = pxCollisionPair::GetHash( oA, oB ) & mMask;
-
-	return _FindPair( oA, oB, HashValue );
+	MemSet( mHashTable.ToPtr(), 0xFF, mHashTable.Num() * sizeof(pxU4) );
+	mPairs.Empty();
 }
 
-// Internal version saving hash computation
-PX_INLINE pxCollisionPair* pxCollisionPairHash::_FindPair( pxCollideable* oA, pxCollideable* oB , pxUInt hashValue )
+void pxCollisionPairHash::Clear()
 {
-// @shvd: this can be removed since we always preallocate arrays
-//	if(!mHashTable)	return nil;	// Nothing has been allocated yet
-
-	// Look for it in the table
-	pxUInt Offset = mHashTable[hashValue];
-	while(Offset!=INVALID_PAIR_INDEX && DifferentPair(mPairs[Offset], oA, oB))
-	{
-//		Assert(mPairs[Offset].mID0!=INVALID_PAIR_INDEX);
-		Offset = mNext[Offset];		// Better to have a separate array for this
-	}
-	if(Offset==INVALID_PAIR_INDEX)	return nil;
-	Assert(Offset<mNbPairs);
-	// Match mPairs[Offset] => the pair is persistent
-	return &mPairs[Offset];
+	mPairs.Clear();
+	mHashTable.Clear();
+	this->Rehash( MIN_HASH_TABLE_SIZE );
 }
 
-pxCollisionPair* pxCollisionPairHash::AddUniquePair( pxCollideable* oA, pxCollideable* oB )
+pxCollisionPair* pxCollisionPairHash::FindPair( pxU4 idA, pxU4 idB )
 {
-	// Order the ids
-	SortIds( (pxULong&)oA, (pxULong&)oB );
+	PX_STATS(gPhysStats.searchedPairs++);
 
-	pxUInt HashValue = pxCollisionPair::GetHash( oA, oB ) & mMask;
+	const pxU4* hashTable = mHashTable.ToPtr();
+	pxCollisionPair* pairs = mPairs.ToPtr();
 
-	pxCollisionPair* P = _FindPair(oA, oB, HashValue);
-	if(P)
-		return P;	// Persistent pair
+	pxUInt slot = pxCalcCollisionPairHash( idA, idB ) & mMask;
 
-	// This is a new pair
-	if(mNbPairs >= mHashSize)
+	while( hashTable[ slot ] != INDEX_NONE )
 	{
-		// Get more entries, resize the table
-		mHashSize = NextPowerOfTwo(mNbPairs+1);
-		mMask = mHashSize - 1;
-
-		pxFree(mHashTable);
-		mHashTable = (pxUInt*)pxNew(mHashSize*sizeof(pxUInt));
-		MemSet(mHashTable, INVALID_PAIR_INDEX, mHashSize*sizeof(pxUInt) );
-
-		// Get some bytes for new entries
-		pxCollisionPair* NewPairs = (pxCollisionPair*)pxNew(mHashSize * sizeof(pxCollisionPair));
-		AssertPtr(NewPairs);
-
-		pxUInt* NewNext = (pxUInt*)pxNew(mHashSize * sizeof(pxUInt));
-		AssertPtr(NewNext);
-
-		// Copy old data if needed
-		if(mNbPairs) {
-			MemCopy(NewPairs, mPairs, mNbPairs*sizeof(pxCollisionPair));
-		}
-		// ### check it's actually needed... probably only for pairs whose hash value was cut by the and
-		// yeah, since pxCollisionPair::GetHash( oA, oB ) is a constant
-		// However it might not be needed to recompute them => only less efficient but still ok
-		for(pxUInt i=0;i<mNbPairs;i++)
+		pxCollisionPair* pair = pairs + hashTable[ slot ];
+		if( pair->Equals( idA, idB ) )
 		{
-			pxUInt HashValue = mPairs[i].GetHash() & mMask;	// New hash value with new mask
-			NewNext[i] = mHashTable[HashValue];
-			mHashTable[HashValue] = i;
+			return pair;
 		}
+		slot = (slot + 1) & mMask;
+	}
+	return nil;
+}
 
-		// Delete old data
-		pxFree(mNext);
-		pxFree(mPairs);
+pxCollisionPair* pxCollisionPairHash::AddPair( pxU4 idA, pxU4 idB )
+{
+	Assert( idA < idB );
+	Assert( !this->FindPair( idA, idB ) );
 
-		// Assign new pointer
-		mPairs = NewPairs;
-		mNext = NewNext;
+	const pxUInt newPairIndex = mPairs.Num();
 
-		// Recompute hash value with new hash size
-		HashValue = pxCollisionPair::GetHash( oA, oB ) & mMask;
+	if( (newPairIndex + 1) * 2 > mHashTable.Num() )
+	{
+		this->Rehash( mHashTable.Num() * 2 );
 	}
 
-	pxCollisionPair* p = &mPairs[ mNbPairs ];
-	new(p) pxCollisionPair( oA, oB );
+	pxUInt slot = pxCalcCollisionPairHash( idA, idB ) & mMask;
+	while( mHashTable[ slot ] != INDEX_NONE )
+	{
+		slot = (slot + 1) & mMask;
+	}
+	mHashTable[ slot ] = newPairIndex;
 
-	mNext[mNbPairs] = mHashTable[HashValue];
-	mHashTable[HashValue] = mNbPairs++;
-	return p;
+	pxCollisionPair& newPair = mPairs.Add();
+	newPair.Clear();
+	newPair.idA = idA;
+	newPair.idB = idB;
+	return &newPair;
 }
 
-pxCollisionPair* pxCollisionPairHash::RemovePair( pxCollideable* oA, pxCollideable* oB )
+void pxCollisionPairHash::RemovePairAt( pxUInt pairIndex )
 {
-	// Order the ids
-	SortIds( (pxULong&)oA, (pxULong&)oB );
+	const pxUInt lastPairIndex = mPairs.Num() - 1;
+	Assert( pairIndex <= lastPairIndex );
 
-	const pxUInt HashValue = pxCollisionPair::GetHash( oA, oB ) & mMask;
-	pxCollisionPair* P = _FindPair(oA, oB, HashValue);
-	if( !P ) {
-		return nil;
-	}
-	Assert(P->Equals(oA,oB));
+	this->RemoveSlot( this->FindSlot( pairIndex, mPairs[ pairIndex ].GetHash() ) );
 
-	const pxUInt PairIndex = GetPairIndex(P);
+	// the last pair will be moved into the hole, fix its slot
+	if( pairIndex != lastPairIndex )
+	{
+		const pxUInt lastSlot = this->FindSlot( lastPairIndex, mPairs[ lastPairIndex ].GetHash() );
+		mHashTable[ lastSlot ] = pairIndex;
+	}
 
-	// Walk the hash table to fix mNext
-	pxUInt Offset = mHashTable[HashValue];
-	Assert(Offset!=INVALID_PAIR_INDEX);
+	mPairs.RemoveAt_Fast( pairIndex );
+}
 
-	pxUInt Previous=INVALID_PAIR_INDEX;
-	while(Offset!=PairIndex)
+pxUInt pxCollisionPairHash::FindSlot( pxUInt pairIndex, pxUInt hashValue ) const
+{
+	pxUInt slot = hashValue & mMask;
+	while( mHashTable[ slot ] != pairIndex )
 	{
-		Previous = Offset;
-		Offset = mNext[Offset];
+		Assert( mHashTable[ slot ] != INDEX_NONE );
+		slot = (slot + 1) & mMask;
 	}
+	return slot;
+}
 
-	// Let us go/jump us
-	if(Previous!=INVALID_PAIR_INDEX)
+void pxCollisionPairHash::RemoveSlot( pxUInt slot )
+{
+	pxU4* hashTable = mHashTable.ToPtr();
+	const pxCollisionPair* pairs = mPairs.ToPtr();
+
+	// backward shift deletion:
+	// move back the following entries which would become unreachable,
+	// so that we don't need tombstones
+	pxUInt hole = slot;
+	pxUInt next = slot;
+	for(;;)
 	{
-		Assert(mNext[Previous]==PairIndex);
-		mNext[Previous] = mNext[PairIndex];
-	}
-	// else we were the first
-	else mHashTable[HashValue] = mNext[PairIndex];
-	// we're now free to reuse next[pairIndex] without breaking the list
+		next = (next + 1) & mMask;
 
-#if PX_DEBUG
-	mNext[PairIndex]=INVALID_PAIR_INDEX;
-#endif
+		const pxU4 pairIndex = hashTable[ next ];
+		if( pairIndex == INDEX_NONE ) {
+			break;
+		}
 
-	// We now move the last pair into spot of the
-	// pair being removed. We need to fix the hash
-	// table indices to support the move.
+		const pxUInt home = pairs[ pairIndex ].GetHash() & mMask;
 
-	// Fill holes
-	if(1)
-	{
-		// 1) Remove last pair
-		const pxUInt LastPairIndex = mNbPairs-1;
-		if(LastPairIndex==PairIndex)
+		// skip the entry if its home slot lies cyclically in (hole, next]
+		const bool reachable = (hole <= next)
+			? (hole < home && home <= next)
+			: (hole < home || home <= next);
+
+		if( !reachable )
 		{
-			mNbPairs--;
-			return P;
+			hashTable[ hole ] = pairIndex;
+			hole = next;
 		}
+	}
+	hashTable[ hole ] = INDEX_NONE;
+}
 
-		const pxCollisionPair* Last = &mPairs[LastPairIndex];
-		const pxUInt LastHashValue = Last->GetHash() & mMask;
+void pxCollisionPairHash::Rehash( pxUInt newTableSize )
+{
+	Assert( IsPowerOfTwo( newTableSize ) );
 
-		// Walk the hash table to fix mNext
-		pxUInt Offset = mHashTable[LastHashValue];
-		Assert(Offset!=INVALID_PAIR_INDEX);
+	mHashTable.SetNum( newTableSize );
+	MemSet( mHashTable.ToPtr(), 0xFF, mHashTable.Num() * sizeof(pxU4) );
+	mMask = newTableSize - 1;
 
-		pxUInt Previous=INVALID_PAIR_INDEX;
-		while(Offset!=LastPairIndex)
-		{
-			Previous = Offset;
-			Offset = mNext[Offset];
-		}
+	pxU4* hashTable = mHashTable.ToPtr();
+	const pxCollisionPair* pairs = mPairs.ToPtr();
+	const pxUInt numPairs = mPairs.Num();
 
-		// Let us go/jump us
-		if(Previous!=INVALID_PAIR_INDEX)
+	for( pxUInt iPair = 0; iPair < numPairs; iPair++ )
+	{
+		pxUInt slot = pairs[ iPair ].GetHash() & mMask;
+		while( hashTable[ slot ] != INDEX_NONE )
 		{
-			Assert(mNext[Previous]==LastPairIndex);
-			mNext[Previous] = mNext[LastPairIndex];
+			slot = (slot + 1) & mMask;
 		}
-		// else we were the first
-		else mHashTable[LastHashValue] = mNext[LastPairIndex];
-		// we're now free to reuse mNext[LastPairIndex] without breaking the list
-
-#if PX_DEBUG
-		mNext[LastPairIndex]=INVALID_PAIR_INDEX;
-#endif
-
-		// Don't invalidate entry since we're going to shrink the array
+		hashTable[ slot ] = iPair;
+	}
+}
 
-		// 2) Re-insert in free slot
-		mPairs[PairIndex] = mPairs[LastPairIndex];
-#if PX_DEBUG
-		Assert(mNext[PairIndex]==INVALID_PAIR_INDEX);
-#endif
-		mNext[PairIndex] = mHashTable[LastHashValue];
-		mHashTable[LastHashValue] = PairIndex;
+void pxCollisionPairHash::validate() const
+{
+	const pxUInt numPairs = mPairs.Num();
+	UINT numUsedSlots = 0;
 
-		mNbPairs--;
+	for( pxUInt iSlot = 0; iSlot < mHashTable.Num(); iSlot++ )
+	{
+		const pxU4 pairIndex = mHashTable[ iSlot ];
+		if( pairIndex != INDEX_NONE )
+		{
+			Assert( pairIndex < numPairs );
+			Assert( this->FindSlot( pairIndex, mPairs[ pairIndex ].GetHash() ) == iSlot );
+			numUsedSlots++;
+		}
 	}
-	return P;
+	Assert( numUsedSlots == numPairs );
 }
-#endif
-
-NO_EMPTY_FILE
 
 //--------------------------------------------------------------//
 //				End Of File.									//
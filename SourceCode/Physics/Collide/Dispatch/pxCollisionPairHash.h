@@ -8,50 +8,67 @@
 #ifndef __PX_COLLISION_PAIR_HASH_H__
 #define __PX_COLLISION_PAIR_HASH_H__
 
-#if 0
 //
 //	pxCollisionPairHash
 //
+//	Hash set of pairs keyed on broadphase proxy ids.
+//	Pairs are stored contiguously (so they can be iterated quickly),
+//	the hash table uses open addressing with linear probing
+//	and stores indices into the pair array.
+//	Removal moves the last pair into the hole (pair indices are not stable!).
+//
 class pxCollisionPairHash
 {
 public:
 	pxCollisionPairHash( pxUInt maxPairs = 1024 );
 	~pxCollisionPairHash();
 
+	// removes all entries, keeps allocated memory
+	void Empty();
+
 	// removes all entries and releases memory
 	void Clear();
 
-	pxCollisionPair* AddUniquePair( pxCollideable* oA, pxCollideable* oB );
+	// returns nil if such pair wasn't found; ids must be ordered
+	pxCollisionPair* FindPair( pxU4 idA, pxU4 idB );
 
-	// attempts to remove the specified pair; returns nil if such pair wasn't found
-	pxCollisionPair* RemovePair( pxCollideable* oA, pxCollideable* oB );
+	// inserts a new pair, the pair must not exist; ids must be ordered.
+	// only the ids of the returned pair are set.
+	pxCollisionPair* AddPair( pxU4 idA, pxU4 idB );
 
-	// returns nil if such pair wasn't found
-	pxCollisionPair* FindPair( pxCollideable* oA, pxCollideable* oB );
+	// removes the pair with the given index,
+	// the last pair is moved into its place
+	void RemovePairAt( pxUInt pairIndex );
 
 	PX_INLINE pxUInt GetPairIndex( const pxCollisionPair* pair ) const
 	{
-		return ((pxUInt)((SizeT(pair) - SizeT(mPairs))) / sizeof(pxCollisionPair));
+		return pxUInt( pair - mPairs.ToPtr() );
 	}
 
-	PX_INLINE pxUInt GetNumPairs() const { return mNbPairs; }
+	PX_INLINE pxUInt GetNumPairs() const { return mPairs.Num(); }
 
-	PX_INLINE pxCollisionPair* GetPairs() { return mPairs; }
-	PX_INLINE const pxCollisionPair* GetPairs() const { return mPairs; }
+	PX_INLINE pxCollisionPair* GetPairs() { return mPairs.ToPtr(); }
+	PX_INLINE const pxCollisionPair* GetPairs() const { return mPairs.ToPtr(); }
+
+	void validate() const;
 
 private:
-	PX_INLINE pxCollisionPair* _FindPair( pxCollideable* oA, pxCollideable* oB, pxUInt hashValue );
+	// returns the index of the slot holding the given pair index
+	pxUInt FindSlot( pxUInt pairIndex, pxUInt hashValue ) const;
+
+	// removes the entry from the hash table and moves the following entries back
+	void RemoveSlot( pxUInt slot );
+
+	// resizes the hash table and rehashes all pairs
+	void Rehash( pxUInt newTableSize );
 
 private:
-	pxUInt				mHashSize;		// should be a power of two
-	pxUInt				mMask;			// mMask = mHashSize - 1
-	pxUInt				mNbPairs;		// number of pairs
-	pxUInt*				mHashTable;		// array of offsets into mPairs
-	pxUInt*				mNext;			// array of links to next items
-	pxCollisionPair*	mPairs;			// pairs are kept here
-};
+	TList< pxU4 >				mHashTable;	// indices into mPairs, INDEX_NONE for empty slots
+	pxUInt						mMask;		// mMask = mHashTable.Num() - 1
+	TList< pxCollisionPair >	mPairs;		// pairs are kept here
 
-#endif
+private:	PREVENT_COPY(pxCollisionPairHash);
+};
 
 #endif // !__PX_COLLISION_PAIR_HASH_H__
 
@@ -10,18 +10,70 @@
 -----------------------------------------------------------------------------
 */
 
-UINT SortContactPoints( pxContactPoint points[MAX_CONTACTS] )
+UINT SortContactPoints( pxManifoldPoint points[MAX_CONTACTS] )
 {
 	return 0;
 }
 
-void pxContactManifold::AddPoint( const pxVec3& position, const pxVec3& normal, pxReal	depth )
+// returns the index of the old point which matches the given new one or INDEX_NONE;
+// points with known feature ids are matched by ids, other points - by proximity.
+static
+UINT FindMatchingPoint(
+	const pxManifoldPoint* points, UINT numPoints,
+	const pxVec3& position, pxContactPointId featureId,
+	UINT usedPointsMask	// bit mask of points which have already been matched
+	)
+{
+	UINT	closestPoint = INDEX_NONE;
+	pxReal	closestDistanceSqr = squaref( PX_CONTACT_MATCH_THRESHOLD );
+
+	for( UINT iPoint = 0; iPoint < numPoints; iPoint++ )
+	{
+		if( usedPointsMask & BIT(iPoint) ) {
+			continue;
+		}
+
+		const pxManifoldPoint & oldPt = points[ iPoint ];
+
+		if( featureId && oldPt.featureId )
+		{
+			if( featureId == oldPt.featureId ) {
+				return iPoint;
+			}
+			continue;
+		}
+
+		const pxReal distanceSqr = (oldPt.position - position).LengthSqr();
+		if( distanceSqr < closestDistanceSqr )
+		{
+			closestDistanceSqr = distanceSqr;
+			closestPoint = iPoint;
+		}
+	}
+
+	return closestPoint;
+}
+
+void pxContactManifold::AddPoint( const pxVec3& position, const pxVec3& normal, pxReal	depth, pxContactPointId featureId )
 {
 	Assert(numPoints <= MAX_CONTACTS);
 
 #if PX_USE_CONTACT_CACHING
 
-	UINT index = numPoints++;
+	UINT index = FindMatchingPoint( points, numPoints, position, featureId, 0 );
+
+	if( index != INDEX_NONE )
+	{
+		// refresh the old point, keep its accumulated impulses for warm starting
+		pxManifoldPoint & oldPt = points[ index ];
+
+		oldPt.setPosition( position );
+		oldPt.setNormalAndDepth( normal, depth );
+		oldPt.featureId = featureId;
+		return;
+	}
+
+	index = numPoints++;
 
 	if( index == NUMBER_OF(points) )
 	{
@@ -29,10 +81,12 @@ void pxContactManifold::AddPoint( const pxVec3& position, const pxVec3& normal,
 		numPoints = NUMBER_OF(points);
 	}
 
-	pxContactPoint & newPt = points[ index ];
+	pxManifoldPoint & newPt = points[ index ];
 
 	newPt.setPosition( position );
 	newPt.setNormalAndDepth( normal, depth );
+	newPt.featureId = featureId;
+	newPt.ClearImpulses();
 
 #else
 
@@ -40,14 +94,61 @@ void pxContactManifold::AddPoint( const pxVec3& position, const pxVec3& normal,
 	
 	const UINT index = (numPoints++) & (MAX_CONTACTS-1);//avoid checking for overflow
 
-	pxContactPoint & newPt = points[ index ];
+	pxManifoldPoint & newPt = points[ index ];
 
 	newPt.setPosition( position );
 	newPt.setNormalAndDepth( normal, depth );
+	newPt.featureId = featureId;
+	newPt.ClearImpulses();
 
 #endif // PX_USE_CONTACT_CACHING
 }
 
+void pxContactManifold::ReplacePoints( const pxManifoldPoint* newPoints, UINT numNewPoints )
+{
+	Assert(numPoints <= MAX_CONTACTS);
+	Assert(numNewPoints <= MAX_CONTACTS);
+
+	pxManifoldPoint	oldPoints[ MAX_CONTACTS ];
+	const UINT numOldPoints = numPoints;
+
+	for( UINT iPoint = 0; iPoint < numOldPoints; iPoint++ )
+	{
+		oldPoints[ iPoint ] = points[ iPoint ];
+	}
+
+	UINT usedPointsMask = 0;
+
+	for( UINT iPoint = 0; iPoint < numNewPoints; iPoint++ )
+	{
+		const pxManifoldPoint & src = newPoints[ iPoint ];
+		pxManifoldPoint & dst = points[ iPoint ];
+
+		dst.position = src.position;
+		dst.normalAndDepth = src.normalAndDepth;
+		dst.featureId = src.featureId;
+
+		const UINT oldIndex = FindMatchingPoint( oldPoints, numOldPoints, src.position, src.featureId, usedPointsMask );
+
+		if( oldIndex != INDEX_NONE )
+		{
+			const pxManifoldPoint & oldPt = oldPoints[ oldIndex ];
+
+			dst.normalImpulse = oldPt.normalImpulse;
+			dst.frictionImpulse[0] = oldPt.frictionImpulse[0];
+			dst.frictionImpulse[1] = oldPt.frictionImpulse[1];
+
+			usedPointsMask |= BIT(oldIndex);
+		}
+		else
+		{
+			dst.ClearImpulses();
+		}
+	}
+
+	numPoints = numNewPoints;
+}
+
 void pxContactManifold::Clear()
 {
 	numPoints = 0;
@@ -11,8 +11,29 @@
 // max. number of contact points in a contact manifold
 enum pxcContactLimits { MAX_CONTACTS = 4 };
 
+//
+//	pxManifoldPoint - a contact point which is kept between simulation steps.
+//
 MX_ALIGN_16(struct) pxManifoldPoint : pxContactPoint
 {
+	// accumulated impulses (solver lambdas) from the previous step,
+	// used for warm starting the constraint solver
+	pxReal				normalImpulse;
+	pxReal				frictionImpulse[2];
+
+	// identifies the pair of features which generated this point (e.g. vertex-face);
+	// zero if unknown, then points are matched by proximity
+	pxContactPointId	featureId;
+
+	//total:32+16=48 bytes
+
+public:
+	FORCEINLINE void ClearImpulses()
+	{
+		normalImpulse = 0.0f;
+		frictionImpulse[0] = 0.0f;
+		frictionImpulse[1] = 0.0f;
+	}
 };
 
 /*
@@ -23,8 +44,7 @@ MX_ALIGN_16(struct) pxManifoldPoint : pxContactPoint
 */
 MX_ALIGN_16(struct) pxContactManifold
 {
-	//pxContactPointId	pointIds[ MAX_CONTACTS ];	// only valid if 'numPoints' > 0
-	pxContactPoint		points[ MAX_CONTACTS ];	// only valid if 'numPoints' > 0
+	pxManifoldPoint		points[ MAX_CONTACTS ];	// only valid if 'numPoints' > 0
 	pxUInt				numPoints;	// can be zero
 	pxCollideable *		oA;
 	pxCollideable *		oB;
@@ -41,7 +61,13 @@ public:
 		ZERO_OUT(*this);
 	}
 
-	void AddPoint( const pxVec3& position, const pxVec3& normal, pxReal	depth );
+	// adds a new point or refreshes the matching old one (keeps its accumulated impulses)
+	void AddPoint( const pxVec3& position, const pxVec3& normal, pxReal	depth, pxContactPointId featureId = 0 );
+
+	// replaces all contact points with the new ones;
+	// accumulated impulses of the old points are carried over to the matching new points.
+	// (impulses of the new points are ignored.)
+	void ReplacePoints( const pxManifoldPoint* newPoints, UINT numNewPoints );
 
 	void Clear();
 
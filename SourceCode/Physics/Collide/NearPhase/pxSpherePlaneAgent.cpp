@@ -57,12 +57,16 @@ void pxSpherePlaneAgent::ProcessCollision(
 		// or penetration depth if positive (>epsilon)
 		//DBGOUT("contact depth: %f\n",depth);
 
-		pxContactPoint& point0 = m_manifold->points[0];
+		pxManifoldPoint	point0;
 
 		point0.position = sphereOrigin - planeNormal * (sphereRadius - depth);
 		point0.setNormalAndDepth( planeNormal, depth );
 
-		m_manifold->numPoints = 1;
+		// a sphere can only touch a plane at a single point
+		point0.featureId = 1;
+
+		// keeps accumulated impulses of the old point
+		m_manifold->ReplacePoints( &point0, 1 );
 
 		m_manifold->oA = objA;
 		m_manifold->oB = objB;
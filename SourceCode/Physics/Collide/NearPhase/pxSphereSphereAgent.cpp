@@ -44,6 +44,7 @@ void pxSphereSphereAgent::ProcessCollision(
 	//iff len positive, don't generate a new contact
 	if( distanceSq > squaref(radiusA + radiusB) )
 	{
+		manifold->Clear();
 		return;
 	}
 
@@ -62,12 +63,18 @@ void pxSphereSphereAgent::ProcessCollision(
 	const pxVec3 pB = posB + radiusB * normalOnSurfaceB;
 
 
-	manifold->points[0].position = pB;
+	pxManifoldPoint	newPoint;
 
-	manifold->points[0].normalAndDepth.mVec128 = normalOnSurfaceB.mVec128;
-	manifold->points[0].normalAndDepth.w = distance;
+	newPoint.position = pB;
 
-	manifold->numPoints = 1;
+	newPoint.normalAndDepth.mVec128 = normalOnSurfaceB.mVec128;
+	newPoint.normalAndDepth.w = distance;
+
+	// two spheres can only touch at a single point
+	newPoint.featureId = 1;
+
+	// keeps accumulated impulses of the old point
+	manifold->ReplacePoints( &newPoint, 1 );
 
 	manifold->oA = objA;
 	manifold->oB = objB;
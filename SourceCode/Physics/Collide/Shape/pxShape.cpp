@@ -69,7 +69,7 @@ pxShape::~pxShape()
 
 bool pxShape::CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const
 {
-	Unimplemented;
+	// the shape is not hit by rays
 	return false;
 }
 
@@ -194,6 +194,8 @@ public_internal:
 	};
 
 	// Finds the closest intersection between the shape and a ray defined in the shape's local space, starting at fromLocal, ending at toLocal.
+	// Returns true and updates the output only if the hit is closer than output.m_hitFraction.
+	// Can be called from multiple threads.
 	//
 	virtual bool CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const;
 
@@ -41,6 +41,60 @@ void pxShape_Box::GetWorldBounds( const pxTransform& xform, pxAABB &outBounds )
 	outBounds.mMax = center + extent;
 }
 
+bool pxShape_Box::CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const
+{
+	// slab test against the box centered at the origin
+	const pxVec3 delta = input.m_to - input.m_from;
+
+	pxReal	tEnter = 0.0f;
+	pxReal	tExit = output.m_hitFraction;
+	UINT	hitAxis = INDEX_NONE;
+	pxReal	hitSign = 0.0f;
+
+	for( UINT iAxis = 0; iAxis < 3; iAxis++ )
+	{
+		const pxReal o = input.m_from[ iAxis ];
+		const pxReal d = delta[ iAxis ];
+		const pxReal h = mHalfSize[ iAxis ];
+
+		if( mxFabs( d ) < PX_EPSILON )
+		{
+			if( o < -h || o > h ) {
+				return false;
+			}
+			continue;
+		}
+
+		const pxReal invD = 1.0f / d;
+		pxReal t1 = (-h - o) * invD;
+		pxReal t2 = (h - o) * invD;
+		pxReal sign = -1.0f;
+		if( t1 > t2 ) {
+			TSwap( t1, t2 );
+			sign = 1.0f;
+		}
+		if( t1 > tEnter ) {
+			tEnter = t1;
+			hitAxis = iAxis;
+			hitSign = sign;
+		}
+		tExit = smallest( tExit, t2 );
+		if( tEnter > tExit ) {
+			return false;
+		}
+	}
+
+	// the ray starts inside the box
+	if( hitAxis == INDEX_NONE ) {
+		return false;
+	}
+
+	output.m_hitFraction = tEnter;
+	output.m_normal.SetZero();
+	output.m_normal[ hitAxis ] = hitSign;
+	return true;
+}
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
@@ -21,6 +21,8 @@ public:
 
 	void GetWorldBounds( const pxTransform& xform, pxAABB &outBounds ) const;
 
+	virtual bool CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const override;
+
 	FORCEINLINE const pxVec3& GetHalfSize() const { return mHalfSize; }
 	FORCEINLINE pxVec3 Num() const { return pxReal(2.0) * mHalfSize; }
 };
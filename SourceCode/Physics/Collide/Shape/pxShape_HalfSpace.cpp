@@ -127,6 +127,26 @@ void pxShape_HalfSpace::GetWorldBounds( const pxTransform& xform, pxAABB &outBou
 	outBounds = mAABB;
 }
 
+bool pxShape_HalfSpace::CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const
+{
+	// the solid region is behind the plane
+	const F4 dStart = mPlane.Distance( input.m_from );
+	const F4 dEnd = mPlane.Distance( input.m_to );
+
+	if( dStart < 0.0f || dEnd >= 0.0f ) {
+		return false;
+	}
+
+	const pxReal t = dStart / (dStart - dEnd);
+	if( t >= output.m_hitFraction ) {
+		return false;
+	}
+
+	output.m_hitFraction = t;
+	output.m_normal = pxVec3::From_Vec3D( mPlane.Normal() );
+	return true;
+}
+
 void pxShape_HalfSpace::TraceBox( ShapePMTraceInput& input, ShapePMTraceOutput &output ) const
 {
 	Unimplemented_Checked;
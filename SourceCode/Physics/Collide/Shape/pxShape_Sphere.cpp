@@ -37,6 +37,35 @@ void pxShape_Sphere::CalculateInertiaLocal( pxReal mass, pxVec3 &inertia ) const
 	inertia.SetAll( x );
 }
 
+bool pxShape_Sphere::CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const
+{
+	// solve |from + delta * t| = radius for the smallest t
+	const pxVec3 delta = input.m_to - input.m_from;
+
+	const pxReal a = delta.LengthSqr();
+	const pxReal b = input.m_from.Dot( delta );
+	const pxReal c = input.m_from.LengthSqr() - squaref( mRadius );
+
+	// the ray starts inside the sphere or points away from it
+	if( c < 0.0f || b > 0.0f || a < PX_EPSILON ) {
+		return false;
+	}
+
+	const pxReal discriminant = b * b - a * c;
+	if( discriminant < 0.0f ) {
+		return false;
+	}
+
+	const pxReal t = (-b - mxSqrt( discriminant )) / a;
+	if( t >= output.m_hitFraction ) {
+		return false;
+	}
+
+	output.m_hitFraction = t;
+	output.m_normal = (input.m_from + delta * t) / mRadius;
+	return true;
+}
+
 pxVec3 pxShape_Sphere::GetSupportingVertex( const pxVec3& direction ) const
 {
 	Assert(direction.IsNormalized());
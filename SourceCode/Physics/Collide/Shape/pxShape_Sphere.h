@@ -27,6 +27,7 @@ public:
 public:	//--pxShape
 	virtual void GetWorldBounds( const pxTransform& xform, pxAABB &outBounds ) const override;
 	virtual void CalculateInertiaLocal( pxReal mass, pxVec3 &inertia ) const override;
+	virtual bool CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const override;
 
 public:	//--pxShape_Convex
 	virtual pxVec3 GetSupportingVertex( const pxVec3& direction ) const override;
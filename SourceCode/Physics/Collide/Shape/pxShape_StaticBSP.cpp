@@ -45,6 +45,21 @@ void pxShape_StaticBSP::GetWorldBounds( const pxTransform& xform, pxAABB &outBou
 		outBounds.mMin, outBounds.mMax );
 }
 
+bool pxShape_StaticBSP::CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const
+{
+	F4		fraction;
+	Vec3D	normal;
+	m_bspTree.CastRay( input.m_from, input.m_to, fraction, normal );
+
+	if( fraction >= output.m_hitFraction ) {
+		return false;
+	}
+
+	output.m_hitFraction = fraction;
+	output.m_normal = pxVec3::From_Vec3D( normal );
+	return true;
+}
+
 void pxShape_StaticBSP::TraceBox( ShapePMTraceInput& input, ShapePMTraceOutput &output ) const
 {
 	m_bspTree.TraceAABB( input.size, input.start, input.end,
@@ -30,6 +30,8 @@ public:
 
 	virtual void GetWorldBounds( const pxTransform& xform, pxAABB &outBounds ) const override;
 
+	virtual bool CastRay( const pxShapeRayCastInput& input, pxShapeRayCastOutput &output ) const override;
+
 	virtual void TraceBox( ShapePMTraceInput& input, ShapePMTraceOutput &output ) const override;
 
 	FORCEINLINE const BSP_Tree& GetTree() const
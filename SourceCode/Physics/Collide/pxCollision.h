@@ -42,6 +42,14 @@ MX_GLOBAL_CONST pxReal PX_COLLISION_TOLERANCE = REAL(0.25);
 //
 MX_GLOBAL_CONST pxReal PX_COLLISION_MARGIN = REAL(0.05);
 
+//------------------------------------------------------------------------
+// PX_CONTACT_MATCH_THRESHOLD - used for matching contact points between steps.
+//
+// If the feature ids of two contact points are unknown, the new point inherits
+// accumulated impulses of the old point if they are closer than this distance.
+//
+MX_GLOBAL_CONST pxReal PX_CONTACT_MATCH_THRESHOLD = REAL(0.02);
+
 //------------------------------------------------------------------------
 // PX_CONTACT_THRESHOLD - used by near-phase collision detection.
 //
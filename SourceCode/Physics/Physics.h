@@ -56,6 +56,8 @@
 #include <Physics/Collide/BroadPhase/pxBroadphase.h>
 #include <Physics/Collide/BroadPhase/pxBroadphasePair.h>
 #include <Physics/Collide/BroadPhase/pxBroadphase_Simple.h>
+#include <Physics/Collide/BroadPhase/pxBroadphase_BVH.h>
+#include <Physics/Collide/BroadPhase/pxBroadphase_SAS.h>
 
 //Physics/Collide/Query
 #include <Physics/Collide/Query/pxShapeRayCastInput.h>
@@ -84,6 +86,7 @@
 #include <Physics/Solve/pxConstraint.h>
 #include <Physics/Solve/pxJoint.h>
 #include <Physics/Solve/pxConstraintSolver.h>
+#include <Physics/Solve/pxSimulationIsland.h>
 #include <Physics/Solve/pxConstraintSolver_PGS.h>
 
 //Physics/Simulate/
@@ -59,6 +59,8 @@ void pxRigidBody::_ctor( const pxRigidBodyInfo& cInfo )
 
 	mTotalForce.SetZero();
 	mTotalTorque.SetZero();
+
+	mSleepTimer = 0.0f;
 }
 
 void pxRigidBody::_dtor()
@@ -22,6 +22,12 @@ const pxReal PX_RB_MAX_ANGULAR_VELOCITY = MX_HALF_PI * REAL(0.5);
 
 const pxReal PX_RB_MAX_FORCE = REAL(1e5);
 
+// bodies moving slower than these thresholds for PX_RB_TIME_TO_SLEEP seconds
+// are deactivated (only if all touching bodies are resting, too)
+const pxReal PX_RB_SLEEP_LINEAR_VELOCITY = REAL(0.05);
+const pxReal PX_RB_SLEEP_ANGULAR_VELOCITY = REAL(0.05);
+const pxReal PX_RB_TIME_TO_SLEEP = REAL(0.5);
+
 //
 // pxClampBodyVelocities
 //
@@ -153,6 +159,8 @@ MX_ALIGN_64(struct) pxRigidBody : pxCollideable
 	pxReal		mLinearDamping;	//4 translational friction
 	pxReal		mAngularDamping;//4 rotational friction
 
+	pxReal		mSleepTimer;	//4 how long the body has been resting, in seconds
+
 	//pxCollideable::Handle	mCollisionData;
 
 	//@todo: remove this:
@@ -201,6 +209,12 @@ public:
 	bool IsStatic() const;
 	bool IsMovable() const;
 
+	// Sleeping bodies are woken up by applying forces/impulses, setting velocities
+	// or by contacts with awake bodies (the whole group of touching bodies wakes up).
+	// Call WakeUp() after teleporting a sleeping body.
+	void WakeUp();
+	void PutToSleep();
+
 public_internal:
 
 	PX_DECLARE_POD_ALLOCATOR( pxRigidBody, PX_MEMORY_DYNAMICS );
@@ -225,6 +239,9 @@ public_internal:
 	void ClampVelocities( pxReal deltaTime );
 	void ApplyDamping( pxReal deltaTime );
 
+	// accumulates resting time (resets it if the body is moving), returns the updated value
+	pxReal UpdateSleepTimer( pxReal deltaTime );
+
 	void IntegrateVelocities( pxReal deltaTime );
 	void IntegratePositions( pxReal deltaTime );
 
@@ -250,11 +267,13 @@ void pxRigidBody::ApplyForce( const pxVec3& force, const pxVec3& relativePoint )
 
 PX_INLINE
 void pxRigidBody::ApplyCentralForce( const pxVec3& force ) {
+	this->WakeUp();
 	mTotalForce += force;
 }
 
 PX_INLINE
 void pxRigidBody::ApplyTorque( const pxVec3& torque ) {
+	this->WakeUp();
 	mTotalTorque += torque;
 }
 
@@ -272,6 +291,7 @@ const pxVec3& pxRigidBody::GetLinearVelocity() const {
 
 PX_INLINE
 void pxRigidBody::SetLinearVelocity( const pxVec3& newLinearVelocity ) {
+	this->WakeUp();
 	mLinearVelocity = newLinearVelocity;
 }
 
@@ -282,6 +302,7 @@ const pxVec3& pxRigidBody::GetAngularVelocity() const {
 
 PX_INLINE
 void pxRigidBody::SetAngularVelocity( const pxVec3& newAngularVelocity ) {
+	this->WakeUp();
 	mAngularVelocity = newAngularVelocity;
 }
 
@@ -294,6 +315,7 @@ pxVec3 pxRigidBody::GetVelocityInLocalPoint( const pxVec3& relativePosition ) co
 PX_INLINE
 void pxRigidBody::ApplyCentralImpulse( const pxVec3& impulse )
 {
+	this->WakeUp();
 	mLinearVelocity += impulse * mInverseMass;
 }
 
@@ -308,6 +330,7 @@ void pxRigidBody::ApplyImpulse( const pxVec3& impulse, const pxVec3& relativePos
 PX_INLINE
 void pxRigidBody::ApplyTorqueImpulse( const pxVec3& torque )
 {
+	this->WakeUp();
 	mAngularVelocity += mInvInertiaTensorWorld * torque;
 }
 
@@ -369,6 +392,42 @@ bool pxRigidBody::IsMovable() const {
 	return !this->IsStatic();
 }
 
+PX_INLINE
+void pxRigidBody::WakeUp()
+{
+	if( this->IsSleeping() )
+	{
+		m_flags.AndWith( ~PX_SLEEPING_OBJECT );
+		mSleepTimer = 0.0f;
+	}
+}
+
+PX_INLINE
+void pxRigidBody::PutToSleep()
+{
+	Assert(this->IsMovable());
+	m_flags.OrWith( PX_SLEEPING_OBJECT );
+	mSleepTimer = 0.0f;
+	mLinearVelocity.SetZero();
+	mAngularVelocity.SetZero();
+	this->ClearForces();
+}
+
+PX_INLINE
+pxReal pxRigidBody::UpdateSleepTimer( pxReal deltaTime )
+{
+	if( mLinearVelocity.LengthSqr() > Square(PX_RB_SLEEP_LINEAR_VELOCITY)
+		|| mAngularVelocity.LengthSqr() > Square(PX_RB_SLEEP_ANGULAR_VELOCITY) )
+	{
+		mSleepTimer = 0.0f;
+	}
+	else
+	{
+		mSleepTimer += deltaTime;
+	}
+	return mSleepTimer;
+}
+
 PX_INLINE
 void pxRigidBody::UpdateWorldInertiaTensor()
 {
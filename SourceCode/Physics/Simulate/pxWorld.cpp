@@ -14,6 +14,106 @@
 #include <Physics/Collide/Shape/pxShape_Box.h>
 #include <Physics/Collide/Shape/pxShape_StaticBSP.h>
 
+#include <Base/JobSystem/ParallelFor.h>
+
+namespace
+{
+	// apply external forces, integrate velocities, predict unconstrained motion
+	struct IntegrateBodies
+	{
+		pxRigidBody *	bodies;
+		pxVec3			gravityAcceleration;
+		pxReal			deltaTime;
+
+	public:
+		void operator () ( UINT firstBody, UINT lastBody ) const
+		{
+			for( UINT iBody = firstBody; iBody < lastBody; iBody++ )
+			{
+				pxRigidBody * body = bodies + iBody;
+
+				if( body->IsSleeping() ) {
+					continue;
+				}
+
+				// apply external forces (such as gravity)
+				//if( ! body->IsStatic() )
+				{
+					pxVec3 gravityForce = gravityAcceleration * body->GetMass();
+					body->ApplyCentralForce( gravityForce );
+				}
+
+				// integrate velocities
+				body->IntegrateVelocities( deltaTime );
+				body->ClampVelocities( deltaTime );
+				body->ApplyDamping( deltaTime );
+
+				// integrate transforms, predict positions
+				body->IntegratePositions( deltaTime );
+				body->UpdateWorldInertiaTensor();
+			}
+		}
+	};
+
+	// advance positions
+	struct IntegrateBodyTransforms
+	{
+		pxRigidBody *	bodies;
+		pxReal			deltaTime;
+
+	public:
+		void operator () ( UINT firstBody, UINT lastBody ) const
+		{
+			for( UINT iBody = firstBody; iBody < lastBody; iBody++ )
+			{
+				pxRigidBody * body = bodies + iBody;
+
+				if( body->IsSleeping() ) {
+					continue;
+				}
+
+				body->IntegratePositions( deltaTime );
+				body->UpdateWorldInertiaTensor();
+			}
+		}
+	};
+
+	enum {
+		// rays are cheap, so use bigger chunks of work
+		PX_RAY_BATCH_GRAIN_SIZE = 64,
+	};
+
+	struct CastRayBatch
+	{
+		pxBroadphase *				broadphase;
+		const WorldRayCastInput *	inputs;
+		WorldRayCastOutput *		outputs;
+
+	public:
+		void operator () ( UINT firstRay, UINT lastRay ) const
+		{
+			broadphase->CastRays( inputs + firstRay, outputs + firstRay, lastRay - firstRay );
+		}
+	};
+
+	struct TraceBoxBatch
+	{
+		pxBroadphase *			broadphase;
+		const TraceBoxInput *	inputs;
+		TraceBoxOutput *		outputs;
+
+	public:
+		void operator () ( UINT first, UINT last ) const
+		{
+			for( UINT i = first; i < last; i++ )
+			{
+				broadphase->TraceBox( inputs[i], outputs[i] );
+			}
+		}
+	};
+
+}//namespace
+
 /*
 -----------------------------------------------------------------------------
 	pxWorldCreationInfo
@@ -27,6 +127,8 @@ void pxWorldCreationInfo::setDefaults()
 	constraintSolver = nil;
 
 	gravity = pxVec3( 0.0f, -Physik::EARTH_GRAVITY, 0.0f );
+
+	jobQueue = GetGlobalJobQueue();
 }
 
 bool pxWorldCreationInfo::isOk() const
@@ -55,6 +157,8 @@ pxWorld::pxWorld( const pxWorldCreationInfo& worldDesc )
 
 	m_gravityAcceleration = worldDesc.gravity;
 
+	m_jobQueue = worldDesc.jobQueue;
+
 	m_timeAccumulator = 0.0f;
 }
 
@@ -86,7 +190,19 @@ pxWorld::~pxWorld()
 //
 void pxWorld::CastRay( const WorldRayCastInput& input, WorldRayCastOutput &output )
 {
-	Unimplemented;
+	m_collisionBroadphase->CastRay( input, output );
+}
+
+void pxWorld::CastRays( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays )
+{
+	PX_PROFILE("Batched ray casts");
+
+	CastRayBatch	castRays;
+	castRays.broadphase = m_collisionBroadphase;
+	castRays.inputs = inputs;
+	castRays.outputs = outputs;
+
+	ParallelFor( m_jobQueue, 0, numRays, PX_RAY_BATCH_GRAIN_SIZE, castRays );
 }
 
 //void pxWorld::LinearCast( const ConvexCastInput& input, ConvexCastOutput &output )
@@ -99,6 +215,18 @@ void pxWorld::TraceBox( const TraceBoxInput& input, TraceBoxOutput &output )
 	m_collisionBroadphase->TraceBox( input, output );
 }
 
+void pxWorld::TraceBoxes( const TraceBoxInput* inputs, TraceBoxOutput* outputs, UINT numBoxes )
+{
+	PX_PROFILE("Batched box traces");
+
+	TraceBoxBatch	traceBoxes;
+	traceBoxes.broadphase = m_collisionBroadphase;
+	traceBoxes.inputs = inputs;
+	traceBoxes.outputs = outputs;
+
+	ParallelFor( m_jobQueue, 0, numBoxes, 0, traceBoxes );
+}
+
 pxRigidBody::Handle pxWorld::AddRigidBody( const pxRigidBodyInfo& cInfo )
 {
 	const pxRigidBody::Handle hNewRigidBody = m_rigidBodies.Add();
@@ -189,29 +317,14 @@ void pxWorld::TickInternal( pxReal deltaTime )
 
 	// apply external forces, integrate velocities, predict unconstrained motion
 	{
-		const UINT numRigidBodies = m_rigidBodies.Num();
-		pxRigidBody* rigidBodies = m_rigidBodies.ToPtr();
-
-		for( UINT iBody = 0; iBody < numRigidBodies; iBody++ )
-		{
-			pxRigidBody * body = rigidBodies + iBody;
+		PX_SCOPED_COUNTER(gPhysStats.integrateMs);
 
-			// apply external forces (such as gravity)
-			//if( ! body->IsStatic() )
-			{
-				pxVec3 gravityForce = m_gravityAcceleration * body->GetMass();
-				body->ApplyCentralForce( gravityForce );
-			}
+		IntegrateBodies	integrateBodies;
+		integrateBodies.bodies = m_rigidBodies.ToPtr();
+		integrateBodies.gravityAcceleration = m_gravityAcceleration;
+		integrateBodies.deltaTime = deltaTime;
 
-			// integrate velocities
-			body->IntegrateVelocities( deltaTime );
-			body->ClampVelocities( deltaTime );
-			body->ApplyDamping( deltaTime );
-
-			// integrate transforms, predict positions
-			body->IntegratePositions( deltaTime );
-			body->UpdateWorldInertiaTensor();
-		}
+		ParallelFor( m_jobQueue, 0, m_rigidBodies.Num(), 0, integrateBodies );
 	}
 
 	// perform collision detection and generate contacts
@@ -234,6 +347,7 @@ void pxWorld::TickInternal( pxReal deltaTime )
 		//	solverInput.constraints = mActiveConstraints.Ptr();
 		//	solverInput.numConstraints = mActiveConstraints.Num();
 		solverInput.contacts = &m_contactCache;
+		solverInput.jobQueue = m_jobQueue;
 
 		m_constraintSolver->Solve( solverInput, solverOutput );
 	}
@@ -244,6 +358,19 @@ void pxWorld::TickInternal( pxReal deltaTime )
 	}
 }
 
+void pxWorld::BenchmarkSolver( UINT numRuns, pxSolverBenchmark &results )
+{
+	pxSolverInput	solverInput;
+
+	solverInput.deltaTime = PX_DEFAULT_FIXED_STEP_SIZE;
+	solverInput.bodies = m_rigidBodies.ToPtr();
+	solverInput.numBodies = m_rigidBodies.Num();
+	solverInput.contacts = &m_contactCache;
+	solverInput.jobQueue = m_jobQueue;
+
+	pxBenchmarkConstraintSolver( *m_constraintSolver, solverInput, numRuns, results );
+}
+
 void pxWorld::Collide()
 {
 	PX_PROFILE("Collision detection");
@@ -265,17 +392,11 @@ void pxWorld::IntegrateTransforms( pxReal deltaTime )
 	PX_PROFILE("pxWorld::IntegrateTransforms");
 	PX_SCOPED_COUNTER(gPhysStats.integrateMs);
 
-	const UINT numRigidBodies = m_rigidBodies.Num();
-	pxRigidBody* rigidBodies = m_rigidBodies.ToPtr();
-
-	for( UINT iBody = 0; iBody < numRigidBodies; iBody++ )
-	{
-		pxRigidBody * body = rigidBodies + iBody;
+	IntegrateBodyTransforms	integrateTransforms;
+	integrateTransforms.bodies = m_rigidBodies.ToPtr();
+	integrateTransforms.deltaTime = deltaTime;
 
-		// advance positions
-		body->IntegratePositions( deltaTime );
-		body->UpdateWorldInertiaTensor();
-	}
+	ParallelFor( m_jobQueue, 0, m_rigidBodies.Num(), 0, integrateTransforms );
 }
 
 void pxWorld::Clear()
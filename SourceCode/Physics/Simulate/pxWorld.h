@@ -10,13 +10,13 @@
 
 #include <Core/Memory.h>
 
+class AsyncJobQueue;
 
 // size of fixed time step - ~60 Hz
 #define PX_DEFAULT_FIXED_STEP_SIZE (1.0f/60.0f)
 
 enum { PX_MAX_COLLIDEABLES = 512*2 };
-// temporary workaround until we have rigid body dynamics
-enum { PX_MAX_RIGID_BODIES = /*512**/2 };
+enum { PX_MAX_RIGID_BODIES = 4096 };
 
 
 // NOTE: pxCollideable structs are not moved in memory (they're usually accessed randomly);
@@ -47,6 +47,9 @@ public:
 
 	pxF4	gravity;	// for faking friction
 
+	// independent simulation islands are solved in parallel (optional)
+	AsyncJobQueue *	jobQueue;
+
 public:
 	pxSolverInput()
 	{
@@ -62,6 +65,8 @@ public:
 		contacts = nil;
 
 		gravity = 10.0f;
+
+		jobQueue = nil;
 	}
 	bool isOk() const
 	{
@@ -82,6 +87,8 @@ public:
 */
 struct pxWorldCreationInfo
 {
+	// pxBroadphase_BVH suits large worlds with many moving objects,
+	// pxBroadphase_SAS is cheaper for mostly static scenes with slow movers
 	pxBroadphase *			broadphase;
 	pxCollisionDispatcher *	dispatcher;
 
@@ -89,6 +96,9 @@ struct pxWorldCreationInfo
 
 	pxVec3	gravity;	// gravity acceleration
 
+	// used for multithreaded simulation, can be null
+	AsyncJobQueue *	jobQueue;
+
 public:
 	pxWorldCreationInfo()
 	{
@@ -127,6 +137,12 @@ public:
 
 	void TraceBox( const TraceBoxInput& input, TraceBoxOutput &output );
 
+	// Batched queries, the batch is split across worker threads.
+	// Coherent rays should be adjacent in the batch.
+	// These mustn't be called while the world is being stepped.
+	void CastRays( const WorldRayCastInput* inputs, WorldRayCastOutput* outputs, UINT numRays );
+	void TraceBoxes( const TraceBoxInput* inputs, TraceBoxOutput* outputs, UINT numBoxes );
+
 	// Rigid body simulation
 
 	pxRigidBody::Handle AddRigidBody( const pxRigidBodyInfo& cInfo );
@@ -148,6 +164,9 @@ public:
 
 	pxConstraintSolver* GetSolver() {return m_constraintSolver;}
 
+	// measures constraint solver throughput on the current contacts, doesn't change the simulation state
+	void BenchmarkSolver( UINT numRuns, pxSolverBenchmark &results );
+
 	void DebugDraw( pxDebugDrawer* renderer );
 
 public_internal:
@@ -171,10 +190,12 @@ private:
 
 	TPtr< pxConstraintSolver >		m_constraintSolver;
 
+	AsyncJobQueue *		m_jobQueue;
+
 	pxVec3	m_gravityAcceleration;
 	pxReal	m_timeAccumulator;	// delta time accumulated across previous frames
 
-	// non-sleeping bodies
+	// all rigid bodies, sleeping ones are skipped by the simulation
 	RigidBodyList	m_rigidBodies;
 
 private:	PREVENT_COPY(pxWorld);
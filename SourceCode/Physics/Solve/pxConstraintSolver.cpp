@@ -18,6 +18,87 @@ pxConstraintSolver::pxConstraintSolver() {
 pxConstraintSolver::~pxConstraintSolver() {
 }
 
+//----------------------------------------------------------------
+
+static pxReal MeasureSolverIterationsPerSecond(
+	pxConstraintSolver& solver,
+	pxSolverInput& input,
+	const pxRigidBody* savedBodies,
+	pxUInt numRuns
+	)
+{
+	pxSolverOutput	output;
+
+	pxUInt totalIterations = 0;
+	unsigned long totalMicroseconds = 0;
+
+	mxTimer	timer;
+
+	for( pxUInt iRun = 0; iRun < numRuns; iRun++ )
+	{
+		MemCopy( input.bodies, savedBodies, input.numBodies * sizeof(pxRigidBody) );
+
+		timer.Reset();
+		solver.Solve( input, output );
+		totalMicroseconds += timer.GetTimeMicroseconds();
+
+		totalIterations += solver.GetStats().numIterations;
+	}
+
+	MemCopy( input.bodies, savedBodies, input.numBodies * sizeof(pxRigidBody) );
+
+	if( !totalMicroseconds ) {
+		return 0.0f;
+	}
+	return pxReal( totalIterations ) * 1e6f / pxReal( totalMicroseconds );
+}
+
+void pxBenchmarkConstraintSolver(
+	pxConstraintSolver& solver,
+	pxSolverInput& input,
+	pxUInt numRuns,
+	pxSolverBenchmark &results
+	)
+{
+	Assert(input.isOk());
+	Assert(numRuns > 0);
+
+	const SizeT bodiesSize = input.numBodies * sizeof(pxRigidBody);
+	pxRigidBody* savedBodies = (pxRigidBody*) mxAllocX( EMemHeap::HeapTemp, bodiesSize );
+	MemCopy( savedBodies, input.bodies, bodiesSize );
+
+	pxSolverSettings & settings = solver.Settings();
+	const bool oldBatchRows = settings.batchRows;
+	const bool oldWarmStarting = settings.warmStarting;
+	const bool oldAllowSleeping = settings.allowSleeping;
+
+	// otherwise each run would start with the solution of the previous one
+	settings.warmStarting = false;
+	settings.allowSleeping = false;
+
+	settings.batchRows = false;
+	results.scalarIterationsPerSecond = MeasureSolverIterationsPerSecond( solver, input, savedBodies, numRuns );
+
+	settings.batchRows = true;
+	results.batchedIterationsPerSecond = MeasureSolverIterationsPerSecond( solver, input, savedBodies, numRuns );
+
+	settings.batchRows = oldBatchRows;
+	settings.warmStarting = oldWarmStarting;
+	settings.allowSleeping = oldAllowSleeping;
+
+	results.speedup = (results.scalarIterationsPerSecond > 0.0f)
+		? results.batchedIterationsPerSecond / results.scalarIterationsPerSecond
+		: 0.0f
+		;
+
+	mxFreeX( EMemHeap::HeapTemp, savedBodies );
+
+	DBGOUT("Solver benchmark (%u constraints, %u islands): scalar: %.1f iterations/sec, SIMD batched: %.1f iterations/sec (x%.2f)\n",
+		(UINT)solver.GetStats().numConstraints, (UINT)solver.GetStats().numIslands,
+		results.scalarIterationsPerSecond, results.batchedIterationsPerSecond, results.speedup
+		);
+}
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
@@ -30,6 +30,16 @@ public:
 	pxUInt			minIterations;// early exit is only allowed after a certain minimum iteration count
 	pxUInt			maxIterations;// to prevent infinite looping
 
+	// solve independent constraint rows four at a time using SIMD instructions
+	bool			batchRows;
+
+	// start with accumulated impulses of persistent contact points from the previous step
+	// (needs about half as many iterations as starting from scratch)
+	bool			warmStarting;
+
+	// deactivate groups of touching bodies which have been resting for a while
+	bool			allowSleeping;
+
 public:
 	pxSolverSettings()
 	{
@@ -42,8 +52,12 @@ public:
 		slop = 0.01f;//0.005f;
 
 		precision = 0.01f;
-		minIterations = 4;
-		maxIterations = 8;
+		minIterations = 2;
+		maxIterations = 4;
+
+		batchRows = false;
+		warmStarting = true;
+		allowSleeping = true;
 	}
 	bool isOk() const
 	{
@@ -63,7 +77,9 @@ public:
 class pxSolverStats {
 public:
 	pxUInt	numConstraints;	// number of constraints solved
-	pxUInt	numIterations;	// number of iterations performed
+	pxUInt	numIterations;	// number of iterations performed (max. over all islands)
+	pxUInt	numIslands;		// number of simulation islands
+	pxUInt	numSleepingBodies;	// number of deactivated bodies
 
 public:
 	pxSolverStats() {
@@ -72,6 +88,8 @@ public:
 	void Reset() {
 		numConstraints = 0;
 		numIterations = 0;
+		numIslands = 0;
+		numSleepingBodies = 0;
 	}
 };
 
@@ -97,6 +115,25 @@ protected_internal:
 	pxSolverStats		mStats;
 };
 
+//
+//	pxSolverBenchmark
+//
+struct pxSolverBenchmark
+{
+	pxReal	scalarIterationsPerSecond;	// with pxSolverSettings::batchRows off
+	pxReal	batchedIterationsPerSecond;	// with pxSolverSettings::batchRows on
+	pxReal	speedup;	// batched / scalar
+};
+
+// Runs the solver on the same input with and without SIMD batching and measures throughput.
+// Bodies are restored after each run.
+void pxBenchmarkConstraintSolver(
+	pxConstraintSolver& solver,
+	pxSolverInput& input,
+	pxUInt numRuns,
+	pxSolverBenchmark &results
+);
+
 #endif // !__PX_CONSTRAINT_SOLVER_H__
 
 //--------------------------------------------------------------//
@@ -9,6 +9,8 @@
 #pragma hdrstop
 #include <Physics.h>
 
+#include <Base/JobSystem/ParallelFor.h>
+
 // We need to solve 'J*B*lambda = rhs' for 'lambda' (given initial 'lambda0'),
 // where
 // lamda - vector of Lagrange multipliers that we solve for (each lambda can be bounded by lower and higher limits),
@@ -28,8 +30,6 @@
 #define ALLOC( num )	(pxReal*)mxStackAlloc16( (num) * sizeof(pxReal) )
 #define ALLOC2(typ,num)	(typ*)mxStackAlloc16((num) * sizeof(typ))
 
-#define PX_SOLVER_INFINITY	9e6f
-
 #define STAT(x)
 
 #define ENSURE(x)
@@ -42,7 +42,7 @@
 // 2 - looks ok, but slower
 static const unsigned gNumFrictionDirections = 2;
 
-static const bool gUseWarmstarting = 0;
+// accumulated impulses are scaled by this factor when warm starting is enabled
 static const pxReal gWarmstartingFactor = 1.0f;
 PX_WHY("which values are the best?");
 static const pxReal gInitialLambda = 0.1f;	// used as initial guess when warmstarting is disabled
@@ -148,8 +148,9 @@ void DampBodyVelocities( pxVec3& linearVelocity, pxVec3& angularVelocity, pxReal
 //
 pxUInt pxConstraintSolver_PGS::BuildSingleContactConstraint(
 	const pxSolverInput& input,
-	const pxContactPoint& contact,
+	pxManifoldPoint& contact,
 	pxRigidBody* oA, pxRigidBody* oB,
+	pxU4 indexA, pxU4 indexB,	// indices into the velocity accumulator
 	pxReal frictionLimit,
 	pxReal restitution,
 	pxSolverConstraint* constraints,	// array of constraint rows
@@ -163,9 +164,6 @@ pxUInt pxConstraintSolver_PGS::BuildSingleContactConstraint(
 
 	pxUInt numJacobianRows = 0;	//« this value is returned from the function
 
-	const pxU4 indexA = oA->m_solverIndex;
-	const pxU4 indexB = oB->m_solverIndex;
-
 	// positions of contact points with respect to body PORs
 	const pxVec3 rA( contact.position - oA->GetCenterOfMassPosition() );
 	const pxVec3 rB( contact.position - oB->GetCenterOfMassPosition() );
@@ -282,10 +280,12 @@ pxUInt pxConstraintSolver_PGS::BuildSingleContactConstraint(
 	);
 
 	// start with initial guess - set initial values of 'lamda'
-	if( gUseWarmstarting ) {
-		// nothing
+	if( mSettings.warmStarting ) {
+		contactConstraint.lambda = contact.normalImpulse * gWarmstartingFactor;
+		contactConstraint.accumulatedImpulse = &contact.normalImpulse;
 	} else {
 		contactConstraint.lambda = gInitialLambda;
+		contactConstraint.accumulatedImpulse = nil;
 	}
 
 	contactConstraint.iA = indexA;
@@ -325,7 +325,6 @@ pxUInt pxConstraintSolver_PGS::BuildSingleContactConstraint(
 		friction_constraint_1.hi		= +frictionLimit;
 //		friction_constraint_1.cfm		= 0.0f;
 		friction_constraint_1.rhs		= ComputeRhs( friction_constraint_1.J, friction_constraint_1.B, 0.0f/*bias*/, invDeltaTime, oA, oB );
-		friction_constraint_1.lambda	= 0.0f;
 		friction_constraint_1.iA		= indexA;
 		friction_constraint_1.iB		= indexB;
 
@@ -341,9 +340,22 @@ pxUInt pxConstraintSolver_PGS::BuildSingleContactConstraint(
 		friction_constraint_2.hi		= +frictionLimit;
 //		friction_constraint_2.cfm		= 0.0f;
 		friction_constraint_2.rhs		= ComputeRhs( friction_constraint_2.J, friction_constraint_2.B, 0.0f/*bias*/, invDeltaTime, oA, oB );
-		friction_constraint_2.lambda	= 0.0f;
 		friction_constraint_2.iA		= indexA;
 		friction_constraint_2.iB		= indexB;
+
+		// friction directions depend only on the contact normal
+		// so they don't change much between steps and can be warm started, too
+		if( mSettings.warmStarting ) {
+			friction_constraint_1.lambda = clampf( contact.frictionImpulse[0] * gWarmstartingFactor, -frictionLimit, +frictionLimit );
+			friction_constraint_1.accumulatedImpulse = &contact.frictionImpulse[0];
+			friction_constraint_2.lambda = clampf( contact.frictionImpulse[1] * gWarmstartingFactor, -frictionLimit, +frictionLimit );
+			friction_constraint_2.accumulatedImpulse = &contact.frictionImpulse[1];
+		} else {
+			friction_constraint_1.lambda = 0.0f;
+			friction_constraint_1.accumulatedImpulse = nil;
+			friction_constraint_2.lambda = 0.0f;
+			friction_constraint_2.accumulatedImpulse = nil;
+		}
 	}
 	else if( gNumFrictionDirections == 1 )
 	{
@@ -374,6 +386,8 @@ pxUInt pxConstraintSolver_PGS::BuildSingleContactConstraint(
 		friction_constraint.lambda	= 0.0f;
 		friction_constraint.iA		= indexA;
 		friction_constraint.iB		= indexB;
+		// the direction of relative velocity changes every step, don't warm start
+		friction_constraint.accumulatedImpulse = nil;
 	}
 L_End:
 	return numJacobianRows;
@@ -381,23 +395,21 @@ L_End:
 
 //----------------------------------------------------------------
 
-void pxConstraintSolver_PGS::SetupContactConstraints( const pxSolverInput& input )
+pxUInt pxConstraintSolver_PGS::SetupContactConstraints(
+	const pxSolverInput& input,
+	const pxSimulationIsland& island,
+	pxSolverConstraint* constraints
+	)
 {
-	// 3 because we set 1 constraint to ensure non-penetration
-	// and max. 2 constraints for two friction directions.
-	const pxUInt maxConstraints = input.contacts->totalNumContacts * 3;
-	mConstraints.Reserve( maxConstraints );
-//	MemSet(mConstraints.ToPtr(),0,maxConstraints*sizeof(pxSolverConstraint));
-
 	pxUInt numConstraints = 0;
 
-	const pxUInt numManifolds = input.contacts->numManifolds;
+	const pxUInt lastManifold = island.firstManifold + island.numManifolds;
 
-	for(pxUInt iManifold = 0;
-		iManifold < numManifolds;
+	for(pxUInt iManifold = island.firstManifold;
+		iManifold < lastManifold;
 		iManifold++)
 	{
-		const pxContactManifold* manifold = input.contacts->manifolds[ iManifold ];
+		pxContactManifold* manifold = mIslands.GetManifold( iManifold );
 
 		const pxUInt numPoints = manifold->numPoints;
 
@@ -409,7 +421,9 @@ void pxConstraintSolver_PGS::SetupContactConstraints( const pxSolverInput& input
 		pxRigidBody * oA = c_cast(pxRigidBody*) manifold->oA;
 		pxRigidBody * oB = c_cast(pxRigidBody*) manifold->oB;
 
-		//Assert(oA->IsMovable());
+		// static bodies are mapped to the island's own slot so that islands don't write to shared memory
+		const pxU4 indexA = oA->IsMovable() ? oA->m_solverIndex : island.fixedBodySlot;
+		const pxU4 indexB = oB->IsMovable() ? oB->m_solverIndex : island.fixedBodySlot;
 
 		const pxMaterial & materialA = Physics::GetMaterial( oA->m_material );
 		const pxMaterial & materialB = Physics::GetMaterial( oB->m_material );
@@ -439,19 +453,20 @@ void pxConstraintSolver_PGS::SetupContactConstraints( const pxSolverInput& input
 			iContact < numPoints;
 			iContact++ )
 		{
-			const pxContactPoint & contact = manifold->points[ iContact ];
+			pxManifoldPoint & contact = manifold->points[ iContact ];
 
 			const pxReal frictionLimit = friction * frictionMultiplier;
 
 			numConstraints += BuildSingleContactConstraint(
 				input, contact, oA, oB,
+				indexA, indexB,
 				frictionLimit, restitution,
-				mConstraints.ToPtr(), numConstraints
+				constraints, numConstraints
 				);
 		}
 	}
 
-	mConstraints.SetNum( numConstraints );
+	return numConstraints;
 }
 
 //----------------------------------------------------------------
@@ -496,6 +511,37 @@ pxReal SolveSingleConstraintRow(
 
 //----------------------------------------------------------------
 
+namespace
+{
+	struct SolveIslands
+	{
+		pxConstraintSolver_PGS *	solver;
+		const pxSolverInput *		input;
+
+	public:
+		void operator () ( UINT firstIsland, UINT lastIsland ) const
+		{
+			for( UINT iIsland = firstIsland; iIsland < lastIsland; iIsland++ )
+			{
+				solver->SolveIsland( *input, iIsland );
+			}
+		}
+	};
+
+	struct UpdateBodyVelocities
+	{
+		pxConstraintSolver_PGS *	solver;
+		const pxSolverInput *		input;
+
+	public:
+		void operator () ( UINT firstBody, UINT lastBody ) const
+		{
+			solver->UpdateVelocities( *input, firstBody, lastBody );
+		}
+	};
+
+}//namespace
+
 void pxConstraintSolver_PGS::Solve( pxSolverInput& input, pxSolverOutput& output )
 {
 	Assert(input.isOk());
@@ -514,55 +560,113 @@ void pxConstraintSolver_PGS::Solve( pxSolverInput& input, pxSolverOutput& output
 	// number all bodies in the body list - set their tag values
 	for( pxUInt iBody = 0; iBody < nb; iBody++ )
 	{
-		PX_OPTIMIZE("use separate VelocityAccumulators/SolverRigidBodies; fuse this loop with the other;");
 		input.bodies[ iBody ].m_solverIndex = iBody;
 	}
 
-	const pxUInt oldNumConstraints = mConstraints.Num();
+	// split the contact graph into independent groups of bodies
 
-	mConstraints.Empty();
+	mIslands.Build( input.bodies, nb, *input.contacts );
 
-	// build contact constraints
+	const pxUInt numIslands = mIslands.NumIslands();
 
-	this->SetupContactConstraints( input );
+	// reserve constraint rows for each island:
+	// 3 because we set 1 constraint to ensure non-penetration
+	// and max. 2 constraints for two friction directions.
+	mIslandConstraints.SetNum( numIslands );
 
+	pxUInt maxConstraints = 0;
+	for( pxUInt iIsland = 0; iIsland < numIslands; iIsland++ )
+	{
+		pxIslandConstraints & islandConstraints = mIslandConstraints[ iIsland ];
+		islandConstraints.firstRow = maxConstraints;
+		islandConstraints.numRows = 0;
+		islandConstraints.numIterations = 0;
 
-	// number of constraints = total number of rows in jacobian
-	// (number of constrained degrees of freedom or total constraint dimension)
-	const pxUInt numConstraintRows = (pxUInt)mConstraints.Num();
+		maxConstraints += mIslands.GetIsland( iIsland ).numContacts * 3;
+	}
 
-	if( ! numConstraintRows ) {
-		return;
+	mConstraints.SetNum( maxConstraints );
+
+	// Fill in 'velocity accumulator': a = Sum( B * lambda ).
+	const pxUInt numAccumulators = nb + numIslands;
+	mVelocityAccumulators.SetNum( numAccumulators );
+	MemSet( mVelocityAccumulators.ToPtr(), 0, sizeof(pxAVector) * numAccumulators );
+
+	if( mSettings.batchRows )
+	{
+		// in the worst case every row goes into its own batch
+		mBatches.SetNum( maxConstraints );
+		mBodyBatch.SetNum( nb );
+		MemSet( mBodyBatch.ToPtr(), 0, sizeof(pxU4) * nb );
 	}
 
-	//DBGOUT("Solving %u constraints\n",numConstraintRows);
+	{
+		PX_PROFILE("Solve constraints");
 
-	mStats.numConstraints = numConstraintRows;
+		SolveIslands	solveIslands;
+		solveIslands.solver = this;
+		solveIslands.input = &input;
 
+		// islands vary greatly in size so distribute them one by one
+		ParallelFor( input.jobQueue, 0, numIslands, 1, solveIslands );
+	}
 
-	if( gUseWarmstarting )
+	mStats.Reset();
+	mStats.numIslands = numIslands;
+	for( pxUInt iIsland = 0; iIsland < numIslands; iIsland++ )
 	{
-		if( numConstraintRows > oldNumConstraints ) {
-			//const mxUInt numAddedConstraints = numConstraintRows - oldNumConstraints;
-			for( pxUInt iConstraint = oldNumConstraints; iConstraint < numConstraintRows; iConstraint++ )
-			{
-				pxSolverConstraint & constraint = mConstraints[ iConstraint ];
-				constraint.lambda = gInitialLambda;
-			}
-		}
+		const pxIslandConstraints & islandConstraints = mIslandConstraints[ iIsland ];
+		mStats.numConstraints += islandConstraints.numRows;
+		mStats.numIterations = largest( mStats.numIterations, islandConstraints.numIterations );
+	}
+
+	//DBGOUT("Solved %u constraints in %u islands (%u iterations)\n",
+	//	(UINT)mStats.numConstraints, (UINT)mStats.numIslands, (UINT)mStats.numIterations
+	//	);
+
+	// compute the velocity update, apply impulse to each body
+	{
+		UpdateBodyVelocities	updateVelocities;
+		updateVelocities.solver = this;
+		updateVelocities.input = &input;
+
+		ParallelFor( input.jobQueue, 0, nb, 0, updateVelocities );
+	}
+
+	// deactivate resting groups of bodies
+	if( mSettings.allowSleeping )
+	{
+		mStats.numSleepingBodies = mIslands.UpdateSleeping( input.bodies, nb, input.deltaTime );
 	}
+}
 
+//----------------------------------------------------------------
 
-	PX_PROFILE("Solve constraints");
+void pxConstraintSolver_PGS::SolveIsland( const pxSolverInput& input, pxUInt islandIndex )
+{
+	const pxSimulationIsland & island = mIslands.GetIsland( islandIndex );
+	pxIslandConstraints & islandConstraints = mIslandConstraints[ islandIndex ];
 
+	pxSolverConstraint * constraints = mConstraints.ToPtr() + islandConstraints.firstRow;
 
-	// Fill in 'velocity accumulator': a = Sum( B * lambda ).
-	pxAVector * vA = ALLOC2(pxAVector,nb);
-	MemSet( vA, 0, sizeof(pxAVector)*nb);
+	// build contact constraints
+
+	// number of constraints = total number of rows in jacobian
+	// (number of constrained degrees of freedom or total constraint dimension)
+	const pxUInt numConstraintRows = this->SetupContactConstraints( input, island, constraints );
+
+	islandConstraints.numRows = numConstraintRows;
+
+	if( ! numConstraintRows ) {
+		return;
+	}
+
+	// islands don't share movable bodies, static bodies use the island's own slot
+	pxAVector * vA = mVelocityAccumulators.ToPtr();
 
 	for( pxUInt iConstraint = 0; iConstraint < numConstraintRows; iConstraint++ )
 	{
-		pxSolverConstraint & constraint = mConstraints[ iConstraint ];
+		pxSolverConstraint & constraint = constraints[ iConstraint ];
 
 		// Erin Catto:
 		// Stability for joints can be improved further by relaxing the lambdas. Before beginning the PGS iterations,
@@ -579,6 +683,33 @@ void pxConstraintSolver_PGS::Solve( pxSolverInput& input, pxSolverOutput& output
 	}
 
 
+	if( mSettings.batchRows )
+	{
+		pxSolverBatch * batches = mBatches.ToPtr() + islandConstraints.firstRow;
+
+		islandConstraints.numIterations = this->SolveConstraintBatches( island, constraints, numConstraintRows, batches, vA );
+	}
+	else
+	{
+		islandConstraints.numIterations = this->SolveConstraintRows( constraints, numConstraintRows, vA );
+	}
+
+	// save the solution for warm starting the next step
+	// (contact points of each manifold belong to a single island)
+	for( pxUInt iConstraint = 0; iConstraint < numConstraintRows; iConstraint++ )
+	{
+		const pxSolverConstraint & constraint = constraints[ iConstraint ];
+
+		if( constraint.accumulatedImpulse ) {
+			*constraint.accumulatedImpulse = constraint.lambda;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+
+pxUInt pxConstraintSolver_PGS::SolveConstraintRows( pxSolverConstraint* constraints, pxUInt numConstraintRows, pxAVector* vA )
+{
 	pxUInt iteration = 0;	// iteration counter
 
 	// Kenny Erleben:
@@ -590,7 +721,7 @@ void pxConstraintSolver_PGS::Solve( pxSolverInput& input, pxSolverOutput& output
 	{
 		for( pxUInt iConstraint = 0; iConstraint < numConstraintRows; iConstraint++ )
 		{
-			pxSolverConstraint & constraint = mConstraints[ iConstraint ];
+			pxSolverConstraint & constraint = constraints[ iConstraint ];
 
 			SolveSingleConstraintRow( constraint, vA );
 		}
@@ -607,7 +738,7 @@ void pxConstraintSolver_PGS::Solve( pxSolverInput& input, pxSolverOutput& output
 
 		for( pxUInt iConstraint = 0; iConstraint < numConstraintRows; iConstraint++ )
 		{
-			pxSolverConstraint & constraint = mConstraints[ iConstraint ];
+			pxSolverConstraint & constraint = constraints[ iConstraint ];
 
 			const pxReal deltaLambda = SolveSingleConstraintRow( constraint, vA );
 
@@ -617,18 +748,23 @@ void pxConstraintSolver_PGS::Solve( pxSolverInput& input, pxSolverOutput& output
 		++iteration;
 	}
 
-	mStats.numIterations = iteration;
+	return iteration;
+}
 
-	//DBGOUT("Solved %u constraints (%u iterations)\n",
-	//	(UINT)mStats.numConstraints, (UINT)mStats.numIterations
-	//	);
+//----------------------------------------------------------------
 
-	// compute the velocity update, apply impulse to each body
+void pxConstraintSolver_PGS::UpdateVelocities( const pxSolverInput& input, pxUInt firstBody, pxUInt lastBody )
+{
+	const pxAVector * vA = mVelocityAccumulators.ToPtr();
 
-	for( pxUInt iBody = 0; iBody < nb; iBody++ )
+	for( pxUInt iBody = firstBody; iBody < lastBody; iBody++ )
 	{
 		pxRigidBody* body = &input.bodies[ iBody ];
 
+		if( body->IsSleeping() ) {
+			continue;
+		}
+
 #if 1
 		// Fix-point-iteration algorithm:
 		// V2 = V1 + M^-1 * ( J^T * lambda + Fext * dt )
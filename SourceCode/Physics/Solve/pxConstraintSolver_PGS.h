@@ -63,14 +63,53 @@ MX_ALIGN_64(struct) pxSolverConstraint
 
 	pxU4			iA;	//4 index of the first body
 	pxU4			iB;	//4 index of the second body
-	//total: 160 bytes (aligned to 176 bytes), 128 bytes without padding
+
+	pxReal *		accumulatedImpulse;	//4/8 the solution is stored here for warm starting the next step, can be null
+	//total: 168 bytes (aligned to 192 bytes)
 };
 
 typedef TList< pxSolverConstraint >	pxConstraintArray;
 
+#define PX_SOLVER_INFINITY	9e6f
+
+enum { PX_SOLVER_BATCH_SIZE = 4 };
+
+//
+//	pxSolverBatch - four constraint rows in SoA layout, one row per SIMD lane.
+//	Rows in a batch don't share movable bodies so they can be solved simultaneously.
+//
+MX_ALIGN_16(struct) pxSolverBatch
+{
+	pxQuadReal		j0Linear[3], j0Angular[3], j1Linear[3], j1Angular[3];	// J, one vector component per register
+	pxQuadReal		b0Linear[3], b0Angular[3], b1Linear[3], b1Angular[3];	// B = M^-1 * J^T
+	pxQuadReal		invJB;
+	pxQuadReal		lambda;
+	pxQuadReal		lo;
+	pxQuadReal		hi;
+	pxQuadReal		rhs;
+
+	pxU4			iA[ PX_SOLVER_BATCH_SIZE ];	// indices of the first bodies
+	pxU4			iB[ PX_SOLVER_BATCH_SIZE ];	// indices of the second bodies
+	pxU4			rows[ PX_SOLVER_BATCH_SIZE ];	// source constraint rows
+	pxU4			numRows;	// number of used lanes
+};
+
+//
+//	pxIslandConstraints - constraint rows of a single simulation island
+//
+struct pxIslandConstraints
+{
+	pxUInt	firstRow;	// offset into the constraint array
+	pxUInt	numRows;	// number of filled rows
+	pxUInt	numIterations;	// number of solver iterations performed on this island
+};
+
 //
 //	pxConstraintSolver_PGS
 //
+//	Simulation islands don't share movable bodies
+//	and are solved in parallel, each with its own Gauss-Seidel loop.
+//
 class pxConstraintSolver_PGS : public pxConstraintSolver {
 public:
 						pxConstraintSolver_PGS();
@@ -78,13 +117,44 @@ public:
 
 	OVERRIDES(pxConstraintSolver)	void Solve( pxSolverInput& input, pxSolverOutput& output );
 
+public_internal:
+	// builds and solves constraints of the given island, can be called from any thread
+	void SolveIsland( const pxSolverInput& input, pxUInt islandIndex );
+
+	// adds constraint impulses to body velocities
+	void UpdateVelocities( const pxSolverInput& input, pxUInt firstBody, pxUInt lastBody );
+
 private_internal:
-	void SetupContactConstraints( const pxSolverInput& input );
+	// Gauss-Seidel iterations over constraint rows, returns the number of iterations
+	pxUInt SolveConstraintRows( pxSolverConstraint* constraints, pxUInt numRows, pxAVector* vA );
+
+	// SIMD version of the above (see pxConstraintSolver_PGS_SoA.cpp)
+	pxUInt SolveConstraintBatches(
+		const pxSimulationIsland& island,
+		pxSolverConstraint* constraints, pxUInt numRows,
+		pxSolverBatch* batches,
+		pxAVector* vA
+	);
+
+	// packs constraint rows into batches, returns the number of batches
+	pxUInt BuildConstraintBatches(
+		const pxSimulationIsland& island,
+		const pxSolverConstraint* constraints, pxUInt numRows,
+		pxSolverBatch* batches
+	);
+
+	// returns the number of constraint rows
+	pxUInt SetupContactConstraints(
+		const pxSolverInput& input,
+		const pxSimulationIsland& island,
+		pxSolverConstraint* constraints
+	);
 
 	pxUInt BuildSingleContactConstraint(
 		const pxSolverInput& input,
-		const pxContactPoint& contact,
+		pxManifoldPoint& contact,	// accumulated impulses are used for warm starting
 		pxRigidBody* oA, pxRigidBody* oB,
+		pxU4 indexA, pxU4 indexB,	// indices into the velocity accumulator
 		pxReal frictionLimit,
 		pxReal restitution,
 		pxSolverConstraint* constraints,	// array of constraint rows
@@ -95,6 +165,16 @@ private:
 	pxReal		mDeltaTime, mInvDeltaTime;	// Time step information.
 	
 	pxConstraintArray	mConstraints;
+
+	pxIslandBuilder		mIslands;
+	TList< pxIslandConstraints >	mIslandConstraints;
+
+	// a = Sum( B * lambda ), one slot per body + one slot for static bodies in each island
+	TList< pxAVector >	mVelocityAccumulators;
+
+	// used only when the rows are solved in batches:
+	TList< pxSolverBatch >	mBatches;	// each island has 'numRows' batches reserved starting at 'firstRow'
+	TList< pxU4 >	mBodyBatch;	// first batch each body can be placed into
 };
 
 #endif // !__PX_CONSTRAINT_SOLVER_PGS_H__
@@ -0,0 +1,319 @@
+/*
+=============================================================================
+	File:	pxConstraintSolver_PGS_SoA.cpp
+	Desc:	SIMD version of the Projected Gauss-Seidel iterations.
+			Constraint rows are packed into batches of four rows
+			which don't share movable bodies; the rows of each batch
+			are stored in SoA layout and solved with SSE instructions.
+=============================================================================
+*/
+#include <Physics_PCH.h>
+#pragma hdrstop
+#include <Physics.h>
+
+FORCEINLINE static
+void SetLane( pxQuadReal & q, pxUInt lane, pxReal value )
+{
+	((pxReal*)&q)[ lane ] = value;
+}
+
+FORCEINLINE static
+pxReal GetLane( const pxQuadReal& q, pxUInt lane )
+{
+	return ((const pxReal*)&q)[ lane ];
+}
+
+// stores the vector in the given lane, one component per register
+FORCEINLINE static
+void SetLane( pxQuadReal (&xyz)[3], pxUInt lane, const pxVec3& v )
+{
+	SetLane( xyz[0], lane, v.x );
+	SetLane( xyz[1], lane, v.y );
+	SetLane( xyz[2], lane, v.z );
+}
+
+// loads four vectors and transposes them so that each register holds one component of all vectors
+FORCEINLINE static
+void GatherVectors( const pxVec3& v0, const pxVec3& v1, const pxVec3& v2, const pxVec3& v3, pxQuadReal (&xyz)[3] )
+{
+	pxQuadReal r0 = v0.mVec128;
+	pxQuadReal r1 = v1.mVec128;
+	pxQuadReal r2 = v2.mVec128;
+	pxQuadReal r3 = v3.mVec128;
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	xyz[0] = r0;
+	xyz[1] = r1;
+	xyz[2] = r2;
+}
+
+// the inverse of GatherVectors()
+FORCEINLINE static
+void ScatterVectors( const pxQuadReal (&xyz)[3], pxVec3& v0, pxVec3& v1, pxVec3& v2, pxVec3& v3 )
+{
+	pxQuadReal r0 = xyz[0];
+	pxQuadReal r1 = xyz[1];
+	pxQuadReal r2 = xyz[2];
+	pxQuadReal r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+	v0.mVec128 = r0;
+	v1.mVec128 = r1;
+	v2.mVec128 = r2;
+	v3.mVec128 = r3;
+}
+
+// four dot products at once
+FORCEINLINE static
+pxQuadReal Dot3_SoA( const pxQuadReal (&a)[3], const pxQuadReal (&b)[3] )
+{
+	return _mm_add_ps(
+		_mm_add_ps( _mm_mul_ps( a[0], b[0] ), _mm_mul_ps( a[1], b[1] ) ),
+		_mm_mul_ps( a[2], b[2] )
+	);
+}
+
+// v += a * s
+FORCEINLINE static
+void AddScaled_SoA( pxQuadReal (&v)[3], const pxQuadReal (&a)[3], const pxQuadReal& s )
+{
+	v[0] = _mm_add_ps( v[0], _mm_mul_ps( a[0], s ) );
+	v[1] = _mm_add_ps( v[1], _mm_mul_ps( a[1], s ) );
+	v[2] = _mm_add_ps( v[2], _mm_mul_ps( a[2], s ) );
+}
+
+//
+// solves four constraint rows, returns deltaLambda for each row
+//
+static FORCEINLINE
+pxQuadReal SolveConstraintBatch(
+	pxSolverBatch & batch,
+	pxAVector * vA	// accumulator, vector a = Sum( B * lambda ), dim(a) = number of bodies.
+	)
+{
+	pxAVector & a0 = vA[ batch.iA[0] ];
+	pxAVector & a1 = vA[ batch.iA[1] ];
+	pxAVector & a2 = vA[ batch.iA[2] ];
+	pxAVector & a3 = vA[ batch.iA[3] ];
+
+	pxAVector & b0 = vA[ batch.iB[0] ];
+	pxAVector & b1 = vA[ batch.iB[1] ];
+	pxAVector & b2 = vA[ batch.iB[2] ];
+	pxAVector & b3 = vA[ batch.iB[3] ];
+
+	pxQuadReal linearA[3], angularA[3], linearB[3], angularB[3];
+
+	GatherVectors( a0.linear, a1.linear, a2.linear, a3.linear, linearA );
+	GatherVectors( a0.angular, a1.angular, a2.angular, a3.angular, angularA );
+	GatherVectors( b0.linear, b1.linear, b2.linear, b3.linear, linearB );
+	GatherVectors( b0.angular, b1.angular, b2.angular, b3.angular, angularB );
+
+	// sum = Jsp(bodyA) * vA(bodyA) + Jsp(bodyB) * vA(bodyB)
+	const pxQuadReal sum = _mm_add_ps(
+		_mm_add_ps( Dot3_SoA( batch.j0Linear, linearA ), Dot3_SoA( batch.j0Angular, angularA ) ),
+		_mm_add_ps( Dot3_SoA( batch.j1Linear, linearB ), Dot3_SoA( batch.j1Angular, angularB ) )
+	);
+
+	// deltaLambda = (eta - Jsp(bodyA) * vA(bodyA) - Jsp(bodyB) * vA(bodyB)) / Di
+	pxQuadReal deltaLambda = _mm_mul_ps( _mm_sub_ps( batch.rhs, sum ), batch.invJB );
+
+	const pxQuadReal lambda0 = batch.lambda;
+
+	// Projection via clamping: lambda = max( lo, min( lambda0+deltaLambda, hi ).
+	batch.lambda = _mm_min_ps( _mm_max_ps( _mm_add_ps( lambda0, deltaLambda ), batch.lo ), batch.hi );
+
+	deltaLambda = _mm_sub_ps( batch.lambda, lambda0 );
+
+	// vA(bodyA) += deltaLambda * B(bodyA)
+	AddScaled_SoA( linearA, batch.b0Linear, deltaLambda );
+	AddScaled_SoA( angularA, batch.b0Angular, deltaLambda );
+	// vA(bodyB) += deltaLambda * B(bodyB)
+	AddScaled_SoA( linearB, batch.b1Linear, deltaLambda );
+	AddScaled_SoA( angularB, batch.b1Angular, deltaLambda );
+
+	// Unused lanes and static bodies refer to the island's fixed slot,
+	// B is zero for them so the slot stays zero no matter which lane is written last.
+	ScatterVectors( linearA, a0.linear, a1.linear, a2.linear, a3.linear );
+	ScatterVectors( angularA, a0.angular, a1.angular, a2.angular, a3.angular );
+	ScatterVectors( linearB, b0.linear, b1.linear, b2.linear, b3.linear );
+	ScatterVectors( angularB, b0.angular, b1.angular, b2.angular, b3.angular );
+
+	return deltaLambda;
+}
+
+//----------------------------------------------------------------
+
+//
+// Rows are assigned greedily to the first batch which comes after all batches
+// containing their bodies, so each body's rows are still solved in the original order.
+//
+pxUInt pxConstraintSolver_PGS::BuildConstraintBatches(
+	const pxSimulationIsland& island,
+	const pxSolverConstraint* constraints, pxUInt numRows,
+	pxSolverBatch* batches
+	)
+{
+	const pxU4 fixedBodySlot = island.fixedBodySlot;
+
+	// islands don't share movable bodies so this array can be used by several threads at once
+	pxU4 * bodyBatch = mBodyBatch.ToPtr();
+
+	pxUInt numBatches = 0;
+	pxUInt firstOpenBatch = 0;	// all batches before this one are full
+
+	for( pxUInt iRow = 0; iRow < numRows; iRow++ )
+	{
+		const pxSolverConstraint & constraint = constraints[ iRow ];
+
+		const bool movableA = (constraint.iA != fixedBodySlot);
+		const bool movableB = (constraint.iB != fixedBodySlot);
+
+		pxUInt batchIndex = firstOpenBatch;
+		if( movableA ) {
+			batchIndex = largest( batchIndex, bodyBatch[ constraint.iA ] );
+		}
+		if( movableB ) {
+			batchIndex = largest( batchIndex, bodyBatch[ constraint.iB ] );
+		}
+		while( batchIndex < numBatches && batches[ batchIndex ].numRows == PX_SOLVER_BATCH_SIZE ) {
+			batchIndex++;
+		}
+		if( batchIndex == numBatches ) {
+			batches[ numBatches++ ].numRows = 0;
+		}
+
+		pxSolverBatch & batch = batches[ batchIndex ];
+		const pxUInt lane = batch.numRows++;
+		batch.rows[ lane ] = iRow;
+
+		if( movableA ) {
+			bodyBatch[ constraint.iA ] = batchIndex + 1;
+		}
+		if( movableB ) {
+			bodyBatch[ constraint.iB ] = batchIndex + 1;
+		}
+
+		while( firstOpenBatch < numBatches && batches[ firstOpenBatch ].numRows == PX_SOLVER_BATCH_SIZE ) {
+			firstOpenBatch++;
+		}
+	}
+
+	// convert rows to SoA layout
+
+	const pxVec3 zero( 0.0f );
+
+	for( pxUInt iBatch = 0; iBatch < numBatches; iBatch++ )
+	{
+		pxSolverBatch & batch = batches[ iBatch ];
+
+		for( pxUInt lane = 0; lane < PX_SOLVER_BATCH_SIZE; lane++ )
+		{
+			if( lane < batch.numRows )
+			{
+				const pxSolverConstraint & constraint = constraints[ batch.rows[ lane ] ];
+
+				SetLane( batch.j0Linear, lane, constraint.J.j0Linear );
+				SetLane( batch.j0Angular, lane, constraint.J.j0Angular );
+				SetLane( batch.j1Linear, lane, constraint.J.j1Linear );
+				SetLane( batch.j1Angular, lane, constraint.J.j1Angular );
+
+				SetLane( batch.b0Linear, lane, constraint.B.b0Linear );
+				SetLane( batch.b0Angular, lane, constraint.B.b0Angular );
+				SetLane( batch.b1Linear, lane, constraint.B.b1Linear );
+				SetLane( batch.b1Angular, lane, constraint.B.b1Angular );
+
+				SetLane( batch.invJB, lane, constraint.invJB );
+				SetLane( batch.lambda, lane, constraint.lambda );
+				SetLane( batch.lo, lane, constraint.lo );
+				SetLane( batch.hi, lane, constraint.hi );
+				SetLane( batch.rhs, lane, constraint.rhs );
+
+				batch.iA[ lane ] = constraint.iA;
+				batch.iB[ lane ] = constraint.iB;
+			}
+			else
+			{
+				// pad with an empty row which never changes lambda
+				SetLane( batch.j0Linear, lane, zero );
+				SetLane( batch.j0Angular, lane, zero );
+				SetLane( batch.j1Linear, lane, zero );
+				SetLane( batch.j1Angular, lane, zero );
+
+				SetLane( batch.b0Linear, lane, zero );
+				SetLane( batch.b0Angular, lane, zero );
+				SetLane( batch.b1Linear, lane, zero );
+				SetLane( batch.b1Angular, lane, zero );
+
+				SetLane( batch.invJB, lane, 0.0f );
+				SetLane( batch.lambda, lane, 0.0f );
+				SetLane( batch.lo, lane, 0.0f );
+				SetLane( batch.hi, lane, 0.0f );
+				SetLane( batch.rhs, lane, 0.0f );
+
+				batch.iA[ lane ] = fixedBodySlot;
+				batch.iB[ lane ] = fixedBodySlot;
+			}
+		}
+	}
+
+	return numBatches;
+}
+
+//----------------------------------------------------------------
+
+pxUInt pxConstraintSolver_PGS::SolveConstraintBatches(
+	const pxSimulationIsland& island,
+	pxSolverConstraint* constraints, pxUInt numRows,
+	pxSolverBatch* batches,
+	pxAVector* vA
+	)
+{
+	const pxUInt numBatches = this->BuildConstraintBatches( island, constraints, numRows, batches );
+
+	pxUInt iteration = 0;	// iteration counter
+
+	while( iteration < mSettings.minIterations )
+	{
+		for( pxUInt iBatch = 0; iBatch < numBatches; iBatch++ )
+		{
+			SolveConstraintBatch( batches[ iBatch ], vA );
+		}
+
+		++iteration;
+	}
+
+	// used to measure error/convergence, always positive
+	pxReal deltaResidual = PX_SOLVER_INFINITY;
+
+	while( (deltaResidual > mSettings.precision) && (iteration < mSettings.maxIterations) )
+	{
+		pxQuadReal residual = _mm_setzero_ps();
+
+		for( pxUInt iBatch = 0; iBatch < numBatches; iBatch++ )
+		{
+			const pxQuadReal deltaLambda = SolveConstraintBatch( batches[ iBatch ], vA );
+
+			residual = _mm_add_ps( residual, _mm_mul_ps( deltaLambda, deltaLambda ) );
+		}
+
+		deltaResidual = GetLane( residual, 0 ) + GetLane( residual, 1 ) + GetLane( residual, 2 ) + GetLane( residual, 3 );
+
+		++iteration;
+	}
+
+	// copy the solution back to constraint rows
+
+	for( pxUInt iBatch = 0; iBatch < numBatches; iBatch++ )
+	{
+		const pxSolverBatch & batch = batches[ iBatch ];
+
+		for( pxUInt lane = 0; lane < batch.numRows; lane++ )
+		{
+			constraints[ batch.rows[ lane ] ].lambda = GetLane( batch.lambda, lane );
+		}
+	}
+
+	return iteration;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,245 @@
+/*
+=============================================================================
+	File:	pxSimulationIsland.cpp
+	Desc:
+=============================================================================
+*/
+#include <Physics_PCH.h>
+#pragma hdrstop
+#include <Physics.h>
+
+/*================================
+		pxIslandBuilder
+================================*/
+
+pxIslandBuilder::pxIslandBuilder()
+{
+}
+
+pxIslandBuilder::~pxIslandBuilder()
+{
+	this->Clear();
+}
+
+// path halving: every other node on the path is linked to its grandparent
+pxU4 pxIslandBuilder::FindRoot( pxU4 bodyIndex )
+{
+	pxU4 * parent = m_parent.ToPtr();
+	while( parent[ bodyIndex ] != bodyIndex )
+	{
+		parent[ bodyIndex ] = parent[ parent[ bodyIndex ] ];
+		bodyIndex = parent[ bodyIndex ];
+	}
+	return bodyIndex;
+}
+
+// union by size keeps the trees shallow
+void pxIslandBuilder::MergeSets( pxU4 bodyA, pxU4 bodyB )
+{
+	pxU4 rootA = FindRoot( bodyA );
+	pxU4 rootB = FindRoot( bodyB );
+	if( rootA == rootB ) {
+		return;
+	}
+	if( m_setSize[ rootA ] < m_setSize[ rootB ] ) {
+		TSwap( rootA, rootB );
+	}
+	m_parent[ rootB ] = rootA;
+	m_setSize[ rootA ] += m_setSize[ rootB ];
+}
+
+void pxIslandBuilder::Build( pxRigidBody* bodies, pxUInt numBodies, const pxContactCache& contacts )
+{
+	PX_PROFILE("Build simulation islands");
+
+	const pxUInt numManifolds = contacts.numManifolds;
+
+	m_islands.Empty();
+	m_manifolds.Empty();
+
+	m_parent.SetNum( numBodies );
+	m_setSize.SetNum( numBodies );
+	m_rootIsland.SetNum( numBodies );
+	m_setAwake.SetNum( numBodies );
+	m_manifoldIsland.SetNum( numManifolds );
+
+	for( pxUInt iBody = 0; iBody < numBodies; iBody++ )
+	{
+		Assert( bodies[ iBody ].m_solverIndex == iBody );
+		m_parent[ iBody ] = iBody;
+		m_setSize[ iBody ] = 1;
+		m_rootIsland[ iBody ] = INDEX_NONE;
+		m_setAwake[ iBody ] = 0;
+	}
+
+	// connect movable bodies touching each other
+
+	for( pxUInt iManifold = 0; iManifold < numManifolds; iManifold++ )
+	{
+		const pxContactManifold* manifold = contacts.manifolds[ iManifold ];
+		if( !manifold->numPoints ) {
+			continue;
+		}
+
+		const pxRigidBody * oA = c_cast(const pxRigidBody*) manifold->oA;
+		const pxRigidBody * oB = c_cast(const pxRigidBody*) manifold->oB;
+
+		if( oA->IsMovable() && oB->IsMovable() )
+		{
+			MergeSets( oA->m_solverIndex, oB->m_solverIndex );
+		}
+	}
+
+	// wake up sleeping bodies touching awake ones
+	// (sleeping bodies keep their contacts so the whole group wakes up)
+
+	for( pxUInt iBody = 0; iBody < numBodies; iBody++ )
+	{
+		const pxRigidBody & body = bodies[ iBody ];
+		if( body.IsMovable() && !body.IsSleeping() ) {
+			m_setAwake[ FindRoot( iBody ) ] = 1;
+		}
+	}
+	for( pxUInt iBody = 0; iBody < numBodies; iBody++ )
+	{
+		pxRigidBody & body = bodies[ iBody ];
+		if( body.IsSleeping() && m_setAwake[ FindRoot( iBody ) ] ) {
+			body.WakeUp();
+		}
+	}
+
+	// assign island indices and count manifolds in each island
+
+	for( pxUInt iManifold = 0; iManifold < numManifolds; iManifold++ )
+	{
+		m_manifoldIsland[ iManifold ] = INDEX_NONE;
+
+		const pxContactManifold* manifold = contacts.manifolds[ iManifold ];
+		if( !manifold->numPoints ) {
+			continue;
+		}
+
+		const pxRigidBody * oA = c_cast(const pxRigidBody*) manifold->oA;
+		const pxRigidBody * oB = c_cast(const pxRigidBody*) manifold->oB;
+
+		// contacts between two static bodies don't need to be solved
+		const pxRigidBody * movableBody = oA->IsMovable() ? oA : oB;
+		if( !movableBody->IsMovable() ) {
+			continue;
+		}
+
+		// the group of touching bodies is sleeping
+		if( movableBody->IsSleeping() ) {
+			continue;
+		}
+
+		const pxU4 root = FindRoot( movableBody->m_solverIndex );
+
+		pxU4 islandIndex = m_rootIsland[ root ];
+		if( islandIndex == INDEX_NONE )
+		{
+			islandIndex = m_islands.Num();
+			m_rootIsland[ root ] = islandIndex;
+
+			pxSimulationIsland & newIsland = m_islands.Add();
+			newIsland.firstManifold = 0;
+			newIsland.numManifolds = 0;
+			newIsland.numContacts = 0;
+			newIsland.fixedBodySlot = numBodies + islandIndex;
+		}
+
+		pxSimulationIsland & island = m_islands[ islandIndex ];
+		island.numManifolds++;
+		island.numContacts += manifold->numPoints;
+
+		m_manifoldIsland[ iManifold ] = islandIndex;
+	}
+
+	// sort manifolds by islands (counting sort)
+
+	const pxUInt numIslands = m_islands.Num();
+
+	pxUInt numSortedManifolds = 0;
+	for( pxUInt iIsland = 0; iIsland < numIslands; iIsland++ )
+	{
+		pxSimulationIsland & island = m_islands[ iIsland ];
+		island.firstManifold = numSortedManifolds;
+		numSortedManifolds += island.numManifolds;
+		island.numManifolds = 0;
+	}
+
+	m_manifolds.SetNum( numSortedManifolds );
+
+	for( pxUInt iManifold = 0; iManifold < numManifolds; iManifold++ )
+	{
+		const pxU4 islandIndex = m_manifoldIsland[ iManifold ];
+		if( islandIndex == INDEX_NONE ) {
+			continue;
+		}
+		pxSimulationIsland & island = m_islands[ islandIndex ];
+		m_manifolds[ island.firstManifold + island.numManifolds++ ] = contacts.manifolds[ iManifold ];
+	}
+}
+
+pxUInt pxIslandBuilder::UpdateSleeping( pxRigidBody* bodies, pxUInt numBodies, pxReal deltaTime )
+{
+	PX_PROFILE("Update sleeping bodies");
+
+	Assert( m_parent.Num() == numBodies );
+
+	m_setSleepTime.SetNum( numBodies );
+
+	for( pxUInt iBody = 0; iBody < numBodies; iBody++ )
+	{
+		m_setSleepTime[ iBody ] = PX_BIG_NUMBER;
+	}
+
+	// a group can only sleep if all its bodies are resting
+
+	for( pxUInt iBody = 0; iBody < numBodies; iBody++ )
+	{
+		pxRigidBody & body = bodies[ iBody ];
+		if( body.IsStatic() || body.IsSleeping() ) {
+			continue;
+		}
+
+		const pxReal sleepTime = body.UpdateSleepTimer( deltaTime );
+
+		const pxU4 root = FindRoot( iBody );
+		m_setSleepTime[ root ] = smallest( m_setSleepTime[ root ], sleepTime );
+	}
+
+	pxUInt numSleepingBodies = 0;
+
+	for( pxUInt iBody = 0; iBody < numBodies; iBody++ )
+	{
+		pxRigidBody & body = bodies[ iBody ];
+		if( body.IsStatic() ) {
+			continue;
+		}
+
+		if( !body.IsSleeping() && m_setSleepTime[ FindRoot( iBody ) ] >= PX_RB_TIME_TO_SLEEP ) {
+			body.PutToSleep();
+		}
+
+		numSleepingBodies += body.IsSleeping();
+	}
+
+	return numSleepingBodies;
+}
+
+void pxIslandBuilder::Clear()
+{
+	m_parent.Clear();
+	m_setSize.Clear();
+	m_rootIsland.Clear();
+	m_setAwake.Clear();
+	m_setSleepTime.Clear();
+	m_manifoldIsland.Clear();
+	m_islands.Clear();
+	m_manifolds.Clear();
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,86 @@
+/*
+=============================================================================
+	File:	pxSimulationIsland.h
+	Desc:	Simulation islands - groups of bodies connected by contacts.
+			Islands don't share movable bodies and can be solved independently.
+=============================================================================
+*/
+
+#ifndef __PX_SIMULATION_ISLAND_H__
+#define __PX_SIMULATION_ISLAND_H__
+
+//
+//	pxSimulationIsland
+//
+struct pxSimulationIsland
+{
+	pxUInt	firstManifold;	// index of the first contact manifold in the sorted manifold list
+	pxUInt	numManifolds;	// number of contact manifolds in this island
+	pxUInt	numContacts;	// total number of contact points in this island
+
+	// static bodies can touch several islands at once
+	// so they are mapped to a separate slot in each island
+	pxU4	fixedBodySlot;
+};
+
+//
+//	pxIslandBuilder
+//
+//	Finds connected components of the contact graph using union-find.
+//	Static bodies don't connect islands.
+//	Each group of touching bodies is either awake or sleeping as a whole.
+//
+class pxIslandBuilder {
+public:
+	pxIslandBuilder();
+	~pxIslandBuilder();
+
+	// groups contact manifolds into islands;
+	// solver indices of the bodies must be equal to their positions in the 'bodies' array.
+	// sleeping bodies touching awake bodies are woken up,
+	// contacts of sleeping bodies are not added to islands.
+	void Build( pxRigidBody* bodies, pxUInt numBodies, const pxContactCache& contacts );
+
+	// puts to sleep groups of touching bodies which have been resting long enough,
+	// returns the number of sleeping bodies.
+	// this must be called after Build() (with the same bodies and contacts).
+	pxUInt UpdateSleeping( pxRigidBody* bodies, pxUInt numBodies, pxReal deltaTime );
+
+	void Clear();
+
+	PX_INLINE pxUInt NumIslands() const {
+		return m_islands.Num();
+	}
+	PX_INLINE const pxSimulationIsland& GetIsland( pxUInt islandIndex ) const {
+		return m_islands[ islandIndex ];
+	}
+	// contact manifolds sorted by islands
+	// (the solver stores accumulated impulses in contact points)
+	PX_INLINE pxContactManifold* GetManifold( pxUInt manifoldIndex ) const {
+		return m_manifolds[ manifoldIndex ];
+	}
+
+private:
+	pxU4 FindRoot( pxU4 bodyIndex );
+	void MergeSets( pxU4 bodyA, pxU4 bodyB );
+
+private:
+	TList< pxU4 >	m_parent;	// union-find forest over body indices
+	TList< pxU4 >	m_setSize;	// number of bodies in the set (valid only for roots)
+	TList< pxU4 >	m_rootIsland;	// maps roots to island indices
+	TList< pxByte >	m_setAwake;		// 1 if the set contains awake bodies (valid only for roots)
+	TList< pxReal >	m_setSleepTime;	// min. resting time of bodies in the set (valid only for roots)
+
+	TList< pxU4 >	m_manifoldIsland;	// island index of each contact manifold
+
+	TList< pxSimulationIsland >			m_islands;
+	TList< pxContactManifold* >			m_manifolds;
+
+private:	PREVENT_COPY(pxIslandBuilder);
+};
+
+#endif // !__PX_SIMULATION_ISLAND_H__
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -844,6 +844,20 @@ void BSP_Tree::TraceAABB(
 	normal = tw.normal;
 }
 
+void BSP_Tree::CastRay(
+	const Vec3D& start, const Vec3D& end,
+	FLOAT & fraction, Vec3D & normal
+	) const
+{
+	// a ray is a trace of a zero-sized box
+	STraceWorks	tw;
+
+	TraceBox_R( tw, *this, BSP_ROOT_NODE, start, end, 0, 1 );
+
+	fraction = tw.fraction;
+	normal = tw.normal;
+}
+
 pxVec3 BSP_Tree::CalcSupportingVertex( const pxVec3& dir ) const
 {
 	UNDONE;
@@ -208,6 +208,12 @@ public:
 
 	// sweep tests
 
+	// 'fraction' is 1 if the ray didn't hit anything
+	void CastRay(
+		const Vec3D& start, const Vec3D& end,
+		FLOAT & fraction, Vec3D & normal
+		) const;
+
 	void TraceAABB(
 		const AABB& boxsize, const Vec3D& start, const Vec3D& end,
 		FLOAT & fraction, Vec3D & normal
@@ -12,6 +12,51 @@
 
 rxStats	gfxStats;
 
+/*
+-----------------------------------------------------------------------------
+	rxSortIdAllocator
+-----------------------------------------------------------------------------
+*/
+UINT rxSortIdAllocator::Alloc()
+{
+	for( UINT iWord = m_firstFreeWord; iWord < NUMBER_OF(m_usedBits); iWord++ )
+	{
+		const U4 freeBits = ~m_usedBits[ iWord ];
+		if( freeBits )
+		{
+			unsigned long iBit;
+			_BitScanForward( &iBit, freeBits );
+
+			const UINT sortId = iWord * 32 + iBit;
+			if( sortId == SHARED_ID ) {
+				break;
+			}
+
+			m_usedBits[ iWord ] |= BIT(iBit);
+			m_firstFreeWord = iWord;
+
+			return sortId;
+		}
+	}
+
+	m_firstFreeWord = NUMBER_OF(m_usedBits);
+	return SHARED_ID;
+}
+
+void rxSortIdAllocator::Free( UINT sortId )
+{
+	Assert( sortId < rxMAX_SORT_IDS );
+	if( sortId == SHARED_ID ) {
+		return;
+	}
+
+	const UINT iWord = sortId / 32;
+	Assert( m_usedBits[ iWord ] & BIT(sortId % 32) );
+
+	m_usedBits[ iWord ] &= ~BIT(sortId % 32);
+	m_firstFreeWord = smallest( m_firstFreeWord, iWord );
+}
+
 
 
 enum { DbgFontSize = 12 };
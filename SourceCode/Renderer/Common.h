@@ -35,7 +35,7 @@ enum ERenderStage
 
 	//RS_Separable_SSS,	// Separable Subsurface Scattering Pass (Post-processing).
 
-	// NOTE: only 8 bits are available, see rxSurface::stage
+	// NOTE: only 4 bits are available, see BatchSortKey64
 	RS_MAX
 };
 
@@ -71,12 +71,40 @@ enum EDrawOrder
 
 	DO_LAST = DO_Transparent,	// marker, don't use!
 
-	// NOTE: must fit into 8 bits, see rxSurface::drawOrder
+	// NOTE: DO_LAST must fit into 4 bits, see BatchSortKey64
 	DO_MAX = 0xFF
 };
 
 const char* EDrawOrderToChars( EDrawOrder e );
 
+// number of unique sort ids of materials and meshes, see BatchSortKey64
+enum { rxMAX_SORT_IDS = 1 << 16 };
+
+/*
+-----------------------------------------------------------------------------
+	rxSortIdAllocator
+
+	hands out small integer ids which are packed into render queue sort keys
+	instead of pointers; ids of destroyed objects are reused.
+	when all ids are taken, the last id is shared by the remaining objects
+	(they will be sorted less efficiently, but still correctly).
+
+	doesn't allocate memory so it can be used in static constructors.
+-----------------------------------------------------------------------------
+*/
+struct rxSortIdAllocator
+{
+	U4		m_usedBits[ rxMAX_SORT_IDS / 32 ];
+	UINT	m_firstFreeWord;	// all words before this one are fully used
+
+public:
+	enum { SHARED_ID = rxMAX_SORT_IDS - 1 };
+
+	UINT Alloc();
+	void Free( UINT sortId );
+};
+mxDECLARE_POD_TYPE( rxSortIdAllocator );
+
 
 
 
@@ -110,6 +138,10 @@ struct rxStats
 
 	UINT	numMaterialChanges;	// number of material changes in the last frame
 
+	UINT	numOccluderTriangles;	// number of occluder triangles rasterized in the last frame
+	UINT	numOccludedModels;		// number of models in the view frustum hidden behind occluders in the last frame
+	UINT	numOccludedBatches;		// number of model batches which were not submitted due to occlusion in the last frame
+
 //	UINT	cull_aabb_cycles;
 //	UINT	cull_sphere_cycles;
 
@@ -144,6 +176,10 @@ public:
 
 		numMaterialChanges = 0;
 
+		numOccluderTriangles = 0;
+		numOccludedModels = 0;
+		numOccludedBatches = 0;
+
 		//render_queue_sort_cycles = 0;
 		//fat_buffer_filling_cycles = 0;
 		//render_to_shadow_map_cycles = 0;
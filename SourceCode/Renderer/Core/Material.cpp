@@ -35,6 +35,8 @@ namespace
 {
 	static UINT	g_totalNumMaterials = 0;
 
+	static rxSortIdAllocator	g_materialSortIds;
+
 	struct SortByTypeGuid
 	{
 		// for comparison-based sorting algorithms
@@ -63,10 +65,12 @@ rxMaterial::rxMaterial()
 {
 	++g_totalNumMaterials;
 	rfBindProgram.SetAll( F_ApplyNullMaterial );
+	m_sortId = g_materialSortIds.Alloc();
 }
 
 rxMaterial::~rxMaterial()
 {
+	g_materialSortIds.Free( m_sortId );
 	--g_totalNumMaterials;
 }
 
@@ -20,12 +20,12 @@
 struct rxMaterialViewContext
 {
 	const rxSceneContext *	s;
-	rxRenderQueue *			q;
+	rxBatchQueue *			q;
 	//rxRenderEntity *	pEntity;	// entity that is being rendered
 	//UINT				nSubSet;	// entity subset being rendered
 	rxModel *			entity;
 	UINT 				subset;
-	FLOAT	fDistance;	// view-space distance
+	UINT	depthKey;	// quantized view-space distance, see BatchSortKey64
 
 public:
 	bool DbgCheckValid() const;
@@ -121,6 +121,9 @@ public:	// Back-end data
 
 	MaterialStages	rfBindProgram;
 
+	// compact id used in render queue sort keys instead of the pointer
+	UINT	m_sortId;
+
 	AEditableRefCounted::Ref	pEditor;
 
 public:
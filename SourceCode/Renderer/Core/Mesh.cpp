@@ -17,15 +17,22 @@
 	rxMesh
 -----------------------------------------------------------------------------
 */
+namespace
+{
+	static rxSortIdAllocator	g_meshSortIds;
+}
+
 rxMesh::rxMesh()
 {
 	m_topology = EPrimitiveType::PT_Unknown;
 	m_numVertices = m_numIndices = 0;
 	rxAABB_Infinity( m_localBounds );
+	m_sortId = g_meshSortIds.Alloc();
 }
 
 rxMesh::~rxMesh()
 {
+	g_meshSortIds.Free( m_sortId );
 }
 
 /*
@@ -163,6 +163,7 @@ mxALIGN_16(struct rxMesh)
 	UINT	m_numVertices;	//4 total vertex count
 	UINT	m_numIndices;	//4 total index count
 	rxAABB		m_localBounds;	//24 mesh bounds in local-space (changes only when geometry changes)
+	UINT		m_sortId;		//4 compact id used in render queue sort keys
 
 public:
 	typedef TResPtr< rxMesh >	Ref;
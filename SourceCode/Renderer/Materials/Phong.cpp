@@ -90,7 +90,7 @@ void PhongMaterial::rfSubmitBatches( const rxMaterialViewContext& context )
 		this,
 		RS_Deferred_FillGBuffer,
 		DO_Opaque,
-		mxFtoI(context.fDistance),mxTODO("dist not used")
+		context.depthKey,
 		context.entity,
 		context.subset
 	);
@@ -71,7 +71,7 @@ void PlainColorMaterial::rfSubmitBatches( const rxMaterialViewContext& context )
 		this,
 		RS_Deferred_FillGBuffer,
 		DO_Opaque,
-		mxFtoI(context.fDistance),mxTODO("dist not used")
+		context.depthKey,
 		context.entity,
 		context.subset
 	);
@@ -94,15 +94,16 @@ void Apply_Material_SSS_Forward_Pass(
 
 	rxRenderWorld& scene = context.s->scene;
 
-	TList< rxLocalLight >& lights = scene.m_localLights;
+	const UINT numLights = scene.rfGetNumLocalLights();
+	rxLocalLight* lights = scene.rfGetLocalLights();
 
-	if( lights.IsEmpty() ) {
+	if( !numLights ) {
 		return;
 	}
 
 	rxLocalLight *	mainLight = nil;
 
-	for( UINT iLight = 0; iLight < lights.Num(); iLight++ )
+	for( UINT iLight = 0; iLight < numLights; iLight++ )
 	{
 		rxLocalLight& light = lights[ iLight ];
 		//if( light.m_lightType == Light_Spot ) {
@@ -171,7 +172,7 @@ void Apply_Material_SSS_Forward_Pass(
 					as_matrix4(lightLinearProjMatrix) = linearProjection;
 
 					const float4x4 linearLightViewProjMatrix = lightViewMatrix * lightLinearProjMatrix;
-					pData->lightWVP = XMMatrixMultiply( model->m_localToWorld, linearLightViewProjMatrix );
+					pData->lightWVP = XMMatrixMultiply( scene.rfGetModelTransform( *model ), linearLightViewProjMatrix );
 				}
 				GPU::p_skin_shader_build_shadow_map::cb_Data.Unmap(pD3DContext);
 			}
@@ -288,7 +289,7 @@ void Material_SSS::rfSubmitBatches( const rxMaterialViewContext& context )
 		this,
 		RS_Deferred_FillGBuffer,
 		DO_Opaque,
-		mxFtoI(context.fDistance),mxTODO("dist not used")
+		context.depthKey,
 		context.entity,
 		context.subset
 	);
@@ -297,7 +298,7 @@ void Material_SSS::rfSubmitBatches( const rxMaterialViewContext& context )
 		this,
 		RS_Forward_SSS,
 		DO_Opaque,
-		mxFtoI(context.fDistance),mxTODO("dist not used")
+		context.depthKey,
 		context.entity,
 		context.subset
 	);
@@ -24,12 +24,15 @@
 
 #include <Renderer/Pipeline/Backend.h>
 #include <Renderer/Pipeline/DeferredLighting.h>
+#include <Renderer/Pipeline/LightClusters.h>
 #include <Renderer/Pipeline/Shadows.h>
 #include <Renderer/Pipeline/PostProcess.h>
 #include <Renderer/Pipeline/PostProcess/SeparableSSS.h>
 
 #include <Renderer/Util/RenderMesh.h>
 
+#include <Base/JobSystem/JobSystem.h>
+
 // Debugging.
 #if 0
 	#define RR_LOG(...)	DBGOUT( __VA_ARGS__ )
@@ -52,16 +55,43 @@ static void F_BuildRenderQueue( const rxSceneContext& sceneContext, rxRenderQueu
 	// Generate render queue.
 
 	scene.rfBuildDrawList( sceneContext, renderQueue );
+
+	// Gather batches collected in parallel.
+
+	renderQueue.MergeBatchQueues();
 }
 
 //---------------------------------------------------------------------------
 
-static void F_SortRenderQueue( rxRenderQueue & renderQueue )
+static void F_SortRenderQueue( const rxSceneContext& sceneContext, rxRenderQueue & renderQueue )
 {
 	mxPROFILE_SCOPE("Sort");
 
 	// Sort objects by material, entity index and eye-space depth.
-	renderQueue.Sort();
+	renderQueue.Sort( GetGlobalJobQueue() );
+}
+
+//---------------------------------------------------------------------------
+
+// uses the light snapshot of the current frame packet (see rxRenderWorld::rfSetFramePacket()),
+// so that the simulation thread can edit the world's lights while the frame is being rendered
+static void F_BuildLightClusters( const rxSceneContext& sceneContext, rxLightClusterGrid &lightClusters )
+{
+	mxPROFILE_SCOPE("Cluster lights");
+
+	const rxRenderWorld& scene = sceneContext.scene;
+
+	const UINT numLocalLights = smallest( scene.rfGetNumLocalLights(), (UINT)MAX_LOCAL_LIGHTS );
+	const rxLocalLight* snapshot = scene.rfGetLocalLights();
+
+	const rxLocalLight*	localLights[ MAX_LOCAL_LIGHTS ];
+
+	for( UINT iLight = 0; iLight < numLocalLights; iLight++ )
+	{
+		localLights[ iLight ] = &snapshot[ iLight ];
+	}
+
+	lightClusters.Build( sceneContext, localLights, numLocalLights, GetGlobalJobQueue() );
 }
 
 //---------------------------------------------------------------------------
@@ -83,7 +113,7 @@ void Draw_Sorted_Batches(ERenderStage stage, const rxRenderContext& context,
 	{
 		const rxSurface & batch = batches[ iBatch++ ];
 
-		rxMaterial *	material = batch.k.material;
+		rxMaterial *	material = batch.material;
 		rxModel *		entity = batch.entity;
 		const UINT		subset = batch.subset;
 
@@ -96,7 +126,7 @@ void Draw_Sorted_Batches(ERenderStage stage, const rxRenderContext& context,
 
 			rxMesh * mesh = entity->m_mesh.ToPtr();
 
-			GPU::UpdatePerObjectConstants( entity->m_localToWorld );
+			GPU::UpdatePerObjectConstants( context.s->scene.rfGetModelTransform( *entity ) );
 
 			if( oldMesh != mesh )
 			{
@@ -575,6 +605,8 @@ class SceneRenderer
 	// put large structures at the end
 	rxRenderQueue	m_renderQueue;
 
+	rxLightClusterGrid	m_lightClusters;
+
 public:
 	SceneRenderer()
 	{
@@ -623,7 +655,13 @@ public:
 
 			// Sort batches by material, geometry, eye-space depth, etc.
 			// Sort lights.
-			F_SortRenderQueue( m_renderQueue );
+			F_SortRenderQueue( sceneContext, m_renderQueue );
+
+			// Assign local lights to view-space clusters.
+			if( g_cvar_enable_light_clusters )
+			{
+				F_BuildLightClusters( sceneContext, m_lightClusters );
+			}
 		}
 
 
@@ -778,11 +816,17 @@ bool	g_cvar_enable_directional_light_shadows = true;
 bool	g_cvar_enable_point_light_shadows = true;
 bool	g_cvar_enable_spot_light_shadows = true;
 
+bool	g_cvar_enable_occlusion_culling = true;
+
+bool	g_cvar_enable_light_clusters = false;
+
 void Pipeline_Init( UINT viewportWidth, UINT viewportHeight )
 {
 	HOT_BOOL(g_cvar_enable_directional_light_shadows);
 	HOT_BOOL(g_cvar_enable_point_light_shadows);
 	HOT_BOOL(g_cvar_enable_spot_light_shadows);
+	HOT_BOOL(g_cvar_enable_occlusion_culling);
+	HOT_BOOL(g_cvar_enable_light_clusters);
 
 	//mxPut( "Initializing the rendering pipeline.\n" );
 	TheSceneRenderer.Construct();
@@ -818,6 +862,7 @@ void Pipeline_RenderScene( const rxViewport* viewport, const rxSceneContext& sce
 	const UINT startTime = mxGetTimeInMicroseconds();
 
 	gfxBEStats.Reset();
+	RX_STATS(gfxStats.Reset());
 
 	// Draw the scene.
 
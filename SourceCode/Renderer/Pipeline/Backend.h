@@ -48,6 +48,11 @@ extern bool	g_cvar_enable_directional_light_shadows;
 extern bool	g_cvar_enable_point_light_shadows;
 extern bool	g_cvar_enable_spot_light_shadows;
 
+extern bool	g_cvar_enable_occlusion_culling;
+
+// bin local lights into view-space clusters (no shaders read them yet)
+extern bool	g_cvar_enable_light_clusters;
+
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
@@ -140,11 +145,8 @@ rxShaderInstanceId F_UpdateSpotLightData(
 	{
 		shaderInstanceId |= SHADER_PROGRAM::bSpotLight_CastShadows;
 
-		rxViewFrustum	lightFrustum;
-		lightFrustum.Build( &lightWorldMatrix, &lightProjectionMatrix );
-
 		SHADER_PROGRAM::shadowDepthMap = rContext.shadowMgr->Prepare_ShadowMap_for_SpotLight(
-			rContext, *pLight, lightFrustum, lightViewProjectionMatrix
+			rContext, *pLight, lightViewProjectionMatrix
 			);
 	}
 	else
@@ -0,0 +1,573 @@
+/*
+=============================================================================
+	File:	LightClusters.cpp
+	Desc:	Clustered assignment of local lights to view-space cells.
+=============================================================================
+*/
+#include "Renderer_PCH.h"
+#pragma hdrstop
+
+#include <Base/Math/Random.h>
+#include <Base/JobSystem/ParallelFor.h>
+
+#include <Renderer/Core/SceneView.h>
+#include <Renderer/Scene/Light.h>
+#include <Renderer/Pipeline/LightClusters.h>
+
+namespace
+{
+	enum { LIGHT_GROUP_SIZE = 4 };
+
+	struct BinLightsIntoSlices
+	{
+		rxLightClusterGrid *	grid;
+
+	public:
+		void operator () ( UINT firstSlice, UINT lastSlice ) const
+		{
+			for( UINT iSlice = firstSlice; iSlice < lastSlice; iSlice++ )
+			{
+				grid->BinSlice( iSlice );
+			}
+		}
+	};
+
+	// appends indices of lights whose bits are set in the mask
+	FORCEINLINE void AppendLights( int mask, const U2* lightIndices, TList< U2 > &output )
+	{
+		while( mask )
+		{
+			unsigned long iLane;
+			_BitScanForward( &iLane, mask );
+			mask &= mask - 1;
+
+			output.Add( lightIndices[ iLane ] );
+		}
+	}
+
+}//namespace
+
+/*
+-----------------------------------------------------------------------------
+	rxClusterView
+-----------------------------------------------------------------------------
+*/
+void rxClusterView::Set( const rxSceneContext& sceneContext )
+{
+	tanHalfFovY = mxTan( 0.5f * sceneContext.fovY );
+	tanHalfFovX = sceneContext.aspectRatio * tanHalfFovY;
+	nearZ = sceneContext.nearZ;
+	farZ = sceneContext.farZ;
+}
+
+bool rxClusterView::operator == ( const rxClusterView& other ) const
+{
+	return tanHalfFovX == other.tanHalfFovX
+		&& tanHalfFovY == other.tanHalfFovY
+		&& nearZ == other.nearZ
+		&& farZ == other.farZ
+		;
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxClusterLightsSoA
+-----------------------------------------------------------------------------
+*/
+rxClusterLightsSoA::rxClusterLightsSoA()
+{
+	num = 0;
+}
+
+void rxClusterLightsSoA::SetNum( UINT numLights )
+{
+	const UINT numPadded = ALIGN_VALUE( numLights, LIGHT_GROUP_SIZE );
+
+	x.SetNum( numPadded );
+	y.SetNum( numPadded );
+	z.SetNum( numPadded );
+	radius.SetNum( numPadded );
+	radiusSq.SetNum( numPadded );
+	dirX.SetNum( numPadded );
+	dirY.SetNum( numPadded );
+	dirZ.SetNum( numPadded );
+	cosAngle.SetNum( numPadded );
+	sinAngle.SetNum( numPadded );
+	spotMask.SetNum( numPadded );
+	lightIndex.SetNum( numPadded );
+
+	num = numLights;
+
+	// padding lights are behind the viewer and have negative squared radius
+	for( UINT i = numLights; i < numPadded; i++ )
+	{
+		x[i] = y[i] = z[i] = 0.0f;
+		radius[i] = -1.0f;
+		radiusSq[i] = -1.0f;
+		dirX[i] = dirY[i] = dirZ[i] = 0.0f;
+		cosAngle[i] = sinAngle[i] = 0.0f;
+		spotMask[i] = 0;
+		lightIndex[i] = 0;
+	}
+}
+
+void rxClusterLightsSoA::Set( UINT i, const rxClusterLight& light, UINT index )
+{
+	Assert( i < num );
+
+	x[i] = light.position.x;
+	y[i] = light.position.y;
+	z[i] = light.position.z;
+	radius[i] = light.radius;
+	radiusSq[i] = light.radius * light.radius;
+	dirX[i] = light.direction.x;
+	dirY[i] = light.direction.y;
+	dirZ[i] = light.direction.z;
+	cosAngle[i] = light.cosAngle;
+	sinAngle[i] = light.sinAngle;
+	spotMask[i] = light.isSpot ? ~0u : 0u;
+	lightIndex[i] = index;
+}
+
+void rxClusterLightsSoA::Copy( UINT i, const rxClusterLightsSoA& other, UINT j )
+{
+	Assert( i < num );
+
+	x[i] = other.x[j];
+	y[i] = other.y[j];
+	z[i] = other.z[j];
+	radius[i] = other.radius[j];
+	radiusSq[i] = other.radiusSq[j];
+	dirX[i] = other.dirX[j];
+	dirY[i] = other.dirY[j];
+	dirZ[i] = other.dirZ[j];
+	cosAngle[i] = other.cosAngle[j];
+	sinAngle[i] = other.sinAngle[j];
+	spotMask[i] = other.spotMask[j];
+	lightIndex[i] = other.lightIndex[j];
+}
+
+void rxClusterLightsSoA::Clear()
+{
+	x.Clear();
+	y.Clear();
+	z.Clear();
+	radius.Clear();
+	radiusSq.Clear();
+	dirX.Clear();
+	dirY.Clear();
+	dirZ.Clear();
+	cosAngle.Clear();
+	sinAngle.Clear();
+	spotMask.Clear();
+	lightIndex.Clear();
+	num = 0;
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxLightClusterGrid
+-----------------------------------------------------------------------------
+*/
+rxLightClusterGrid::rxLightClusterGrid()
+{
+	ZERO_OUT( m_view );
+	m_sliceScale = 0.0f;
+	ZERO_OUT( m_clusters );
+}
+
+rxLightClusterGrid::~rxLightClusterGrid()
+{
+}
+
+void rxLightClusterGrid::SetView( const rxClusterView& view )
+{
+	Assert( view.nearZ > 0.0f && view.farZ > view.nearZ );
+
+	if( m_view == view ) {
+		return;
+	}
+
+	m_view = view;
+
+	this->CalcClusterBounds();
+}
+
+void rxLightClusterGrid::CalcClusterBounds()
+{
+	// depth slices are distributed exponentially so that clusters have similar proportions
+	const F4 depthRatio = m_view.farZ / m_view.nearZ;
+
+	for( UINT iSlice = 0; iSlice <= rxLIGHT_CLUSTERS_Z; iSlice++ )
+	{
+		m_sliceNearZ[ iSlice ] = m_view.nearZ * mxPow( depthRatio, F4(iSlice) / rxLIGHT_CLUSTERS_Z );
+	}
+
+	m_sliceScale = rxLIGHT_CLUSTERS_Z / mxLog( depthRatio );
+
+	for( UINT iSlice = 0; iSlice < rxLIGHT_CLUSTERS_Z; iSlice++ )
+	{
+		const F4 z0 = m_sliceNearZ[ iSlice ];
+		const F4 z1 = m_sliceNearZ[ iSlice + 1 ];
+
+		for( UINT iRow = 0; iRow < rxLIGHT_CLUSTERS_Y; iRow++ )
+		{
+			// rows go from top to bottom
+			const F4 top = ( 1.0f - 2.0f * iRow / rxLIGHT_CLUSTERS_Y ) * m_view.tanHalfFovY;
+			const F4 bottom = ( 1.0f - 2.0f * (iRow + 1) / rxLIGHT_CLUSTERS_Y ) * m_view.tanHalfFovY;
+
+			for( UINT iColumn = 0; iColumn < rxLIGHT_CLUSTERS_X; iColumn++ )
+			{
+				const F4 left = ( -1.0f + 2.0f * iColumn / rxLIGHT_CLUSTERS_X ) * m_view.tanHalfFovX;
+				const F4 right = ( -1.0f + 2.0f * (iColumn + 1) / rxLIGHT_CLUSTERS_X ) * m_view.tanHalfFovX;
+
+				// the cell is a frustum, its bounds are given by its eight corners
+				AABB & bounds = m_clusterBounds[ this->GetClusterIndex( iColumn, iRow, iSlice ) ];
+				bounds.Clear();
+				bounds.AddPoint( Vec3D( left * z0, bottom * z0, z0 ) );
+				bounds.AddPoint( Vec3D( left * z1, bottom * z1, z1 ) );
+				bounds.AddPoint( Vec3D( right * z0, top * z0, z0 ) );
+				bounds.AddPoint( Vec3D( right * z1, top * z1, z1 ) );
+
+				Sphere & sphere = m_clusterSpheres[ this->GetClusterIndex( iColumn, iRow, iSlice ) ];
+				sphere.Center = bounds.GetCenter();
+				sphere.Radius = ( bounds.GetMax() - sphere.Center ).GetLength();
+			}
+		}
+	}
+}
+
+UINT rxLightClusterGrid::GetSliceIndex( F4 viewZ ) const
+{
+	if( viewZ <= m_view.nearZ ) {
+		return 0;
+	}
+	const INT iSlice = Math::Ftoi( Math::Floor( mxLog( viewZ / m_view.nearZ ) * m_sliceScale ) );
+	return smallest<UINT>( iSlice, rxLIGHT_CLUSTERS_Z - 1 );
+}
+
+const AABB& rxLightClusterGrid::GetClusterBounds( UINT clusterIndex ) const
+{
+	Assert( clusterIndex < rxNUM_LIGHT_CLUSTERS );
+	return m_clusterBounds[ clusterIndex ];
+}
+
+void rxLightClusterGrid::Build( const rxClusterLight* lights, UINT numLights, AsyncJobQueue* jobQueue )
+{
+	Assert( m_view.farZ > 0.0f );
+	Assert( numLights <= rxMAX_CLUSTERED_LIGHTS );
+
+	numLights = smallest<UINT>( numLights, rxMAX_CLUSTERED_LIGHTS );
+
+	m_lights.SetNum( numLights );
+	for( UINT iLight = 0; iLight < numLights; iLight++ )
+	{
+		m_lights.Set( iLight, lights[ iLight ], iLight );
+	}
+
+	BinLightsIntoSlices	binLights;
+	binLights.grid = this;
+
+	ParallelFor( jobQueue, 0, rxLIGHT_CLUSTERS_Z, 1, binLights );
+
+	// concatenate lists of all slices, offsets of clusters become global
+	UINT totalIndices = 0;
+	for( UINT iSlice = 0; iSlice < rxLIGHT_CLUSTERS_Z; iSlice++ )
+	{
+		totalIndices += m_sliceIndices[ iSlice ].Num();
+	}
+
+	m_lightIndices.SetNum( totalIndices );
+
+	UINT sliceOffset = 0;
+	for( UINT iSlice = 0; iSlice < rxLIGHT_CLUSTERS_Z; iSlice++ )
+	{
+		const TList< U2 > & sliceIndices = m_sliceIndices[ iSlice ];
+
+		rxLightCluster* clusters = m_clusters + iSlice * rxLIGHT_CLUSTERS_PER_SLICE;
+		for( UINT iCluster = 0; iCluster < rxLIGHT_CLUSTERS_PER_SLICE; iCluster++ )
+		{
+			clusters[ iCluster ].offset += sliceOffset;
+		}
+
+		if( sliceIndices.Num() ) {
+			MemCopy( m_lightIndices.ToPtr() + sliceOffset, sliceIndices.ToPtr(), sliceIndices.Num() * sizeof(U2) );
+		}
+
+		sliceOffset += sliceIndices.Num();
+	}
+}
+
+void rxLightClusterGrid::Build( const rxSceneContext& sceneContext, const rxLocalLight*const* lights, UINT numLights, AsyncJobQueue* jobQueue )
+{
+	rxClusterView	view;
+	view.Set( sceneContext );
+	this->SetView( view );
+
+	m_viewSpaceLights.SetNum( numLights );
+
+	for( UINT iLight = 0; iLight < numLights; iLight++ )
+	{
+		const rxLocalLight& light = *lights[ iLight ];
+		rxClusterLight & viewSpaceLight = m_viewSpaceLights[ iLight ];
+
+		const float4 position = XMVector3TransformCoord( light.m_position, sceneContext.viewMatrix );
+		viewSpaceLight.position.Set( XMVectorGetX( position ), XMVectorGetY( position ), XMVectorGetZ( position ) );
+		viewSpaceLight.radius = light.GetRadius();
+
+		viewSpaceLight.isSpot = ( light.m_lightType == Light_Spot );
+		if( viewSpaceLight.isSpot )
+		{
+			const float4 direction = XMVector3Normalize( XMVector3TransformNormal( light.m_spotDirection, sceneContext.viewMatrix ) );
+			viewSpaceLight.direction.Set( XMVectorGetX( direction ), XMVectorGetY( direction ), XMVectorGetZ( direction ) );
+
+			const F4 cosAngle = XMVectorGetY( light.m_spotAngles );
+			viewSpaceLight.cosAngle = cosAngle;
+			viewSpaceLight.sinAngle = mxSqrt( maxf( 1.0f - cosAngle * cosAngle, 0.0f ) );
+		}
+		else
+		{
+			viewSpaceLight.direction.Set( 0.0f, 0.0f, 1.0f );
+			viewSpaceLight.cosAngle = -1.0f;
+			viewSpaceLight.sinAngle = 0.0f;
+		}
+	}
+
+	this->Build( m_viewSpaceLights.ToPtr(), numLights, jobQueue );
+}
+
+void rxLightClusterGrid::Clear()
+{
+	ZERO_OUT( m_clusters );
+	m_lightIndices.Clear();
+	m_lights.Clear();
+	for( UINT iSlice = 0; iSlice < rxLIGHT_CLUSTERS_Z; iSlice++ )
+	{
+		m_sliceLights[ iSlice ].Clear();
+		m_sliceIndices[ iSlice ].Clear();
+	}
+	m_viewSpaceLights.Clear();
+}
+
+void rxLightClusterGrid::BinSlice( UINT iSlice )
+{
+	rxClusterLightsSoA & sliceLights = m_sliceLights[ iSlice ];
+	TList< U2 > & sliceIndices = m_sliceIndices[ iSlice ];
+
+	sliceIndices.Empty();
+
+	// find lights overlapping the depth range of the slice
+	TList< U2 > & candidates = sliceIndices;	// used as temporary storage
+	{
+		const __m128 sliceNearZ = _mm_set1_ps( m_sliceNearZ[ iSlice ] );
+		const __m128 sliceFarZ = _mm_set1_ps( m_sliceNearZ[ iSlice + 1 ] );
+
+		const UINT numPadded = m_lights.z.Num();
+
+		for( UINT iLight = 0; iLight < numPadded; iLight += LIGHT_GROUP_SIZE )
+		{
+			const __m128 z = _mm_load_ps( m_lights.z.ToPtr() + iLight );
+			const __m128 r = _mm_load_ps( m_lights.radius.ToPtr() + iLight );
+
+			const __m128 overlaps = _mm_and_ps(
+				_mm_cmpge_ps( _mm_add_ps( z, r ), sliceNearZ ),
+				_mm_cmple_ps( _mm_sub_ps( z, r ), sliceFarZ )
+			);
+
+			int mask = _mm_movemask_ps( overlaps );
+			while( mask )
+			{
+				unsigned long iLane;
+				_BitScanForward( &iLane, mask );
+				mask &= mask - 1;
+
+				candidates.Add( iLight + iLane );
+			}
+		}
+
+		sliceLights.SetNum( candidates.Num() );
+		for( UINT i = 0; i < candidates.Num(); i++ )
+		{
+			sliceLights.Copy( i, m_lights, candidates[i] );
+		}
+
+		candidates.Empty();
+	}
+
+	rxLightCluster* clusters = m_clusters + iSlice * rxLIGHT_CLUSTERS_PER_SLICE;
+	const AABB* clusterBounds = m_clusterBounds + iSlice * rxLIGHT_CLUSTERS_PER_SLICE;
+	const Sphere* clusterSpheres = m_clusterSpheres + iSlice * rxLIGHT_CLUSTERS_PER_SLICE;
+
+	const UINT numPadded = sliceLights.z.Num();
+	const __m128 zero = _mm_setzero_ps();
+
+	for( UINT iCluster = 0; iCluster < rxLIGHT_CLUSTERS_PER_SLICE; iCluster++ )
+	{
+		const AABB& bounds = clusterBounds[ iCluster ];
+		const Sphere& sphere = clusterSpheres[ iCluster ];
+
+		const __m128 minX = _mm_set1_ps( bounds.GetMin().x );
+		const __m128 minY = _mm_set1_ps( bounds.GetMin().y );
+		const __m128 minZ = _mm_set1_ps( bounds.GetMin().z );
+		const __m128 maxX = _mm_set1_ps( bounds.GetMax().x );
+		const __m128 maxY = _mm_set1_ps( bounds.GetMax().y );
+		const __m128 maxZ = _mm_set1_ps( bounds.GetMax().z );
+
+		const __m128 centerX = _mm_set1_ps( sphere.Center.x );
+		const __m128 centerY = _mm_set1_ps( sphere.Center.y );
+		const __m128 centerZ = _mm_set1_ps( sphere.Center.z );
+		const __m128 sphereRadius = _mm_set1_ps( sphere.Radius );
+
+		const UINT firstIndex = sliceIndices.Num();
+
+		for( UINT iLight = 0; iLight < numPadded; iLight += LIGHT_GROUP_SIZE )
+		{
+			const __m128 x = _mm_load_ps( sliceLights.x.ToPtr() + iLight );
+			const __m128 y = _mm_load_ps( sliceLights.y.ToPtr() + iLight );
+			const __m128 z = _mm_load_ps( sliceLights.z.ToPtr() + iLight );
+
+			// squared distance from the light center to the box
+			const __m128 dx = _mm_max_ps( _mm_max_ps( _mm_sub_ps( minX, x ), _mm_sub_ps( x, maxX ) ), zero );
+			const __m128 dy = _mm_max_ps( _mm_max_ps( _mm_sub_ps( minY, y ), _mm_sub_ps( y, maxY ) ), zero );
+			const __m128 dz = _mm_max_ps( _mm_max_ps( _mm_sub_ps( minZ, z ), _mm_sub_ps( z, maxZ ) ), zero );
+			const __m128 distSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+
+			const __m128 touchesBox = _mm_cmple_ps( distSq, _mm_load_ps( sliceLights.radiusSq.ToPtr() + iLight ) );
+
+			if( !_mm_movemask_ps( touchesBox ) ) {
+				continue;
+			}
+
+			// spot lights: cone against the bounding sphere of the cluster
+			const __m128 vx = _mm_sub_ps( centerX, x );
+			const __m128 vy = _mm_sub_ps( centerY, y );
+			const __m128 vz = _mm_sub_ps( centerZ, z );
+			const __m128 vLenSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vx, vx ), _mm_mul_ps( vy, vy ) ), _mm_mul_ps( vz, vz ) );
+
+			// distance along the cone axis
+			const __m128 axial = _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( vx, _mm_load_ps( sliceLights.dirX.ToPtr() + iLight ) ),
+				_mm_mul_ps( vy, _mm_load_ps( sliceLights.dirY.ToPtr() + iLight ) ) ),
+				_mm_mul_ps( vz, _mm_load_ps( sliceLights.dirZ.ToPtr() + iLight ) ) );
+
+			const __m128 radial = _mm_sqrt_ps( _mm_max_ps( _mm_sub_ps( vLenSq, _mm_mul_ps( axial, axial ) ), zero ) );
+
+			// distance from the sphere center to the cone surface
+			const __m128 distToCone = _mm_sub_ps(
+				_mm_mul_ps( _mm_load_ps( sliceLights.cosAngle.ToPtr() + iLight ), radial ),
+				_mm_mul_ps( _mm_load_ps( sliceLights.sinAngle.ToPtr() + iLight ), axial )
+			);
+
+			const __m128 outsideCone = _mm_or_ps( _mm_or_ps(
+				_mm_cmpgt_ps( distToCone, sphereRadius ),
+				_mm_cmpgt_ps( axial, _mm_add_ps( sphereRadius, _mm_load_ps( sliceLights.radius.ToPtr() + iLight ) ) ) ),
+				_mm_cmplt_ps( axial, _mm_sub_ps( zero, sphereRadius ) )
+			);
+
+			const __m128 culledByCone = _mm_and_ps( outsideCone, _mm_load_ps( (const F4*)sliceLights.spotMask.ToPtr() + iLight ) );
+
+			const int mask = _mm_movemask_ps( _mm_andnot_ps( culledByCone, touchesBox ) );
+
+			AppendLights( mask, sliceLights.lightIndex.ToPtr() + iLight, sliceIndices );
+		}
+
+		// offsets are relative to the slice until all slices are finished
+		clusters[ iCluster ].offset = firstIndex;
+		clusters[ iCluster ].count = sliceIndices.Num() - firstIndex;
+	}
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxBenchmarkLightClusters
+-----------------------------------------------------------------------------
+*/
+void rxBenchmarkLightClusters(
+	rxLightClusterGrid& grid,
+	UINT numRuns,
+	AsyncJobQueue* jobQueue,
+	rxLightClusterBenchmark &results
+	)
+{
+	Assert( numRuns > 0 );
+
+	static const UINT numLightsInTest[ rxLightClusterBenchmark::NUM_TESTS ] = { 1024, 4096, 16384 };
+
+	rxClusterView	view;
+	view.tanHalfFovY = mxTan( DEG2RAD(45) );
+	view.tanHalfFovX = view.tanHalfFovY * (16.0f / 9.0f);
+	view.nearZ = 0.1f;
+	view.farZ = 1000.0f;
+
+	grid.SetView( view );
+
+	TList< rxClusterLight >	lights;
+
+	for( UINT iTest = 0; iTest < rxLightClusterBenchmark::NUM_TESTS; iTest++ )
+	{
+		const UINT numLights = numLightsInTest[ iTest ];
+
+		// lights are scattered in a box in front of the viewer, every fourth is a spot light
+		mxRandom	random( 12345 );
+
+		lights.SetNum( numLights );
+
+		for( UINT iLight = 0; iLight < numLights; iLight++ )
+		{
+			rxClusterLight & light = lights[ iLight ];
+
+			light.position.Set(
+				random.RandomFloat( -200.0f, 200.0f ),
+				random.RandomFloat( -50.0f, 50.0f ),
+				random.RandomFloat( 0.0f, 400.0f )
+			);
+			light.radius = random.RandomFloat( 1.0f, 20.0f );
+
+			light.isSpot = ( iLight % 4 == 0 );
+			if( light.isSpot )
+			{
+				Vec3D direction( random.CRandomFloat(), random.CRandomFloat(), random.CRandomFloat() );
+				if( direction.LengthSqr() < 1e-4f ) {
+					direction.Set( 0.0f, -1.0f, 0.0f );
+				}
+				direction.Normalize();
+
+				const F4 halfAngle = random.RandomFloat( DEG2RAD(10), DEG2RAD(60) );
+				light.direction = direction;
+				light.cosAngle = mxCos( halfAngle );
+				light.sinAngle = mxSin( halfAngle );
+			}
+			else
+			{
+				light.direction.Set( 0.0f, 0.0f, 1.0f );
+				light.cosAngle = -1.0f;
+				light.sinAngle = 0.0f;
+			}
+		}
+
+		unsigned long totalMicroseconds = 0;
+
+		mxTimer	timer;
+
+		for( UINT iRun = 0; iRun < numRuns; iRun++ )
+		{
+			timer.Reset();
+			grid.Build( lights.ToPtr(), numLights, jobQueue );
+			totalMicroseconds += timer.GetTimeMicroseconds();
+		}
+
+		results.numLights[ iTest ] = numLights;
+		results.milliseconds[ iTest ] = FLOAT( totalMicroseconds ) * 1e-3f / numRuns;
+		results.numLightIndices[ iTest ] = grid.GetNumLightIndices();
+
+		DBGOUT("Light clusters benchmark: %u lights: %.3f ms, %u light indices\n",
+			results.numLights[ iTest ], results.milliseconds[ iTest ], results.numLightIndices[ iTest ]
+			);
+	}
+}
+
+NO_EMPTY_FILE
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,220 @@
+/*
+=============================================================================
+	File:	LightClusters.h
+	Desc:	Clustered assignment of local lights to view-space cells.
+=============================================================================
+*/
+#pragma once
+
+#include <Renderer/Common.h>
+
+class AsyncJobQueue;
+struct rxLocalLight;
+
+enum
+{
+	// the view frustum is split into a grid of clusters:
+	// screen-space tiles times exponentially distributed depth slices
+	rxLIGHT_CLUSTERS_X = 16,
+	rxLIGHT_CLUSTERS_Y = 8,
+	rxLIGHT_CLUSTERS_Z = 24,
+
+	rxLIGHT_CLUSTERS_PER_SLICE = rxLIGHT_CLUSTERS_X * rxLIGHT_CLUSTERS_Y,
+	rxNUM_LIGHT_CLUSTERS = rxLIGHT_CLUSTERS_PER_SLICE * rxLIGHT_CLUSTERS_Z,
+
+	// light indices are stored in 16 bits
+	rxMAX_CLUSTERED_LIGHTS = 1 << 16,
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxClusterLight
+
+	input for light binning: a point or spot light in view space
+-----------------------------------------------------------------------------
+*/
+struct rxClusterLight
+{
+	Vec3D	position;	// in view space
+	F4		radius;		// range of influence
+	Vec3D	direction;	// spot lights: normalized axis in view space
+	F4		cosAngle;	// spot lights: cosine of half outer cone angle
+	F4		sinAngle;	// spot lights: sine of half outer cone angle
+	U4		isSpot;		// 0 for point lights
+};
+mxDECLARE_POD_TYPE( rxClusterLight );
+
+/*
+-----------------------------------------------------------------------------
+	rxClusterView
+
+	projection parameters of the view (left-handed view space, +Z forward)
+-----------------------------------------------------------------------------
+*/
+struct rxClusterView
+{
+	F4	tanHalfFovX;
+	F4	tanHalfFovY;
+	F4	nearZ;
+	F4	farZ;
+
+public:
+	void Set( const rxSceneContext& sceneContext );
+	bool operator == ( const rxClusterView& other ) const;
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxLightCluster
+
+	range of light indices affecting a cluster
+-----------------------------------------------------------------------------
+*/
+struct rxLightCluster
+{
+	U4	offset;	// index of the first light index in rxLightClusterGrid::GetLightIndices()
+	U4	count;	// number of lights
+};
+mxDECLARE_POD_TYPE( rxLightCluster );
+
+/*
+-----------------------------------------------------------------------------
+	rxClusterLightsSoA
+
+	light parameters in SoA layout for testing four lights at once,
+	the arrays are padded with lights which never touch any cluster
+-----------------------------------------------------------------------------
+*/
+struct rxClusterLightsSoA
+{
+	TList< F4 >		x, y, z;
+	TList< F4 >		radius;
+	TList< F4 >		radiusSq;	// negative for padding
+	TList< F4 >		dirX, dirY, dirZ;
+	TList< F4 >		cosAngle, sinAngle;
+	TList< U4 >		spotMask;	// ~0 for spot lights, 0 for point lights
+	TList< U2 >		lightIndex;	// index of the light in the input array
+	UINT			num;
+
+public:
+	rxClusterLightsSoA();
+
+	// resizes the arrays and fills the padding
+	void SetNum( UINT numLights );
+
+	void Set( UINT i, const rxClusterLight& light, UINT index );
+	void Copy( UINT i, const rxClusterLightsSoA& other, UINT j );
+
+	void Clear();
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxLightClusterGrid
+
+	bins local lights into a 3D grid of view-space clusters
+	and builds compact per-cluster lists of light indices.
+
+	depth slices are processed on worker threads,
+	lights are tested against cluster bounds four at a time with SSE
+	(spheres against boxes, cones against bounding spheres of clusters).
+
+	works only on the CPU, doesn't need a graphics device.
+-----------------------------------------------------------------------------
+*/
+mxALIGN_16(class) rxLightClusterGrid
+{
+public:
+	rxLightClusterGrid();
+	~rxLightClusterGrid();
+
+	// recomputes bounds of clusters if projection parameters have changed
+	void SetView( const rxClusterView& view );
+
+	// assigns the lights (up to rxMAX_CLUSTERED_LIGHTS) to clusters,
+	// depth slices are processed in parallel if the job queue is not null.
+	void Build( const rxClusterLight* lights, UINT numLights, AsyncJobQueue* jobQueue = nil );
+
+	// transforms the lights into view space and assigns them to clusters
+	void Build( const rxSceneContext& sceneContext, const rxLocalLight*const* lights, UINT numLights, AsyncJobQueue* jobQueue = nil );
+
+	void Clear();
+
+	// returns index of the depth slice containing the given view-space depth
+	UINT GetSliceIndex( F4 viewZ ) const;
+
+	// x - column (from left to right), y - row (from top to bottom), z - depth slice
+	FORCEINLINE UINT GetClusterIndex( UINT x, UINT y, UINT z ) const
+	{
+		Assert( x < rxLIGHT_CLUSTERS_X && y < rxLIGHT_CLUSTERS_Y && z < rxLIGHT_CLUSTERS_Z );
+		return (z * rxLIGHT_CLUSTERS_Y + y) * rxLIGHT_CLUSTERS_X + x;
+	}
+	FORCEINLINE const rxLightCluster& GetCluster( UINT clusterIndex ) const
+	{
+		return m_clusters[ clusterIndex ];
+	}
+	FORCEINLINE const U2* GetLightIndices() const
+	{
+		return m_lightIndices.ToPtr();
+	}
+	FORCEINLINE UINT GetNumLightIndices() const
+	{
+		return m_lightIndices.Num();
+	}
+
+	const AABB& GetClusterBounds( UINT clusterIndex ) const;
+
+public_internal:
+	// culls lights against the depth range of the slice and then against each cluster in the slice
+	void BinSlice( UINT iSlice );
+
+private:
+	void CalcClusterBounds();
+
+private:
+	rxClusterView	m_view;
+	F4				m_sliceScale;	// for converting depth into slice index
+
+	F4		m_sliceNearZ[ rxLIGHT_CLUSTERS_Z + 1 ];
+	AABB	m_clusterBounds[ rxNUM_LIGHT_CLUSTERS ];	// in view space
+	Sphere	m_clusterSpheres[ rxNUM_LIGHT_CLUSTERS ];	// bounding spheres for testing spot light cones
+
+	rxLightCluster	m_clusters[ rxNUM_LIGHT_CLUSTERS ];
+	TList< U2 >		m_lightIndices;
+
+	rxClusterLightsSoA	m_lights;	// all lights
+
+	// scratch memory of each depth slice (kept between frames)
+	rxClusterLightsSoA	m_sliceLights[ rxLIGHT_CLUSTERS_Z ];	// lights overlapping the depth range of the slice
+	TList< U2 >			m_sliceIndices[ rxLIGHT_CLUSTERS_Z ];
+
+	TList< rxClusterLight >	m_viewSpaceLights;
+
+	NO_COPY_CONSTRUCTOR(rxLightClusterGrid);
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxLightClusterBenchmark
+-----------------------------------------------------------------------------
+*/
+struct rxLightClusterBenchmark
+{
+	enum { NUM_TESTS = 3 };
+
+	UINT	numLights[ NUM_TESTS ];		// 1K, 4K and 16K lights
+	FLOAT	milliseconds[ NUM_TESTS ];	// average time of Build()
+	UINT	numLightIndices[ NUM_TESTS ];	// total length of per-cluster lists
+};
+
+// bins synthetic sets of randomly placed point and spot lights and measures the time.
+void rxBenchmarkLightClusters(
+	rxLightClusterGrid& grid,
+	UINT numRuns,
+	AsyncJobQueue* jobQueue,
+	rxLightClusterBenchmark &results
+);
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
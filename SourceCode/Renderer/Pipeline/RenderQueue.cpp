@@ -10,10 +10,13 @@
 #include <Core/Util/Tweakable.h>
 #include <Renderer/Core/Material.h>
 #include <Renderer/Scene/RenderEntity.h>
+#include <Renderer/Scene/RenderWorld.h>
 
 
 #include <Renderer/Pipeline/RenderQueue.h>
 
+#include <Base/JobSystem/ParallelFor.h>
+
 
 #if MX_EDITOR
 
@@ -64,64 +67,213 @@ void rxSurface::DbgPrint()
 
 	MX_DEBUG_BREAK;
 }
-//--------------------------------------------------------------
-static inline
-void RadixSortPass( const UINT byte, const UINT size, const rxSurface* source, rxSurface *dest )
+#endif
+
+namespace
 {
-	UINT	count[ 256 ] = { 0 };
-	UINT	index[ 256 ];
-	UINT	i;
-	BYTE *	sortKey = nil;
-	BYTE *	end = nil;
+	// LSD radix sort on 64-bit sort keys, each pass sorts by 11 bits;
+	// the keys are split into blocks which are counted and scattered in parallel
 
-	sortKey = ( (BYTE*) &source[ 0 ].sortKey ) + byte;
-	end = sortKey + ( size * (sizeof rxSurface) );
-	for( ; sortKey < end; sortKey += (sizeof rxSurface) )
+	enum
 	{
-		++count[ *sortKey ];
+		RADIX_BITS = 11,
+		RADIX_SIZE = 1 << RADIX_BITS,
+		RADIX_MASK = RADIX_SIZE - 1,
+
+		// smaller lists are sorted with quick sort
+		// (clearing and scanning the histograms would take longer)
+		RADIX_MIN_ITEMS = 2048,
+
+		// minimum number of keys in a single block
+		RADIX_MIN_BLOCK_SIZE = 4096,
+		// limits the size of per-block histograms and the serial prefix sum
+		RADIX_MAX_BLOCKS = 32,
+
+		// minimum number of batches copied by a single job
+		GATHER_GRANULARITY = 1024,
+	};
+
+	inline UINT CalcRadixBlockSize( UINT numItems )
+	{
+		return largest( (UINT)RADIX_MIN_BLOCK_SIZE, (numItems + RADIX_MAX_BLOCKS - 1) / RADIX_MAX_BLOCKS );
 	}
-	index[ 0 ] = 0;
 
-	for( i = 1; i < 256; ++i )
+	inline UINT CalcNumRadixBlocks( UINT numItems )
 	{
-		index[ i ] = index[ i - 1 ] + count[ i - 1 ];
+		const UINT blockSize = CalcRadixBlockSize( numItems );
+		return (numItems + blockSize - 1) / blockSize;
 	}
 
-	sortKey = ( (BYTE*) &source[ 0 ].sortKey ) + byte;
-	for( i = 0; i < size; ++i, sortKey += (sizeof rxSurface) )
+	// a single sorting pass over the blocks of keys
+	struct RadixPass
+	{
+		const U8 *	srcKeys;
+		const U4 *	srcIndices;
+		U8 *		dstKeys;
+		U4 *		dstIndices;
+		UINT *		histograms;	// RADIX_SIZE counters per block
+		UINT		numItems;
+		UINT		blockSize;
+		UINT		shift;
+	};
+
+	// builds the digit histogram of each block
+	struct CountBlockDigits
 	{
-		dest[ index[ *sortKey ]++ ] = source[ i ];
+		const RadixPass *	pass;
+
+	public:
+		void operator () ( UINT firstBlock, UINT lastBlock ) const
+		{
+			for( UINT iBlock = firstBlock; iBlock < lastBlock; iBlock++ )
+			{
+				UINT* histogram = pass->histograms + iBlock * RADIX_SIZE;
+				MemZero( histogram, RADIX_SIZE * sizeof(histogram[0]) );
+
+				const UINT start = iBlock * pass->blockSize;
+				const UINT end = smallest( start + pass->blockSize, pass->numItems );
+				for( UINT i = start; i < end; i++ )
+				{
+					histogram[ (UINT)( pass->srcKeys[i] >> pass->shift ) & RADIX_MASK ]++;
+				}
+			}
+		}
+	};
+
+	// moves the keys of each block to the offsets computed by the prefix sum
+	struct ScatterBlocks
+	{
+		const RadixPass *	pass;
+
+	public:
+		void operator () ( UINT firstBlock, UINT lastBlock ) const
+		{
+			for( UINT iBlock = firstBlock; iBlock < lastBlock; iBlock++ )
+			{
+				UINT* offsets = pass->histograms + iBlock * RADIX_SIZE;
+
+				const UINT start = iBlock * pass->blockSize;
+				const UINT end = smallest( start + pass->blockSize, pass->numItems );
+				for( UINT i = start; i < end; i++ )
+				{
+					const U8 key = pass->srcKeys[i];
+					const UINT dest = offsets[ (UINT)( key >> pass->shift ) & RADIX_MASK ]++;
+					pass->dstKeys[ dest ] = key;
+					pass->dstIndices[ dest ] = pass->srcIndices[i];
+				}
+			}
+		}
+	};
+
+	// sorts (key, index) pairs, the result is written into keys[0] and indices[0];
+	// 'histograms' must hold CalcNumRadixBlocks( numItems ) * RADIX_SIZE counters
+	//
+	void SortKeysAndIndices( AsyncJobQueue* jobQueue, U8* keys[2], U4* indices[2], UINT* histograms, UINT numItems )
+	{
+		// skip digits which are equal in all keys (e.g. render stages or unused depth bits)
+		U8 differentBits = 0;
+		{
+			const U8 firstKey = keys[0][0];
+			for( UINT i = 1; i < numItems; i++ )
+			{
+				differentBits |= keys[0][i] ^ firstKey;
+			}
+		}
+
+		const UINT numBlocks = CalcNumRadixBlocks( numItems );
+
+		RadixPass	pass;
+		pass.histograms = histograms;
+		pass.numItems = numItems;
+		pass.blockSize = CalcRadixBlockSize( numItems );
+
+		CountBlockDigits	countDigits;
+		countDigits.pass = &pass;
+
+		ScatterBlocks	scatter;
+		scatter.pass = &pass;
+
+		UINT current = 0;
+
+		for( UINT shift = 0; shift < sizeof(U8) * BITS_IN_BYTE; shift += RADIX_BITS )
+		{
+			if( !( (differentBits >> shift) & RADIX_MASK ) ) {
+				continue;
+			}
+
+			pass.srcKeys = keys[ current ];
+			pass.srcIndices = indices[ current ];
+			pass.dstKeys = keys[ current ^ 1 ];
+			pass.dstIndices = indices[ current ^ 1 ];
+			pass.shift = shift;
+
+			ParallelFor( jobQueue, 0, numBlocks, 1, countDigits );
+
+			// exclusive prefix sum in (digit, block) order keeps the sort stable
+			UINT start = 0;
+			for( UINT iDigit = 0; iDigit < RADIX_SIZE; iDigit++ )
+			{
+				for( UINT iBlock = 0; iBlock < numBlocks; iBlock++ )
+				{
+					UINT & counter = histograms[ iBlock * RADIX_SIZE + iDigit ];
+					const UINT numKeys = counter;
+					counter = start;
+					start += numKeys;
+				}
+			}
+
+			ParallelFor( jobQueue, 0, numBlocks, 1, scatter );
+
+			current ^= 1;
+		}
+
+		if( current != 0 ) {
+			MemCopy( keys[0], keys[1], numItems * sizeof(keys[0][0]) );
+			MemCopy( indices[0], indices[1], numItems * sizeof(indices[0][0]) );
+		}
 	}
-}
-//--------------------------------------------------------------
-mxMT_UNSAFE
-static inline
-void SortBatches_RadixSort( rxSurface* source, UINT size )
+
+	struct GatherSortedBatches
+	{
+		const rxSurface *	source;
+		const U4 *			order;	// sorted indices into the source array
+		rxSurface *			dest;
+
+	public:
+		void operator () ( UINT first, UINT last ) const
+		{
+			for( UINT i = first; i < last; i++ )
+			{
+				dest[i] = source[ order[i] ];
+			}
+		}
+	};
+
+}//namespace
+
+/*
+-----------------------------------------------------------------------------
+	rxBatchQueue
+-----------------------------------------------------------------------------
+*/
+rxBatchQueue::rxBatchQueue()
 {
-	static rxSurface scratch[ MAX_BATCHES ];
-
-	// Radix sort with 4 byte size buckets.
-
-	StaticAssert( FIELD_SIZE(rxSurface,sortKey) == 4 * (sizeof BYTE) );
-
-#if MX_LITTLE_ENDIAN
-	RadixSortPass( 0, size, source, scratch );
-	RadixSortPass( 1, size, scratch, source );
-	RadixSortPass( 2, size, source, scratch );
-	RadixSortPass( 3, size, scratch, source );
-#else
-	RadixSortPass( 3, size, source, scratch );
-	RadixSortPass( 2, size, scratch, source );
-	RadixSortPass( 1, size, source, scratch );
-	RadixSortPass( 0, size, scratch, source );
-#endif //!MX_LITTLE_ENDIAN
+	this->Empty();
 }
-#endif
 
+void rxBatchQueue::Empty()
+{
+	ZERO_OUT(numBatches);
+	surfaces.Empty();
+}
 
+/*
+-----------------------------------------------------------------------------
+	rxRenderQueue
+-----------------------------------------------------------------------------
+*/
 rxRenderQueue::rxRenderQueue()
-	: surfaces(_InitZero)
-	, localLights(_InitZero)
+	: localLights(_InitZero)
 {
 	this->Empty();
 }
@@ -139,6 +291,17 @@ void rxRenderQueue::Initialize()
 void rxRenderQueue::Shutdown()
 {
 	surfaces.Clear();
+	for( UINT i = 0; i < 2; i++ )
+	{
+		m_sortKeys[i].Clear();
+		m_sortIndices[i].Clear();
+	}
+	m_sortHistogram.Clear();
+	m_sortScratch.Clear();
+	for( UINT iQueue = 0; iQueue < MAX_BATCH_QUEUES; iQueue++ )
+	{
+		batchQueues[ iQueue ].surfaces.Clear();
+	}
 	localLights.Clear();
 }
 
@@ -147,6 +310,11 @@ void rxRenderQueue::Empty()
 	ZERO_OUT(numBatches);
 	surfaces.Empty();
 
+	for( UINT iQueue = 0; iQueue < MAX_BATCH_QUEUES; iQueue++ )
+	{
+		batchQueues[ iQueue ].Empty();
+	}
+
 	globalLights.Empty();
 
 	ZERO_OUT(numLocalLights);
@@ -155,28 +323,47 @@ void rxRenderQueue::Empty()
 	sky = nil;
 }
 
-void rxRenderQueue::Sort()
+void rxRenderQueue::MergeBatchQueues()
 {
-#if MX_EDITOR && RX_DEBUG_RENDER_QUEUE
-	static bool bDumpRenderQueue = HOT_BOOL(bDumpRenderQueue);
-	if(bDumpRenderQueue){
-		DBG_DO_INTERVAL(this->DbgPrint("\n---Render queue before sorting:\n"),2000);
+	UINT totalBatches = surfaces.Num();
+	for( UINT iQueue = 0; iQueue < MAX_BATCH_QUEUES; iQueue++ )
+	{
+		totalBatches += batchQueues[ iQueue ].surfaces.Num();
 	}
-#endif // MX_EDITOR && RX_DEBUG_RENDER_QUEUE
 
+	surfaces.Reserve( totalBatches );
 
-	// Sort objects by material, entity index and eye-space depth.
+	for( UINT iQueue = 0; iQueue < MAX_BATCH_QUEUES; iQueue++ )
 	{
-		rxSurface* batches = this->GetBatches();
-		const UINT numBatches = this->NumBatches();
+		rxBatchQueue & batchQueue = batchQueues[ iQueue ];
 
-		if( numBatches > 1 )
+		const UINT num = batchQueue.surfaces.Num();
+		if( num )
 		{
-			//SortBatches_RadixSort( batches, numBatches );
-			rxSurface::Compare	predicate;
-			NxQuickSort( batches, batches + numBatches - 1, predicate );
+			surfaces.Add( batchQueue.surfaces.ToPtr(), num );
+
+			for( UINT iStage = 0; iStage < RS_MAX; iStage++ )
+			{
+				numBatches[ iStage ] += batchQueue.numBatches[ iStage ];
+			}
+
+			batchQueue.Empty();
 		}
 	}
+}
+
+void rxRenderQueue::Sort( AsyncJobQueue* jobQueue )
+{
+#if MX_EDITOR && RX_DEBUG_RENDER_QUEUE
+	static bool bDumpRenderQueue = HOT_BOOL(bDumpRenderQueue);
+	if(bDumpRenderQueue){
+		DBG_DO_INTERVAL(this->DbgPrint("\n---Render queue before sorting:\n"),2000);
+	}
+#endif // MX_EDITOR && RX_DEBUG_RENDER_QUEUE
+
+
+	// Sort objects by material, mesh and eye-space depth.
+	this->SortBatches( jobQueue );
 
 	// Sort lights.
 	{
@@ -197,6 +384,55 @@ void rxRenderQueue::Sort()
 #endif // MX_EDITOR && RX_DEBUG_RENDER_QUEUE
 }
 
+void rxRenderQueue::SortBatches( AsyncJobQueue* jobQueue )
+{
+	rxSurface* batches = this->GetBatches();
+	const UINT numBatches = this->NumBatches();
+
+	if( numBatches < 2 ) {
+		return;
+	}
+
+	if( numBatches < RADIX_MIN_ITEMS )
+	{
+		rxSurface::Compare	predicate;
+		NxQuickSort( batches, batches + numBatches - 1, predicate );
+		return;
+	}
+
+	U8*	keys[2];
+	U4*	indices[2];
+
+	for( UINT i = 0; i < 2; i++ )
+	{
+		m_sortKeys[i].SetNum( numBatches );
+		m_sortIndices[i].SetNum( numBatches );
+		keys[i] = m_sortKeys[i].ToPtr();
+		indices[i] = m_sortIndices[i].ToPtr();
+	}
+
+	for( UINT iBatch = 0; iBatch < numBatches; iBatch++ )
+	{
+		keys[0][ iBatch ] = batches[ iBatch ].sortKey;
+		indices[0][ iBatch ] = iBatch;
+	}
+
+	m_sortHistogram.SetNum( CalcNumRadixBlocks( numBatches ) * RADIX_SIZE );
+
+	SortKeysAndIndices( jobQueue, keys, indices, m_sortHistogram.ToPtr(), numBatches );
+
+	m_sortScratch.SetNum( numBatches );
+
+	GatherSortedBatches	gather;
+	gather.source = batches;
+	gather.order = indices[0];
+	gather.dest = m_sortScratch.ToPtr();
+
+	ParallelFor( jobQueue, 0, numBatches, GATHER_GRANULARITY, gather );
+
+	MemCopy( batches, m_sortScratch.ToPtr(), numBatches * sizeof(batches[0]) );
+}
+
 #if MX_EDITOR && RX_DEBUG_RENDER_QUEUE
 void rxRenderQueue::DbgPrint( PCSTR header ) const
 {
@@ -219,7 +455,7 @@ void rxRenderQueue::DbgPrint( PCSTR header ) const
 	{
 		const rxSurface & batch = this->surfaces[ iBatch ];
 
-		rxMaterial *	material = batch.k.material;
+		rxMaterial *	material = batch.material;
 		//rxRenderEntity *entity = batch.e.entity;
 
 		AssertPtr( material );
@@ -228,7 +464,7 @@ void rxRenderQueue::DbgPrint( PCSTR header ) const
 		ERenderStage stage;
 		EDrawOrder order;
 
-		BatchSortKey64::DecomposeSort32( batch.k.sort, &stage, &order );
+		BatchSortKey64::Decompose( batch.sortKey, &stage, &order );
 
 
 		mxPutf("[%u] material: %p = '%s' (%s, %s)\n",
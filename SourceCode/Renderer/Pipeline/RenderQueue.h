@@ -12,6 +12,8 @@
 //#include <Renderer/Core/Material.h>
 //#include <Renderer/Scene/RenderEntity.h>
 
+class AsyncJobQueue;
+
 #define RX_DEBUG_RENDER_QUEUE	(RX_DEBUG_RENDERER)
 
 // define to 1 for faster & less accurate render queue sorting
@@ -38,27 +40,69 @@
 
 
 
-// NOTE: could use free 4 bits in each 16-byte aligned pointer for storing bucket/order
+/*
+-----------------------------------------------------------------------------
+	BatchSortKey64
+
+	64-bit sort key of a render queue entry.
+	materials and meshes are identified by compact ids (see rxSortIdAllocator)
+	so that the key doesn't depend on pointer size or memory layout.
+
+	opaque batches:
+	ERenderStage(4) | EDrawOrder(4) | material(16) | mesh(16) | depth(24)
 
-// 64-bit sort key
-union BatchSortKey64
+	translucent batches (back-to-front):
+	ERenderStage(4) | EDrawOrder(4) | inverted depth(24) | material(16) | mesh(16)
+-----------------------------------------------------------------------------
+*/
+struct BatchSortKey64
 {
-	struct
+	enum
 	{
-		rxMaterial*	material;	//32
-		UINT32		sort;	// ERenderStage(8) | EDrawOrder(8) | sort(16)
+		STAGE_BITS = 4,
+		ORDER_BITS = 4,
+		SORT_ID_BITS = 16,
+		DEPTH_BITS = 24,
+
+		STAGE_SHIFT = 60,
+		ORDER_SHIFT = 56,
+
+		SORT_ID_MASK = (1 << SORT_ID_BITS) - 1,
+		DEPTH_MASK = (1 << DEPTH_BITS) - 1,
 	};
-	U8	v;
 
-public:
-	static FORCEINLINE UINT ComposeSort32( ERenderStage stage, EDrawOrder order, UINT key )
+	static FORCEINLINE U8 Compose(
+		ERenderStage stage, EDrawOrder order,
+		UINT materialId, UINT meshId,
+		UINT depth	// quantized view distance, see QuantizeDepth()
+		)
+	{
+		const U8 header = ((U8)stage << STAGE_SHIFT) | ((U8)order << ORDER_SHIFT);
+
+		const U8 state = ((U8)(materialId & SORT_ID_MASK) << SORT_ID_BITS) | (meshId & SORT_ID_MASK);
+
+		if( order == DO_Transparent )
+		{
+			// farthest surfaces are drawn first
+			const U8 invDepth = DEPTH_MASK - (depth & DEPTH_MASK);
+			return header | (invDepth << (SORT_ID_BITS * 2)) | state;
+		}
+
+		// sort by state first, then front-to-back to reduce overdraw
+		return header | (state << DEPTH_BITS) | (depth & DEPTH_MASK);
+	}
+
+	static FORCEINLINE void Decompose( U8 key, ERenderStage *stage, EDrawOrder *order )
 	{
-		return ((UINT)stage << 24) | ((UINT)order << 16) | (key);
+		*stage = (ERenderStage)	((key >> STAGE_SHIFT) & ((1 << STAGE_BITS) - 1));
+		*order = (EDrawOrder)	((key >> ORDER_SHIFT) & ((1 << ORDER_BITS) - 1));
 	}
-	static FORCEINLINE void DecomposeSort32( UINT sort, ERenderStage *stage, EDrawOrder *order )
+
+	// maps view distance in range [0..farZ] to an integer depth key
+	static FORCEINLINE UINT QuantizeDepth( FLOAT distance, FLOAT farZ )
 	{
-		*stage = (ERenderStage)	((sort & 0xFF000000u) >> 24);
-		*order = (EDrawOrder)	((sort & 0x00FF0000u) >> 16);
+		const FLOAT t = clampf( distance / farZ, 0.0f, 1.0f );
+		return Math::Ftoi( t * DEPTH_MASK );
 	}
 };
 
@@ -67,13 +111,12 @@ public:
 	rxSurface
 
 	is a single render queue entry
-
-	NOTE: could store render model index and subset in ushorts
 -----------------------------------------------------------------------------
 */
-mxALIGN_16(struct) rxSurface
+struct rxSurface
 {
-	BatchSortKey64	k;
+	U8				sortKey;	// see BatchSortKey64
+	rxMaterial *	material;
 	rxModel *		entity;	// renderable model
 	UINT			subset;	// mesh subset (batch)
 
@@ -83,14 +126,18 @@ public:
 		rxMaterial* material,
 		const ERenderStage stage,
 		const EDrawOrder order,
-		UINT key,
+		UINT depth,
 		rxModel* entity,
 		UINT subset
 	)
 	{
-		k.material = material;
-		k.sort = BatchSortKey64::ComposeSort32( stage, order, key );
+		sortKey = BatchSortKey64::Compose(
+			stage, order,
+			material->m_sortId, entity->m_mesh.ToPtr()->m_sortId,
+			depth
+		);
 
+		this->material = material;
 		this->entity = entity;
 		this->subset = subset;
 	}
@@ -99,20 +146,23 @@ public:
 	{
 		FORCEINLINE bool operator () ( const rxSurface& a, const rxSurface& b ) const
 		{
-			return a.k.v < b.k.v;
+			return a.sortKey < b.sortKey;
 		}
 	};
 
 	static void DbgPrint();
 
-	// make sure that structure layout is correct before porting to other platforms
+	// make sure that all fields fit into sort keys
 	void StaticChecks()
 	{
-		mxSTATIC_ASSERT( MX_LITTLE_ENDIAN == 1 );
-		mxSTATIC_ASSERT( SIZE_OF_VOID == sizeof U4 );
-		mxSTATIC_ASSERT( sizeof BatchSortKey64 == sizeof UINT64 );
+		mxSTATIC_ASSERT( RS_MAX <= (1 << BatchSortKey64::STAGE_BITS) );
+		mxSTATIC_ASSERT( DO_LAST < (1 << BatchSortKey64::ORDER_BITS) );
+		mxSTATIC_ASSERT( rxMAX_SORT_IDS <= (1 << BatchSortKey64::SORT_ID_BITS) );
+		mxSTATIC_ASSERT( BatchSortKey64::STAGE_BITS + BatchSortKey64::ORDER_BITS
+			+ BatchSortKey64::SORT_ID_BITS * 2 + BatchSortKey64::DEPTH_BITS == sizeof U8 * BITS_IN_BYTE );
 	}
 };
+mxDECLARE_POD_TYPE( rxSurface );
 
 
 // this basically describes the order in which lights are processed during deferred lighting
@@ -173,8 +223,8 @@ public:
 };
 
 
-// maximum number of draw calls per view
-enum { MAX_BATCHES = 2048*2 };
+// maximum number of batch queues which can be filled in parallel
+enum { MAX_BATCH_QUEUES = 32 };
 
 //MAX_DIRECTIONAL_LIGHTS
 enum { MAX_GLOBAL_LIGHTS = 4 };
@@ -184,43 +234,38 @@ enum { MAX_LOCAL_LIGHTS = 1024 };
 
 /*
 -----------------------------------------------------------------------------
-	rxRenderQueue
+	rxBatchQueue
+
+	collects batches submitted by a single thread,
+	the memory is kept between frames
 -----------------------------------------------------------------------------
 */
-mxALIGN_BY_CACHE_LINE struct rxRenderQueue
+mxALIGN_BY_CACHE_LINE struct rxBatchQueue
 {
 	UINT	numBatches[RS_MAX];	// number of batches in each bucket
-	TStaticList< rxSurface, MAX_BATCHES >	surfaces;
-
-	// global lights (rendered as full screen quads)
-	TStaticList< rxParallelLight*, MAX_GLOBAL_LIGHTS >	globalLights;
-
-	// local dynamic lights
-	UINT	numLocalLights[NumLightStages][NumLightTypes];	// number of items in each bucket
-	TStaticList< rxLightEntry, MAX_LOCAL_LIGHTS >	localLights;
-
-	TPtr< rxSkyModel >		sky;
+	TList< rxSurface >	surfaces;
 
 public:
+	rxBatchQueue();
 
 	FORCEINLINE rxSurface& AddBatch(
 		rxMaterial* material,
 		const ERenderStage stage,
 		const EDrawOrder order,
-		UINT key,
+		UINT depth,	// quantized view distance, see BatchSortKey64::QuantizeDepth()
 		rxModel* entity,
 		UINT subset
 	)
 	{
 		++(this->numBatches[ stage ]);
 
-		rxSurface & newBatch = this->surfaces.AddFast_Unsafe();
+		rxSurface & newBatch = this->surfaces.Add();
 
 		newBatch.Encode(
 			material,
 			stage,
 			order,
-			key,
+			depth,
 			entity,
 			subset
 		);
@@ -228,6 +273,34 @@ public:
 		return newBatch;
 	}
 
+	void Empty();
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxRenderQueue
+
+	batches are submitted into several batch queues in parallel,
+	then the queues are merged and sorted
+-----------------------------------------------------------------------------
+*/
+mxALIGN_BY_CACHE_LINE struct rxRenderQueue
+{
+	UINT	numBatches[RS_MAX];	// number of batches in each bucket
+	TList< rxSurface >	surfaces;	// merged and sorted batches (the memory is kept between frames)
+
+	rxBatchQueue	batchQueues[ MAX_BATCH_QUEUES ];
+
+	// global lights (rendered as full screen quads)
+	TStaticList< rxParallelLight*, MAX_GLOBAL_LIGHTS >	globalLights;
+
+	// local dynamic lights
+	UINT	numLocalLights[NumLightStages][NumLightTypes];	// number of items in each bucket
+	TStaticList< rxLightEntry, MAX_LOCAL_LIGHTS >	localLights;
+
+	TPtr< rxSkyModel >		sky;
+
+public:
 	FORCEINLINE void AddLight(
 		rxLight* pLight,
 		const ELightStage eLightStage,
@@ -266,7 +339,22 @@ public_internal:
 		return surfaces.ToPtr();
 	}
 
-	void Sort();
+	// combines all batch queues into a single list
+	void MergeBatchQueues();
+
+	// sorts merged batches and lights, uses the job queue for sorting large lists of batches
+	void Sort( AsyncJobQueue* jobQueue = nil );
+
+private:
+	void SortBatches( AsyncJobQueue* jobQueue );
+
+private:
+	// scratch memory for sorting batches (kept between frames),
+	// only (key, index) pairs are moved during radix sort passes
+	TList< U8 >		m_sortKeys[2];
+	TList< U4 >		m_sortIndices[2];
+	TList< U4 >		m_sortHistogram;	// digit counters of each block
+	TList< rxSurface >	m_sortScratch;
 
 public:
 	void DbgPrint( PCSTR header = nil ) const;
@@ -29,13 +29,13 @@ rxShadowCastingSet::rxShadowCastingSet()
 	m_objects.Reserve(64);
 }
 
-void rxShadowCastingSet::UpdatePerObjectConstants( const rxModel& model, mat4_carg lightViewProjection )
+void rxShadowCastingSet::UpdatePerObjectConstants( mat4_carg localToWorld, mat4_carg lightViewProjection )
 {
 	ID3D11DeviceContext* pD3DContext = GetD3DDeviceContext();
 
 	GPU::p_build_hw_shadow_map::Data* pData = GPU::p_build_hw_shadow_map::cb_Data.Map(pD3DContext);
 	{
-		pData->lightWVP = XMMatrixMultiply( model.m_localToWorld, lightViewProjection );
+		pData->lightWVP = XMMatrixMultiply( localToWorld, lightViewProjection );
 	}
 	GPU::p_build_hw_shadow_map::cb_Data.Unmap(pD3DContext);
 }
@@ -48,11 +48,13 @@ void rxShadowCastingSet::Render( const rxShadowRenderContext& shadowRenderContex
 	const UINT numObjects = m_objects.Num();
 	rxModel** objectsArray = m_objects.ToPtr();
 
+	const rxRenderWorld& scene = shadowRenderContext.s->scene;
+
 	for( UINT iShadowCaster = 0; iShadowCaster < numObjects; iShadowCaster++ )
 	{
 		rxModel* pObject = objectsArray[ iShadowCaster ];
 
-		this->UpdatePerObjectConstants( *pObject, lightViewProjection );
+		this->UpdatePerObjectConstants( scene.rfGetModelTransform( *pObject ), lightViewProjection );
 
 		pObject->RenderShadowDepth( shadowRenderContext );
 	}
@@ -368,6 +370,116 @@ void rxShadowManager::Initialize()
 	HOT_BOOL(g_cvar_dir_light_visualize_cascades);
 }
 
+float4x4 rxShadowManager::CalcCascadeViewProjection(
+	const rxSceneContext& sceneContext,
+	const rxParallelLight& light,
+	UINT iCascadeIndex
+	)
+{
+	Assert( iCascadeIndex < NUM_SHADOW_CASCADES );
+
+	// Get the 8 points of the view frustum in world space
+
+	// first get the view frustum corners in projection space
+	float4 frustumCornersWS[8] =
+	{
+		// near plane
+		XMVectorSet(-1.0f,  1.0f, 0.0f, 1.0f),
+		XMVectorSet( 1.0f,  1.0f, 0.0f, 1.0f),
+		XMVectorSet( 1.0f, -1.0f, 0.0f, 1.0f),
+		XMVectorSet(-1.0f, -1.0f, 0.0f, 1.0f),
+
+		// far plane
+		XMVectorSet(-1.0f,  1.0f, 1.0f, 1.0f),
+		XMVectorSet( 1.0f,  1.0f, 1.0f, 1.0f),
+		XMVectorSet( 1.0f, -1.0f, 1.0f, 1.0f),
+		XMVectorSet(-1.0f, -1.0f, 1.0f, 1.0f),
+	};
+
+	const F4 prevSplitDist = (iCascadeIndex == 0)
+		?
+		0.0f
+		:
+		CascadeSplits[ iCascadeIndex - 1 ] * ShadowDist
+		;
+
+	const F4 splitDist = CascadeSplits[ iCascadeIndex ] * ShadowDist;
+
+	const float4x4 invViewProj = sceneContext.invViewProjectionMatrix;
+	for(UINT i = 0; i < 8; ++i)
+	{
+		frustumCornersWS[i] = XMVector3TransformCoord( frustumCornersWS[i], invViewProj );
+	}
+
+	// Scale by the shadow view distance
+	for(UINT i = 0; i < 4; ++i)
+	{
+		float4 cornerRay = XMVectorSubtract(frustumCornersWS[i + 4], frustumCornersWS[i]);
+		float4 nearCornerRay = XMVectorScale(cornerRay, prevSplitDist);
+		float4 farCornerRay = XMVectorScale(cornerRay, splitDist);
+		frustumCornersWS[i + 4] = XMVectorAdd(frustumCornersWS[i], farCornerRay);
+		frustumCornersWS[i] = XMVectorAdd(frustumCornersWS[i], nearCornerRay);
+	}
+
+	// Calculate the centroid of the view frustum
+	float4 sphereCenterPosition = XMVectorZero();
+	for(UINT i = 0; i < 8; ++i)
+	{
+		sphereCenterPosition = XMVectorAdd( sphereCenterPosition, frustumCornersWS[i] );
+	}
+	sphereCenterPosition = XMVectorScale( sphereCenterPosition, 1.0f / 8.0f );
+
+	// Calculate the radius of a bounding sphere
+	float4 sphereRadiusVec = XMVectorZero();
+	for(UINT i = 0; i < 8; ++i)
+	{
+		float4 dist = XMVector3Length(XMVectorSubtract( frustumCornersWS[i], sphereCenterPosition) );
+		sphereRadiusVec = XMVectorMax( sphereRadiusVec, dist );
+	}
+
+	sphereRadiusVec = XMVectorRound( sphereRadiusVec );
+	const F4 sphereRadius = XMVectorGetX( sphereRadiusVec );
+	const F4 backupDist = sphereRadius + Light_Camera_Near_Clip + Light_Backup_Distance;
+
+	// Get position of the shadow camera
+	float4 shadowCameraPosition = sphereCenterPosition;
+	float4 backupDirVec = XMVectorNegate( light.m_lightDirWS );
+	backupDirVec = XMVectorScale( backupDirVec, backupDist );
+	shadowCameraPosition = XMVectorAdd( shadowCameraPosition, backupDirVec );
+
+	const float4 shadowCameraLookDirection = XMVector3Normalize( XMVectorSubtract( sphereCenterPosition, shadowCameraPosition ) );
+	const float4 upDirVec = BuildBasisVectors( shadowCameraPosition, shadowCameraLookDirection ).r[1];
+
+	// Come up with a new orthographic camera for the shadow caster
+	OrthographicCamera shadowCamera(
+		shadowCameraPosition, sphereCenterPosition, upDirVec,
+		-sphereRadius, -sphereRadius,
+		+sphereRadius, +sphereRadius,
+		Light_Camera_Near_Clip, backupDist + sphereRadius
+	);
+
+	// Create the rounding matrix, by projecting the world-space origin and determining
+	// the fractional offset in texel space
+	float4x4 shadowViewProjMatrix = shadowCamera.m_viewProjection;
+
+	float4 shadowOrigin = XMVectorSet( 0.0f, 0.0f, 0.0f, 1.0f );
+	shadowOrigin = XMVector4Transform( shadowOrigin, shadowViewProjMatrix );
+	shadowOrigin = XMVectorScale( shadowOrigin, fCascadeBufferSize / 2.0f );
+
+	float4 roundedOrigin = XMVectorRound( shadowOrigin );
+	float4 roundOffset = XMVectorSubtract( roundedOrigin, shadowOrigin );
+	roundOffset = XMVectorScale( roundOffset, 2.0f / fCascadeBufferSize );
+	roundOffset = XMVectorSetZ( roundOffset, 0.0f);
+	roundOffset = XMVectorSetW( roundOffset, 0.0f);
+
+	float4x4 shadowProjMatrix = shadowCamera.m_projection;
+	shadowProjMatrix.r[3] = XMVectorAdd( shadowProjMatrix.r[3], roundOffset );
+	shadowCamera.UpdateProjectionMatrix( shadowProjMatrix );
+	shadowViewProjMatrix = shadowCamera.m_viewProjection;
+
+	return shadowViewProjMatrix;
+}
+
 mxSWIPED("Matt Pettineo (MJP)")
 // Renders meshes using cascaded shadow mapping. The technique is a basic stable CSM implementation,
 // based on the article "Stable rendering of cascaded shadow maps" by Michael Valient, from ShaderX6
@@ -443,118 +555,22 @@ ID3D11ShaderResourceView* rxShadowManager::Process_Directional_Light(
 		viewport.MaxDepth	= 1.0f;
 		pD3DContext->RSSetViewports( 1, &viewport );
 
-		// Get the 8 points of the view frustum in world space
-
-		// first get the view frustum corners in projection space
-		float4 frustumCornersWS[8] =
-		{
-			// near plane
-			XMVectorSet(-1.0f,  1.0f, 0.0f, 1.0f),
-			XMVectorSet( 1.0f,  1.0f, 0.0f, 1.0f),
-			XMVectorSet( 1.0f, -1.0f, 0.0f, 1.0f),
-			XMVectorSet(-1.0f, -1.0f, 0.0f, 1.0f),
-
-			// far plane
-			XMVectorSet(-1.0f,  1.0f, 1.0f, 1.0f),
-			XMVectorSet( 1.0f,  1.0f, 1.0f, 1.0f),
-			XMVectorSet( 1.0f, -1.0f, 1.0f, 1.0f),
-			XMVectorSet(-1.0f, -1.0f, 1.0f, 1.0f),
-		};
-
-		const F4 prevSplitDist = (iCascadeIndex == 0)
-			?
-			0.0f
-			:
-			CascadeSplits[ iCascadeIndex - 1 ] * ShadowDist
-			;
-
 		const F4 splitDist = CascadeSplits[ iCascadeIndex ] * ShadowDist;
 
-		const float4x4 invViewProj = sceneContext.invViewProjectionMatrix;
-		for(UINT i = 0; i < 8; ++i)
-		{
-			frustumCornersWS[i] = XMVector3TransformCoord( frustumCornersWS[i], invViewProj );
-		}
-
-		// Scale by the shadow view distance
-		for(UINT i = 0; i < 4; ++i)
-		{
-			float4 cornerRay = XMVectorSubtract(frustumCornersWS[i + 4], frustumCornersWS[i]);
-			float4 nearCornerRay = XMVectorScale(cornerRay, prevSplitDist);
-			float4 farCornerRay = XMVectorScale(cornerRay, splitDist);
-			frustumCornersWS[i + 4] = XMVectorAdd(frustumCornersWS[i], farCornerRay);
-			frustumCornersWS[i] = XMVectorAdd(frustumCornersWS[i], nearCornerRay);
-		}
-
-		// Calculate the centroid of the view frustum
-		float4 sphereCenterPosition = XMVectorZero();
-		for(UINT i = 0; i < 8; ++i)
-		{
-			sphereCenterPosition = XMVectorAdd( sphereCenterPosition, frustumCornersWS[i] );
-		}
-		sphereCenterPosition = XMVectorScale( sphereCenterPosition, 1.0f / 8.0f );
-
-		// Calculate the radius of a bounding sphere
-		float4 sphereRadiusVec = XMVectorZero();
-		for(UINT i = 0; i < 8; ++i)
-		{
-			float4 dist = XMVector3Length(XMVectorSubtract( frustumCornersWS[i], sphereCenterPosition) );
-			sphereRadiusVec = XMVectorMax( sphereRadiusVec, dist );
-		}
-
-		sphereRadiusVec = XMVectorRound( sphereRadiusVec );
-		const F4 sphereRadius = XMVectorGetX( sphereRadiusVec );
-		const F4 backupDist = sphereRadius + Light_Camera_Near_Clip + Light_Backup_Distance;
-
-		// Get position of the shadow camera
-		float4 shadowCameraPosition = sphereCenterPosition;
-		float4 backupDirVec = XMVectorNegate( light.m_lightDirWS );
-		backupDirVec = XMVectorScale( backupDirVec, backupDist );
-		shadowCameraPosition = XMVectorAdd( shadowCameraPosition, backupDirVec );
-
-		const float4 shadowCameraLookDirection = XMVector3Normalize( XMVectorSubtract( sphereCenterPosition, shadowCameraPosition ) );
-		const float4 upDirVec = BuildBasisVectors( shadowCameraPosition, shadowCameraLookDirection ).r[1];
-
-		// Come up with a new orthographic camera for the shadow caster
-		OrthographicCamera shadowCamera(
-			shadowCameraPosition, sphereCenterPosition, upDirVec,
-			-sphereRadius, -sphereRadius,
-			+sphereRadius, +sphereRadius,
-			Light_Camera_Near_Clip, backupDist + sphereRadius
-		);
-
-		// Create the rounding matrix, by projecting the world-space origin and determining
-		// the fractional offset in texel space
-		float4x4 shadowViewProjMatrix = shadowCamera.m_viewProjection;
-
-		float4 shadowOrigin = XMVectorSet( 0.0f, 0.0f, 0.0f, 1.0f );
-		shadowOrigin = XMVector4Transform( shadowOrigin, shadowViewProjMatrix );
-		shadowOrigin = XMVectorScale( shadowOrigin, fCascadeBufferSize / 2.0f );
-
-		float4 roundedOrigin = XMVectorRound( shadowOrigin );
-		float4 roundOffset = XMVectorSubtract( roundedOrigin, shadowOrigin );
-		roundOffset = XMVectorScale( roundOffset, 2.0f / fCascadeBufferSize );
-		roundOffset = XMVectorSetZ( roundOffset, 0.0f);
-		roundOffset = XMVectorSetW( roundOffset, 0.0f);
-
-		float4x4 shadowProjMatrix = shadowCamera.m_projection;
-		shadowProjMatrix.r[3] = XMVectorAdd( shadowProjMatrix.r[3], roundOffset );
-		shadowCamera.UpdateProjectionMatrix( shadowProjMatrix );
-		shadowViewProjMatrix = shadowCamera.m_viewProjection;
-
+		float4x4 shadowViewProjMatrix = CalcCascadeViewProjection( sceneContext, light, iCascadeIndex );
 
 		// Draw the objects with depth only, using the new shadow camera
 		{
 			rxShadowRenderContext	shadowRenderContext;
 			shadowRenderContext.s = &sceneContext;
 			shadowRenderContext.pD3D = pD3DContext;
-mxTODO("use dir light frustum");
+
 			m_shadowCasters.m_objects.Empty();
-			sceneContext.scene.rfGetDirLightShadowCasters( m_shadowCasters );
+			sceneContext.scene.rfGetDirLightShadowCasters( light, iCascadeIndex, shadowViewProjMatrix, m_shadowCasters );
 
 			rxSET_SHADER_SCOPED( p_build_hw_shadow_map, pD3DContext );
 
-			m_shadowCasters.Render( shadowRenderContext, shadowCamera.m_viewProjection );
+			m_shadowCasters.Render( shadowRenderContext, shadowViewProjMatrix );
 		}
 
 
@@ -590,7 +606,6 @@ mxTODO("use dir light frustum");
 ID3D11ShaderResourceView* rxShadowManager::Prepare_ShadowMap_for_SpotLight(
 	const rxRenderContext& context,
 	const rxLocalLight& light,
-	const rxViewFrustum& lightFrustum,
 	mat4_carg lightViewProjection
 	)
 {
@@ -615,7 +630,7 @@ ID3D11ShaderResourceView* rxShadowManager::Prepare_ShadowMap_for_SpotLight(
 		shadowRenderContext.pD3D = pD3DContext;
 
 		m_shadowCasters.m_objects.Empty();
-		renderWorld.rfGetSpotLightShadowCasters( lightFrustum, m_shadowCasters );
+		renderWorld.rfGetSpotLightShadowCasters( light, lightViewProjection, m_shadowCasters );
 
 		rxSET_SHADER_SCOPED( p_build_hw_shadow_map, pD3DContext );
 
@@ -35,7 +35,7 @@ public:
 	void Render( const rxShadowRenderContext& shadowRenderContext, mat4_carg lightViewProjection );
 
 private:
-	void UpdatePerObjectConstants( const rxModel& model, mat4_carg lightViewProjection );
+	void UpdatePerObjectConstants( mat4_carg localToWorld, mat4_carg lightViewProjection );
 };
 
 
@@ -72,10 +72,17 @@ public:
 	ID3D11ShaderResourceView* Prepare_ShadowMap_for_SpotLight(
 		const rxRenderContext& context,
 		const rxLocalLight& light,
-		const rxViewFrustum& lightFrustum,
 		mat4_carg lightViewProjection
 		);
 
+	// computes the view-projection matrix of the shadow camera for the given cascade
+	// (used both for rendering cascades and for culling shadow casters)
+	static float4x4 CalcCascadeViewProjection(
+		const rxSceneContext& sceneContext,
+		const rxParallelLight& light,
+		UINT iCascadeIndex
+		);
+
 	static UINT Static_Get_Shadow_Map_Atlas_Size();
 
 public:
@@ -18,6 +18,7 @@ class rxScene;
 class rxSpatialObject;
 class rxRenderEntity;
 class rxRenderQueue;
+struct rxBatchQueue;
 class rxSceneView;
 class VertexData;
 class GrViewport;
@@ -0,0 +1,134 @@
+/*
+=============================================================================
+	File:	Culling.cpp
+	Desc:	Data-parallel frustum culling of bounding boxes.
+=============================================================================
+*/
+#include "Renderer_PCH.h"
+#pragma hdrstop
+
+#include "Culling.h"
+
+/*
+-----------------------------------------------------------------------------
+	rxCullingBounds
+-----------------------------------------------------------------------------
+*/
+rxCullingBounds::rxCullingBounds()
+{
+	m_numBoxes = 0;
+}
+
+void rxCullingBounds::SetNum( UINT numBoxes )
+{
+	const UINT numPadded = ALIGN_VALUE( numBoxes, rxCULL_GROUP_SIZE );
+
+	m_minX.SetNum( numPadded );
+	m_minY.SetNum( numPadded );
+	m_minZ.SetNum( numPadded );
+	m_maxX.SetNum( numPadded );
+	m_maxY.SetNum( numPadded );
+	m_maxZ.SetNum( numPadded );
+
+	m_numBoxes = numBoxes;
+
+	// padding boxes are degenerate, their visibility bits are ignored
+	for( UINT i = numBoxes; i < numPadded; i++ )
+	{
+		m_minX[i] = m_minY[i] = m_minZ[i] = 0.0f;
+		m_maxX[i] = m_maxY[i] = m_maxZ[i] = 0.0f;
+	}
+}
+
+void rxCullingBounds::Set( UINT index, const rxAABB& aabb )
+{
+	Assert( index < m_numBoxes );
+
+	m_minX[ index ] = aabb.Center.x - aabb.Extents.x;
+	m_minY[ index ] = aabb.Center.y - aabb.Extents.y;
+	m_minZ[ index ] = aabb.Center.z - aabb.Extents.z;
+	m_maxX[ index ] = aabb.Center.x + aabb.Extents.x;
+	m_maxY[ index ] = aabb.Center.y + aabb.Extents.y;
+	m_maxZ[ index ] = aabb.Center.z + aabb.Extents.z;
+}
+
+void rxCullingBounds::Set( UINT index, const AABB& aabb )
+{
+	Assert( index < m_numBoxes );
+
+	m_minX[ index ] = aabb.GetMin().x;
+	m_minY[ index ] = aabb.GetMin().y;
+	m_minZ[ index ] = aabb.GetMin().z;
+	m_maxX[ index ] = aabb.GetMax().x;
+	m_maxY[ index ] = aabb.GetMax().y;
+	m_maxZ[ index ] = aabb.GetMax().z;
+}
+
+void rxCullingBounds::Clear()
+{
+	m_minX.Clear();
+	m_minY.Clear();
+	m_minZ.Clear();
+	m_maxX.Clear();
+	m_maxY.Clear();
+	m_maxZ.Clear();
+	m_numBoxes = 0;
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxCullingPlanes
+-----------------------------------------------------------------------------
+*/
+void rxCullingPlanes::Set( const ViewFrustum& frustum )
+{
+	for( UINT iPlane = 0; iPlane < VF_CLIP_PLANES; iPlane++ )
+	{
+		const Plane3D& plane = frustum.planes[ iPlane ];
+
+		nx[ iPlane ] = _mm_set1_ps( plane.a );
+		ny[ iPlane ] = _mm_set1_ps( plane.b );
+		nz[ iPlane ] = _mm_set1_ps( plane.c );
+		d[ iPlane ] = _mm_set1_ps( plane.d );
+
+		planes[ iPlane ] = plane;
+	}
+}
+
+int rxCullingPlanes::Classify( const AABB& aabb ) const
+{
+	const Vec3D& mins = aabb.GetMin();
+	const Vec3D& maxs = aabb.GetMax();
+
+	int result = ESpatialRelation::Inside;
+
+	for( UINT iPlane = 0; iPlane < VF_CLIP_PLANES; iPlane++ )
+	{
+		const Plane3D& plane = planes[ iPlane ];
+
+		// the corners farthest along and against the plane normal
+		const Vec3D pVertex(
+			( plane.a >= 0.0f ) ? maxs.x : mins.x,
+			( plane.b >= 0.0f ) ? maxs.y : mins.y,
+			( plane.c >= 0.0f ) ? maxs.z : mins.z
+		);
+		const Vec3D nVertex(
+			( plane.a >= 0.0f ) ? mins.x : maxs.x,
+			( plane.b >= 0.0f ) ? mins.y : maxs.y,
+			( plane.c >= 0.0f ) ? mins.z : maxs.z
+		);
+
+		if( plane.Distance( pVertex ) < 0.0f ) {
+			return ESpatialRelation::Outside;
+		}
+		if( plane.Distance( nVertex ) < 0.0f ) {
+			result = ESpatialRelation::Intersects;
+		}
+	}
+
+	return result;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,125 @@
+/*
+=============================================================================
+	File:	Culling.h
+	Desc:	Data-parallel frustum culling of bounding boxes.
+=============================================================================
+*/
+#pragma once
+
+#include <Renderer/Common.h>
+
+// boxes are processed in groups (one SSE register holds the same coordinate of four boxes)
+enum { rxCULL_GROUP_SIZE = 4 };
+
+// maximum number of views which can be culled in one pass (one bit per view)
+enum { rxCULL_MAX_VIEWS = 32 };
+
+/*
+-----------------------------------------------------------------------------
+	rxCullingBounds
+
+	world-space bounding boxes stored in SoA layout
+	(separate arrays for each coordinate) for fast SIMD culling.
+	arrays are padded to a multiple of rxCULL_GROUP_SIZE.
+-----------------------------------------------------------------------------
+*/
+class rxCullingBounds
+{
+public:
+	rxCullingBounds();
+
+	void SetNum( UINT numBoxes );
+
+	FORCEINLINE UINT Num() const { return m_numBoxes; }
+
+	// converts the given box from center/extents to min/max representation
+	void Set( UINT index, const rxAABB& aabb );
+	void Set( UINT index, const AABB& aabb );
+
+	void Clear();
+
+public_internal:
+	TList< F4 >		m_minX;
+	TList< F4 >		m_minY;
+	TList< F4 >		m_minZ;
+	TList< F4 >		m_maxX;
+	TList< F4 >		m_maxY;
+	TList< F4 >		m_maxZ;
+	UINT			m_numBoxes;	// the number of valid boxes (not counting padding)
+
+	NO_COPY_CONSTRUCTOR(rxCullingBounds);
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxCullingPlanes
+
+	frustum planes with each component replicated into all SIMD lanes
+-----------------------------------------------------------------------------
+*/
+mxALIGN_16(struct rxCullingPlanes)
+{
+	mxSimdQuad	nx[ VF_CLIP_PLANES ];
+	mxSimdQuad	ny[ VF_CLIP_PLANES ];
+	mxSimdQuad	nz[ VF_CLIP_PLANES ];
+	mxSimdQuad	d[ VF_CLIP_PLANES ];
+
+	// the same planes for testing single boxes
+	Plane3D		planes[ VF_CLIP_PLANES ];
+
+public:
+	// the frustum planes must face inward
+	void Set( const ViewFrustum& frustum );
+
+	// returns ESpatialRelation::Outside, Inside or Intersects
+	int Classify( const AABB& aabb ) const;
+};
+
+// returns a 4-bit mask with bits set for boxes intersecting the frustum
+//
+FORCEINLINE int rxCullBoxGroup( const rxCullingPlanes& planes,
+	const __m128 minX, const __m128 minY, const __m128 minZ,
+	const __m128 maxX, const __m128 maxY, const __m128 maxZ )
+{
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 outside = zero;
+
+	for( UINT iPlane = 0; iPlane < VF_CLIP_PLANES; iPlane++ )
+	{
+		const __m128 nx = planes.nx[ iPlane ];
+		const __m128 ny = planes.ny[ iPlane ];
+		const __m128 nz = planes.nz[ iPlane ];
+
+		// max(n*min, n*max) selects the corner of the box
+		// which lies farthest along the plane normal ('positive vertex')
+		const __m128 dx = _mm_max_ps( _mm_mul_ps( nx, minX ), _mm_mul_ps( nx, maxX ) );
+		const __m128 dy = _mm_max_ps( _mm_mul_ps( ny, minY ), _mm_mul_ps( ny, maxY ) );
+		const __m128 dz = _mm_max_ps( _mm_mul_ps( nz, minZ ), _mm_mul_ps( nz, maxZ ) );
+
+		const __m128 dist = _mm_add_ps( _mm_add_ps( dx, dy ), _mm_add_ps( dz, planes.d[ iPlane ] ) );
+
+		// the box is outside if its positive vertex is behind any plane
+		outside = _mm_or_ps( outside, _mm_cmplt_ps( dist, zero ) );
+	}
+
+	return ~_mm_movemask_ps( outside ) & 0xF;
+}
+
+// tests the group of boxes starting at the given index (must be a multiple of rxCULL_GROUP_SIZE)
+//
+FORCEINLINE int rxCullBoxGroup( const rxCullingPlanes& planes, const rxCullingBounds& bounds, UINT firstBox )
+{
+	return rxCullBoxGroup( planes,
+		_mm_load_ps( bounds.m_minX.ToPtr() + firstBox ),
+		_mm_load_ps( bounds.m_minY.ToPtr() + firstBox ),
+		_mm_load_ps( bounds.m_minZ.ToPtr() + firstBox ),
+		_mm_load_ps( bounds.m_maxX.ToPtr() + firstBox ),
+		_mm_load_ps( bounds.m_maxY.ToPtr() + firstBox ),
+		_mm_load_ps( bounds.m_maxZ.ToPtr() + firstBox )
+	);
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
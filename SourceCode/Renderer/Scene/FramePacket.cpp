@@ -0,0 +1,157 @@
+/*
+=============================================================================
+	File:	FramePacket.cpp
+	Desc:	Immutable snapshots of the render world passed
+			from the simulation to the renderer.
+=============================================================================
+*/
+#include "Renderer_PCH.h"
+#pragma hdrstop
+
+#include "FramePacket.h"
+
+/*
+-----------------------------------------------------------------------------
+	rxFrameArena
+-----------------------------------------------------------------------------
+*/
+rxFrameArena::rxFrameArena()
+{
+	m_memory = nil;
+	m_capacity = 0;
+	m_used = 0;
+}
+
+rxFrameArena::~rxFrameArena()
+{
+	if( m_memory != nil )
+	{
+		mxFreeX( EMemHeap::HeapSceneData, m_memory );
+		m_memory = nil;
+	}
+}
+
+void rxFrameArena::Reset( SizeT capacity )
+{
+	m_used = 0;
+
+	if( capacity > m_capacity )
+	{
+		if( m_memory != nil ) {
+			mxFreeX( EMemHeap::HeapSceneData, m_memory );
+		}
+
+		// grow by half to avoid reallocating every frame while the world is growing
+		m_capacity = ALIGN16( capacity + capacity / 2 );
+		m_memory = c_cast(BYTE*) mxAllocX( EMemHeap::HeapSceneData, m_capacity );
+
+		Assert( IS_16_BYTE_ALIGNED( m_memory ) );
+	}
+}
+
+void* rxFrameArena::Alloc( SizeT numBytes )
+{
+	const SizeT alignedSize = GetAlignedSize( numBytes );
+
+	// the capacity must be reserved in Reset()
+	Assert( m_used + alignedSize <= m_capacity );
+	if( m_used + alignedSize > m_capacity ) {
+		return nil;
+	}
+
+	void* ptr = m_memory + m_used;
+	m_used += alignedSize;
+
+	return ptr;
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxFramePacket
+-----------------------------------------------------------------------------
+*/
+rxFramePacket::rxFramePacket()
+{
+	frameNumber = 0;
+	this->Clear();
+}
+
+void rxFramePacket::Clear()
+{
+	numModels = 0;
+	modelTransforms = nil;
+	modelBounds = nil;
+
+	numMovedModels = 0;
+	movedModels = nil;
+	modelTreeDirty = false;
+
+	numDirLights = 0;
+	dirLights = nil;
+
+	numLocalLights = 0;
+	localLights = nil;
+
+	arena.Reset( 0 );
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxFramePacketQueue
+-----------------------------------------------------------------------------
+*/
+rxFramePacketQueue::rxFramePacketQueue()
+{
+	// all packets are free initially
+	for( UINT i = 0; i < NUM_PACKETS; i++ )
+	{
+		m_consumed[i].Signal();
+	}
+	m_writeIndex = 0;
+	m_readIndex = 0;
+	m_frameCounter = 0;
+}
+
+rxFramePacketQueue::~rxFramePacketQueue()
+{
+}
+
+rxFramePacket& rxFramePacketQueue::BeginWrite()
+{
+	mxPROFILE_SCOPE("Wait for frame packet");
+
+	m_consumed[ m_writeIndex ].Wait();
+
+	rxFramePacket & packet = m_packets[ m_writeIndex ];
+	packet.Clear();
+	packet.frameNumber = m_frameCounter++;
+
+	return packet;
+}
+
+void rxFramePacketQueue::EndWrite()
+{
+	m_written[ m_writeIndex ].Signal();
+	m_writeIndex = (m_writeIndex + 1) % NUM_PACKETS;
+}
+
+const rxFramePacket& rxFramePacketQueue::BeginRead()
+{
+	mxPROFILE_SCOPE("Wait for simulation");
+
+	m_written[ m_readIndex ].Wait();
+
+	return m_packets[ m_readIndex ];
+}
+
+void rxFramePacketQueue::EndRead()
+{
+	m_consumed[ m_readIndex ].Signal();
+	m_readIndex = (m_readIndex + 1) % NUM_PACKETS;
+}
+
+NO_EMPTY_FILE
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,149 @@
+/*
+=============================================================================
+	File:	FramePacket.h
+	Desc:	Immutable snapshots of the render world passed
+			from the simulation to the renderer.
+=============================================================================
+*/
+#pragma once
+
+#include <Renderer/Common.h>
+#include <Renderer/Core/SceneView.h>
+#include <Renderer/Scene/Light.h>
+
+/*
+-----------------------------------------------------------------------------
+	rxFrameArena
+
+	linear allocator for per-frame data,
+	all allocations are released at once by Reset().
+	the memory block only grows in Reset() so that pointers stay valid during the frame.
+-----------------------------------------------------------------------------
+*/
+class rxFrameArena
+{
+public:
+	rxFrameArena();
+	~rxFrameArena();
+
+	// discards all allocations and makes sure that the arena can hold the given number of bytes
+	// (use GetAlignedSize() for computing the size of each allocation)
+	void Reset( SizeT capacity );
+
+	// returns 16-byte aligned memory which is valid until the next reset
+	void* Alloc( SizeT numBytes );
+
+	template< typename TYPE >
+	FORCEINLINE TYPE* AllocArray( UINT count )
+	{
+		return c_cast(TYPE*) this->Alloc( count * sizeof(TYPE) );
+	}
+
+	FORCEINLINE SizeT GetUsedSize() const { return m_used; }
+	FORCEINLINE SizeT GetCapacity() const { return m_capacity; }
+
+	static FORCEINLINE SizeT GetAlignedSize( SizeT numBytes )
+	{
+		return ALIGN16( numBytes );
+	}
+
+private:
+	BYTE *	m_memory;
+	SizeT	m_capacity;
+	SizeT	m_used;
+
+	NO_COPY_CONSTRUCTOR(rxFrameArena);
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxFramePacket
+
+	everything the render thread needs to know about the world for one frame;
+	filled by rxRenderWorld::ExtractFramePacket() on the simulation thread
+	and never changed until the renderer has finished with it.
+
+	arrays of models are indexed by model indices in rxRenderWorld::m_models.
+-----------------------------------------------------------------------------
+*/
+struct rxFramePacket
+{
+	UINT		frameNumber;
+
+	rxView		camera;
+
+	UINT		numModels;
+	float4x4 *	modelTransforms;	// local-to-world matrices
+	rxAABB *	modelBounds;		// world-space bounds
+
+	// models whose bounds have changed since the previous packet,
+	// the render thread refits the culling tree with them (see rxRenderWorld::rfSetFramePacket())
+	UINT		numMovedModels;
+	UINT *		movedModels;
+	bool		modelTreeDirty;		// true if the culling tree must be rebuilt from scratch
+
+	UINT				numDirLights;
+	rxParallelLight *	dirLights;
+
+	// only lights which can affect anything visible from the camera
+	UINT				numLocalLights;
+	rxLocalLight *		localLights;
+
+	// holds the arrays above
+	rxFrameArena	arena;
+
+public:
+	rxFramePacket();
+
+	void Clear();
+
+	NO_COPY_CONSTRUCTOR(rxFramePacket);
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxFramePacketQueue
+
+	double-buffered frame packets:
+	the simulation thread fills the packet for frame N+1
+	while the render thread consumes the packet for frame N.
+
+	BeginWrite() blocks until the render thread has finished with the packet,
+	BeginRead() blocks until the simulation thread has filled it.
+	each side may be called only from a single thread.
+-----------------------------------------------------------------------------
+*/
+class rxFramePacketQueue
+{
+public:
+	rxFramePacketQueue();
+	~rxFramePacketQueue();
+
+	// Simulation thread.
+
+	rxFramePacket& BeginWrite();
+	void EndWrite();
+
+	// Render thread.
+
+	const rxFramePacket& BeginRead();
+	void EndRead();
+
+private:
+	enum { NUM_PACKETS = 2 };
+
+	rxFramePacket	m_packets[ NUM_PACKETS ];
+
+	mxEvent		m_written[ NUM_PACKETS ];	// signalled after the packet has been filled
+	mxEvent		m_consumed[ NUM_PACKETS ];	// signalled after the packet has been rendered
+
+	UINT		m_writeIndex;
+	UINT		m_readIndex;
+	UINT		m_frameCounter;
+
+	NO_COPY_CONSTRUCTOR(rxFramePacketQueue);
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -9,6 +9,9 @@
 //#include "Renderer.h"
 
 #include "Model.h"
+#include <Renderer/Core/SceneView.h>
+#include <Renderer/Scene/RenderWorld.h>
+#include <Renderer/Pipeline/RenderQueue.h>
 #include <Renderer/Pipeline/Shadows.h>
 #include <Renderer/Util/RenderMesh.h>
 
@@ -46,6 +49,7 @@ rxModel::rxModel()
 	m_localToWorld = XMMatrixIdentity();
 	rxAABB_Infinity( m_localAABB );
 	rxAABB_Infinity( m_worldAABB );
+	m_transformNode = INDEX_NONE;
 }
 
 void rxModel::SubmitBatches( const rxEntityViewContext& context )
@@ -57,12 +61,19 @@ void rxModel::SubmitBatches( const rxEntityViewContext& context )
 	materialContext.q = context.q;
 	materialContext.entity = this;
 
+	// all batches of the model are sorted by the distance to the center of its bounds
+	{
+		const rxAABB& worldAABB = context.s->scene.rfGetModelBounds( *this );
+		const Vec3D center( worldAABB.Center.x, worldAABB.Center.y, worldAABB.Center.z );
+		const FLOAT distance = ( center - context.s->GetOrigin() ).GetLength();
+		materialContext.depthKey = BatchSortKey64::QuantizeDepth( distance, context.s->farZ );
+	}
+
 	for( UINT iBatch = 0; iBatch < numBatches; iBatch++ )
 	{
 		const rxModelBatch & batch = m_batches[ iBatch ];
 
 		materialContext.subset = iBatch;
-		materialContext.fDistance = 0.0f;mxUNDONE;
 
 		rxMaterial* material = batch.material.ToPtr();
 
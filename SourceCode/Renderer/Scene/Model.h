@@ -46,6 +46,7 @@ mxALIGN_16(struct rxModel) : public SBaseType
 	TList< rxModelBatch >	m_batches;		//16 mesh subsets
 	rxAABB					m_localAABB;	//24 bounds in local space (changes only when geometry changes)
 	rxAABB					m_worldAABB;	//24 bounds in world space for coarse culling (should be updated properly)
+	U4						m_transformNode;//4 node in rxRenderWorld::m_transforms or INDEX_NONE if the model is placed directly
 
 public:
 	mxDECLARE_CLASS( rxModel, SBaseType );
@@ -0,0 +1,507 @@
+/*
+=============================================================================
+	File:	Occlusion.cpp
+	Desc:	Software occlusion culling with a low-resolution depth buffer.
+=============================================================================
+*/
+#include "Renderer_PCH.h"
+#pragma hdrstop
+
+#include <Base/JobSystem/ParallelFor.h>
+
+#include "Occlusion.h"
+
+namespace
+{
+	FORCEINLINE UINT GetLevelWidth( UINT level )
+	{
+		return rxOCCLUSION_BUFFER_WIDTH >> level;
+	}
+
+	FORCEINLINE UINT GetLevelHeight( UINT level )
+	{
+		return rxOCCLUSION_BUFFER_HEIGHT >> level;
+	}
+
+	// computes the given rows of the level from the finer level,
+	// each texel receives the farthest depth of the 2x2 texels below it
+	//
+	void DownsampleRows( F4* depth, const UINT* levelOffsets, UINT level, UINT firstRow, UINT lastRow )
+	{
+		Assert( level > 0 );
+
+		const UINT srcWidth = GetLevelWidth( level - 1 );
+		const UINT dstWidth = GetLevelWidth( level );
+		Assert( dstWidth % 4 == 0 );
+
+		const F4* src = depth + levelOffsets[ level - 1 ];
+		F4* dst = depth + levelOffsets[ level ];
+
+		for( UINT y = firstRow; y < lastRow; y++ )
+		{
+			const F4* srcRow0 = src + (y * 2 + 0) * srcWidth;
+			const F4* srcRow1 = src + (y * 2 + 1) * srcWidth;
+			F4* dstRow = dst + y * dstWidth;
+
+			for( UINT x = 0; x < dstWidth; x += 4 )
+			{
+				const __m128 q0 = _mm_max_ps( _mm_load_ps( srcRow0 + x * 2 + 0 ), _mm_load_ps( srcRow1 + x * 2 + 0 ) );
+				const __m128 q1 = _mm_max_ps( _mm_load_ps( srcRow0 + x * 2 + 4 ), _mm_load_ps( srcRow1 + x * 2 + 4 ) );
+
+				const __m128 even = _mm_shuffle_ps( q0, q1, _MM_SHUFFLE(2,0,2,0) );
+				const __m128 odd = _mm_shuffle_ps( q0, q1, _MM_SHUFFLE(3,1,3,1) );
+
+				_mm_store_ps( dstRow + x, _mm_max_ps( even, odd ) );
+			}
+		}
+	}
+
+	struct RasterizeOcclusionBands
+	{
+		rxOcclusionBuffer *	buffer;
+
+	public:
+		void operator () ( UINT firstBand, UINT lastBand ) const
+		{
+			for( UINT iBand = firstBand; iBand < lastBand; iBand++ )
+			{
+				buffer->RasterizeBand( iBand );
+			}
+		}
+	};
+
+	// levels which fit into a single band are built by the band jobs
+	enum { NUM_LEVELS_BUILT_PER_BAND = 4 };	// log2(rxOCCLUSION_BAND_HEIGHT) + 1
+	mxSTATIC_ASSERT( (rxOCCLUSION_BAND_HEIGHT >> (NUM_LEVELS_BUILT_PER_BAND - 1)) == 1 );
+	mxSTATIC_ASSERT( rxOCCLUSION_NUM_LEVELS >= NUM_LEVELS_BUILT_PER_BAND );
+	mxSTATIC_ASSERT( (rxOCCLUSION_BUFFER_WIDTH >> (rxOCCLUSION_NUM_LEVELS - 1)) % 4 == 0 );
+	mxSTATIC_ASSERT( rxOCCLUSION_NUM_BANDS * rxOCCLUSION_BAND_HEIGHT == rxOCCLUSION_BUFFER_HEIGHT );
+
+}//namespace
+
+/*
+-----------------------------------------------------------------------------
+	rxOccluder
+-----------------------------------------------------------------------------
+*/
+rxOccluder::rxOccluder()
+{
+	m_bounds.Clear();
+}
+
+void rxOccluder::Set( const Vec3D* vertices, UINT numVertices, const U4* indices, UINT numIndices )
+{
+	Assert( numIndices % 3 == 0 );
+
+	m_vertices.SetNum( numVertices );
+	m_indices.SetNum( numIndices );
+
+	MemCopy( m_vertices.ToPtr(), vertices, numVertices * sizeof(vertices[0]) );
+	MemCopy( m_indices.ToPtr(), indices, numIndices * sizeof(indices[0]) );
+
+	m_bounds.Clear();
+	for( UINT i = 0; i < numVertices; i++ )
+	{
+		m_bounds.AddPoint( vertices[i] );
+	}
+}
+
+/*
+-----------------------------------------------------------------------------
+	rxOcclusionBuffer
+-----------------------------------------------------------------------------
+*/
+rxOcclusionBuffer::rxOcclusionBuffer()
+{
+	m_viewProjection = XMMatrixIdentity();
+
+	UINT totalSize = 0;
+	for( UINT iLevel = 0; iLevel < rxOCCLUSION_NUM_LEVELS; iLevel++ )
+	{
+		m_levelOffsets[ iLevel ] = totalSize;
+		totalSize += GetLevelWidth( iLevel ) * GetLevelHeight( iLevel );
+	}
+
+	m_depth.SetNum( totalSize );
+	Assert(IS_16_BYTE_ALIGNED( m_depth.ToPtr() ));
+
+	for( UINT i = 0; i < totalSize; i++ )
+	{
+		m_depth[i] = 1.0f;
+	}
+}
+
+rxOcclusionBuffer::~rxOcclusionBuffer()
+{
+}
+
+void rxOcclusionBuffer::Begin( mat4_carg viewProjection )
+{
+	m_viewProjection = viewProjection;
+	m_triangles.Empty();
+}
+
+void rxOcclusionBuffer::AddOccluder( const rxOccluder& occluder )
+{
+	const UINT numVertices = occluder.m_vertices.Num();
+	const UINT numIndices = occluder.m_indices.Num();
+
+	const Vec3D* vertices = occluder.m_vertices.ToPtr();
+	const U4* indices = occluder.m_indices.ToPtr();
+
+	m_clipVerts.SetNum( numVertices );
+	float4* clipVerts = m_clipVerts.ToPtr();
+
+	for( UINT iVertex = 0; iVertex < numVertices; iVertex++ )
+	{
+		const Vec3D& v = vertices[ iVertex ];
+		clipVerts[ iVertex ] = XMVector3Transform( XMVectorSet( v.x, v.y, v.z, 1.0f ), m_viewProjection );
+	}
+
+	for( UINT i = 0; i + 2 < numIndices; i += 3 )
+	{
+		this->ClipAndAddTriangle(
+			clipVerts[ indices[ i + 0 ] ],
+			clipVerts[ indices[ i + 1 ] ],
+			clipVerts[ indices[ i + 2 ] ]
+		);
+	}
+}
+
+void rxOcclusionBuffer::ClipAndAddTriangle( const float4& v0, const float4& v1, const float4& v2 )
+{
+	const float4 verts[3] = { v0, v1, v2 };
+
+	// reject triangles which are completely outside one of the frustum planes
+
+	UINT outsideLeft = 0, outsideRight = 0, outsideBottom = 0, outsideTop = 0, outsideNear = 0, outsideFar = 0;
+	for( UINT i = 0; i < 3; i++ )
+	{
+		const F4 x = XMVectorGetX( verts[i] );
+		const F4 y = XMVectorGetY( verts[i] );
+		const F4 z = XMVectorGetZ( verts[i] );
+		const F4 w = XMVectorGetW( verts[i] );
+
+		outsideLeft += (x < -w);
+		outsideRight += (x > w);
+		outsideBottom += (y < -w);
+		outsideTop += (y > w);
+		outsideNear += (z < 0.0f);
+		outsideFar += (z > w);
+	}
+
+	if( outsideLeft == 3 || outsideRight == 3 || outsideBottom == 3 || outsideTop == 3 || outsideNear == 3 || outsideFar == 3 ) {
+		return;
+	}
+
+	if( !outsideNear )
+	{
+		this->AddScreenTriangle( v0, v1, v2 );
+		return;
+	}
+
+	// clip against the near plane (z >= 0 in D3D clip space),
+	// the other planes are handled by clamping to the screen rectangle
+
+	float4	polygon[4];
+	UINT	numPolygonVerts = 0;
+
+	for( UINT i = 0; i < 3; i++ )
+	{
+		const float4& a = verts[ i ];
+		const float4& b = verts[ (i + 1) % 3 ];
+
+		const F4 da = XMVectorGetZ( a );
+		const F4 db = XMVectorGetZ( b );
+
+		if( da >= 0.0f ) {
+			polygon[ numPolygonVerts++ ] = a;
+		}
+		if( (da >= 0.0f) != (db >= 0.0f) ) {
+			polygon[ numPolygonVerts++ ] = XMVectorLerp( a, b, da / (da - db) );
+		}
+	}
+
+	Assert( numPolygonVerts == 3 || numPolygonVerts == 4 );
+
+	this->AddScreenTriangle( polygon[0], polygon[1], polygon[2] );
+
+	if( numPolygonVerts == 4 ) {
+		this->AddScreenTriangle( polygon[0], polygon[2], polygon[3] );
+	}
+}
+
+void rxOcclusionBuffer::AddScreenTriangle( const float4& v0, const float4& v1, const float4& v2 )
+{
+	const float4* verts[3] = { &v0, &v1, &v2 };
+
+	rxOccluderTriangle	t;
+
+	for( UINT i = 0; i < 3; i++ )
+	{
+		const F4 invW = 1.0f / XMVectorGetW( *verts[i] );
+
+		t.x[i] = ( XMVectorGetX( *verts[i] ) * invW * 0.5f + 0.5f ) * rxOCCLUSION_BUFFER_WIDTH;
+		t.y[i] = ( 0.5f - XMVectorGetY( *verts[i] ) * invW * 0.5f ) * rxOCCLUSION_BUFFER_HEIGHT;
+		t.z[i] = XMVectorGetZ( *verts[i] ) * invW;
+	}
+
+	// make the winding order consistent so that inside pixels have positive edge functions
+	const F4 area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+	if( area == 0.0f ) {
+		return;
+	}
+	if( area < 0.0f )
+	{
+		TSwap( t.x[1], t.x[2] );
+		TSwap( t.y[1], t.y[2] );
+		TSwap( t.z[1], t.z[2] );
+	}
+
+	// find rows whose pixel centers can lie inside the triangle
+	const F4 minY = smallest( smallest( t.y[0], t.y[1] ), t.y[2] );
+	const F4 maxY = largest( largest( t.y[0], t.y[1] ), t.y[2] );
+	const F4 minX = smallest( smallest( t.x[0], t.x[1] ), t.x[2] );
+	const F4 maxX = largest( largest( t.x[0], t.x[1] ), t.x[2] );
+
+	if( maxX < 0.0f || minX > rxOCCLUSION_BUFFER_WIDTH || maxY < 0.0f || minY > rxOCCLUSION_BUFFER_HEIGHT ) {
+		return;
+	}
+
+	t.minY = largest( Math::Ftoi( Math::Ceil( minY - 0.5f ) ), 0 );
+	t.maxY = smallest( Math::Ftoi( Math::Floor( maxY - 0.5f ) ), rxOCCLUSION_BUFFER_HEIGHT - 1 );
+
+	if( t.minY > t.maxY ) {
+		return;
+	}
+
+	m_triangles.Add( t );
+}
+
+void rxOcclusionBuffer::End( AsyncJobQueue* jobQueue )
+{
+	if( m_triangles.IsEmpty() ) {
+		return;
+	}
+
+	// rasterize triangles and build fine levels of the hierarchy
+	RasterizeOcclusionBands		rasterizeBands;
+	rasterizeBands.buffer = this;
+
+	ParallelFor( jobQueue, 0, rxOCCLUSION_NUM_BANDS, 1, rasterizeBands );
+
+	// build the remaining coarse levels
+	for( UINT iLevel = NUM_LEVELS_BUILT_PER_BAND; iLevel < rxOCCLUSION_NUM_LEVELS; iLevel++ )
+	{
+		DownsampleRows( m_depth.ToPtr(), m_levelOffsets, iLevel, 0, GetLevelHeight( iLevel ) );
+	}
+}
+
+void rxOcclusionBuffer::RasterizeBand( UINT iBand )
+{
+	const INT bandMinY = iBand * rxOCCLUSION_BAND_HEIGHT;
+	const INT bandMaxY = bandMinY + rxOCCLUSION_BAND_HEIGHT - 1;
+
+	F4* depth = m_depth.ToPtr();
+
+	// clear the band
+	{
+		const __m128 farDepth = _mm_set1_ps( 1.0f );
+
+		F4* bandStart = depth + bandMinY * rxOCCLUSION_BUFFER_WIDTH;
+		for( UINT i = 0; i < rxOCCLUSION_BAND_HEIGHT * rxOCCLUSION_BUFFER_WIDTH; i += 4 )
+		{
+			_mm_store_ps( bandStart + i, farDepth );
+		}
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+
+	const UINT numTriangles = m_triangles.Num();
+	const rxOccluderTriangle* triangles = m_triangles.ToPtr();
+
+	for( UINT iTriangle = 0; iTriangle < numTriangles; iTriangle++ )
+	{
+		const rxOccluderTriangle& t = triangles[ iTriangle ];
+
+		if( t.maxY < bandMinY || t.minY > bandMaxY ) {
+			continue;
+		}
+
+		const INT minY = largest( t.minY, bandMinY );
+		const INT maxY = smallest( t.maxY, bandMaxY );
+
+		const F4 triMinX = smallest( smallest( t.x[0], t.x[1] ), t.x[2] );
+		const F4 triMaxX = largest( largest( t.x[0], t.x[1] ), t.x[2] );
+
+		// start at a multiple of four for aligned stores
+		const INT minX = largest( Math::Ftoi( Math::Ceil( triMinX - 0.5f ) ), 0 ) & ~3;
+		const INT maxX = smallest( Math::Ftoi( Math::Floor( triMaxX - 0.5f ) ), rxOCCLUSION_BUFFER_WIDTH - 1 );
+
+		if( minX > maxX ) {
+			continue;
+		}
+
+		// edge functions: E(x,y) = A*x + B*y + C, positive inside the triangle
+
+		F4 A[3], B[3], C[3];
+		for( UINT i = 0; i < 3; i++ )
+		{
+			const UINT j = (i + 1) % 3;
+			A[i] = t.y[i] - t.y[j];
+			B[i] = t.x[j] - t.x[i];
+			C[i] = t.x[i] * t.y[j] - t.x[j] * t.y[i];
+		}
+
+		// depth is interpolated linearly in screen space: Z(x,y) = zA*x + zB*y + zC;
+		// edge i is opposite to vertex (i + 2) % 3
+
+		const F4 area = C[0] + C[1] + C[2];
+		const F4 invArea = 1.0f / area;
+
+		const F4 zA = (A[1] * t.z[0] + A[2] * t.z[1] + A[0] * t.z[2]) * invArea;
+		const F4 zB = (B[1] * t.z[0] + B[2] * t.z[1] + B[0] * t.z[2]) * invArea;
+		const F4 zC = (C[1] * t.z[0] + C[2] * t.z[1] + C[0] * t.z[2]) * invArea;
+
+		const __m128 A0 = _mm_set1_ps( A[0] ), A1 = _mm_set1_ps( A[1] ), A2 = _mm_set1_ps( A[2] );
+		const __m128 vZA = _mm_set1_ps( zA );
+
+		for( INT y = minY; y <= maxY; y++ )
+		{
+			const F4 py = (F4)y + 0.5f;
+
+			const __m128 rowE0 = _mm_set1_ps( B[0] * py + C[0] );
+			const __m128 rowE1 = _mm_set1_ps( B[1] * py + C[1] );
+			const __m128 rowE2 = _mm_set1_ps( B[2] * py + C[2] );
+			const __m128 rowZ = _mm_set1_ps( zB * py + zC );
+
+			F4* row = depth + y * rxOCCLUSION_BUFFER_WIDTH;
+
+			for( INT x = minX; x <= maxX; x += 4 )
+			{
+				const __m128 px = _mm_add_ps( _mm_set1_ps( (F4)x ), laneOffsets );
+
+				const __m128 e0 = _mm_add_ps( _mm_mul_ps( A0, px ), rowE0 );
+				const __m128 e1 = _mm_add_ps( _mm_mul_ps( A1, px ), rowE1 );
+				const __m128 e2 = _mm_add_ps( _mm_mul_ps( A2, px ), rowE2 );
+				const __m128 z = _mm_add_ps( _mm_mul_ps( vZA, px ), rowZ );
+
+				const __m128 oldDepth = _mm_load_ps( row + x );
+
+				__m128 mask = _mm_and_ps( _mm_cmpge_ps( e0, zero ), _mm_cmpge_ps( e1, zero ) );
+				mask = _mm_and_ps( mask, _mm_cmpge_ps( e2, zero ) );
+				mask = _mm_and_ps( mask, _mm_cmplt_ps( z, oldDepth ) );
+
+				const __m128 newDepth = _mm_or_ps( _mm_and_ps( mask, z ), _mm_andnot_ps( mask, oldDepth ) );
+
+				_mm_store_ps( row + x, newDepth );
+			}
+		}
+	}
+
+	// build the levels of the hierarchy covered by this band
+	for( UINT iLevel = 1; iLevel < NUM_LEVELS_BUILT_PER_BAND; iLevel++ )
+	{
+		DownsampleRows( depth, m_levelOffsets, iLevel, bandMinY >> iLevel, (bandMaxY + 1) >> iLevel );
+	}
+}
+
+bool rxOcclusionBuffer::IsVisible( const AABB& worldBounds ) const
+{
+	if( m_triangles.IsEmpty() ) {
+		return true;
+	}
+
+	// project the corners of the box onto the screen
+
+	const Vec3D& mins = worldBounds.GetMin();
+	const Vec3D& maxs = worldBounds.GetMax();
+
+	F4 minX = +MX_INFINITY, maxX = -MX_INFINITY;
+	F4 minY = +MX_INFINITY, maxY = -MX_INFINITY;
+	F4 minZ = +MX_INFINITY;
+
+	for( UINT iCorner = 0; iCorner < 8; iCorner++ )
+	{
+		const float4 corner = XMVectorSet(
+			(iCorner & 1) ? maxs.x : mins.x,
+			(iCorner & 2) ? maxs.y : mins.y,
+			(iCorner & 4) ? maxs.z : mins.z,
+			1.0f
+		);
+
+		const float4 clipPos = XMVector3Transform( corner, m_viewProjection );
+
+		const F4 w = XMVectorGetW( clipPos );
+		const F4 z = XMVectorGetZ( clipPos );
+
+		// the box intersects the near plane
+		if( z < 0.0f || w <= 0.0f ) {
+			return true;
+		}
+
+		const F4 invW = 1.0f / w;
+
+		const F4 sx = ( XMVectorGetX( clipPos ) * invW * 0.5f + 0.5f ) * rxOCCLUSION_BUFFER_WIDTH;
+		const F4 sy = ( 0.5f - XMVectorGetY( clipPos ) * invW * 0.5f ) * rxOCCLUSION_BUFFER_HEIGHT;
+
+		minX = smallest( minX, sx );
+		maxX = largest( maxX, sx );
+		minY = smallest( minY, sy );
+		maxY = largest( maxY, sy );
+		minZ = smallest( minZ, z * invW );
+	}
+
+	// find pixels touched by the screen-space rectangle
+
+	const INT x0 = largest( Math::Ftoi( Math::Floor( minX ) ), 0 );
+	const INT x1 = smallest( Math::Ftoi( Math::Floor( maxX ) ), rxOCCLUSION_BUFFER_WIDTH - 1 );
+	const INT y0 = largest( Math::Ftoi( Math::Floor( minY ) ), 0 );
+	const INT y1 = smallest( Math::Ftoi( Math::Floor( maxY ) ), rxOCCLUSION_BUFFER_HEIGHT - 1 );
+
+	// the box is off-screen, leave it to frustum culling
+	if( x0 > x1 || y0 > y1 ) {
+		return true;
+	}
+
+	// select the finest level where the rectangle covers at most 4x4 texels
+
+	UINT level = 0;
+	while( level < rxOCCLUSION_NUM_LEVELS - 1
+		&& ( (x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4 ) )
+	{
+		level++;
+	}
+
+	const UINT levelWidth = GetLevelWidth( level );
+	const F4* levelDepth = m_depth.ToPtr() + m_levelOffsets[ level ];
+
+	// the box is hidden if its nearest point is behind the farthest occluder depth in all texels
+
+	for( INT y = (y0 >> level); y <= (y1 >> level); y++ )
+	{
+		const F4* row = levelDepth + y * levelWidth;
+
+		for( INT x = (x0 >> level); x <= (x1 >> level); x++ )
+		{
+			if( minZ <= row[ x ] ) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+F4 rxOcclusionBuffer::GetDepth( UINT level, UINT x, UINT y ) const
+{
+	Assert( level < rxOCCLUSION_NUM_LEVELS );
+	Assert( x < GetLevelWidth( level ) && y < GetLevelHeight( level ) );
+
+	return m_depth[ m_levelOffsets[ level ] + y * GetLevelWidth( level ) + x ];
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
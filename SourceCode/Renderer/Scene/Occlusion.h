@@ -0,0 +1,126 @@
+/*
+=============================================================================
+	File:	Occlusion.h
+	Desc:	Software occlusion culling with a low-resolution depth buffer.
+=============================================================================
+*/
+#pragma once
+
+#include <Renderer/Common.h>
+
+class AsyncJobQueue;
+
+enum
+{
+	// size of the depth buffer, the width must be a multiple of four
+	rxOCCLUSION_BUFFER_WIDTH = 256,
+	rxOCCLUSION_BUFFER_HEIGHT = 128,
+
+	// the depth buffer is split into horizontal bands which are rasterized in parallel
+	rxOCCLUSION_BAND_HEIGHT = 8,
+	rxOCCLUSION_NUM_BANDS = rxOCCLUSION_BUFFER_HEIGHT / rxOCCLUSION_BAND_HEIGHT,
+
+	// the number of levels in the hierarchical depth buffer (including the full-resolution level)
+	rxOCCLUSION_NUM_LEVELS = 6,
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxOccluder
+
+	simplified geometry (e.g. walls, floors, large static meshes)
+	which is rendered into the occlusion buffer.
+	it must lie inside visible geometry so that it doesn't hide anything visible.
+-----------------------------------------------------------------------------
+*/
+struct rxOccluder
+{
+	TList< Vec3D >	m_vertices;	// in world space
+	TList< U4 >		m_indices;	// triangle list
+	AABB			m_bounds;	// in world space
+
+public:
+	rxOccluder();
+
+	// copies the triangle list and computes its bounds
+	void Set( const Vec3D* vertices, UINT numVertices, const U4* indices, UINT numIndices );
+};
+
+/*
+-----------------------------------------------------------------------------
+	rxOccluderTriangle
+
+	triangle in screen space (pixels, z/w depth)
+-----------------------------------------------------------------------------
+*/
+struct rxOccluderTriangle
+{
+	F4		x[3];
+	F4		y[3];
+	F4		z[3];
+	INT		minY, maxY;	// covered rows (inclusive), used for skipping triangles outside bands
+};
+mxDECLARE_POD_TYPE( rxOccluderTriangle );
+
+/*
+-----------------------------------------------------------------------------
+	rxOcclusionBuffer
+
+	occluders are transformed and clipped in the calling thread,
+	then horizontal bands of the depth buffer are rasterized on worker threads with SSE.
+	bounding boxes are tested against a hierarchy of farthest depths
+	so that large boxes touch only a few texels.
+
+	uses only the CPU so it works without a graphics device.
+-----------------------------------------------------------------------------
+*/
+mxALIGN_16(class) rxOcclusionBuffer
+{
+public:
+	rxOcclusionBuffer();
+	~rxOcclusionBuffer();
+
+	// clears the depth buffer and sets the view-projection matrix for the following calls
+	void Begin( mat4_carg viewProjection );
+
+	// transforms and clips the triangles of the occluder
+	void AddOccluder( const rxOccluder& occluder );
+
+	// rasterizes all added occluders and builds the depth hierarchy
+	void End( AsyncJobQueue* jobQueue = nil );
+
+	// returns false if the box is fully hidden behind occluders
+	bool IsVisible( const AABB& worldBounds ) const;
+
+	// returns true if anything has been rendered since the last call to Begin()
+	bool HasOccluders() const { return m_triangles.Num() > 0; }
+
+	UINT GetNumTriangles() const { return m_triangles.Num(); }
+
+	// returns the farthest depth in the given texel of the given level
+	F4 GetDepth( UINT level, UINT x, UINT y ) const;
+
+public_internal:
+	void RasterizeBand( UINT iBand );
+
+private:
+	void ClipAndAddTriangle( const float4& v0, const float4& v1, const float4& v2 );
+	void AddScreenTriangle( const float4& v0, const float4& v1, const float4& v2 );
+
+private:
+	float4x4		m_viewProjection;
+
+	TList< rxOccluderTriangle >	m_triangles;
+	TList< float4 >				m_clipVerts;	// scratch memory for transformed vertices of occluders
+
+	// all levels of the depth hierarchy (the full-resolution buffer comes first),
+	// each texel of a coarse level holds the farthest depth of the four texels below it
+	TList< F4 >		m_depth;
+	UINT			m_levelOffsets[ rxOCCLUSION_NUM_LEVELS ];
+
+	NO_COPY_CONSTRUCTOR(rxOcclusionBuffer);
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
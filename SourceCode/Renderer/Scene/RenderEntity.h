@@ -21,7 +21,7 @@
 struct rxEntityViewContext
 {
 	const rxSceneContext *	s;
-	rxRenderQueue *			q;
+	rxBatchQueue *			q;
 	//UINT				iEntity;
 };
 
@@ -8,6 +8,10 @@
 #include <Renderer/Util/BatchRenderer.h>
 #include <Renderer/Pipeline/Shadows.h>
 #include <Renderer/Pipeline/RenderQueue.h>
+#include <Renderer/Pipeline/DeferredLighting.h>
+#include <Renderer/Pipeline/Backend.h>
+
+#include <Base/JobSystem/ParallelFor.h>
 
 #include "RenderWorld.h"
 
@@ -20,7 +24,6 @@
 */
 mxDEFINE_CLASS(rxRenderWorld);
 mxBEGIN_REFLECTION(rxRenderWorld)
-	//mxMEMBER_FIELD( m_bounds )
 	mxMEMBER_FIELD( m_models )
 
 	mxMEMBER_FIELD( m_dirLights )
@@ -30,7 +33,14 @@ mxBEGIN_REFLECTION(rxRenderWorld)
 mxEND_REFLECTION
 
 rxRenderWorld::rxRenderWorld()
+	: m_modelTree( &m_modelClient )
+	, m_entityTree( &m_entityClient )
 {
+	m_modelClient.world = this;
+	m_entityClient.world = this;
+	m_modelTreeDirty = true;
+	m_modelBoundsInvalid = false;
+	m_framePacket = nil;
 }
 
 rxRenderWorld::~rxRenderWorld()
@@ -41,13 +51,16 @@ void rxRenderWorld::ReserveNumEntities( UINT count )
 	Assert( count <= MAX_RENDER_ENTITIES );
 	count = smallest( count, MAX_RENDER_ENTITIES );
 	m_entities.Reserve( count );
+	m_entityNodes.Reserve( count );
 }
 
 void rxRenderWorld::RegisterEntity( rxRenderEntity* newRenderEntity )
 {
 	Assert( m_entities.Num() <= MAX_RENDER_ENTITIES );
 
+	const UINT entityIndex = m_entities.Num();
 	m_entities.Add( newRenderEntity );
+	m_entityNodes.Add( m_entityTree.Insert( entityIndex ) );
 }
 
 void rxRenderWorld::UnregisterEntity( rxRenderEntity* theRenderEntity )
@@ -56,7 +69,15 @@ void rxRenderWorld::UnregisterEntity( rxRenderEntity* theRenderEntity )
 
 	CHK_VRET_IF_NOT( entityIndex != INDEX_NONE );
 
+	m_entityTree.Remove( m_entityNodes[ entityIndex ] );
+
 	m_entities.RemoveAt_Fast( entityIndex );
+	m_entityNodes.RemoveAt_Fast( entityIndex );
+
+	// the last entity has been moved into the freed place
+	if( entityIndex < m_entities.Num() ) {
+		m_entityTree.SetActor( m_entityNodes[ entityIndex ], entityIndex );
+	}
 }
 
 UINT rxRenderWorld::GetNumEntities()
@@ -67,6 +88,214 @@ UINT rxRenderWorld::GetNumEntities()
 void rxRenderWorld::Clear()
 {
 	m_entities.Empty();
+	m_entityNodes.Empty();
+	m_entityTree.Clear();
+}
+
+void rxRenderWorld::OnModelMoved( UINT modelIndex )
+{
+	m_movedModels.Add( modelIndex );
+}
+
+void rxRenderWorld::rfMarkMovedModels( const UINT* movedModels, UINT numMovedModels, bool treeDirty )
+{
+	if( treeDirty ) {
+		m_modelTreeDirty = true;
+	}
+	if( m_modelTreeDirty ) {
+		return;
+	}
+
+	// models are never removed so their handles in the tree are equal to their indices
+	const UINT numObjects = m_modelTree.GetNumObjects();
+
+	for( UINT i = 0; i < numMovedModels; i++ )
+	{
+		if( movedModels[i] < numObjects ) {
+			m_modelTree.OnObjectMoved( movedModels[i] );
+		}
+	}
+}
+
+void rxRenderWorld::UpdateModelTree()
+{
+	// rendering live data on the simulation thread
+	if( m_framePacket == nil )
+	{
+		this->rfMarkMovedModels( m_movedModels.ToPtr(), m_movedModels.Num(), m_modelBoundsInvalid );
+		m_movedModels.Empty();
+		m_modelBoundsInvalid = false;
+	}
+
+	if( m_modelTreeDirty )
+	{
+		m_modelTree.Clear();
+		m_modelTreeDirty = false;
+	}
+
+	// models added after the packet has been extracted are inserted with the next packet
+	const UINT numModels = this->rfGetNumModels();
+
+	for( UINT iModel = m_modelTree.GetNumObjects(); iModel < numModels; iModel++ )
+	{
+		const TreeNodeID handle = m_modelTree.Insert( iModel );
+		Assert( handle == iModel );
+		(void)handle;
+	}
+
+	m_modelTree.Update();
+}
+
+rxTransformHandle rxRenderWorld::AttachModel( UINT modelIndex, rxTransformHandle parent )
+{
+	rxModel & model = m_models[ modelIndex ];
+	Assert( model.m_transformNode == INDEX_NONE );
+
+	const rxTransformHandle node = m_transforms.Add( parent, modelIndex );
+	m_transforms.SetLocalTransform( node, model.m_localToWorld );
+	m_transforms.SetLocalBounds( node, model.m_localAABB );
+
+	model.m_transformNode = node;
+
+	return node;
+}
+
+void rxRenderWorld::UpdateTransforms()
+{
+	m_transforms.Update( GetGlobalJobQueue() );
+
+	// copy the results into moved models
+
+	const UINT numChangedNodes = m_transforms.GetNumChangedNodes();
+	const rxTransformHandle* changedNodes = m_transforms.GetChangedNodes();
+
+	for( UINT i = 0; i < numChangedNodes; i++ )
+	{
+		const rxTransformHandle node = changedNodes[ i ];
+		const UINT modelIndex = m_transforms.GetUserData( node );
+
+		if( modelIndex != INDEX_NONE )
+		{
+			rxModel & model = m_models[ modelIndex ];
+			model.m_localToWorld = m_transforms.GetWorldTransform( node );
+			model.m_worldAABB = m_transforms.GetWorldBounds( node );
+
+			this->OnModelMoved( modelIndex );
+		}
+	}
+}
+
+void rxRenderWorld::ModelBoundsClient::GetBoundingBox( ActorID entity, AABB &bounds )
+{
+	rxAABB_To_AABB( world->rfGetModelBounds( world->m_models[ entity ] ), bounds );
+}
+
+UINT rxRenderWorld::ModelBoundsClient::ExpectedNumObjects() const
+{
+	return 1024;
+}
+
+void rxRenderWorld::EntityBoundsClient::GetBoundingBox( ActorID entity, AABB &bounds )
+{
+	rxAABB	aabb;
+	world->m_entities[ entity ]->GetWorldAABB( aabb );
+	rxAABB_To_AABB( aabb, bounds );
+}
+
+UINT rxRenderWorld::EntityBoundsClient::ExpectedNumObjects() const
+{
+	return 256;
+}
+
+void rxRenderWorld::ExtractFramePacket( const rxView& camera, rxFramePacket &packet )
+{
+	mxPROFILE_SCOPE("Extract frame packet");
+
+	this->UpdateTransforms();
+
+	const UINT numModels = m_models.Num();
+	const UINT numDirLights = m_dirLights.Num();
+	const UINT numLocalLights = m_localLights.Num();
+
+	const UINT numMovedModels = m_movedModels.Num();
+
+	packet.arena.Reset(
+		rxFrameArena::GetAlignedSize( numModels * sizeof(packet.modelTransforms[0]) ) +
+		rxFrameArena::GetAlignedSize( numModels * sizeof(packet.modelBounds[0]) ) +
+		rxFrameArena::GetAlignedSize( numMovedModels * sizeof(packet.movedModels[0]) ) +
+		rxFrameArena::GetAlignedSize( numDirLights * sizeof(packet.dirLights[0]) ) +
+		rxFrameArena::GetAlignedSize( numLocalLights * sizeof(packet.localLights[0]) )
+		);
+
+	packet.camera = camera;
+
+	// copy transforms and bounds of all models
+
+	packet.numModels = numModels;
+	packet.modelTransforms = packet.arena.AllocArray< float4x4 >( numModels );
+	packet.modelBounds = packet.arena.AllocArray< rxAABB >( numModels );
+
+	const rxModel* models = m_models.ToPtr();
+
+	for( UINT iModel = 0; iModel < numModels; iModel++ )
+	{
+		packet.modelTransforms[ iModel ] = models[ iModel ].m_localToWorld;
+		packet.modelBounds[ iModel ] = models[ iModel ].m_worldAABB;
+	}
+
+	// hand over the changes to the render thread, which owns the culling tree
+
+	packet.numMovedModels = numMovedModels;
+	packet.movedModels = packet.arena.AllocArray< UINT >( numMovedModels );
+	MemCopy( packet.movedModels, m_movedModels.ToPtr(), numMovedModels * sizeof(packet.movedModels[0]) );
+	packet.modelTreeDirty = m_modelBoundsInvalid;
+
+	m_movedModels.Empty();
+	m_modelBoundsInvalid = false;
+
+	// directional lights affect everything
+
+	packet.numDirLights = numDirLights;
+	packet.dirLights = packet.arena.AllocArray< rxParallelLight >( numDirLights );
+	MemCopy( packet.dirLights, m_dirLights.ToPtr(), numDirLights * sizeof(packet.dirLights[0]) );
+
+	// keep only local lights whose range intersects the view frustum
+
+	rxSceneContext	sceneContext( camera, *this );
+
+	rxCullingPlanes		cameraFrustum;
+	cameraFrustum.Set( ViewFrustum( as_matrix4( sceneContext.viewProjectionMatrix ) ) );
+
+	packet.numLocalLights = 0;
+	packet.localLights = packet.arena.AllocArray< rxLocalLight >( numLocalLights );
+
+	for( UINT iLocalLight = 0; iLocalLight < numLocalLights; iLocalLight++ )
+	{
+		const rxLocalLight& light = m_localLights[ iLocalLight ];
+
+		const Vec3D& center = light.GetOrigin();
+		const FLOAT radius = light.GetRadius();
+
+		AABB	lightBounds;
+		lightBounds.mPoints[0].Set( center.x - radius, center.y - radius, center.z - radius );
+		lightBounds.mPoints[1].Set( center.x + radius, center.y + radius, center.z + radius );
+
+		if( cameraFrustum.Classify( lightBounds ) != ESpatialRelation::Outside )
+		{
+			MemCopy( &packet.localLights[ packet.numLocalLights++ ], &light, sizeof(light) );
+		}
+	}
+}
+
+void rxRenderWorld::rfSetFramePacket( const rxFramePacket* packet )
+{
+	m_framePacket = packet;
+
+	if( packet != nil )
+	{
+		// the tree will be refitted with the bounds from the packet
+		this->rfMarkMovedModels( packet->movedModels, packet->numMovedModels, packet->modelTreeDirty );
+	}
 }
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -83,74 +312,158 @@ static void SubmitVisiblePrimCallback( ActorID actorHandle, void* userData )
 	args.entities[ actorHandle ]->rfSubmitBatches( *args.context );
 }
 
-void rxRenderWorld::rfBuildDrawList( const rxSceneContext& sceneContext, rxRenderQueue & q )
+// distributes models visible in several views among per-view lists
+static void ScatterVisibleModelCallback( ActorID actorHandle, U4 viewMask, void* userData )
 {
-	// Find any potentially visible objects.
-
-	rxEntityViewContext		entityViewContext;
-	entityViewContext.q = &q;
-	entityViewContext.s = &sceneContext;
+	TList< UINT >* viewModels = c_cast(TList< UINT >*) userData;
 
+	while( viewMask )
+	{
+		DWORD iView;
+		_BitScanForward( &iView, viewMask );
+		viewModels[ iView ].Add( actorHandle );
+		viewMask &= viewMask - 1;
+	}
+}
 
-	// Add model surfaces.
-
-	//{
-	//	const UINT numAabbs = m_bounds.Num();
+static void CollectVisibleModelCallback( ActorID actorHandle, void* userData )
+{
+	TList< UINT >* visibleModels = c_cast(TList< UINT >*) userData;
+	visibleModels->Add( actorHandle );
+}
 
-	//	for( UINT i = 0; i < numAabbs; i++ )
-	//	{
-	//		const rxAABB & aabb = m_bounds[ i ];
+enum
+{
+	// visible models are split into chunks which are submitted in parallel into separate batch queues
+	MODEL_CHUNKS_PER_THREAD = 4,
 
-	//		if( sceneContext.frustum.TestAABB( aabb ) )
-	//		{
-	//			m_visibleModels.Add( &models[i] );
-	//		}
-	//	}
-	//}
+	// batches of generic entities are collected into the last queue
+	ENTITY_BATCH_QUEUE = MAX_BATCH_QUEUES - 1,
+	MAX_MODEL_CHUNKS = ENTITY_BATCH_QUEUE,
+};
 
+namespace
+{
+	struct SubmitVisibleModels
 	{
-		const UINT numModels = m_models.Num();
-		rxModel* models = m_models.ToPtr();
-
-		for( UINT i = 0; i < numModels; i++ )
+		const rxRenderWorld *		world;
+		rxModel *					models;
+		const UINT *				visibleModels;
+		UINT						numVisibleModels;
+		UINT						numChunks;
+		const rxSceneContext *		sceneContext;
+		rxRenderQueue *				renderQueue;
+		const rxOcclusionBuffer *	occlusionBuffer;	// nil if occlusion culling is disabled
+		UINT *						numOccludedModels;	// per chunk
+		UINT *						numOccludedBatches;	// per chunk
+
+	public:
+		void operator () ( UINT firstChunk, UINT lastChunk ) const
 		{
-			rxModel & model = models[ i ];
-
-			if( sceneContext.frustum.TestAABB( model.m_worldAABB ) )
+			for( UINT iChunk = firstChunk; iChunk < lastChunk; iChunk++ )
 			{
-				model.SubmitBatches( entityViewContext );
+				rxEntityViewContext		entityViewContext;
+				entityViewContext.s = sceneContext;
+				entityViewContext.q = &renderQueue->batchQueues[ iChunk ];
+
+				numOccludedModels[ iChunk ] = 0;
+				numOccludedBatches[ iChunk ] = 0;
+
+				const UINT start = (U8)numVisibleModels * iChunk / numChunks;
+				const UINT end = (U8)numVisibleModels * (iChunk + 1) / numChunks;
+
+				for( UINT i = start; i < end; i++ )
+				{
+					rxModel & model = models[ visibleModels[ i ] ];
+
+					if( occlusionBuffer != nil )
+					{
+						AABB	worldBounds;
+						rxAABB_To_AABB( world->rfGetModelBounds( model ), worldBounds );
+
+						if( !occlusionBuffer->IsVisible( worldBounds ) )
+						{
+							numOccludedModels[ iChunk ]++;
+							numOccludedBatches[ iChunk ] += model.m_batches.Num();
+							continue;
+						}
+					}
+
+					model.SubmitBatches( entityViewContext );
+				}
 			}
 		}
-	}
+	};
 
-	// Collect graphics primitives from generic entities.
+}//namespace
 
-#if USE_SPATIAL_DATABASE
+void rxRenderWorld::rfBuildDrawList( const rxSceneContext& sceneContext, rxRenderQueue & q )
+{
+	// Find any potentially visible objects.
+
+	AsyncJobQueue* jobQueue = GetGlobalJobQueue();
+
+	rxEntityViewContext		entityViewContext;
+	entityViewContext.q = &q.batchQueues[ ENTITY_BATCH_QUEUE ];
+	entityViewContext.s = &sceneContext;
 
-	SubmitVisiblePrimArgs	args;
-	args.context = &entityViewContext;
-	args.entities = m_entities.ToPtr();
 
-	m_entityTree.ProcessVisibleObjects( sceneContext, &SubmitVisiblePrimCallback, &args );
+	// Add model surfaces.
 
-#else
+	this->rfCullViews( sceneContext );
 
-	rxRenderEntity** pEnts = m_entities.ToPtr();
-	const UINT numEnts = m_entities.Num();
+	const bool bTestOcclusion = g_cvar_enable_occlusion_culling && this->rfRenderOccluders( sceneContext );
 
-	for( UINT iEntity = 0; iEntity < numEnts; iEntity++ )
 	{
-		rxRenderEntity* ent = pEnts[ iEntity ];
+		const TList< UINT >& cameraModels = m_viewModels[ CAMERA_VIEW ];
 
-		rxAABB	aabb;
-		ent->GetWorldAABB( aabb );
+		const UINT numVisibleModels = cameraModels.Num();
 
-		if( sceneContext.frustum.TestAABB( aabb ) ) {
-			ent->rfSubmitBatches( entityViewContext );
+		UINT numChunks = 1;
+		if( jobQueue ) {
+			numChunks = smallest<UINT>( jobQueue->NumThreads() * MODEL_CHUNKS_PER_THREAD, MAX_MODEL_CHUNKS );
+		}
+		numChunks = largest<UINT>( smallest( numChunks, numVisibleModels ), 1 );
+
+		UINT	numOccludedModels[ MAX_MODEL_CHUNKS ];
+		UINT	numOccludedBatches[ MAX_MODEL_CHUNKS ];
+
+		SubmitVisibleModels		submitModels;
+		submitModels.world = this;
+		submitModels.models = m_models.ToPtr();
+		submitModels.visibleModels = cameraModels.ToPtr();
+		submitModels.numVisibleModels = numVisibleModels;
+		submitModels.numChunks = numChunks;
+		submitModels.sceneContext = &sceneContext;
+		submitModels.renderQueue = &q;
+		submitModels.occlusionBuffer = bTestOcclusion ? &m_occlusionBuffer : nil;
+		submitModels.numOccludedModels = numOccludedModels;
+		submitModels.numOccludedBatches = numOccludedBatches;
+
+		// each chunk writes only into its own batch queue so no locking is needed
+		ParallelFor( jobQueue, 0, numChunks, 1, submitModels );
+
+		for( UINT iChunk = 0; iChunk < numChunks; iChunk++ )
+		{
+			RX_STATS(gfxStats.numOccludedModels += numOccludedModels[ iChunk ]);
+			RX_STATS(gfxStats.numOccludedBatches += numOccludedBatches[ iChunk ]);
 		}
 	}
 
-#endif
+	// Collect graphics primitives from generic entities.
+
+	// entities don't report their movement so their bounds are refitted every frame
+	if( m_entities.Num() )
+	{
+		m_entityTree.OnAllObjectsMoved();
+		m_entityTree.Update();
+
+		SubmitVisiblePrimArgs	args;
+		args.context = &entityViewContext;
+		args.entities = m_entities.ToPtr();
+
+		m_entityTree.FrustumQuery( m_cullViews[ CAMERA_VIEW ], &SubmitVisiblePrimCallback, &args );
+	}
 
 
 
@@ -163,10 +476,12 @@ void rxRenderWorld::rfBuildDrawList( const rxSceneContext& sceneContext, rxRende
 
 	// Collect global lights.
 
-	const UINT numDirLights = m_dirLights.Num();
+	const UINT numDirLights = this->rfGetNumDirLights();
+	rxParallelLight* dirLights = this->rfGetDirLights();
+
 	for( UINT iDirLight = 0; iDirLight < numDirLights; iDirLight++ )
 	{
-		rxParallelLight& rDirLight = m_dirLights[ iDirLight ];
+		rxParallelLight& rDirLight = dirLights[ iDirLight ];
 	
 		q.globalLights.AddFast_Unsafe( &rDirLight );
 	}
@@ -175,10 +490,12 @@ void rxRenderWorld::rfBuildDrawList( const rxSceneContext& sceneContext, rxRende
 	//	Find local lights.
 	//
 
-	const UINT numLocalLights = m_localLights.Num();
+	const UINT numLocalLights = this->rfGetNumLocalLights();
+	rxLocalLight* localLights = this->rfGetLocalLights();
+
 	for( UINT iLocalLight = 0; iLocalLight < numLocalLights; iLocalLight++ )
 	{
-		rxLocalLight& rLocalLight = m_localLights[ iLocalLight ];
+		rxLocalLight& rLocalLight = localLights[ iLocalLight ];
 
 		FASTBOOL bContainsEyePos = rLocalLight.EnclosesView( sceneContext );
 		if( bContainsEyePos ) {
@@ -192,68 +509,169 @@ void rxRenderWorld::rfBuildDrawList( const rxSceneContext& sceneContext, rxRende
 
 }
 
-void rxRenderWorld::rfGetDirLightShadowCasters( rxShadowCastingSet & shadowCasters )
+void rxRenderWorld::rfCullViews( const rxSceneContext& sceneContext )
 {
-	const UINT numModels = m_models.Num();
-	rxModel* models = m_models.ToPtr();
+	this->UpdateModelTree();
+
+	m_cullViews.Empty();
+
+	// the camera is always the first view
+	m_cullViews.Add().Set( ViewFrustum( as_matrix4( sceneContext.viewProjectionMatrix ) ) );
+
+	// add cascades of shadow-casting directional lights
 
-	for( UINT i = 0; i < numModels; i++ )
+	const UINT numDirLights = this->rfGetNumDirLights();
+	const rxParallelLight* dirLights = this->rfGetDirLights();
+
+	m_dirLightViews.SetNum( numDirLights );
+
+	for( UINT iDirLight = 0; iDirLight < numDirLights; iDirLight++ )
 	{
-		rxModel & model = models[ i ];
+		const rxParallelLight& light = dirLights[ iDirLight ];
 
-		shadowCasters.m_objects.Add( &model );
+		m_dirLightViews[ iDirLight ] = INDEX_NONE;
+
+		if( g_cvar_enable_directional_light_shadows && light.DoesCastShadows()
+			&& m_cullViews.Num() + NUM_SHADOW_CASCADES <= rxCULL_MAX_VIEWS )
+		{
+			m_dirLightViews[ iDirLight ] = m_cullViews.Num();
+
+			for( UINT iCascade = 0; iCascade < NUM_SHADOW_CASCADES; iCascade++ )
+			{
+				const float4x4 cascadeViewProjection = rxShadowManager::CalcCascadeViewProjection( sceneContext, light, iCascade );
+
+				m_cullViews.Add().Set( ViewFrustum( as_matrix4( cascadeViewProjection ) ) );
+			}
+		}
 	}
 
-//	rxRenderEntity** pEnts = m_entities.ToPtr();
-//	const UINT numEnts = m_entities.Num();
-//
-//	for( UINT iEntity = 0; iEntity < numEnts; iEntity++ )
-//	{
-//		rxRenderEntity* ent = pEnts[ iEntity ];
-//
-//		//rxAABB	aabb;
-//		//ent->GetAABB( aabb );
-//
-//		//if( sceneContext.frustum.IntersectsAABB(aabb) )
-//		//{
-//			shadowCasters.m_objects.Add(ent);
-//		//}
-//	}
+	// add shadow-casting spot lights
+
+	const UINT numLocalLights = this->rfGetNumLocalLights();
+	const rxLocalLight* localLights = this->rfGetLocalLights();
+
+	m_localLightViews.SetNum( numLocalLights );
+
+	for( UINT iLocalLight = 0; iLocalLight < numLocalLights; iLocalLight++ )
+	{
+		const rxLocalLight& light = localLights[ iLocalLight ];
+
+		m_localLightViews[ iLocalLight ] = INDEX_NONE;
+
+		if( light.m_lightType == Light_Spot
+			&& g_cvar_enable_spot_light_shadows && light.DoesCastShadows()
+			&& m_cullViews.Num() < rxCULL_MAX_VIEWS )
+		{
+			m_localLightViews[ iLocalLight ] = m_cullViews.Num();
+
+			const float4x4 lightViewMatrix = WorldMatrixToViewMatrix( CalcSpotLightWorldMatrix( &light ) );
+			const float4x4 lightViewProjection = XMMatrixMultiply( lightViewMatrix, CalcSpotLightProjectionMatrix( &light ) );
+
+			m_cullViews.Add().Set( ViewFrustum( as_matrix4( lightViewProjection ) ) );
+		}
+	}
+
+	// traverse the tree once for all views and distribute visible models among the views
+
+	const UINT numViews = m_cullViews.Num();
+
+	for( UINT iView = 0; iView < numViews; iView++ )
+	{
+		m_viewModels[ iView ].Empty();
+	}
+
+	m_modelTree.CullViews( m_cullViews.ToPtr(), numViews, &ScatterVisibleModelCallback, m_viewModels, GetGlobalJobQueue() );
+}
+
+bool rxRenderWorld::rfRenderOccluders( const rxSceneContext& sceneContext )
+{
+	mxPROFILE_SCOPE("Render occluders");
+
+	m_occlusionBuffer.Begin( sceneContext.viewProjectionMatrix );
+
+	const rxCullingPlanes& cameraFrustum = m_cullViews[ CAMERA_VIEW ];
+
+	const UINT numOccluders = m_occluders.Num();
+	for( UINT iOccluder = 0; iOccluder < numOccluders; iOccluder++ )
+	{
+		const rxOccluder& occluder = m_occluders[ iOccluder ];
+
+		if( cameraFrustum.Classify( occluder.m_bounds ) != ESpatialRelation::Outside ) {
+			m_occlusionBuffer.AddOccluder( occluder );
+		}
+	}
+
+	m_occlusionBuffer.End( GetGlobalJobQueue() );
+
+	RX_STATS(gfxStats.numOccluderTriangles += m_occlusionBuffer.GetNumTriangles());
+
+	return m_occlusionBuffer.HasOccluders();
+}
+
+void rxRenderWorld::rfGetDirLightShadowCasters(
+	const rxParallelLight& light,
+	UINT iCascade,
+	mat4_carg cascadeViewProjection,
+	rxShadowCastingSet & shadowCasters
+	)
+{
+	Assert( iCascade < NUM_SHADOW_CASCADES );
+
+	const UINT lightIndex = &light - this->rfGetDirLights();
+
+	if( lightIndex < m_dirLightViews.Num() && m_dirLightViews[ lightIndex ] != INDEX_NONE )
+	{
+		this->AddShadowCasters( m_viewModels[ m_dirLightViews[ lightIndex ] + iCascade ], shadowCasters );
+	}
+	else
+	{
+		this->CullShadowCasters( cascadeViewProjection, shadowCasters );
+	}
 }
 
 void rxRenderWorld::rfGetSpotLightShadowCasters(
-	const rxViewFrustum& lightFrustum,
+	const rxLocalLight& light,
+	mat4_carg lightViewProjection,
 	rxShadowCastingSet &shadowCasters
 	)
 {
-	const UINT numModels = m_models.Num();
-	rxModel* models = m_models.ToPtr();
+	const UINT lightIndex = &light - this->rfGetLocalLights();
 
-	for( UINT i = 0; i < numModels; i++ )
+	if( lightIndex < m_localLightViews.Num() && m_localLightViews[ lightIndex ] != INDEX_NONE )
 	{
-		rxModel & model = models[ i ];
+		this->AddShadowCasters( m_viewModels[ m_localLightViews[ lightIndex ] ], shadowCasters );
+	}
+	else
+	{
+		this->CullShadowCasters( lightViewProjection, shadowCasters );
+	}
+}
 
-		if( lightFrustum.TestAABB( model.m_worldAABB ) )
-		{
-			shadowCasters.m_objects.Add( &model );
-		}
+void rxRenderWorld::AddShadowCasters( const TList< UINT >& modelIndices, rxShadowCastingSet &shadowCasters )
+{
+	const UINT numCasters = modelIndices.Num();
+	rxModel* models = m_models.ToPtr();
+
+	shadowCasters.m_objects.Reserve( shadowCasters.m_objects.Num() + numCasters );
+
+	for( UINT i = 0; i < numCasters; i++ )
+	{
+		shadowCasters.m_objects.AddFast_Unsafe( &models[ modelIndices[ i ] ] );
 	}
+}
 
-	//rxRenderEntity** pEnts = m_entities.ToPtr();
-	//const UINT numEnts = m_entities.Num();
+// used for lights which didn't fit into the shared culling pass
+void rxRenderWorld::CullShadowCasters( mat4_carg lightViewProjection, rxShadowCastingSet &shadowCasters )
+{
+	this->UpdateModelTree();
 
-	//for( UINT iEntity = 0; iEntity < numEnts; iEntity++ )
-	//{
-	//	rxRenderEntity* ent = pEnts[ iEntity ];
+	rxCullingPlanes		frustumPlanes;
+	frustumPlanes.Set( ViewFrustum( as_matrix4( lightViewProjection ) ) );
 
-	//	rxAABB	aabb;
-	//	ent->GetWorldAABB( aabb );
+	m_visibleModels.Empty();
+	m_modelTree.FrustumQuery( frustumPlanes, &CollectVisibleModelCallback, &m_visibleModels );
 
-	//	if( lightFrustum.TestAABB(aabb) )
-	//	{
-	//		shadowCasters.m_objects.Add(ent);
-	//	}
-	//}
+	this->AddShadowCasters( m_visibleModels, shadowCasters );
 }
 
 //void rxRenderWorld::ForEachEntity( F_EntityIterator* pIterator, void* pUserData )
@@ -310,23 +728,30 @@ void rxRenderWorld::rfGetSpotLightShadowCasters(
 
 void rxRenderWorld::DebugDraw( const rxViewport* viewport, const rxSceneContext& sceneContext )
 {
-	//BatchRenderer & batchRenderer = gRenderer.GetDrawHelper();
+	if( g_cvar_debug_draw_spatial_database )
+	{
+		BatchRenderer & batchRenderer = gRenderer.GetDrawHelper();
 
-	//batchRenderer.SetTransform( sceneContext.viewProjectionMatrix );
+		batchRenderer.SetTransform( sceneContext.viewProjectionMatrix );
 
-	//if( g_cvar_debug_draw_spatial_database )
-	//{
-	//	m_entityTree.DebugDraw( sceneContext );
-	//}
+		m_modelTree.DebugDraw( sceneContext );
+		m_entityTree.DebugDraw( sceneContext );
 
-	//batchRenderer.Flush();
+		batchRenderer.Flush();
+	}
 }
 
 rxModel& rxRenderWorld::CreateModel()
 {
+	// the new model will be inserted into the culling tree by UpdateModelTree()
 	return m_models.Add();
 }
 
+rxOccluder& rxRenderWorld::CreateOccluder()
+{
+	return m_occluders.Add();
+}
+
 rxParallelLight& rxRenderWorld::CreateDirectionalLight()
 {
 	return m_dirLights.Add();
@@ -12,7 +12,10 @@
 #include <Renderer/Scene/Light.h>
 #include <Renderer/Scene/Model.h>
 #include <Renderer/Scene/SkyModel.h>
-#include <Renderer/Scene/SphereTree.h>
+#include <Renderer/Scene/SpatialBVH.h>
+#include <Renderer/Scene/Occlusion.h>
+#include <Renderer/Scene/FramePacket.h>
+#include <Renderer/Scene/TransformHierarchy.h>
 
 // hardcoded limits
 
@@ -21,17 +24,57 @@ enum { MAX_RENDER_ENTITIES = 4096*4 };	// 16 K in each world
 /*
 -----------------------------------------------------------------------------
 	rxRenderWorld
+
+	threading:
+	the simulation thread changes models and lights, calls OnModelMoved(), InvalidateModelBounds()
+	and ExtractFramePacket() - these never touch the culling trees.
+	the render thread (functions with the 'rf' prefix) owns m_modelTree, m_entityTree and culling scratch memory,
+	while a packet is bound it reads transforms, bounds and lights only from the packet
+	and applies the changes recorded in the packet to the model tree in rfSetFramePacket().
+	without packets both sides must run on the same thread.
 -----------------------------------------------------------------------------
 */
 class rxRenderWorld : public SBaseType
 {
-public:
-	// bounds of model instances for frustum culling
-	//TList< rxAABB >		m_bounds;
+	// provides bounds of models to m_modelTree (actor handles are model indices)
+	struct ModelBoundsClient : rxSpatialDatabase::IClientInfo
+	{
+		rxRenderWorld *	world;
+	public:
+		virtual void GetBoundingBox( ActorID entity, AABB &bounds ) override;
+		virtual UINT ExpectedNumObjects() const override;
+	};
+
+	// provides bounds of generic entities to m_entityTree (actor handles are entity indices)
+	struct EntityBoundsClient : rxSpatialDatabase::IClientInfo
+	{
+		rxRenderWorld *	world;
+	public:
+		virtual void GetBoundingBox( ActorID entity, AABB &bounds ) override;
+		virtual UINT ExpectedNumObjects() const override;
+	};
 
+	ModelBoundsClient	m_modelClient;	//+noserialize
+	EntityBoundsClient	m_entityClient;	//+noserialize
+
+public:
 	// graphics models for rendering
 	TList< rxModel >	m_models;
 
+	// hierarchy of world-space bounds of models for culling (render thread)
+	rxSpatialBVH		m_modelTree;	//+noserialize
+	bool				m_modelTreeDirty;	//+noserialize (true if the tree must be recreated from scratch)
+
+	// models moved since the last extracted packet (simulation thread)
+	TList< UINT >		m_movedModels;	//+noserialize
+	bool				m_modelBoundsInvalid;	//+noserialize (set by InvalidateModelBounds())
+
+	// transforms of attached models (e.g. props on characters, parts of vehicles)
+	rxTransformHierarchy	m_transforms;	//+noserialize
+
+	// simplified geometry for software occlusion culling
+	TList< rxOccluder >	m_occluders;	//+noserialize
+
 	// dynamic light sources
 	TList< rxParallelLight >	m_dirLights;
 	TList< rxLocalLight >		m_localLights;
@@ -39,9 +82,34 @@ public:
 	// generic graphics entities
 	TList< rxRenderEntity* >	m_entities;	//+noserialize
 
+	// bounds of generic entities, refitted each frame
+	rxSpatialBVH			m_entityTree;	//+noserialize
+	TList< TreeNodeID >		m_entityNodes;	//+noserialize (handle of each entity in m_entityTree)
+
 	// sky
 	rxSkyModel		m_skyModel;
 
+	// views culled in a single pass over the model tree:
+	// the camera (always the first view), cascades of shadow-casting directional lights and shadow-casting spot lights
+	enum { CAMERA_VIEW = 0 };
+	TList< rxCullingPlanes >	m_cullViews;	//+noserialize
+
+	// indices of visible models in each view
+	TList< UINT >	m_viewModels[ rxCULL_MAX_VIEWS ];	//+noserialize
+
+	// index of the first cascade view of each directional light (INDEX_NONE if there's none)
+	TList< U4 >		m_dirLightViews;	//+noserialize
+
+	// index of the view of each local light (INDEX_NONE if there's none)
+	TList< U4 >		m_localLightViews;	//+noserialize
+
+	// scratch memory for culling
+	TList< UINT >		m_visibleModels;	//+noserialize
+	rxOcclusionBuffer	m_occlusionBuffer;	//+noserialize
+
+	// snapshot read by the render thread instead of live data (nil if rendering live data)
+	const rxFramePacket *	m_framePacket;	//+noserialize
+
 public:
 	mxDECLARE_CLASS(rxRenderWorld,SBaseType);
 	mxDECLARE_REFLECTION;
@@ -59,20 +127,109 @@ public:
 
 	void Clear();
 
+	// must be called after world-space bounds of many models have been changed
+	void InvalidateModelBounds() { m_modelBoundsInvalid = true; }
+
+	// must be called after world-space bounds of the model have been changed,
+	// the model tree is refitted by the render thread after the next packet has been extracted
+	void OnModelMoved( UINT modelIndex );
+
+	// inserts new models into the tree used for culling and refits it (render thread)
+	void UpdateModelTree();
+
+private:
+	// Render thread.
+	void rfMarkMovedModels( const UINT* movedModels, UINT numMovedModels, bool treeDirty );
+
+public:
+
+	// puts the model into the transform hierarchy, its current transform becomes relative to the parent;
+	// the model must then be moved only via m_transforms.SetLocalTransform()
+	rxTransformHandle AttachModel( UINT modelIndex, rxTransformHandle parent = INDEX_NONE );
+
+	// recomputes world matrices and bounds of models in changed subtrees of m_transforms
+	void UpdateTransforms();
+
+	// copies transforms and bounds of models, lights and the camera into the packet,
+	// called on the simulation thread after all updates of the frame
+	void ExtractFramePacket( const rxView& camera, rxFramePacket &packet );
+
+	// makes the render thread read the packet instead of live data
+	// and marks models moved in the packet in the culling tree
+	// (the packet must stay unchanged until it's unbound with nil)
+	void rfSetFramePacket( const rxFramePacket* packet );
+
+	// Data seen by the render thread.
+
+	FORCEINLINE UINT rfGetNumModels() const
+	{
+		return m_framePacket != nil ? m_framePacket->numModels : m_models.Num();
+	}
+
+	FORCEINLINE const float4x4& rfGetModelTransform( const rxModel& model ) const
+	{
+		const UINT modelIndex = &model - m_models.ToPtr();
+		if( m_framePacket != nil && modelIndex < m_framePacket->numModels ) {
+			return m_framePacket->modelTransforms[ modelIndex ];
+		}
+		return model.m_localToWorld;
+	}
+	FORCEINLINE const rxAABB& rfGetModelBounds( const rxModel& model ) const
+	{
+		const UINT modelIndex = &model - m_models.ToPtr();
+		if( m_framePacket != nil && modelIndex < m_framePacket->numModels ) {
+			return m_framePacket->modelBounds[ modelIndex ];
+		}
+		return model.m_worldAABB;
+	}
+	FORCEINLINE UINT rfGetNumDirLights() const
+	{
+		return m_framePacket != nil ? m_framePacket->numDirLights : m_dirLights.Num();
+	}
+	FORCEINLINE rxParallelLight* rfGetDirLights() const
+	{
+		return m_framePacket != nil ? m_framePacket->dirLights : c_cast(rxParallelLight*) m_dirLights.ToPtr();
+	}
+	FORCEINLINE UINT rfGetNumLocalLights() const
+	{
+		return m_framePacket != nil ? m_framePacket->numLocalLights : m_localLights.Num();
+	}
+	FORCEINLINE rxLocalLight* rfGetLocalLights() const
+	{
+		return m_framePacket != nil ? m_framePacket->localLights : c_cast(rxLocalLight*) m_localLights.ToPtr();
+	}
+
 	void rfBuildDrawList( const rxSceneContext& sceneContext, rxRenderQueue & q );
 
-	// compute shadow casters for a directional light
-	void rfGetDirLightShadowCasters( rxShadowCastingSet & shadowCasters );
+	// tests models against the camera and all shadow-casting lights in one pass
+	// and collects visible models for each view, called by rfBuildDrawList()
+	void rfCullViews( const rxSceneContext& sceneContext );
+
+	// renders occluders inside the camera frustum into the occlusion buffer,
+	// returns false if there's nothing to test against, called by rfBuildDrawList()
+	bool rfRenderOccluders( const rxSceneContext& sceneContext );
+
+	// compute shadow casters for a cascade of a directional light
+	// (uses results of rfCullViews(), culls against the given matrix if the light hasn't been culled)
+	void rfGetDirLightShadowCasters(
+		const rxParallelLight& light,
+		UINT iCascade,
+		mat4_carg cascadeViewProjection,
+		rxShadowCastingSet & shadowCasters
+		);
 
 	// compute shadow casters for a spot light
+	// (uses results of rfCullViews(), culls against the given matrix if the light hasn't been culled)
 	void rfGetSpotLightShadowCasters(
-		const rxViewFrustum& lightFrustum,
+		const rxLocalLight& light,
+		mat4_carg lightViewProjection,
 		rxShadowCastingSet &shadowCasters
 		);
 
 	//virtual void ForEachEntity( F_EntityIterator* pIterator, void* pUserData ) override;
 
 	rxModel& CreateModel();
+	rxOccluder& CreateOccluder();
 	rxParallelLight& CreateDirectionalLight();
 	rxLocalLight& CreateLocalLight();
 
@@ -80,6 +237,10 @@ public:
 
 	rxSkyModel & GetSky() { return m_skyModel; }
 
+private:
+	void AddShadowCasters( const TList< UINT >& modelIndices, rxShadowCastingSet &shadowCasters );
+	void CullShadowCasters( mat4_carg lightViewProjection, rxShadowCastingSet &shadowCasters );
+
 public:	// Editor
 
 #if MX_EDITOR
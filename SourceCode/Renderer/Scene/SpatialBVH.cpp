@@ -0,0 +1,1058 @@
+/*
+=============================================================================
+	File:	SpatialBVH.cpp
+	Desc:	Bounding volume hierarchy for visibility culling and spatial queries.
+=============================================================================
+*/
+#include "Renderer_PCH.h"
+#pragma hdrstop
+
+#include <Base/JobSystem/ParallelFor.h>
+
+#include <Renderer/Scene/SpatialBVH.h>
+#include <Renderer/Util/BatchRenderer.h>
+
+enum
+{
+	// set in rxBVHNode::slots to distinguish empty leaves from internal nodes
+	BVH_LEAF_FLAG = BIT(30),
+
+	// rebuild the tree if there are more objects which couldn't be put into free leaf slots
+	BVH_MAX_PENDING_OBJECTS = 64,
+
+	// check the quality of the tree after this many refits
+	BVH_QUALITY_CHECK_PERIOD = 32,
+
+	// subtrees at this depth and below are split in the middle to bound the depth of the tree
+	BVH_MAX_SPATIAL_SPLIT_DEPTH = rxBVH_MAX_DEPTH / 2,
+
+	// the size of a single culling task in m_cullTasks
+	BVH_CULL_TASK_SIZE = 3,
+
+	// the number of culling tasks for each worker thread
+	BVH_CULL_TASKS_PER_THREAD = 4,
+};
+
+// rebuild the tree if refitting made it this much worse
+static const FLOAT BVH_MAX_COST_RATIO = 1.5f;
+
+namespace
+{
+	FORCEINLINE FLOAT BvhSurfaceArea( const AABB& aabb )
+	{
+		if( aabb.IsCleared() ) {
+			return 0.0f;
+		}
+		const Vec3D size = aabb.Size();
+		return 2.0f * ( size.x * size.y + size.y * size.z + size.z * size.x );
+	}
+
+	FORCEINLINE U4 BvhViewBit( UINT iView )
+	{
+		return U4(1) << iView;
+	}
+
+	FORCEINLINE U4 BvhAllViews( UINT numViews )
+	{
+		return (numViews >= 32) ? ~U4(0) : BvhViewBit( numViews ) - 1;
+	}
+
+	// removes views which don't see the box from 'partialViews'
+	// and moves views which fully contain the box into 'insideViews'
+	//
+	FORCEINLINE void BvhClassifyBox( const rxCullingPlanes* views, const AABB& bounds, U4 &partialViews, U4 &insideViews )
+	{
+		U4 viewsToTest = partialViews;
+		while( viewsToTest )
+		{
+			DWORD iView;
+			_BitScanForward( &iView, viewsToTest );
+			viewsToTest &= viewsToTest - 1;
+
+			const int relation = views[ iView ].Classify( bounds );
+
+			if( relation != ESpatialRelation::Intersects )
+			{
+				partialViews &= ~BvhViewBit( iView );
+
+				if( relation == ESpatialRelation::Inside ) {
+					insideViews |= BvhViewBit( iView );
+				}
+			}
+		}
+	}
+
+	FORCEINLINE bool BvhSphereOverlapsBox( const Sphere& sphere, const AABB& bounds )
+	{
+		return bounds.ShortestDistanceSquared( sphere.Center ) <= sphere.Radius * sphere.Radius;
+	}
+
+	FORCEINLINE bool BvhSegmentOverlapsBox( const Vec3D& origin, const Vec3D& invDir, FLOAT maxDistance, const AABB& bounds )
+	{
+		FLOAT tMin = 0.0f;
+		FLOAT tMax = maxDistance;
+
+		for( UINT iAxis = 0; iAxis < 3; iAxis++ )
+		{
+			FLOAT t1 = ( bounds.GetMin()[ iAxis ] - origin[ iAxis ] ) * invDir[ iAxis ];
+			FLOAT t2 = ( bounds.GetMax()[ iAxis ] - origin[ iAxis ] ) * invDir[ iAxis ];
+			if( t1 > t2 ) {
+				TSwap( t1, t2 );
+			}
+			tMin = largest( tMin, t1 );
+			tMax = smallest( tMax, t2 );
+			if( tMin > tMax ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct CullBvhSubtrees
+	{
+		const rxSpatialBVH *	tree;
+		const rxCullingPlanes *	views;
+		const U4 *				tasks;
+		TList< U4> *			results;
+
+	public:
+		void operator () ( UINT firstTask, UINT lastTask ) const
+		{
+			for( UINT iTask = firstTask; iTask < lastTask; iTask++ )
+			{
+				const U4* task = tasks + iTask * BVH_CULL_TASK_SIZE;
+
+				results[ iTask ].Empty();
+				tree->CullSubtree( views, task[0], task[1], task[2], results[ iTask ] );
+			}
+		}
+	};
+
+	const FColor GetDbgColorForTreeDepth( UINT depth )
+	{
+		static const FColor colors[]=
+		{
+			FColor::RED,	//root
+			FColor::WHITE,
+			FColor::YELLOW,
+			FColor::LIGHT_YELLOW_GREEN,
+			FColor::GREEN,
+			FColor::BLUE,
+			FColor::MAGENTA,
+			FColor::LIGHT_GREY,
+		};
+		depth = smallest<UINT>( depth, NUMBER_OF(colors)-1 );
+		return colors[ depth ];
+	}
+
+}//namespace
+
+/*================================
+		rxSpatialBVH
+================================*/
+
+rxSpatialBVH::rxSpatialBVH( rxSpatialDatabase::IClientInfo* client )
+{
+	AssertPtr(client);
+	m_client = client;
+
+	m_objects.Reserve( client->ExpectedNumObjects() );
+	m_objectBounds.Reserve( client->ExpectedNumObjects() );
+
+	m_numObjects = 0;
+	m_numRemoved = 0;
+	m_numUpdates = 0;
+	m_buildCost = 0.0f;
+}
+
+rxSpatialBVH::~rxSpatialBVH()
+{
+}
+
+void rxSpatialBVH::Clear()
+{
+	m_nodes.Empty();
+	m_parents.Empty();
+
+	m_objects.Empty();
+	m_objectBounds.Empty();
+	m_freeObjects.Empty();
+	m_pendingObjects.Empty();
+
+	m_slotBounds.SetNum( 0 );
+	m_slotObjects.Empty();
+	m_groupLeaves.Empty();
+	m_groupDirty.Empty();
+	m_dirtyGroups.Empty();
+
+	m_numObjects = 0;
+	m_numRemoved = 0;
+	m_numUpdates = 0;
+	m_buildCost = 0.0f;
+}
+
+TreeNodeID rxSpatialBVH::Insert( ActorID newObject )
+{
+	U4 objectHandle;
+	if( m_freeObjects.Num() ) {
+		objectHandle = m_freeObjects.GetLast();
+		m_freeObjects.PopBack();
+	} else {
+		objectHandle = m_objects.Num();
+		m_objects.Add();
+		m_objectBounds.Add();
+	}
+
+	rxBVHObject & o = m_objects[ objectHandle ];
+	o.actor = newObject;
+	o.slot = INDEX_NONE;
+
+	m_client->GetBoundingBox( newObject, m_objectBounds[ objectHandle ] );
+
+	m_numObjects++;
+
+	if( !this->InsertIntoLeaf( objectHandle ) ) {
+		m_pendingObjects.Add( objectHandle );
+	}
+
+	return objectHandle;
+}
+
+void rxSpatialBVH::Remove( TreeNodeID objectHandle )
+{
+	rxBVHObject & o = m_objects[ objectHandle ];
+	Assert( o.actor != INDEX_NONE );
+
+	if( o.slot != INDEX_NONE )
+	{
+		const UINT group = o.slot / rxBVH_LEAF_SIZE;
+		const UINT lane = o.slot % rxBVH_LEAF_SIZE;
+
+		m_nodes[ m_groupLeaves[ group ] ].slots &= ~BIT(lane);
+		m_slotObjects[ o.slot ] = INDEX_NONE;
+
+		this->MarkGroupDirty( group );
+		m_numRemoved++;
+	}
+	else
+	{
+		const UINT pendingIndex = m_pendingObjects.FindIndexOf( objectHandle );
+		Assert( pendingIndex != INDEX_NONE );
+		m_pendingObjects.RemoveAt_Fast( pendingIndex );
+	}
+
+	o.actor = INDEX_NONE;
+	o.slot = INDEX_NONE;
+
+	m_freeObjects.Add( objectHandle );
+	m_numObjects--;
+}
+
+void rxSpatialBVH::SetActor( TreeNodeID objectHandle, ActorID newActor )
+{
+	Assert( m_objects[ objectHandle ].actor != INDEX_NONE );
+	m_objects[ objectHandle ].actor = newActor;
+}
+
+void rxSpatialBVH::OnObjectMoved( TreeNodeID objectHandle )
+{
+	const rxBVHObject& o = m_objects[ objectHandle ];
+	Assert( o.actor != INDEX_NONE );
+
+	AABB & bounds = m_objectBounds[ objectHandle ];
+	m_client->GetBoundingBox( o.actor, bounds );
+
+	if( o.slot != INDEX_NONE )
+	{
+		m_slotBounds.Set( o.slot, bounds );
+		this->MarkGroupDirty( o.slot / rxBVH_LEAF_SIZE );
+	}
+}
+
+void rxSpatialBVH::OnAllObjectsMoved()
+{
+	const UINT numObjects = m_objects.Num();
+	for( UINT iObject = 0; iObject < numObjects; iObject++ )
+	{
+		if( m_objects[ iObject ].actor != INDEX_NONE ) {
+			this->OnObjectMoved( iObject );
+		}
+	}
+}
+
+void rxSpatialBVH::Update()
+{
+	const UINT numPending = m_pendingObjects.Num();
+
+	const bool bMustRebuild = ( m_nodes.IsEmpty() && numPending )
+		|| ( numPending > largest<UINT>( BVH_MAX_PENDING_OBJECTS, m_numObjects / 8 ) )
+		|| ( m_numRemoved > largest<UINT>( BVH_MAX_PENDING_OBJECTS, m_numObjects / 2 ) )
+		;
+	if( bMustRebuild )
+	{
+		this->Rebuild();
+		return;
+	}
+
+	const UINT numDirtyGroups = m_dirtyGroups.Num();
+	if( !numDirtyGroups ) {
+		return;
+	}
+
+	if( numDirtyGroups * 8 > m_groupLeaves.Num() )
+	{
+		// many objects have moved, refit the whole tree in one pass
+		this->RefitAll();
+	}
+	else
+	{
+		for( UINT i = 0; i < numDirtyGroups; i++ )
+		{
+			const UINT leaf = m_groupLeaves[ m_dirtyGroups[i] ];
+			this->RefitLeaf( leaf );
+			this->RefitAncestors( leaf );
+		}
+	}
+
+	for( UINT i = 0; i < numDirtyGroups; i++ )
+	{
+		m_groupDirty[ m_dirtyGroups[i] ] = 0;
+	}
+	m_dirtyGroups.Empty();
+
+	// periodically rebuild the tree if its nodes have grown too much
+	if( ++m_numUpdates >= BVH_QUALITY_CHECK_PERIOD )
+	{
+		m_numUpdates = 0;
+
+		if( this->CalcCost() > m_buildCost * BVH_MAX_COST_RATIO ) {
+			this->Rebuild();
+		}
+	}
+}
+
+FLOAT rxSpatialBVH::CalcCost() const
+{
+	if( m_nodes.IsEmpty() ) {
+		return 0.0f;
+	}
+
+	const FLOAT rootArea = BvhSurfaceArea( m_nodes[0].bounds );
+	if( rootArea <= 0.0f ) {
+		return 0.0f;
+	}
+
+	FLOAT totalArea = 0.0f;
+
+	const UINT numNodes = m_nodes.Num();
+	for( UINT iNode = 0; iNode < numNodes; iNode++ )
+	{
+		if( !m_nodes[ iNode ].IsLeaf() ) {
+			totalArea += BvhSurfaceArea( m_nodes[ iNode ].bounds );
+		}
+	}
+
+	return totalArea / rootArea;
+}
+
+void rxSpatialBVH::Rebuild()
+{
+	// collect all live objects
+
+	m_buildObjects.Empty();
+	m_buildObjects.Reserve( m_numObjects );
+
+	const UINT numObjects = m_objects.Num();
+	for( UINT iObject = 0; iObject < numObjects; iObject++ )
+	{
+		rxBVHObject & o = m_objects[ iObject ];
+		o.slot = INDEX_NONE;
+		if( o.actor != INDEX_NONE ) {
+			m_buildObjects.Add( iObject );
+		}
+	}
+	Assert( m_buildObjects.Num() == m_numObjects );
+
+	m_nodes.Empty();
+	m_parents.Empty();
+	m_pendingObjects.Empty();
+	m_slotObjects.Empty();
+	m_groupLeaves.Empty();
+	m_dirtyGroups.Empty();
+
+	m_numRemoved = 0;
+	m_numUpdates = 0;
+
+	if( m_buildObjects.IsEmpty() )
+	{
+		m_slotBounds.SetNum( 0 );
+		m_groupDirty.Empty();
+		m_buildCost = 0.0f;
+		return;
+	}
+
+	// build the tree top-down
+
+	m_nodes.Add();
+	m_parents.Add( INDEX_NONE );
+
+	this->BuildSubtree( 0, m_buildObjects.ToPtr(), m_buildObjects.Num(), 0 );
+
+	// copy bounds of objects into leaf slots
+
+	const UINT numSlots = m_slotObjects.Num();
+	m_slotBounds.SetNum( numSlots );
+
+	const AABB emptyBox( Vec3D(0.0f), Vec3D(0.0f) );
+
+	for( UINT iSlot = 0; iSlot < numSlots; iSlot++ )
+	{
+		const U4 objectHandle = m_slotObjects[ iSlot ];
+		m_slotBounds.Set( iSlot, (objectHandle != INDEX_NONE) ? m_objectBounds[ objectHandle ] : emptyBox );
+	}
+
+	m_groupDirty.SetNum( m_groupLeaves.Num() );
+	MemSet( m_groupDirty.ToPtr(), 0, m_groupDirty.Num() * sizeof(BYTE) );
+
+	m_buildCost = this->CalcCost();
+}
+
+void rxSpatialBVH::BuildSubtree( UINT nodeIndex, U4* objects, UINT numObjects, UINT depth )
+{
+	Assert( numObjects > 0 );
+	Assert( depth < rxBVH_MAX_DEPTH );
+
+	AABB	bounds;
+	bounds.Clear();
+
+	for( UINT i = 0; i < numObjects; i++ )
+	{
+		bounds.AddBounds( m_objectBounds[ objects[i] ] );
+	}
+
+	m_nodes[ nodeIndex ].bounds = bounds;
+
+	if( numObjects <= rxBVH_LEAF_SIZE )
+	{
+		// create a leaf with its own group of slots
+
+		const UINT firstSlot = m_slotObjects.Num();
+		m_slotObjects.SetNum( firstSlot + rxBVH_LEAF_SIZE );
+
+		for( UINT i = 0; i < rxBVH_LEAF_SIZE; i++ )
+		{
+			m_slotObjects[ firstSlot + i ] = (i < numObjects) ? objects[i] : INDEX_NONE;
+		}
+		for( UINT i = 0; i < numObjects; i++ )
+		{
+			m_objects[ objects[i] ].slot = firstSlot + i;
+		}
+
+		m_groupLeaves.Add( nodeIndex );
+
+		rxBVHNode & leaf = m_nodes[ nodeIndex ];
+		leaf.first = firstSlot;
+		leaf.slots = BVH_LEAF_FLAG | (BIT(numObjects) - 1);
+		return;
+	}
+
+	// split at the middle of the centroid bounds along the longest axis
+
+	AABB	centroidBounds;
+	centroidBounds.Clear();
+
+	for( UINT i = 0; i < numObjects; i++ )
+	{
+		centroidBounds.AddPoint( m_objectBounds[ objects[i] ].GetCenter() );
+	}
+
+	const UINT axis = centroidBounds.GetLargestAxis();
+	const FLOAT splitPos = centroidBounds.GetCenter()[ axis ];
+
+	UINT numLeft = 0;
+
+	if( depth < BVH_MAX_SPATIAL_SPLIT_DEPTH )
+	{
+		for( UINT i = 0; i < numObjects; i++ )
+		{
+			if( m_objectBounds[ objects[i] ].GetCenter()[ axis ] < splitPos )
+			{
+				TSwap( objects[i], objects[ numLeft ] );
+				numLeft++;
+			}
+		}
+	}
+
+	// fall back to splitting the object list in half
+	if( numLeft == 0 || numLeft == numObjects ) {
+		numLeft = numObjects / 2;
+	}
+
+	const UINT firstChild = m_nodes.Num();
+
+	m_nodes.SetNum( firstChild + 2 );
+	m_parents.SetNum( firstChild + 2 );
+	m_parents[ firstChild + 0 ] = nodeIndex;
+	m_parents[ firstChild + 1 ] = nodeIndex;
+
+	m_nodes[ nodeIndex ].first = firstChild;
+	m_nodes[ nodeIndex ].slots = 0;
+
+	this->BuildSubtree( firstChild + 0, objects, numLeft, depth + 1 );
+	this->BuildSubtree( firstChild + 1, objects + numLeft, numObjects - numLeft, depth + 1 );
+}
+
+bool rxSpatialBVH::InsertIntoLeaf( U4 objectHandle )
+{
+	if( m_nodes.IsEmpty() ) {
+		return false;
+	}
+
+	const AABB& bounds = m_objectBounds[ objectHandle ];
+
+	// descend into the child which grows least
+
+	UINT nodeIndex = 0;
+	while( !m_nodes[ nodeIndex ].IsLeaf() )
+	{
+		const UINT firstChild = m_nodes[ nodeIndex ].first;
+
+		FLOAT growth[2];
+		for( UINT i = 0; i < 2; i++ )
+		{
+			const AABB& childBounds = m_nodes[ firstChild + i ].bounds;
+			AABB merged( childBounds );
+			merged.AddBounds( bounds );
+			growth[i] = BvhSurfaceArea( merged ) - BvhSurfaceArea( childBounds );
+		}
+
+		nodeIndex = firstChild + ((growth[1] < growth[0]) ? 1 : 0);
+	}
+
+	rxBVHNode & leaf = m_nodes[ nodeIndex ];
+
+	const UINT freeSlots = ~leaf.GetSlotMask() & (BIT(rxBVH_LEAF_SIZE) - 1);
+	if( !freeSlots ) {
+		return false;
+	}
+
+	DWORD lane;
+	_BitScanForward( &lane, freeSlots );
+
+	const UINT slot = leaf.first + lane;
+
+	leaf.slots |= BIT(lane);
+	m_slotObjects[ slot ] = objectHandle;
+	m_slotBounds.Set( slot, bounds );
+	m_objects[ objectHandle ].slot = slot;
+
+	this->MarkGroupDirty( slot / rxBVH_LEAF_SIZE );
+
+	return true;
+}
+
+void rxSpatialBVH::MarkGroupDirty( UINT group )
+{
+	if( !m_groupDirty[ group ] )
+	{
+		m_groupDirty[ group ] = 1;
+		m_dirtyGroups.Add( group );
+	}
+}
+
+void rxSpatialBVH::RefitLeaf( UINT nodeIndex )
+{
+	rxBVHNode & leaf = m_nodes[ nodeIndex ];
+	Assert( leaf.IsLeaf() );
+
+	leaf.bounds.Clear();
+
+	UINT slotMask = leaf.GetSlotMask();
+	while( slotMask )
+	{
+		DWORD lane;
+		_BitScanForward( &lane, slotMask );
+		slotMask &= slotMask - 1;
+
+		leaf.bounds.AddBounds( m_objectBounds[ m_slotObjects[ leaf.first + lane ] ] );
+	}
+}
+
+void rxSpatialBVH::RefitAncestors( UINT nodeIndex )
+{
+	UINT parent = m_parents[ nodeIndex ];
+
+	while( parent != INDEX_NONE )
+	{
+		const UINT firstChild = m_nodes[ parent ].first;
+
+		AABB	bounds( m_nodes[ firstChild ].bounds );
+		bounds.AddBounds( m_nodes[ firstChild + 1 ].bounds );
+
+		// stop if the bounds haven't changed
+		if( bounds == m_nodes[ parent ].bounds ) {
+			break;
+		}
+
+		m_nodes[ parent ].bounds = bounds;
+		parent = m_parents[ parent ];
+	}
+}
+
+void rxSpatialBVH::RefitAll()
+{
+	const UINT numGroups = m_groupLeaves.Num();
+	for( UINT iGroup = 0; iGroup < numGroups; iGroup++ )
+	{
+		this->RefitLeaf( m_groupLeaves[ iGroup ] );
+	}
+
+	// children are always stored after their parents
+	for( UINT iNode = m_nodes.Num(); iNode-- > 0; )
+	{
+		rxBVHNode & node = m_nodes[ iNode ];
+		if( !node.IsLeaf() )
+		{
+			node.bounds = m_nodes[ node.first ].bounds;
+			node.bounds.AddBounds( m_nodes[ node.first + 1 ].bounds );
+		}
+	}
+}
+
+void rxSpatialBVH::CullViews(
+	const rxCullingPlanes* views, UINT numViews,
+	F_EnumerateVisibleActor* callback, void* userData,
+	AsyncJobQueue* jobQueue
+	)
+{
+	Assert( numViews <= rxCULL_MAX_VIEWS );
+	numViews = smallest<UINT>( numViews, rxCULL_MAX_VIEWS );
+
+	const U4 allViews = BvhAllViews( numViews );
+
+	if( m_nodes.Num() && numViews )
+	{
+		// split the tree into subtrees which can be culled in parallel:
+		// expand the top of the tree breadth-first, dropping invisible nodes
+
+		UINT numTasksWanted = 1;
+		if( jobQueue ) {
+			numTasksWanted = smallest<UINT>( jobQueue->NumThreads() * BVH_CULL_TASKS_PER_THREAD, rxBVH_MAX_CULL_TASKS );
+		}
+
+		m_cullTasks.Empty();
+		m_cullTasks.Add( 0 );
+		m_cullTasks.Add( allViews );
+		m_cullTasks.Add( 0 );
+
+		UINT head = 0;	// index of the first unexpanded task
+		UINT numLeafTasks = 0;	// leaf tasks are moved to the beginning of the list
+
+		while( head < m_cullTasks.Num() )
+		{
+			const UINT numUnexpanded = (m_cullTasks.Num() - head) / BVH_CULL_TASK_SIZE;
+			if( numLeafTasks + numUnexpanded >= numTasksWanted ) {
+				break;
+			}
+
+			const UINT nodeIndex = m_cullTasks[ head + 0 ];
+			U4 partialViews = m_cullTasks[ head + 1 ];
+			U4 insideViews = m_cullTasks[ head + 2 ];
+			head += BVH_CULL_TASK_SIZE;
+
+			const rxBVHNode& node = m_nodes[ nodeIndex ];
+
+			BvhClassifyBox( views, node.bounds, partialViews, insideViews );
+
+			if( !(partialViews | insideViews) ) {
+				continue;
+			}
+
+			if( node.IsLeaf() )
+			{
+				U4* leafTask = m_cullTasks.ToPtr() + numLeafTasks * BVH_CULL_TASK_SIZE;
+				leafTask[0] = nodeIndex;
+				leafTask[1] = partialViews;
+				leafTask[2] = insideViews;
+				numLeafTasks++;
+				continue;
+			}
+
+			for( UINT iChild = 0; iChild < 2; iChild++ )
+			{
+				m_cullTasks.Add( node.first + iChild );
+				m_cullTasks.Add( partialViews );
+				m_cullTasks.Add( insideViews );
+			}
+		}
+
+		// the remaining tasks: leaves found so far and unexpanded subtrees
+		const UINT numUnexpanded = (m_cullTasks.Num() - head) / BVH_CULL_TASK_SIZE;
+
+		MemMove( m_cullTasks.ToPtr() + numLeafTasks * BVH_CULL_TASK_SIZE,
+			m_cullTasks.ToPtr() + head,
+			numUnexpanded * BVH_CULL_TASK_SIZE * sizeof(U4) );
+
+		const UINT numTasks = numLeafTasks + numUnexpanded;
+		Assert( numTasks <= rxBVH_MAX_CULL_TASKS );
+
+		CullBvhSubtrees		cullSubtrees;
+		cullSubtrees.tree = this;
+		cullSubtrees.views = views;
+		cullSubtrees.tasks = m_cullTasks.ToPtr();
+		cullSubtrees.results = m_taskResults;
+
+		if( jobQueue && numTasks > 1 ) {
+			ParallelFor( jobQueue, 0, numTasks, 1, cullSubtrees );
+		} else {
+			cullSubtrees( 0, numTasks );
+		}
+
+		// report visible objects
+
+		for( UINT iTask = 0; iTask < numTasks; iTask++ )
+		{
+			const TList< U4 >& results = m_taskResults[ iTask ];
+
+			const UINT numResults = results.Num();
+			for( UINT i = 0; i < numResults; i += 2 )
+			{
+				(*callback)( results[ i ], results[ i + 1 ], userData );
+			}
+		}
+	}
+
+	// test objects which haven't been inserted into the tree yet
+
+	const UINT numPending = m_pendingObjects.Num();
+	for( UINT i = 0; i < numPending; i++ )
+	{
+		const U4 objectHandle = m_pendingObjects[i];
+
+		U4 partialViews = allViews;
+		U4 insideViews = 0;
+		BvhClassifyBox( views, m_objectBounds[ objectHandle ], partialViews, insideViews );
+
+		if( partialViews | insideViews ) {
+			(*callback)( m_objects[ objectHandle ].actor, partialViews | insideViews, userData );
+		}
+	}
+}
+
+void rxSpatialBVH::CullSubtree(
+	const rxCullingPlanes* views,
+	UINT nodeIndex, U4 partialViews, U4 insideViews,
+	TList< U4 > &results
+	) const
+{
+	struct StackEntry
+	{
+		U4	node;
+		U4	partialViews;	// views which (may) intersect the node
+		U4	insideViews;	// views which fully contain the node
+	};
+	StackEntry	stack[ rxBVH_MAX_DEPTH + 1 ];
+	UINT		stackSize = 0;
+
+	stack[ stackSize ].node = nodeIndex;
+	stack[ stackSize ].partialViews = partialViews;
+	stack[ stackSize ].insideViews = insideViews;
+	stackSize++;
+
+	const rxBVHNode* nodes = m_nodes.ToPtr();
+
+	while( stackSize > 0 )
+	{
+		const StackEntry entry = stack[ --stackSize ];
+		const rxBVHNode& node = nodes[ entry.node ];
+
+		U4 nodePartialViews = entry.partialViews;
+		U4 nodeInsideViews = entry.insideViews;
+
+		// subtrees which are fully inside a view are not tested against it anymore
+		BvhClassifyBox( views, node.bounds, nodePartialViews, nodeInsideViews );
+
+		if( !(nodePartialViews | nodeInsideViews) ) {
+			continue;
+		}
+
+		if( !node.IsLeaf() )
+		{
+			Assert( stackSize + 2 <= NUMBER_OF(stack) );
+			for( UINT iChild = 2; iChild-- > 0; )
+			{
+				stack[ stackSize ].node = node.first + iChild;
+				stack[ stackSize ].partialViews = nodePartialViews;
+				stack[ stackSize ].insideViews = nodeInsideViews;
+				stackSize++;
+			}
+			continue;
+		}
+
+		const UINT slotMask = node.GetSlotMask();
+		if( !slotMask ) {
+			continue;
+		}
+
+		// test all objects in the leaf at once
+
+		U4 objectViews[ rxBVH_LEAF_SIZE ];
+		for( UINT lane = 0; lane < rxBVH_LEAF_SIZE; lane++ )
+		{
+			objectViews[ lane ] = nodeInsideViews;
+		}
+
+		U4 viewsToTest = nodePartialViews;
+		while( viewsToTest )
+		{
+			DWORD iView;
+			_BitScanForward( &iView, viewsToTest );
+			viewsToTest &= viewsToTest - 1;
+
+			const UINT visibleLanes = rxCullBoxGroup( views[ iView ], m_slotBounds, node.first );
+
+			for( UINT lane = 0; lane < rxBVH_LEAF_SIZE; lane++ )
+			{
+				objectViews[ lane ] |= ((visibleLanes >> lane) & 1) << iView;
+			}
+		}
+
+		for( UINT lane = 0; lane < rxBVH_LEAF_SIZE; lane++ )
+		{
+			if( (slotMask & BIT(lane)) && objectViews[ lane ] )
+			{
+				const U4 objectHandle = m_slotObjects[ node.first + lane ];
+				results.Add( m_objects[ objectHandle ].actor );
+				results.Add( objectViews[ lane ] );
+			}
+		}
+	}
+}
+
+void rxSpatialBVH::FrustumQuery( const rxCullingPlanes& frustum, F_EnumerateActorID* callback, void* userData ) const
+{
+	if( m_nodes.Num() )
+	{
+		struct StackEntry
+		{
+			U4	node;
+			U4	inside;	// 1 if the node is fully inside the frustum
+		};
+		StackEntry	stack[ rxBVH_MAX_DEPTH + 1 ];
+		UINT		stackSize = 0;
+
+		stack[ stackSize ].node = 0;
+		stack[ stackSize ].inside = 0;
+		stackSize++;
+
+		while( stackSize > 0 )
+		{
+			const StackEntry entry = stack[ --stackSize ];
+			const rxBVHNode& node = m_nodes[ entry.node ];
+
+			U4 inside = entry.inside;
+			if( !inside )
+			{
+				const int relation = frustum.Classify( node.bounds );
+				if( relation == ESpatialRelation::Outside ) {
+					continue;
+				}
+				inside = (relation == ESpatialRelation::Inside);
+			}
+
+			if( !node.IsLeaf() )
+			{
+				Assert( stackSize + 2 <= NUMBER_OF(stack) );
+				for( UINT iChild = 2; iChild-- > 0; )
+				{
+					stack[ stackSize ].node = node.first + iChild;
+					stack[ stackSize ].inside = inside;
+					stackSize++;
+				}
+				continue;
+			}
+
+			UINT visibleLanes = node.GetSlotMask();
+			if( !inside ) {
+				visibleLanes &= rxCullBoxGroup( frustum, m_slotBounds, node.first );
+			}
+
+			while( visibleLanes )
+			{
+				DWORD lane;
+				_BitScanForward( &lane, visibleLanes );
+				visibleLanes &= visibleLanes - 1;
+
+				(*callback)( m_objects[ m_slotObjects[ node.first + lane ] ].actor, userData );
+			}
+		}
+	}
+
+	const UINT numPending = m_pendingObjects.Num();
+	for( UINT i = 0; i < numPending; i++ )
+	{
+		const U4 objectHandle = m_pendingObjects[i];
+		if( frustum.Classify( m_objectBounds[ objectHandle ] ) != ESpatialRelation::Outside ) {
+			(*callback)( m_objects[ objectHandle ].actor, userData );
+		}
+	}
+}
+
+void rxSpatialBVH::SphereQuery( const Sphere& sphere, F_EnumerateActorID* callback, void* userData ) const
+{
+	if( m_nodes.Num() )
+	{
+		U4		stack[ rxBVH_MAX_DEPTH + 1 ];
+		UINT	stackSize = 0;
+
+		stack[ stackSize++ ] = 0;
+
+		while( stackSize > 0 )
+		{
+			const rxBVHNode& node = m_nodes[ stack[ --stackSize ] ];
+
+			if( !BvhSphereOverlapsBox( sphere, node.bounds ) ) {
+				continue;
+			}
+
+			if( !node.IsLeaf() )
+			{
+				Assert( stackSize + 2 <= NUMBER_OF(stack) );
+				stack[ stackSize++ ] = node.first + 1;
+				stack[ stackSize++ ] = node.first;
+				continue;
+			}
+
+			UINT slotMask = node.GetSlotMask();
+			while( slotMask )
+			{
+				DWORD lane;
+				_BitScanForward( &lane, slotMask );
+				slotMask &= slotMask - 1;
+
+				const U4 objectHandle = m_slotObjects[ node.first + lane ];
+				if( BvhSphereOverlapsBox( sphere, m_objectBounds[ objectHandle ] ) ) {
+					(*callback)( m_objects[ objectHandle ].actor, userData );
+				}
+			}
+		}
+	}
+
+	const UINT numPending = m_pendingObjects.Num();
+	for( UINT i = 0; i < numPending; i++ )
+	{
+		const U4 objectHandle = m_pendingObjects[i];
+		if( BvhSphereOverlapsBox( sphere, m_objectBounds[ objectHandle ] ) ) {
+			(*callback)( m_objects[ objectHandle ].actor, userData );
+		}
+	}
+}
+
+void rxSpatialBVH::RayQuery( const Vec3D& origin, const Vec3D& direction, FLOAT maxDistance, F_EnumerateActorID* callback, void* userData ) const
+{
+	// avoid divisions by zero
+	Vec3D	invDir;
+	for( UINT iAxis = 0; iAxis < 3; iAxis++ )
+	{
+		const FLOAT d = direction[ iAxis ];
+		invDir[ iAxis ] = (mxFabs( d ) > 1e-20f) ? (1.0f / d) : ((d < 0.0f) ? -1e20f : 1e20f);
+	}
+
+	if( m_nodes.Num() )
+	{
+		U4		stack[ rxBVH_MAX_DEPTH + 1 ];
+		UINT	stackSize = 0;
+
+		stack[ stackSize++ ] = 0;
+
+		while( stackSize > 0 )
+		{
+			const rxBVHNode& node = m_nodes[ stack[ --stackSize ] ];
+
+			if( !BvhSegmentOverlapsBox( origin, invDir, maxDistance, node.bounds ) ) {
+				continue;
+			}
+
+			if( !node.IsLeaf() )
+			{
+				Assert( stackSize + 2 <= NUMBER_OF(stack) );
+				stack[ stackSize++ ] = node.first + 1;
+				stack[ stackSize++ ] = node.first;
+				continue;
+			}
+
+			UINT slotMask = node.GetSlotMask();
+			while( slotMask )
+			{
+				DWORD lane;
+				_BitScanForward( &lane, slotMask );
+				slotMask &= slotMask - 1;
+
+				const U4 objectHandle = m_slotObjects[ node.first + lane ];
+				if( BvhSegmentOverlapsBox( origin, invDir, maxDistance, m_objectBounds[ objectHandle ] ) ) {
+					(*callback)( m_objects[ objectHandle ].actor, userData );
+				}
+			}
+		}
+	}
+
+	const UINT numPending = m_pendingObjects.Num();
+	for( UINT i = 0; i < numPending; i++ )
+	{
+		const U4 objectHandle = m_pendingObjects[i];
+		if( BvhSegmentOverlapsBox( origin, invDir, maxDistance, m_objectBounds[ objectHandle ] ) ) {
+			(*callback)( m_objects[ objectHandle ].actor, userData );
+		}
+	}
+}
+
+void rxSpatialBVH::DebugDraw( const rxSceneContext& sceneContext )
+{
+	if( m_nodes.IsEmpty() ) {
+		return;
+	}
+
+	BatchRenderer & batchRenderer = gRenderer.GetDrawHelper();
+
+	U4		stack[ rxBVH_MAX_DEPTH + 1 ];
+	U4		depths[ rxBVH_MAX_DEPTH + 1 ];
+	UINT	stackSize = 0;
+
+	stack[ stackSize ] = 0;
+	depths[ stackSize ] = 0;
+	stackSize++;
+
+	while( stackSize > 0 )
+	{
+		--stackSize;
+		const rxBVHNode& node = m_nodes[ stack[ stackSize ] ];
+		const UINT depth = depths[ stackSize ];
+
+		if( node.bounds.IsCleared() ) {
+			continue;
+		}
+
+		rxAABB	aabb;
+		rxAABB_From_AABB( aabb, node.bounds );
+
+		if( sceneContext.frustum.TestAABB( aabb ) == CS_Disjoint ) {
+			continue;
+		}
+
+		batchRenderer.DrawAABB( aabb, GetDbgColorForTreeDepth( depth ) );
+
+		if( !node.IsLeaf() )
+		{
+			for( UINT iChild = 0; iChild < 2; iChild++ )
+			{
+				stack[ stackSize ] = node.first + iChild;
+				depths[ stackSize ] = depth + 1;
+				stackSize++;
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,184 @@
+/*
+=============================================================================
+	File:	SpatialBVH.h
+	Desc:	Bounding volume hierarchy for visibility culling and spatial queries.
+=============================================================================
+*/
+#pragma once
+
+#include <Renderer/Core/SceneView.h>
+#include <Renderer/Scene/SpatialDatabase.h>
+#include <Renderer/Scene/Culling.h>
+
+class AsyncJobQueue;
+
+enum
+{
+	// maximum number of objects in a leaf,
+	// all objects of a leaf are tested against a frustum at once with SIMD
+	rxBVH_LEAF_SIZE = rxCULL_GROUP_SIZE,
+
+	// maximum depth of the tree (and the size of traversal stacks)
+	rxBVH_MAX_DEPTH = 64,
+
+	// maximum number of subtrees culled in parallel
+	rxBVH_MAX_CULL_TASKS = 64,
+};
+
+// called for each object visible in at least one view,
+// bit N of the mask is set if the object is visible in view N
+typedef void F_EnumerateVisibleActor( ActorID actorHandle, U4 viewMask, void* userData );
+
+/*
+-----------------------------------------------------------------------------
+	rxBVHNode
+-----------------------------------------------------------------------------
+*/
+struct rxBVHNode
+{
+	AABB	bounds;	//24 in world space
+	U4		first;	//4 index of the first child (the second child follows it) or index of the first object slot (if leaf)
+	U4		slots;	//4 leaves: leaf flag | bitmask of occupied object slots; zero for internal nodes
+
+	// 32 bytes in total
+
+public:
+	FORCEINLINE bool IsLeaf() const { return slots != 0; }
+	FORCEINLINE UINT GetSlotMask() const { return slots & (BIT(rxBVH_LEAF_SIZE) - 1); }
+};
+mxDECLARE_POD_TYPE( rxBVHNode );
+
+/*
+-----------------------------------------------------------------------------
+	rxBVHObject
+-----------------------------------------------------------------------------
+*/
+struct rxBVHObject
+{
+	ActorID	actor;	// client handle, INDEX_NONE if the object has been removed
+	U4		slot;	// object slot in a leaf, INDEX_NONE if the object hasn't been inserted into the tree yet
+};
+mxDECLARE_POD_TYPE( rxBVHObject );
+
+/*
+-----------------------------------------------------------------------------
+	rxSpatialBVH
+
+	flattened binary AABB tree with 32-bit node links,
+	the children of each internal node are stored next to each other.
+	each leaf owns a group of rxBVH_LEAF_SIZE object slots,
+	bounds of object slots are kept in SoA layout for SIMD culling.
+
+	moved objects are refitted bottom-up,
+	new objects are put into free leaf slots (or kept in a small list which is tested linearly),
+	the tree is rebuilt from scratch when it degrades too much.
+-----------------------------------------------------------------------------
+*/
+class rxSpatialBVH : public rxSpatialDatabase
+{
+public:
+	rxSpatialBVH( rxSpatialDatabase::IClientInfo* client );
+	~rxSpatialBVH();
+
+	// removes all objects
+	void Clear();
+
+	// adds a new object, returns a handle which stays valid until the object is removed
+	TreeNodeID Insert( ActorID newObject );
+	void Remove( TreeNodeID objectHandle );
+
+	// changes the client handle of the object
+	// (e.g. after the client has moved the object to another place in its arrays)
+	void SetActor( TreeNodeID objectHandle, ActorID newActor );
+
+	// re-reads bounds of the object from the client
+	void OnObjectMoved( TreeNodeID objectHandle );
+
+	// re-reads bounds of all objects from the client
+	void OnAllObjectsMoved();
+
+	// refits the tree and rebuilds it if its quality has degraded too much,
+	// must be called before queries if objects have been added, removed or moved.
+	void Update();
+
+	UINT GetNumObjects() const { return m_numObjects; }
+
+	// returns the ratio of the summed surface areas of internal nodes to the surface area of the root
+	FLOAT CalcCost() const;
+
+public:	// Spatial queries
+
+	// hierarchical culling against several frusta at once (up to rxCULL_MAX_VIEWS),
+	// subtrees are culled in parallel if the job queue is not null.
+	// the callback is executed in the calling thread.
+	void CullViews(
+		const rxCullingPlanes* views, UINT numViews,
+		F_EnumerateVisibleActor* callback, void* userData,
+		AsyncJobQueue* jobQueue = nil
+		);
+
+	// execute callback for objects intersecting the frustum
+	void FrustumQuery( const rxCullingPlanes& frustum, F_EnumerateActorID* callback, void* userData ) const;
+
+	// execute callback for objects intersecting the sphere
+	void SphereQuery( const Sphere& sphere, F_EnumerateActorID* callback, void* userData ) const;
+
+	// execute callback for objects whose bounds are hit by the ray segment
+	// (origin + direction * t, 0 <= t <= maxDistance)
+	void RayQuery( const Vec3D& origin, const Vec3D& direction, FLOAT maxDistance, F_EnumerateActorID* callback, void* userData ) const;
+
+	void DebugDraw( const rxSceneContext& sceneContext );
+
+public_internal:
+	// culls the subtree and appends (actor, view mask) pairs to the results
+	void CullSubtree(
+		const rxCullingPlanes* views,
+		UINT nodeIndex, U4 partialViews, U4 insideViews,
+		TList< U4 > &results
+		) const;
+
+private:
+	void Rebuild();
+	void BuildSubtree( UINT nodeIndex, U4* objects, UINT numObjects, UINT depth );
+
+	bool InsertIntoLeaf( U4 objectHandle );
+	void MarkGroupDirty( UINT group );
+
+	void RefitLeaf( UINT nodeIndex );
+	void RefitAncestors( UINT nodeIndex );
+	void RefitAll();
+
+private:
+	TList< rxBVHNode >	m_nodes;	// 0 - root node
+	TList< U4 >			m_parents;	// parent of each node, INDEX_NONE for the root
+
+	TList< rxBVHObject >	m_objects;	// indexed by object handles
+	TList< AABB >			m_objectBounds;	// world-space bounds of each object
+	TList< U4 >				m_freeObjects;	// handles of removed objects for reuse
+	TList< U4 >				m_pendingObjects;	// objects which haven't been inserted into the tree yet
+
+	// object slots (rxBVH_LEAF_SIZE slots per leaf)
+	rxCullingBounds		m_slotBounds;
+	TList< U4 >			m_slotObjects;	// object handle in each slot, INDEX_NONE if the slot is free
+	TList< U4 >			m_groupLeaves;	// leaf node owning each group of slots
+	TList< BYTE >		m_groupDirty;	// 1 if bounds of objects in the group have changed
+	TList< U4 >			m_dirtyGroups;
+
+	UINT	m_numObjects;
+	UINT	m_numRemoved;	// number of objects removed from leaves since the last rebuild
+	UINT	m_numUpdates;	// number of refits since the last quality check
+	FLOAT	m_buildCost;	// CalcCost() right after rebuilding
+
+	TPtr< rxSpatialDatabase::IClientInfo >	m_client;
+
+	// scratch memory
+	TList< U4 >		m_buildObjects;
+	TList< U4 >		m_cullTasks;	// (node, partial views, inside views) triples
+	TList< U4 >		m_taskResults[ rxBVH_MAX_CULL_TASKS ];
+
+	NO_COPY_CONSTRUCTOR(rxSpatialBVH);
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
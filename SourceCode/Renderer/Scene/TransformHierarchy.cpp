@@ -0,0 +1,490 @@
+/*
+=============================================================================
+	File:	TransformHierarchy.cpp
+	Desc:	Scene graph of transforms with dirty-flag propagation.
+=============================================================================
+*/
+#include "Renderer_PCH.h"
+#pragma hdrstop
+
+#include <Base/JobSystem/ParallelFor.h>
+
+#include "TransformHierarchy.h"
+
+namespace
+{
+	enum
+	{
+		// most trees are short so each job should get many of them
+		TREES_PER_JOB = 16,
+	};
+
+	// transforms the box and computes the box enclosing the result
+	FORCEINLINE void TransformBounds( const rxAABB& localBounds, mat4_carg m, rxAABB &worldBounds )
+	{
+		const XMVECTOR center = XMLoadFloat3( &localBounds.Center );
+		const XMVECTOR extents = XMLoadFloat3( &localBounds.Extents );
+
+		XMVECTOR newExtents = XMVectorMultiply( XMVectorAbs( m.r[0] ), XMVectorSplatX( extents ) );
+		newExtents = XMVectorMultiplyAdd( XMVectorAbs( m.r[1] ), XMVectorSplatY( extents ), newExtents );
+		newExtents = XMVectorMultiplyAdd( XMVectorAbs( m.r[2] ), XMVectorSplatZ( extents ), newExtents );
+
+		XMStoreFloat3( &worldBounds.Center, XMVector3Transform( center, m ) );
+		XMStoreFloat3( &worldBounds.Extents, newExtents );
+	}
+
+	// moves elements into new positions: dest[i] = src[ newOrder[i] ]
+	template< typename TYPE >
+	void PermuteArray( TList< TYPE > & items, const U4* newOrder, UINT newNum )
+	{
+		TList< TYPE >	temp;
+		temp.SetNum( newNum );
+
+		for( UINT i = 0; i < newNum; i++ )
+		{
+			temp[ i ] = items[ newOrder[ i ] ];
+		}
+
+		items.SetNum( newNum );
+		MemCopy( items.ToPtr(), temp.ToPtr(), newNum * sizeof(TYPE) );
+	}
+
+	struct UpdateDirtyTrees
+	{
+		rxTransformHierarchy *	hierarchy;
+		const U4 *				trees;
+
+	public:
+		void operator () ( UINT first, UINT last ) const
+		{
+			for( UINT i = first; i < last; i++ )
+			{
+				hierarchy->UpdateTree( trees[ i ] );
+			}
+		}
+	};
+
+}//namespace
+
+/*
+-----------------------------------------------------------------------------
+	rxTransformHierarchy
+-----------------------------------------------------------------------------
+*/
+rxTransformHierarchy::rxTransformHierarchy()
+{
+	m_numLiveNodes = 0;
+	m_hierarchyChanged = false;
+}
+
+rxTransformHierarchy::~rxTransformHierarchy()
+{
+}
+
+rxTransformHandle rxTransformHierarchy::Add( rxTransformHandle parent, UINT userData )
+{
+	rxTransformHandle handle;
+	if( m_freeHandles.Num() )
+	{
+		handle = m_freeHandles.GetLast();
+		m_freeHandles.PopBack();
+	}
+	else
+	{
+		handle = m_handleSlots.Num();
+		m_handleSlots.Add( INDEX_NONE );
+	}
+
+	// new nodes are appended and put into place by the next sort
+	const UINT slot = m_slotHandles.Num();
+	m_handleSlots[ handle ] = slot;
+
+	m_localMatrices.Add( XMMatrixIdentity() );
+	m_worldMatrices.Add( XMMatrixIdentity() );
+
+	rxAABB	emptyBounds;
+	ZERO_OUT( emptyBounds );
+	m_localBounds.Add( emptyBounds );
+	m_worldBounds.Add( emptyBounds );
+
+	m_parents.Add( (parent != INDEX_NONE) ? this->GetSlot( parent ) : INDEX_NONE );
+	m_reparentedNodes.Add( slot );
+	m_flags.Add( NODE_DIRTY );
+	m_nodeTrees.Add( INDEX_NONE );
+	m_slotHandles.Add( handle );
+	m_userData.Add( userData );
+
+	m_numLiveNodes++;
+	m_hierarchyChanged = true;
+
+	return handle;
+}
+
+void rxTransformHierarchy::Remove( rxTransformHandle handle )
+{
+	const UINT slot = this->GetSlot( handle );
+	const UINT parentSlot = m_parents[ slot ];
+	const float4x4 localMatrix = m_localMatrices[ slot ];
+
+	// attach the children to the parent,
+	// their transforms become relative to the parent of the removed node
+
+	if( slot < m_numChildren.Num() )
+	{
+		const UINT firstChild = m_firstChild[ slot ];
+		const UINT endChild = firstChild + m_numChildren[ slot ];
+
+		for( UINT i = firstChild; i < endChild; i++ )
+		{
+			if( m_parents[ i ] == slot )
+			{
+				m_localMatrices[ i ] = XMMatrixMultiply( m_localMatrices[ i ], localMatrix );
+				this->SetParentSlot( i, parentSlot );
+			}
+		}
+	}
+
+	// children attached since the last sort
+	const UINT numReparented = m_reparentedNodes.Num();
+	for( UINT iReparented = 0; iReparented < numReparented; iReparented++ )
+	{
+		const UINT i = m_reparentedNodes[ iReparented ];
+		if( m_parents[ i ] == slot && m_slotHandles[ i ] != INDEX_NONE )
+		{
+			m_localMatrices[ i ] = XMMatrixMultiply( m_localMatrices[ i ], localMatrix );
+			this->SetParentSlot( i, parentSlot );
+		}
+	}
+
+	// the slot is reclaimed by the next sort
+	m_slotHandles[ slot ] = INDEX_NONE;
+	m_parents[ slot ] = INDEX_NONE;
+	m_handleSlots[ handle ] = INDEX_NONE;
+	m_freeHandles.Add( handle );
+
+	m_numLiveNodes--;
+	m_hierarchyChanged = true;
+}
+
+void rxTransformHierarchy::SetParent( rxTransformHandle handle, rxTransformHandle parent )
+{
+	const UINT slot = this->GetSlot( handle );
+	const UINT parentSlot = (parent != INDEX_NONE) ? this->GetSlot( parent ) : INDEX_NONE;
+
+#if MX_DEBUG
+	// cycles are not allowed
+	for( UINT i = parentSlot; i != INDEX_NONE; i = m_parents[ i ] )
+	{
+		Assert( i != slot );
+	}
+#endif // MX_DEBUG
+
+	this->SetParentSlot( slot, parentSlot );
+	m_hierarchyChanged = true;
+}
+
+void rxTransformHierarchy::SetParentSlot( UINT slot, UINT parentSlot )
+{
+	m_parents[ slot ] = parentSlot;
+	m_flags[ slot ] |= NODE_DIRTY;
+	m_reparentedNodes.Add( slot );
+}
+
+rxTransformHandle rxTransformHierarchy::GetParent( rxTransformHandle handle ) const
+{
+	const UINT parentSlot = m_parents[ this->GetSlot( handle ) ];
+	return (parentSlot != INDEX_NONE) ? m_slotHandles[ parentSlot ] : INDEX_NONE;
+}
+
+void rxTransformHierarchy::SetLocalTransform( rxTransformHandle handle, mat4_carg localToParent )
+{
+	const UINT slot = this->GetSlot( handle );
+	m_localMatrices[ slot ] = localToParent;
+	this->MarkDirty( slot );
+}
+
+const float4x4& rxTransformHierarchy::GetLocalTransform( rxTransformHandle handle ) const
+{
+	return m_localMatrices[ this->GetSlot( handle ) ];
+}
+
+void rxTransformHierarchy::SetLocalBounds( rxTransformHandle handle, const rxAABB& localBounds )
+{
+	const UINT slot = this->GetSlot( handle );
+	m_localBounds[ slot ] = localBounds;
+	this->MarkDirty( slot );
+}
+
+const float4x4& rxTransformHierarchy::GetWorldTransform( rxTransformHandle handle ) const
+{
+	return m_worldMatrices[ this->GetSlot( handle ) ];
+}
+
+const rxAABB& rxTransformHierarchy::GetWorldBounds( rxTransformHandle handle ) const
+{
+	return m_worldBounds[ this->GetSlot( handle ) ];
+}
+
+UINT rxTransformHierarchy::GetUserData( rxTransformHandle handle ) const
+{
+	return m_userData[ this->GetSlot( handle ) ];
+}
+
+void rxTransformHierarchy::Clear()
+{
+	m_localMatrices.Clear();
+	m_worldMatrices.Clear();
+	m_localBounds.Clear();
+	m_worldBounds.Clear();
+	m_parents.Clear();
+	m_flags.Clear();
+	m_nodeTrees.Clear();
+	m_slotHandles.Clear();
+	m_userData.Clear();
+
+	m_firstChild.Clear();
+	m_numChildren.Clear();
+	m_reparentedNodes.Clear();
+
+	m_handleSlots.Clear();
+	m_freeHandles.Clear();
+
+	m_trees.Clear();
+	m_dirtyTrees.Clear();
+	m_changedNodes.Clear();
+
+	m_numLiveNodes = 0;
+	m_hierarchyChanged = false;
+}
+
+void rxTransformHierarchy::MarkDirty( UINT slot )
+{
+	m_flags[ slot ] |= NODE_DIRTY;
+
+	const UINT iTree = m_nodeTrees[ slot ];
+	if( iTree != INDEX_NONE ) {
+		m_trees[ iTree ].dirty = true;
+	}
+}
+
+void rxTransformHierarchy::Update( AsyncJobQueue* jobQueue )
+{
+	mxPROFILE_SCOPE("Update transforms");
+
+	if( m_hierarchyChanged )
+	{
+		this->SortNodes();
+	}
+
+	m_changedNodes.Empty();
+
+	m_dirtyTrees.Empty();
+
+	const UINT numTrees = m_trees.Num();
+	for( UINT iTree = 0; iTree < numTrees; iTree++ )
+	{
+		if( m_trees[ iTree ].dirty ) {
+			m_dirtyTrees.Add( iTree );
+		}
+	}
+
+	if( m_dirtyTrees.IsEmpty() ) {
+		return;
+	}
+
+	UpdateDirtyTrees	updateTrees;
+	updateTrees.hierarchy = this;
+	updateTrees.trees = m_dirtyTrees.ToPtr();
+
+	// trees don't share any nodes so they can be updated independently
+	ParallelFor( jobQueue, 0, m_dirtyTrees.Num(), TREES_PER_JOB, updateTrees );
+
+	// collect the recomputed nodes
+
+	const UINT numDirtyTrees = m_dirtyTrees.Num();
+	for( UINT i = 0; i < numDirtyTrees; i++ )
+	{
+		rxTransformTree & tree = m_trees[ m_dirtyTrees[ i ] ];
+
+		const UINT end = tree.firstNode + tree.numNodes;
+		for( UINT iNode = tree.firstNode; iNode < end; iNode++ )
+		{
+			if( m_flags[ iNode ] & NODE_CHANGED ) {
+				m_changedNodes.Add( m_slotHandles[ iNode ] );
+			}
+		}
+
+		tree.dirty = false;
+	}
+}
+
+void rxTransformHierarchy::UpdateTree( UINT iTree )
+{
+	const rxTransformTree& tree = m_trees[ iTree ];
+
+	const float4x4* localMatrices = m_localMatrices.ToPtr();
+	float4x4* worldMatrices = m_worldMatrices.ToPtr();
+	const rxAABB* localBounds = m_localBounds.ToPtr();
+	rxAABB* worldBounds = m_worldBounds.ToPtr();
+	const U4* parents = m_parents.ToPtr();
+	U1* flags = m_flags.ToPtr();
+
+	// parents precede children so changes propagate down in a single pass
+
+	const UINT end = tree.firstNode + tree.numNodes;
+	for( UINT iNode = tree.firstNode; iNode < end; iNode++ )
+	{
+		const UINT parent = parents[ iNode ];
+
+		const bool bChanged = (flags[ iNode ] & NODE_DIRTY)
+			|| (parent != INDEX_NONE && (flags[ parent ] & NODE_CHANGED));
+
+		if( !bChanged )
+		{
+			flags[ iNode ] = 0;
+			continue;
+		}
+
+		if( parent != INDEX_NONE ) {
+			worldMatrices[ iNode ] = XMMatrixMultiply( localMatrices[ iNode ], worldMatrices[ parent ] );
+		} else {
+			worldMatrices[ iNode ] = localMatrices[ iNode ];
+		}
+
+		TransformBounds( localBounds[ iNode ], worldMatrices[ iNode ], worldBounds[ iNode ] );
+
+		flags[ iNode ] = NODE_CHANGED;
+	}
+}
+
+void rxTransformHierarchy::SortNodes()
+{
+	mxPROFILE_SCOPE("Sort transforms");
+
+	const UINT numSlots = m_slotHandles.Num();
+
+	// build lists of children of each node
+
+	TList< U4 >	childOffsets;
+	childOffsets.SetNum( numSlots + 1 );
+	MemZero( childOffsets.ToPtr(), childOffsets.GetDataSize() );
+
+	for( UINT i = 0; i < numSlots; i++ )
+	{
+		if( m_slotHandles[ i ] != INDEX_NONE && m_parents[ i ] != INDEX_NONE ) {
+			childOffsets[ m_parents[ i ] + 1 ]++;
+		}
+	}
+	for( UINT i = 0; i < numSlots; i++ )
+	{
+		childOffsets[ i + 1 ] += childOffsets[ i ];
+	}
+
+	TList< U4 >	children;
+	children.SetNum( childOffsets[ numSlots ] );
+	{
+		TList< U4 >	cursors;
+		cursors.SetNum( numSlots );
+		MemCopy( cursors.ToPtr(), childOffsets.ToPtr(), numSlots * sizeof(U4) );
+
+		for( UINT i = 0; i < numSlots; i++ )
+		{
+			if( m_slotHandles[ i ] != INDEX_NONE && m_parents[ i ] != INDEX_NONE ) {
+				children[ cursors[ m_parents[ i ] ]++ ] = i;
+			}
+		}
+	}
+
+	// traverse each tree in breadth-first order
+
+	TList< U4 >	newOrder;
+	newOrder.Reserve( m_numLiveNodes );
+
+	// children of each node are added to the queue together
+	// so they occupy a contiguous range in the new order
+	m_firstChild.SetNum( m_numLiveNodes );
+	m_numChildren.SetNum( m_numLiveNodes );
+
+	m_trees.Empty();
+
+	for( UINT iRoot = 0; iRoot < numSlots; iRoot++ )
+	{
+		if( m_slotHandles[ iRoot ] == INDEX_NONE || m_parents[ iRoot ] != INDEX_NONE ) {
+			continue;
+		}
+
+		rxTransformTree & tree = m_trees.Add();
+		tree.firstNode = newOrder.Num();
+		tree.dirty = false;
+
+		newOrder.Add( iRoot );
+
+		for( UINT head = tree.firstNode; head < newOrder.Num(); head++ )
+		{
+			const UINT node = newOrder[ head ];
+
+			tree.dirty |= (m_flags[ node ] & NODE_DIRTY);
+
+			m_firstChild[ head ] = newOrder.Num();
+			m_numChildren[ head ] = childOffsets[ node + 1 ] - childOffsets[ node ];
+
+			for( UINT i = childOffsets[ node ]; i < childOffsets[ node + 1 ]; i++ )
+			{
+				newOrder.Add( children[ i ] );
+			}
+		}
+
+		tree.numNodes = newOrder.Num() - tree.firstNode;
+	}
+
+	Assert( newOrder.Num() == m_numLiveNodes );
+
+	const UINT numNodes = newOrder.Num();
+
+	// remap parent indices
+
+	TList< U4 >	oldToNew;
+	oldToNew.SetNum( numSlots );
+	for( UINT i = 0; i < numNodes; i++ )
+	{
+		oldToNew[ newOrder[ i ] ] = i;
+	}
+
+	PermuteArray( m_localMatrices, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_worldMatrices, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_localBounds, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_worldBounds, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_parents, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_flags, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_slotHandles, newOrder.ToPtr(), numNodes );
+	PermuteArray( m_userData, newOrder.ToPtr(), numNodes );
+
+	m_nodeTrees.SetNum( numNodes );
+
+	for( UINT iTree = 0; iTree < m_trees.Num(); iTree++ )
+	{
+		const rxTransformTree& tree = m_trees[ iTree ];
+		for( UINT i = tree.firstNode; i < tree.firstNode + tree.numNodes; i++ )
+		{
+			m_nodeTrees[ i ] = iTree;
+		}
+	}
+
+	for( UINT i = 0; i < numNodes; i++ )
+	{
+		if( m_parents[ i ] != INDEX_NONE ) {
+			m_parents[ i ] = oldToNew[ m_parents[ i ] ];
+		}
+		m_handleSlots[ m_slotHandles[ i ] ] = i;
+	}
+
+	m_reparentedNodes.Empty();
+
+	m_hierarchyChanged = false;
+}
+
+NO_EMPTY_FILE
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,147 @@
+/*
+=============================================================================
+	File:	TransformHierarchy.h
+	Desc:	Scene graph of transforms with dirty-flag propagation.
+=============================================================================
+*/
+#pragma once
+
+#include <Renderer/Common.h>
+
+class AsyncJobQueue;
+
+// handle of a node in rxTransformHierarchy (stays valid while the nodes are reordered)
+typedef U4 rxTransformHandle;
+
+/*
+-----------------------------------------------------------------------------
+	rxTransformTree
+
+	range of nodes belonging to a single root
+-----------------------------------------------------------------------------
+*/
+struct rxTransformTree
+{
+	U4	firstNode;
+	U4	numNodes;
+	U4	dirty;	// true if any node in the tree has been changed
+};
+mxDECLARE_POD_TYPE( rxTransformTree );
+
+/*
+-----------------------------------------------------------------------------
+	rxTransformHierarchy
+
+	stores transforms of attached objects (e.g. props on characters, wheels on vehicles)
+	in parallel arrays sorted so that each tree occupies a contiguous range
+	and nodes of each tree are in breadth-first order (parents always precede children).
+
+	Update() walks each changed tree in a single linear pass,
+	recomputing world matrices and world bounds only for changed nodes and their descendants.
+	independent trees are updated on worker threads.
+-----------------------------------------------------------------------------
+*/
+mxALIGN_16(class) rxTransformHierarchy
+{
+public:
+	rxTransformHierarchy();
+	~rxTransformHierarchy();
+
+	// creates a new node with identity transform,
+	// user data is an arbitrary index (e.g. model index), INDEX_NONE if not used
+	rxTransformHandle Add( rxTransformHandle parent = INDEX_NONE, UINT userData = INDEX_NONE );
+
+	// removes the node and attaches its children to the parent of the node
+	// (their world transforms are preserved)
+	void Remove( rxTransformHandle handle );
+
+	// pass INDEX_NONE to make the node a root
+	void SetParent( rxTransformHandle handle, rxTransformHandle parent );
+	rxTransformHandle GetParent( rxTransformHandle handle ) const;
+
+	// sets the transform relative to the parent node (or to the world if the node is a root)
+	void SetLocalTransform( rxTransformHandle handle, mat4_carg localToParent );
+	const float4x4& GetLocalTransform( rxTransformHandle handle ) const;
+
+	// sets bounds of the node in its local space
+	void SetLocalBounds( rxTransformHandle handle, const rxAABB& localBounds );
+
+	// valid after Update()
+	const float4x4& GetWorldTransform( rxTransformHandle handle ) const;
+	const rxAABB& GetWorldBounds( rxTransformHandle handle ) const;
+
+	UINT GetUserData( rxTransformHandle handle ) const;
+
+	UINT Num() const { return m_numLiveNodes; }
+	UINT NumTrees() const { return m_trees.Num(); }
+
+	void Clear();
+
+	// reorders nodes if the hierarchy has been changed
+	// and recomputes world matrices and bounds of changed subtrees,
+	// trees are updated in parallel if the job queue is not null
+	void Update( AsyncJobQueue* jobQueue = nil );
+
+	// nodes whose world transforms have been recomputed by the last Update()
+	UINT GetNumChangedNodes() const { return m_changedNodes.Num(); }
+	const rxTransformHandle* GetChangedNodes() const { return m_changedNodes.ToPtr(); }
+
+public_internal:
+	// recomputes world transforms of changed nodes in the tree
+	void UpdateTree( UINT iTree );
+
+private:
+	void SortNodes();
+	void MarkDirty( UINT slot );
+	void SetParentSlot( UINT slot, UINT parentSlot );
+
+	FORCEINLINE UINT GetSlot( rxTransformHandle handle ) const
+	{
+		Assert( handle < m_handleSlots.Num() && m_handleSlots[ handle ] != INDEX_NONE );
+		return m_handleSlots[ handle ];
+	}
+
+private:
+	enum
+	{
+		NODE_DIRTY		= BIT(0),	// the local transform or bounds have been changed
+		NODE_CHANGED	= BIT(1),	// the world transform has been recomputed
+	};
+
+	// per-node data indexed by slots
+	TList< float4x4 >	m_localMatrices;
+	TList< float4x4 >	m_worldMatrices;
+	TList< rxAABB >		m_localBounds;
+	TList< rxAABB >		m_worldBounds;
+	TList< U4 >			m_parents;		// slot of the parent node, INDEX_NONE for roots
+	TList< U1 >			m_flags;		// NODE_* flags
+	TList< U4 >			m_nodeTrees;	// index of the tree containing the node
+	TList< U4 >			m_slotHandles;	// INDEX_NONE for removed nodes
+	TList< U4 >			m_userData;
+
+	// children of each node in the sorted order (built by SortNodes(), removed children are not excluded)
+	TList< U4 >			m_firstChild;
+	TList< U4 >			m_numChildren;
+	// nodes added or reparented since the last sort (not in the child ranges of their parents)
+	TList< U4 >			m_reparentedNodes;
+
+	// indirection table for handles
+	TList< U4 >			m_handleSlots;
+	TList< U4 >			m_freeHandles;
+
+	TList< rxTransformTree >	m_trees;
+	TList< U4 >					m_dirtyTrees;	// scratch memory for Update()
+
+	TList< rxTransformHandle >	m_changedNodes;
+
+	UINT	m_numLiveNodes;
+
+	// true if nodes have been added, removed or reparented since the last sort
+	bool	m_hierarchyChanged;
+
+	NO_COPY_CONSTRUCTOR(rxTransformHierarchy);
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//